@@ -8,7 +8,31 @@
       "target_name": "openvg",
       "sources": [
         "src/openvg.cc",
-        "src/egl.cc"
+        "src/egl.cc",
+        "src/pixel_convert.cc",
+        "src/pixel_filter.cc",
+        "src/image_decode.cc",
+        "src/image_loader.cc",
+        "src/image_registry.cc",
+        "src/image_pyramid.cc",
+        "src/filter_graph.cc",
+        "src/khr_filters.cc",
+        "src/image_blur.cc",
+        "src/frame_diff.cc",
+        "src/font_face.cc",
+        "src/glyph_cache.cc",
+        "src/text_layer.cc",
+        "src/state_cache.cc",
+        "src/matrix_stack.cc",
+        "src/paint_cache.cc",
+        "src/clip_stack.cc",
+        "src/scene_graph.cc",
+        "src/sprite_batch.cc",
+        "src/canvas_context.cc",
+        "src/animation_timeline.cc",
+        "src/chart_geometry.cc",
+        "src/series_decimation.cc",
+        "src/draw_reorder.cc"
       ],
       "defines": [
         "NODE_BUFFER_TYPE_<(buffer_impl)",
@@ -16,7 +40,7 @@
         "V8_CALLBACK_STYLE_<(callback_style)"
       ],
       "ldflags": [
-        "-lGLESv2 -lEGL -lOpenVG -lSDL2",
+        "-lGLESv2 -lEGL -lOpenVG -lSDL2 -lpng -ljpeg",
       ],
       "cflags": [
         "-DENABLE_GDB_JIT_INTERFACE",
@@ -0,0 +1,133 @@
+//
+// Animates 500 scene nodes sliding back and forth with ease-in-out while
+// their paints pulse: easing in JS and setting transforms and colors each
+// frame, and as looping native animations that renderScene evaluates.
+// Prints the time per frame.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var PP = openVG.VGPaintParamType;
+
+var nodes = 500, columns = 25, frames = 100, duration = 2;
+
+util.init({ loadFonts: false });
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var rows = nodes / columns;
+var sync = new Buffer(4);
+var size = Math.min(width / columns, height / rows) / 2;
+var travel = width / columns;
+
+var path = openVG.createPath(openVG.VG_PATH_FORMAT_STANDARD,
+                             openVG.VGPathDatatype.VG_PATH_DATATYPE_F,
+                             1.0, 0.0, 0, 0,
+                             openVG.VGPathCapabilities.VG_PATH_CAPABILITY_ALL);
+openVG.vgu.rect(path, -size / 2, -size / 2, size, size);
+
+var root = openVG.createSceneNode();
+openVG.setSceneBackground(root, 1, 1, 1, 1);
+var squares = [];
+for (var i = 0; i < nodes; i++) {
+  var paint = openVG.createPaint();
+  openVG.setParameterFV(paint, PP.VG_PAINT_COLOR, new Float32Array([0.2, 0.3, 0.9, 1]));
+  var node = openVG.createSceneNode();
+  openVG.setNodePath(node, path, { fillPaint: paint });
+  openVG.appendSceneNode(root, node);
+  squares.push({
+    node: node,
+    paint: paint,
+    x: (i % columns + 0.25) * width / columns,
+    y: (Math.floor(i / columns) + 0.5) * height / rows,
+    phase: (i % 10) / 10 * duration
+  });
+}
+
+// CSS ease-in-out, as the JS loops of a dashboard would have it
+function easeInOut(p) {
+  var low = 0, high = 1, t = p;
+  for (var k = 0; k < 20; k++) {
+    var x = 3 * (1 - t) * (1 - t) * t * 0.42 + 3 * (1 - t) * t * t * 0.58 + t * t * t;
+    if (x < p) low = t; else high = t;
+    t = (low + high) / 2;
+  }
+  return 3 * (1 - t) * t * t + t * t * t;
+}
+
+var matrix = new Float32Array([1, 0, 0, 0, 1, 0, 0, 0, 1]);
+var color = new Float32Array([0.2, 0.3, 0.9, 1]);
+
+function jsFrame(time) {
+  for (var i = 0; i < nodes; i++) {
+    var square = squares[i];
+    var t = ((time + square.phase) % duration) / (duration / 2);
+    var p = t < 1 ? easeInOut(t) : easeInOut(2 - t);
+    matrix[6] = square.x + p * travel;
+    matrix[7] = square.y;
+    openVG.setNodeTransform(square.node, matrix);
+    color[2] = 0.5 + p / 2;
+    openVG.setParameterFV(square.paint, PP.VG_PAINT_COLOR, color);
+    openVG.invalidateSceneNode(square.node);
+  }
+  openVG.renderScene(root);
+}
+
+function nativeFrame() {
+  openVG.renderScene(root);
+}
+
+function measure(label, frame) {
+  frame(0);
+  util.end();
+
+  var start = process.hrtime();
+  for (var f = 1; f <= frames; f++) {
+    frame(f / 60);
+    util.end();
+  }
+  // Waits for the GPU (openVG.finish shuts down instead)
+  openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+  var elapsed = process.hrtime(start);
+
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms per frame');
+}
+
+measure('Eased in JS', jsFrame);
+
+var animations = squares.map(function(square) {
+  var animation = openVG.createAnimation();
+  openVG.addAnimationTrack(animation, { node: square.node, property: 'x' }, [
+    { time: 0, value: square.x, easing: 'ease-in-out' },
+    { time: duration / 2, value: square.x + travel, easing: 'ease-in-out' },
+    { time: duration, value: square.x }
+  ]);
+  openVG.addAnimationTrack(animation, { node: square.node, property: 'y' }, [
+    { time: 0, value: square.y }
+  ]);
+  openVG.addAnimationTrack(animation,
+                           { paint: square.paint, component: 'b', node: square.node }, [
+    { time: 0, value: 0.5, easing: 'ease-in-out' },
+    { time: duration / 2, value: 1, easing: 'ease-in-out' },
+    { time: duration, value: 0.5 }
+  ]);
+  openVG.seekAnimation(animation, square.phase);
+  openVG.playAnimation(animation, { loop: true });
+  return animation;
+});
+
+measure('Native animations', nativeFrame);
+
+var stats = {};
+openVG.getAnimationStats(stats);
+console.log('  ' + stats.tracks + ' tracks, ' + stats.updates + ' updates, ' +
+            stats.unchanged + ' unchanged');
+
+animations.forEach(function(animation) {
+  openVG.destroyAnimation(animation);
+});
+util.finish();
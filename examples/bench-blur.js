@@ -0,0 +1,117 @@
+//
+// fastGaussianBlur against gaussianBlur for growing deviations: time per
+// call, and the error against a reference separable Gaussian computed here.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var Q = openVG.VGImageQuality;
+var T = openVG.VGTilingMode;
+
+var size = 512, rounds = 10;
+var deviations = [ 4, 8, 16, 32, 64 ];
+
+util.init({ loadFonts: false });
+
+var src = openVG.createImage(F.VG_sRGBA_8888_PRE, size, size, Q.VG_IMAGE_QUALITY_BETTER);
+var dst = openVG.createImage(F.VG_sRGBA_8888_PRE, size, size, Q.VG_IMAGE_QUALITY_BETTER);
+
+// A checkerboard of 32 pixel squares
+var pixels = new Buffer(size * size * 4);
+for (var y = 0; y < size; y++) {
+  for (var x = 0; x < size; x++) {
+    var i = (y * size + x) * 4;
+    var on = ((x >> 5) + (y >> 5)) & 1 ? 255 : 0;
+    pixels[i] = pixels[i + 1] = pixels[i + 2] = on;
+    pixels[i + 3] = 255;
+  }
+}
+openVG.imageSubData(src, pixels, size * 4, F.VG_sABGR_8888_PRE, 0, 0, size, size);
+
+// Separable Gaussian, edges padded, on the first channel only
+function reference(stdDeviation) {
+  var radius = Math.ceil(stdDeviation * 3);
+  var kernel = new Float64Array(2 * radius + 1), sum = 0;
+  for (var k = -radius; k <= radius; k++) {
+    sum += kernel[k + radius] = Math.exp(-k * k / (2 * stdDeviation * stdDeviation));
+  }
+  for (k = 0; k < kernel.length; k++) {
+    kernel[k] /= sum;
+  }
+
+  function clamp(v) { return v < 0 ? 0 : v >= size ? size - 1 : v; }
+
+  var rows = new Float64Array(size * size), out = new Float64Array(size * size);
+  for (var y = 0; y < size; y++) {
+    for (var x = 0; x < size; x++) {
+      var acc = 0;
+      for (k = -radius; k <= radius; k++) {
+        acc += kernel[k + radius] * pixels[(y * size + clamp(x + k)) * 4];
+      }
+      rows[y * size + x] = acc;
+    }
+  }
+  for (y = 0; y < size; y++) {
+    for (x = 0; x < size; x++) {
+      acc = 0;
+      for (k = -radius; k <= radius; k++) {
+        acc += kernel[k + radius] * rows[clamp(y + k) * size + x];
+      }
+      out[y * size + x] = acc;
+    }
+  }
+  return out;
+}
+
+function time(fn) {
+  var sync = new Buffer(4);
+  fn();  // Warm up
+  var start = process.hrtime();
+  for (var r = 0; r < rounds; r++) {
+    fn();
+  }
+  // Waits for the GPU
+  openVG.getImageSubData(dst, sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+  var elapsed = process.hrtime(start);
+  return (elapsed[0] * 1e3 + elapsed[1] / 1e6) / rounds;
+}
+
+var maxDeviation = openVG.getF(openVG.VGParamType.VG_MAX_GAUSSIAN_STD_DEVIATION);
+var result = new Buffer(size * size * 4);
+
+deviations.forEach(function(stdDeviation) {
+  var path;
+  var fast = time(function() {
+    path = openVG.fastGaussianBlur(dst, src, stdDeviation, stdDeviation, T.VG_TILE_PAD);
+  });
+
+  openVG.getImageSubData(dst, result, size * 4, F.VG_sABGR_8888_PRE, 0, 0, size, size);
+  var expected = reference(stdDeviation), total = 0, worst = 0;
+  for (var i = 0; i < size * size; i++) {
+    var error = Math.abs(result[i * 4] - expected[i]);
+    total += error;
+    worst = Math.max(worst, error);
+  }
+
+  var line = 'stdDeviation ' + stdDeviation + ' (' + path + '): ' +
+             fast.toFixed(2) + ' ms, error mean ' +
+             (total / (size * size)).toFixed(2) + ' max ' + worst.toFixed(0) + ' /255';
+
+  if (stdDeviation <= maxDeviation) {
+    var exact = time(function() {
+      openVG.gaussianBlur(dst, src, stdDeviation, stdDeviation, T.VG_TILE_PAD);
+    });
+    line += ', gaussianBlur ' + exact.toFixed(2) + ' ms (x' +
+            (exact / fast).toFixed(1) + ')';
+  } else {
+    line += ', beyond VG_MAX_GAUSSIAN_STD_DEVIATION (' + maxDeviation + ')';
+  }
+  console.log(line);
+});
+
+openVG.destroyImage(src);
+openVG.destroyImage(dst);
+util.finish();
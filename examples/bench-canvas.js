@@ -0,0 +1,186 @@
+//
+// Draws 1000 rotated squares and circles per frame, filled and stroked
+// with a color of their own, the way a canvas does: once through a JS
+// context keeping its path in arrays and calling the 1:1 bindings for each
+// fill and stroke, and once through createCanvasContext. Prints the time
+// per frame.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var P = openVG.VGParamType;
+var PP = openVG.VGPaintParamType;
+var C = openVG.VGPathCommand;
+var M = openVG.VGPaintMode;
+
+var shapes = 1000, frames = 30;
+
+util.init({ loadFonts: false });
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var sync = new Buffer(4);
+
+var colors = [];
+for (var i = 0; i < 16; i++) {
+  colors.push('rgb(' + (i * 16) + ',' + (255 - i * 16) + ',128)');
+}
+
+// A canvas context in JS over the 1:1 bindings, only what the benchmark
+// uses: paths kept in arrays, a paint set per fill and stroke, the matrix
+// loaded for each.
+function JSContext() {
+  this.path = openVG.createPath(openVG.VG_PATH_FORMAT_STANDARD,
+                                openVG.VGPathDatatype.VG_PATH_DATATYPE_F,
+                                1.0, 0.0, 0, 0,
+                                openVG.VGPathCapabilities.VG_PATH_CAPABILITY_ALL);
+  this.fillPaint = openVG.createPaint();
+  this.strokePaint = openVG.createPaint();
+  this.matrix = [1, 0, 0, 0, -1, 0, 0, height, 1];
+  this.saved = [];
+  this.segments = [];
+  this.points = [];
+  this.fillStyle = this.strokeStyle = 'black';
+}
+
+JSContext.prototype.color = function(style) {
+  var match = /rgb\((\d+),(\d+),(\d+)\)/.exec(style) || [0, 0, 0, 0];
+  return new Float32Array([match[1] / 255, match[2] / 255, match[3] / 255, 1]);
+};
+
+JSContext.prototype.save = function() {
+  this.saved.push(this.matrix.slice());
+};
+
+JSContext.prototype.restore = function() {
+  this.matrix = this.saved.pop();
+};
+
+JSContext.prototype.translate = function(x, y) {
+  var m = this.matrix;
+  m[6] += m[0] * x + m[3] * y;
+  m[7] += m[1] * x + m[4] * y;
+};
+
+JSContext.prototype.rotate = function(angle) {
+  var m = this.matrix, c = Math.cos(angle), s = Math.sin(angle);
+  var m0 = m[0], m1 = m[1];
+  m[0] = c * m0 + s * m[3]; m[1] = c * m1 + s * m[4];
+  m[3] = -s * m0 + c * m[3]; m[4] = -s * m1 + c * m[4];
+};
+
+JSContext.prototype.beginPath = function() {
+  this.segments = [];
+  this.points = [];
+};
+
+JSContext.prototype.moveTo = function(x, y) {
+  this.segments.push(C.VG_MOVE_TO_ABS);
+  this.points.push(x, y);
+};
+
+JSContext.prototype.lineTo = function(x, y) {
+  this.segments.push(C.VG_LINE_TO_ABS);
+  this.points.push(x, y);
+};
+
+JSContext.prototype.closePath = function() {
+  this.segments.push(openVG.VGPathSegment.VG_CLOSE_PATH);
+};
+
+JSContext.prototype.arc = function(x, y, r) {
+  var k = 0.5522847 * r;
+  this.moveTo(x + r, y);
+  for (var q = 0; q < 4; q++) {
+    var a = q * Math.PI / 2, b = a + Math.PI / 2;
+    this.segments.push(C.VG_CUBIC_TO_ABS);
+    this.points.push(x + r * Math.cos(a) - k * Math.sin(a),
+                     y + r * Math.sin(a) + k * Math.cos(a),
+                     x + r * Math.cos(b) + k * Math.sin(b),
+                     y + r * Math.sin(b) - k * Math.cos(b),
+                     x + r * Math.cos(b), y + r * Math.sin(b));
+  }
+};
+
+JSContext.prototype.draw = function(paint, style, mode) {
+  openVG.clearPath(this.path, openVG.VGPathCapabilities.VG_PATH_CAPABILITY_ALL);
+  openVG.appendPathData(this.path, this.segments.length,
+                        new Uint8Array(this.segments),
+                        new Float32Array(this.points));
+  openVG.setParameterFV(paint, PP.VG_PAINT_COLOR, this.color(style));
+  openVG.setPaint(paint, mode);
+  openVG.setI(P.VG_MATRIX_MODE,
+              openVG.VGMatrixMode.VG_MATRIX_PATH_USER_TO_SURFACE);
+  openVG.loadMatrix(new Float32Array(this.matrix));
+  openVG.drawPath(this.path, mode);
+};
+
+JSContext.prototype.fill = function() {
+  this.draw(this.fillPaint, this.fillStyle, M.VG_FILL_PATH);
+};
+
+JSContext.prototype.stroke = function() {
+  this.draw(this.strokePaint, this.strokeStyle, M.VG_STROKE_PATH);
+};
+
+function scene(ctx, f) {
+  for (var i = 0; i < shapes; i++) {
+    ctx.save();
+    ctx.translate((i * 37) % width, (i * 53 + f) % height);
+    ctx.rotate((i + f) * 0.05);
+    ctx.beginPath();
+    if (i % 2 === 0) {
+      ctx.moveTo(-8, -8);
+      ctx.lineTo(8, -8);
+      ctx.lineTo(8, 8);
+      ctx.lineTo(-8, 8);
+      ctx.closePath();
+    } else {
+      ctx.arc(0, 0, 8, 0, 2 * Math.PI);
+    }
+    ctx.fillStyle = colors[i % colors.length];
+    ctx.fill();
+    ctx.strokeStyle = colors[(i + 5) % colors.length];
+    ctx.stroke();
+    ctx.restore();
+  }
+}
+
+function measure(label, ctx) {
+  util.start();
+  scene(ctx, 0);
+
+  var start = process.hrtime();
+  for (var f = 0; f < frames; f++) {
+    util.start();
+    scene(ctx, f);
+    // Waits for the GPU (openVG.finish shuts down instead)
+    openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+    util.end();
+  }
+  var elapsed = process.hrtime(start);
+
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms per frame');
+}
+
+var js = new JSContext();
+measure('JS context over the bindings', js);
+
+var native = openVG.createCanvasContext(width, height);
+measure('Native canvas context', native);
+
+var stats = {};
+openVG.getCanvasStats(stats);
+console.log('  ' + stats.draws + ' draws, ' + stats.pathBuilds +
+            ' path builds, ' + stats.pathReuses + ' reused');
+
+native.destroy();
+openVG.destroyPath(js.path);
+openVG.destroyPaint(js.fillPaint);
+openVG.destroyPaint(js.strokePaint);
+
+util.finish();
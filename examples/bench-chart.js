@@ -0,0 +1,111 @@
+//
+// Draws a 1000 bar chart and a 10k point line chart per frame: each bar a
+// util.rect and the line assembled in JS for appendPathData, then each
+// series built natively into one path drawn once. Prints the time per
+// frame.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var C = openVG.VGPathCommand;
+var M = openVG.VGPaintMode;
+
+var bars = 1000, points = 10000, frames = 30;
+
+util.init({ loadFonts: false });
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var sync = new Buffer(4);
+
+var barValues = new Float32Array(bars);
+var lineValues = new Float32Array(points);
+for (var i = 0; i < bars; i++) {
+  barValues[i] = 50 + 40 * Math.sin(i / 30);
+}
+for (var i = 0; i < points; i++) {
+  lineValues[i] = 50 + 30 * Math.sin(i / 200) + 10 * Math.sin(i / 7);
+}
+
+var barAxis = { xMin: -0.5, xMax: bars - 0.5, yMin: 0, yMax: 100,
+                left: 0, bottom: height / 2, width: width, height: height / 2 };
+var lineAxis = { yMin: 0, yMax: 100, left: 0, bottom: 0,
+                 width: width, height: height / 2 };
+
+function newPath() {
+  return openVG.createPath(openVG.VG_PATH_FORMAT_STANDARD,
+                           openVG.VGPathDatatype.VG_PATH_DATATYPE_F,
+                           1.0, 0.0, 0, 0,
+                           openVG.VGPathCapabilities.VG_PATH_CAPABILITY_ALL);
+}
+
+var line = newPath(), barPath = newPath();
+
+function jsFrame() {
+  var barWidth = width / bars;
+  for (var i = 0; i < bars; i++) {
+    util.rect(i * barWidth + barWidth * 0.1, height / 2,
+              barWidth * 0.8, barValues[i] / 100 * height / 2);
+  }
+
+  var segments = new Uint8Array(points);
+  var coords = new Float32Array(points * 2);
+  for (var i = 0; i < points; i++) {
+    segments[i] = i === 0 ? C.VG_MOVE_TO_ABS : C.VG_LINE_TO_ABS;
+    coords[i * 2] = i / (points - 1) * width;
+    coords[i * 2 + 1] = lineValues[i] / 100 * height / 2;
+  }
+  openVG.clearPath(line, openVG.VGPathCapabilities.VG_PATH_CAPABILITY_ALL);
+  openVG.appendPathData(line, points, segments, coords);
+  openVG.drawPath(line, M.VG_STROKE_PATH);
+}
+
+function nativeFrame() {
+  openVG.chartBars(barPath, barValues, barAxis);
+  openVG.drawPath(barPath, M.VG_FILL_PATH | M.VG_STROKE_PATH);
+
+  openVG.chartPolyline(line, lineValues, lineAxis);
+  openVG.drawPath(line, M.VG_STROKE_PATH);
+}
+
+// util.start resets the paints and the stroke width
+function startFrame() {
+  util.start();
+  util.fill(44, 77, 232, 1);
+  util.strokeWidth(1);
+}
+
+function measure(label, frame) {
+  startFrame();
+  frame();
+
+  var start = process.hrtime();
+  for (var f = 0; f < frames; f++) {
+    startFrame();
+    frame();
+    // Waits for the GPU (openVG.finish shuts down instead)
+    openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+    util.end();
+  }
+  var elapsed = process.hrtime(start);
+
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms per frame');
+}
+
+measure('util.rect bars, line assembled in JS', jsFrame);
+measure('Native chart paths', nativeFrame);
+
+var stats = {};
+openVG.getChartStats(stats);
+console.log('  ' + stats.series + ' series, ' + stats.points + ' points, ' +
+            stats.segments + ' segments');
+
+[line, barPath].forEach(function(path) {
+  openVG.destroyPath(path);
+});
+
+util.finish();
@@ -0,0 +1,118 @@
+//
+// Draws 8 scrolling lists of 40 rows per frame, each list clipped to its
+// rounded panel and, inside it, to the rectangle its rows scroll in. Clips
+// are made with mask layers created, rendered and destroyed per clip as the
+// raw calls allow, and with pushClip / popClip. Prints the time per frame.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var P = openVG.VGParamType;
+var M = openVG.VGMaskOperation;
+
+var lists = 8, rows = 40, frames = 50;
+
+util.init({ loadFonts: false });
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var sync = new Buffer(4);
+var listWidth = width / lists, rowHeight = height / 10;
+
+function createPath() {
+  return openVG.createPath(openVG.VG_PATH_FORMAT_STANDARD,
+                           openVG.VGPathDatatype.VG_PATH_DATATYPE_F,
+                           1.0, 0.0, 0, 0,
+                           openVG.VGPathCapabilities.VG_PATH_CAPABILITY_ALL);
+}
+
+var panel = createPath();
+openVG.vgu.roundRect(panel, 4, 4, listWidth - 8, height - 8, 24, 24);
+var viewport = createPath();
+openVG.vgu.rect(viewport, 8, 40, listWidth - 16, height - 80);
+var row = createPath();
+openVG.vgu.rect(row, 8, 0, listWidth - 16, rowHeight - 2);
+
+function drawRows(scroll) {
+  for (var r = 0; r < rows; r++) {
+    openVG.pushMatrix();
+    openVG.translate(0, r * rowHeight - scroll);
+    openVG.drawPath(row, openVG.VGPaintMode.VG_FILL_PATH);
+    openVG.popMatrix();
+  }
+}
+
+function pushMaskLayer(path) {
+  var layer = openVG.createMaskLayer(width, height);
+  openVG.copyMask(layer, 0, 0, 0, 0, width, height);
+  openVG.renderToMask(path, openVG.VGPaintMode.VG_FILL_PATH, M.VG_INTERSECT_MASK);
+  openVG.setI(P.VG_MASKING, 1);
+  return layer;
+}
+
+function popMaskLayer(layer) {
+  openVG.mask(layer, M.VG_SET_MASK, 0, 0, width, height);
+  openVG.destroyMaskLayer(layer);
+}
+
+function withMaskLayers(l, scroll) {
+  var outer = pushMaskLayer(panel);
+  openVG.drawPath(panel, openVG.VGPaintMode.VG_FILL_PATH);
+  var inner = pushMaskLayer(viewport);
+  drawRows(scroll);
+  popMaskLayer(inner);
+  popMaskLayer(outer);
+}
+
+function withClipStack(l, scroll) {
+  openVG.pushClip(panel);
+  openVG.drawPath(panel, openVG.VGPaintMode.VG_FILL_PATH);
+  openVG.pushClip(8, 40, listWidth - 16, height - 80);
+  drawRows(scroll);
+  openVG.popClip();
+  openVG.popClip();
+}
+
+function frame(list, f) {
+  util.start();
+  openVG.mask(0, M.VG_FILL_MASK, 0, 0, width, height);
+  for (var l = 0; l < lists; l++) {
+    openVG.pushMatrix();
+    openVG.translate(l * listWidth, 0);
+    list(l, (f * 7 + l * 50) % (rows * rowHeight - height));
+    openVG.popMatrix();
+  }
+  openVG.setI(P.VG_MASKING, 0);
+  // Waits for the GPU (openVG.finish shuts down instead)
+  openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+}
+
+function measure(label, list) {
+  frame(list, 0);
+
+  var start = process.hrtime();
+  for (var f = 0; f < frames; f++) {
+    frame(list, f);
+  }
+  var elapsed = process.hrtime(start);
+
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms per frame');
+}
+
+measure('Mask layer per clip', withMaskLayers);
+measure('pushClip/popClip', withClipStack);
+
+var stats = {};
+openVG.getClipStats(stats);
+console.log('  ' + stats.scissorClips + ' scissored, ' + stats.maskClips +
+            ' masked, ' + stats.layers + ' mask layers');
+
+openVG.destroyPath(row);
+openVG.destroyPath(viewport);
+openVG.destroyPath(panel);
+
+util.finish();
@@ -0,0 +1,57 @@
+//
+// Throughput of the native pixel format conversions (convertPixels), in MB/s
+// of source data. Doesn't need a display.
+//
+
+var openVG = require('../openvg');
+
+var F = openVG.VGImageFormat;
+var X = openVG.VGImageFormatExt;
+
+var width = 1920, height = 1080, rounds = 20;
+
+var conversions = [
+  [ 'RGBA -> ABGR'    , F.VG_sRGBA_8888    , F.VG_sABGR_8888     ],
+  [ 'BGRA -> RGBA'    , F.VG_sBGRA_8888    , F.VG_sRGBA_8888     ],
+  [ 'ARGB -> RGBA'    , F.VG_sARGB_8888    , F.VG_sRGBA_8888     ],
+  [ 'RGBA -> RGBA_PRE', F.VG_sRGBA_8888    , F.VG_sRGBA_8888_PRE ],
+  [ 'BGRA -> RGBA_PRE', F.VG_sBGRA_8888    , F.VG_sRGBA_8888_PRE ],
+  [ 'RGBA_PRE -> RGBA', F.VG_sRGBA_8888_PRE, F.VG_sRGBA_8888     ],
+  [ 'RGB888 -> RGBA'  , X.VG_sRGB_888_EXT  , F.VG_sRGBA_8888     ],
+  [ 'RGBA -> RGB565'  , F.VG_sRGBA_8888    , F.VG_sRGB_565       ],
+  [ 'RGB565 -> RGBA'  , F.VG_sRGB_565      , F.VG_sRGBA_8888     ],
+  [ 'RGBA -> A8'      , F.VG_sRGBA_8888    , F.VG_A_8            ],
+  [ 'A8 -> RGBA_PRE'  , F.VG_A_8           , F.VG_sRGBA_8888_PRE ]
+];
+
+function bytesPerPixel(format) {
+  if (format === X.VG_sRGB_888_EXT || format === X.VG_sBGR_888_EXT) { return 3; }
+  if (format === F.VG_sRGB_565) { return 2; }
+  if (format === F.VG_A_8) { return 1; }
+  return 4;
+}
+
+var src = new Buffer(width * height * 4);
+var dst = new Buffer(width * height * 4);
+for (var i = 0; i < src.length; i++) {
+  src[i] = (i * 2654435761) >>> 24;
+}
+
+conversions.forEach(function(conversion) {
+  var srcFormat = conversion[1], dstFormat = conversion[2];
+  var srcStride = width * bytesPerPixel(srcFormat);
+  var dstStride = width * bytesPerPixel(dstFormat);
+
+  // Warm up
+  openVG.convertPixels(dst, dstStride, dstFormat, src, srcStride, srcFormat, width, height);
+
+  var start = process.hrtime();
+  for (var r = 0; r < rounds; r++) {
+    openVG.convertPixels(dst, dstStride, dstFormat, src, srcStride, srcFormat, width, height);
+  }
+  var elapsed = process.hrtime(start);
+  var seconds = elapsed[0] + elapsed[1] / 1e9;
+
+  console.log(conversion[0] + ": " +
+              (rounds * srcStride * height / seconds / 1e6).toFixed(0) + " MB/s");
+});
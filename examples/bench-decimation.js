@@ -0,0 +1,108 @@
+//
+// Draws a 10M point sensor stream across the screen: every point appended
+// to the path, the whole series through chartPolyline, and decimated to
+// the screen width by min/max and by LTTB with chartDecimated. Prints the
+// time per frame and the points each draws.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var C = openVG.VGPathCommand;
+var M = openVG.VGPaintMode;
+var D = openVG.VGDecimationMethod;
+
+var points = 10000000, frames = 5;
+
+util.init({ loadFonts: false });
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var sync = new Buffer(4);
+
+var times = new Float32Array(points);
+var values = new Float32Array(points);
+for (var i = 0; i < points; i++) {
+  times[i] = i / 1000;
+  values[i] = 50 + 30 * Math.sin(i / 200000) + 10 * Math.sin(i / 50) +
+              (i % 100003 === 0 ? 15 : 0);
+}
+
+var axis = { xMin: 0, xMax: times[points - 1], yMin: 0, yMax: 100,
+             left: 0, bottom: 0, width: width, height: height };
+
+var path = openVG.createPath(openVG.VG_PATH_FORMAT_STANDARD,
+                             openVG.VGPathDatatype.VG_PATH_DATATYPE_F,
+                             1.0, 0.0, 0, 0,
+                             openVG.VGPathCapabilities.VG_PATH_CAPABILITY_ALL);
+
+var segments = new Uint8Array(points);
+var coords = new Float32Array(points * 2);
+
+function allPointsFrame() {
+  for (var i = 0; i < points; i++) {
+    segments[i] = i === 0 ? C.VG_MOVE_TO_ABS : C.VG_LINE_TO_ABS;
+    coords[i * 2] = times[i] / axis.xMax * width;
+    coords[i * 2 + 1] = values[i] / 100 * height;
+  }
+  openVG.clearPath(path, openVG.VGPathCapabilities.VG_PATH_CAPABILITY_ALL);
+  openVG.appendPathData(path, points, segments, coords);
+  openVG.drawPath(path, M.VG_STROKE_PATH);
+  return points;
+}
+
+function polylineFrame() {
+  var drawn = openVG.chartPolyline(path, values, axis, { x: times });
+  openVG.drawPath(path, M.VG_STROKE_PATH);
+  return drawn;
+}
+
+function decimatedFrame(method) {
+  return function() {
+    var drawn = openVG.chartDecimated(path, values, axis,
+                                      { x: times, method: method });
+    openVG.drawPath(path, M.VG_STROKE_PATH);
+    return drawn;
+  };
+}
+
+// util.start resets the stroke width
+function startFrame() {
+  util.start();
+  util.strokeWidth(1);
+}
+
+function measure(label, frame) {
+  startFrame();
+  frame();
+
+  var drawn = 0;
+  var start = process.hrtime();
+  for (var f = 0; f < frames; f++) {
+    startFrame();
+    drawn = frame();
+    // Waits for the GPU (openVG.finish shuts down instead)
+    openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+    util.end();
+  }
+  var elapsed = process.hrtime(start);
+
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms per frame, ' + drawn + ' points drawn');
+}
+
+measure('Every point through appendPathData', allPointsFrame);
+measure('Every point through chartPolyline', polylineFrame);
+measure('Min/max per pixel column', decimatedFrame(D.MIN_MAX));
+measure('LTTB', decimatedFrame(D.LTTB));
+
+var stats = {};
+openVG.getDecimationStats(stats);
+console.log('  ' + stats.series + ' series decimated, ' + stats.points +
+            ' points read, ' + stats.decimated + ' kept');
+
+openVG.destroyPath(path);
+
+util.finish();
@@ -0,0 +1,99 @@
+//
+// Time per call of the KHR filters, on the CPU fallback and, when the
+// driver has the extensions, natively.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var Q = openVG.VGImageQuality;
+var T = openVG.VGTilingMode;
+var PF = openVG.VGPfTypeKHR;
+
+var size = 512, rounds = 20;
+var quality = Q.VG_IMAGE_QUALITY_BETTER;
+
+util.init({ loadFonts: false });
+
+var src = openVG.createImage(F.VG_sRGBA_8888_PRE, size, size, quality);
+var dst = openVG.createImage(F.VG_sRGBA_8888_PRE, size, size, quality);
+var blur = openVG.createImage(F.VG_sRGBA_8888_PRE, size, size, quality);
+
+// An opaque disc on a transparent background
+var pixels = new Buffer(size * size * 4);
+for (var y = 0; y < size; y++) {
+  for (var x = 0; x < size; x++) {
+    var i = (y * size + x) * 4;
+    var dx = x - size / 2, dy = y - size / 2;
+    var inside = dx * dx + dy * dy < size * size / 9 ? 255 : 0;
+    pixels[i] = pixels[i + 1] = pixels[i + 3] = inside;
+    pixels[i + 2] = 0;
+  }
+}
+openVG.imageSubData(src, pixels, size * 4, F.VG_sABGR_8888_PRE, 0, 0, size, size);
+openVG.ext.iterativeAverageBlurKHR(blur, src, 8, 8, 3, T.VG_TILE_FILL);
+
+var stops = new Float32Array([0, 1, 1, 1, 0, 1, 1, 0.5, 0, 1]);
+var outer = PF.VG_PF_OBJECT_VISIBLE_FLAG_KHR | PF.VG_PF_OUTER_FLAG_KHR;
+var inner = PF.VG_PF_OBJECT_VISIBLE_FLAG_KHR | PF.VG_PF_INNER_FLAG_KHR;
+
+var filters = [
+  [ 'iterativeAverageBlur', function() {
+    openVG.ext.iterativeAverageBlurKHR(dst, src, 8, 8, 3, T.VG_TILE_FILL);
+  } ],
+  [ 'parametricFilter', function() {
+    openVG.ext.parametricFilterKHR(dst, src, blur, 1, 4, 4, outer, 0, 0);
+  } ],
+  [ 'dropShadow', function() {
+    openVG.ext.dropShadowKHR(dst, src, 8, 8, 3, 1, 6, 45, outer, quality, 0x000000a0);
+  } ],
+  [ 'glow', function() {
+    openVG.ext.glowKHR(dst, src, 8, 8, 3, 2, outer, quality, 0xffff00ff);
+  } ],
+  [ 'bevel', function() {
+    openVG.ext.bevelKHR(dst, src, 8, 8, 3, 2, 4, 45, inner, quality, 0xffffffff, 0x000000ff);
+  } ],
+  [ 'gradientGlow', function() {
+    openVG.ext.gradientGlowKHR(dst, src, 8, 8, 3, 2, 0, 0, outer, quality, 2, stops);
+  } ],
+  [ 'gradientBevel', function() {
+    openVG.ext.gradientBevelKHR(dst, src, 8, 8, 3, 2, 4, 45, inner, quality, 2, stops);
+  } ]
+];
+
+var sync = new Buffer(4);
+
+function measure(label) {
+  filters.forEach(function(filter) {
+    filter[1]();  // Warm up
+
+    var start = process.hrtime();
+    for (var r = 0; r < rounds; r++) {
+      filter[1]();
+    }
+    // Waits for the GPU
+    openVG.getImageSubData(dst, sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+    var elapsed = process.hrtime(start);
+
+    console.log(label + ' ' + filter[0] + ': ' +
+                ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / rounds).toFixed(2) +
+                ' ms');
+  });
+}
+
+openVG.ext.forceCPUFiltersKHR(true);
+measure('CPU');
+openVG.ext.forceCPUFiltersKHR(false);
+
+if (openVG.ext.hasNativeFiltersKHR()) {
+  measure('Native');
+} else {
+  console.log('No native KHR filters to compare with');
+}
+
+openVG.destroyImage(src);
+openVG.destroyImage(dst);
+openVG.destroyImage(blur);
+util.finish();
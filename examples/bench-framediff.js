@@ -0,0 +1,95 @@
+//
+// Mirrors the screen while a few small rectangles change every frame:
+// bytes and time per frame of a full readPixels against captureFrameDiff,
+// with and without run-length encoding.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var P = openVG.VGParamType;
+
+var frames = 100, changesPerFrame = 3;
+
+util.init({ loadFonts: false });
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var color = new Float32Array(4);
+
+function fill(x, y, w, h, r, g, b) {
+  color[0] = r; color[1] = g; color[2] = b; color[3] = 1;
+  openVG.setFV(P.VG_CLEAR_COLOR, color);
+  openVG.clear(x, y, w, h);
+}
+
+// Flat vertical bands, like a desktop with windows
+function background() {
+  for (var x = 0; x < width; x += 160) {
+    var shade = (x / width) * 0.8 + 0.1;
+    fill(x, 0, 160, height, shade, shade, 1 - shade);
+  }
+}
+
+// Deterministic "random" so every run changes the same areas
+var seed = 1;
+function random() {
+  seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+  return seed / 0x7fffffff;
+}
+
+function change() {
+  for (var c = 0; c < changesPerFrame; c++) {
+    fill((random() * (width - 80)) | 0, (random() * (height - 20)) | 0, 80, 20,
+         random(), random(), random());
+  }
+}
+
+function measure(label, capture) {
+  seed = 1;
+  background();
+  capture();  // First frame, sent whole
+
+  var bytes = 0, elapsed = [0, 0];
+  for (var f = 0; f < frames; f++) {
+    change();
+    // Only time the capture, waiting for the drawing first
+    openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+    var start = process.hrtime();
+    bytes += capture();
+    var delta = process.hrtime(start);
+    elapsed[0] += delta[0];
+    elapsed[1] += delta[1];
+  }
+
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms, ' + (bytes / frames / 1024).toFixed(1) + ' KiB per frame');
+}
+
+var sync = new Buffer(4);
+var full = new Buffer(width * height * 4);
+
+measure('readPixels', function() {
+  openVG.readPixels(full, width * 4, F.VG_sRGBA_8888, 0, 0, width, height);
+  return full.length;
+});
+
+[ false, true ].forEach(function(rle) {
+  var diff = openVG.createFrameDiff(0, 0, width, height, { rle: rle });
+  var info = {};
+  openVG.getFrameDiffInfo(diff, info);
+  var out = new Buffer(info.maxBytes);
+
+  measure('captureFrameDiff' + (rle ? ' (RLE)' : ''), function() {
+    return openVG.captureFrameDiff(diff, out);
+  });
+
+  openVG.getFrameDiffInfo(diff, info);
+  console.log('  last frame: ' + info.changedTiles + ' of ' + info.tiles +
+              ' tiles, ' + info.rleTiles + ' run-length encoded');
+  openVG.destroyFrameDiff(diff);
+});
+
+util.finish();
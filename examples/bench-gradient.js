@@ -0,0 +1,99 @@
+//
+// Draws a chart of 500 bars filled with 10 different gradients per frame,
+// building each gradient paint every time and getting it from the gradient
+// cache, and prints the time per frame.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var T = openVG.VGPaintType;
+var PP = openVG.VGPaintParamType;
+
+var bars = 500, series = 10, frames = 50;
+
+util.init({ loadFonts: false });
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var sync = new Buffer(4);
+var barWidth = width / bars;
+
+var path = openVG.createPath(openVG.VG_PATH_FORMAT_STANDARD,
+                             openVG.VGPathDatatype.VG_PATH_DATATYPE_F,
+                             1.0, 0.0, 0, 0,
+                             openVG.VGPathCapabilities.VG_PATH_CAPABILITY_ALL);
+openVG.vgu.rect(path, 0, 0, barWidth - 1, height);
+
+var geometry = new Float32Array([0, 0, 0, height]);
+var ramps = [];
+for (var s = 0; s < series; s++) {
+  ramps.push(new Float32Array([
+    0.0, s / series, 0.2, 1 - s / series, 1,
+    0.5, 1, 1, 1, 1,
+    1.0, 1 - s / series, 0.5, s / series, 1
+  ]));
+}
+
+function createGradient(s) {
+  var paint = openVG.createPaint();
+  openVG.setParameterI(paint, PP.VG_PAINT_TYPE, T.VG_PAINT_TYPE_LINEAR_GRADIENT);
+  openVG.setParameterFV(paint, PP.VG_PAINT_LINEAR_GRADIENT, geometry);
+  openVG.setParameterFV(paint, PP.VG_PAINT_COLOR_RAMP_STOPS, ramps[s]);
+  openVG.setParameterI(paint, PP.VG_PAINT_COLOR_RAMP_SPREAD_MODE,
+                       openVG.VGColorRampSpreadMode.VG_COLOR_RAMP_SPREAD_PAD);
+  return paint;
+}
+
+function built(i) {
+  var paint = createGradient(i % series);
+  openVG.setPaint(paint, openVG.VGPaintMode.VG_FILL_PATH);
+  openVG.drawPath(path, openVG.VGPaintMode.VG_FILL_PATH);
+  openVG.destroyPaint(paint);
+}
+
+function cached(i) {
+  var paint = openVG.getGradientPaint(T.VG_PAINT_TYPE_LINEAR_GRADIENT,
+                                      geometry, ramps[i % series]);
+  openVG.setPaint(paint, openVG.VGPaintMode.VG_FILL_PATH);
+  openVG.drawPath(path, openVG.VGPaintMode.VG_FILL_PATH);
+}
+
+function frame(bar) {
+  util.start();
+  for (var i = 0; i < bars; i++) {
+    openVG.pushMatrix();
+    openVG.translate(i * barWidth, -height * (1 - (i * 37 % 100) / 100));
+    bar(i);
+    openVG.popMatrix();
+  }
+  // Waits for the GPU (openVG.finish shuts down instead)
+  openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+}
+
+function measure(label, bar) {
+  frame(bar);
+
+  var start = process.hrtime();
+  for (var f = 0; f < frames; f++) {
+    frame(bar);
+  }
+  var elapsed = process.hrtime(start);
+
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms per frame');
+}
+
+measure('Gradients built per bar', built);
+measure('Cached gradients', cached);
+
+var stats = {};
+openVG.getGradientCacheStats(stats);
+console.log('  ' + stats.entries + ' paints, ' + stats.hits + ' hits, ' +
+            stats.misses + ' misses');
+
+openVG.destroyPath(path);
+
+util.finish();
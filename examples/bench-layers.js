@@ -0,0 +1,115 @@
+//
+// Draws 12 gauges of 120 stroked paths each, all of them drifting and
+// fading every frame, as scene nodes drawn path by path and as layers
+// composited from their images. Prints the time per frame and how often
+// the layers were rendered.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var PP = openVG.VGPaintParamType;
+
+var gauges = 12, ticks = 120, frames = 100;
+
+util.init({ loadFonts: false });
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var sync = new Buffer(4);
+var radius = Math.min(width / 4, height / 3) / 2 - 10;
+
+function createPath() {
+  return openVG.createPath(openVG.VG_PATH_FORMAT_STANDARD,
+                           openVG.VGPathDatatype.VG_PATH_DATATYPE_F,
+                           1.0, 0.0, 0, 0,
+                           openVG.VGPathCapabilities.VG_PATH_CAPABILITY_ALL);
+}
+
+function createPaint(color) {
+  var paint = openVG.createPaint();
+  openVG.setParameterFV(paint, PP.VG_PAINT_COLOR, new Float32Array(color));
+  return paint;
+}
+
+var dial = createPath();
+openVG.vgu.ellipse(dial, 0, 0, radius * 2, radius * 2);
+var tick = createPath();
+openVG.vgu.line(tick, 0, radius * 0.8, 0, radius * 0.95);
+
+var face = createPaint([0.1, 0.1, 0.15, 1]);
+var ink = createPaint([0.9, 0.9, 0.8, 1]);
+
+var root = openVG.createSceneNode();
+openVG.setSceneBackground(root, 1, 1, 1, 1);
+var all = [root], widgets = [];
+
+function translation(x, y) {
+  return [1, 0, 0, 0, 1, 0, x, y, 1];
+}
+
+for (var g = 0; g < gauges; g++) {
+  var widget = openVG.createSceneNode();
+  openVG.setNodePath(widget, dial, { fillPaint: face });
+  for (var t = 0; t < ticks; t++) {
+    var a = t * 2 * Math.PI / ticks, c = Math.cos(a), s = Math.sin(a);
+    var node = openVG.createSceneNode();
+    openVG.setNodePath(node, tick, { strokePaint: ink,
+                                     strokeWidth: t % 10 ? 1 : 3 });
+    openVG.setNodeTransform(node, [c, s, 0, -s, c, 0, 0, 0, 1]);
+    openVG.appendSceneNode(widget, node);
+    all.push(node);
+  }
+  openVG.appendSceneNode(root, widget);
+  widgets.push(widget);
+  all.push(widget);
+}
+
+function frame(f) {
+  for (var g = 0; g < gauges; g++) {
+    var x = (g % 4 + 0.5) * width / 4 + 10 * Math.sin((f + g) / 10);
+    var y = (Math.floor(g / 4) + 0.5) * height / 3;
+    openVG.setNodeTransform(widgets[g], translation(x, y));
+    openVG.setNodeOpacity(widgets[g], 0.6 + 0.4 * Math.cos((f + g) / 15));
+  }
+  openVG.renderScene(root);
+  util.end();
+}
+
+function measure(label, layers) {
+  for (var g = 0; g < gauges; g++) {
+    openVG.setNodeLayer(widgets[g], layers);
+  }
+  frame(0);
+
+  var before = {};
+  openVG.getSceneStats(before);
+  var start = process.hrtime();
+  for (var f = 1; f <= frames; f++) {
+    frame(f);
+  }
+  // Waits for the GPU (openVG.finish shuts down instead)
+  openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+  var elapsed = process.hrtime(start);
+  var stats = {};
+  openVG.getSceneStats(stats);
+
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms per frame, ' + (stats.layerRenders - before.layerRenders) +
+              ' layer renders');
+}
+
+measure('Drawn path by path', false);
+measure('Layers', true);
+
+for (var n = 0; n < all.length; n++) {
+  openVG.destroySceneNode(all[n]);
+}
+openVG.destroyPaint(ink);
+openVG.destroyPaint(face);
+openVG.destroyPath(tick);
+openVG.destroyPath(dial);
+
+util.finish();
@@ -0,0 +1,83 @@
+//
+// Draws 2000 rotated squares per frame, each a scene node that saves the
+// transform, translates, rotates, draws and restores it: with getMatrix /
+// loadMatrix into a Float32Array per node, and with pushMatrix / popMatrix.
+// Prints the time per frame and how many matrices reached the driver.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+
+var nodes = 2000, columns = 50, frames = 50;
+
+util.init({ loadFonts: false });
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var rows = nodes / columns;
+var sync = new Buffer(4);
+var size = Math.min(width / columns, height / rows) / 2;
+
+var path = openVG.createPath(openVG.VG_PATH_FORMAT_STANDARD,
+                             openVG.VGPathDatatype.VG_PATH_DATATYPE_F,
+                             1.0, 0.0, 0, 0,
+                             openVG.VGPathCapabilities.VG_PATH_CAPABILITY_ALL);
+openVG.vgu.rect(path, -size / 2, -size / 2, size, size);
+
+function withArrays(i) {
+  var saved = new Float32Array(9);
+  openVG.getMatrix(saved);
+  openVG.translate((i % columns + 0.5) * width / columns,
+                   (Math.floor(i / columns) + 0.5) * height / rows);
+  openVG.rotate(i);
+  openVG.drawPath(path, openVG.VGPaintMode.VG_FILL_PATH);
+  openVG.loadMatrix(saved);
+}
+
+function withStack(i) {
+  openVG.pushMatrix();
+  openVG.translate((i % columns + 0.5) * width / columns,
+                   (Math.floor(i / columns) + 0.5) * height / rows);
+  openVG.rotate(i);
+  openVG.drawPath(path, openVG.VGPaintMode.VG_FILL_PATH);
+  openVG.popMatrix();
+}
+
+function frame(node) {
+  util.start();
+  util.fill(44, 77, 232, 1);
+  for (var i = 0; i < nodes; i++) {
+    node(i);
+  }
+  // Waits for the GPU (openVG.finish shuts down instead)
+  openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+}
+
+function measure(label, node) {
+  frame(node);
+
+  var before = {};
+  openVG.getMatrixStats(before);
+  var start = process.hrtime();
+  for (var f = 0; f < frames; f++) {
+    frame(node);
+  }
+  var elapsed = process.hrtime(start);
+  var stats = {};
+  openVG.getMatrixStats(stats);
+
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms per frame, ' +
+              ((stats.uploads - before.uploads) / frames).toFixed(0) +
+              ' matrix uploads per frame');
+}
+
+measure('getMatrix/loadMatrix', withArrays);
+measure('pushMatrix/popMatrix', withStack);
+
+openVG.destroyPath(path);
+
+util.finish();
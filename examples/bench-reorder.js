@@ -0,0 +1,93 @@
+//
+// Draws 2000 squares per frame in a grid, each filled with one of four
+// paints in turn, as scene code would: in order, setting the paint before
+// each, and between beginDrawBatch and endDrawBatch so they are drawn
+// grouped by paint. Prints the time per frame and the paint and matrix
+// mode changes each way.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var PP = openVG.VGPaintParamType;
+var M = openVG.VGPaintMode;
+
+var shapes = 2000, columns = 50, frames = 30;
+
+util.init({ loadFonts: false });
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var sync = new Buffer(4);
+var cell = Math.min(width / columns, height / (shapes / columns));
+
+var path = openVG.createPath(openVG.VG_PATH_FORMAT_STANDARD,
+                             openVG.VGPathDatatype.VG_PATH_DATATYPE_F,
+                             1.0, 0.0, 0, 0,
+                             openVG.VGPathCapabilities.VG_PATH_CAPABILITY_ALL);
+openVG.vgu.rect(path, 0, 0, cell * 0.8, cell * 0.8);
+
+var paints = [[0.9, 0.2, 0.2], [0.2, 0.7, 0.3], [0.2, 0.3, 0.9], [0.9, 0.7, 0.1]]
+  .map(function(color) {
+    var paint = openVG.createPaint();
+    openVG.setParameterFV(paint, PP.VG_PAINT_COLOR,
+                          new Float32Array(color.concat([1])));
+    return paint;
+  });
+
+function scene(f) {
+  for (var i = 0; i < shapes; i++) {
+    openVG.setPaint(paints[i % paints.length], M.VG_FILL_PATH);
+    openVG.loadIdentity();
+    openVG.translate((i % columns) * cell + (f % 2),
+                     Math.floor(i / columns) * cell);
+    openVG.drawPath(path, M.VG_FILL_PATH);
+  }
+}
+
+function inOrderFrame(f) {
+  scene(f);
+}
+
+function batchedFrame(f) {
+  openVG.beginDrawBatch();
+  scene(f);
+  openVG.endDrawBatch();
+}
+
+function measure(label, frame) {
+  util.start();
+  frame(0);
+
+  var start = process.hrtime();
+  for (var f = 0; f < frames; f++) {
+    util.start();
+    frame(f);
+    // Waits for the GPU (openVG.finish shuts down instead)
+    openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+    util.end();
+  }
+  var elapsed = process.hrtime(start);
+
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms per frame');
+}
+
+measure('In order', inOrderFrame);
+measure('Reordered by paint', batchedFrame);
+
+var stats = {};
+openVG.getDrawBatchStats(stats);
+console.log('  ' + stats.draws + ' draws in ' + stats.flushes + ' flushes, ' +
+            stats.moved + ' moved; ' + stats.changesInOrder +
+            ' paint and matrix mode changes in order, ' + stats.changes +
+            ' reordered');
+
+paints.forEach(function(paint) {
+  openVG.destroyPaint(paint);
+});
+openVG.destroyPath(path);
+
+util.finish();
@@ -0,0 +1,110 @@
+//
+// Draws 2000 squares of which one moves every frame: redrawing them all
+// from JS each frame, and as a retained scene where only the moving square
+// is touched and renderScene redraws the pixels it left and entered.
+// Prints the time per frame and what the scene redrew.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var PP = openVG.VGPaintParamType;
+
+var nodes = 2000, columns = 50, frames = 100;
+
+util.init({ loadFonts: false });
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var rows = nodes / columns;
+var sync = new Buffer(4);
+var size = Math.min(width / columns, height / rows) / 2;
+
+var path = openVG.createPath(openVG.VG_PATH_FORMAT_STANDARD,
+                             openVG.VGPathDatatype.VG_PATH_DATATYPE_F,
+                             1.0, 0.0, 0, 0,
+                             openVG.VGPathCapabilities.VG_PATH_CAPABILITY_ALL);
+openVG.vgu.rect(path, -size / 2, -size / 2, size, size);
+
+var paint = openVG.createPaint();
+openVG.setParameterFV(paint, PP.VG_PAINT_COLOR, new Float32Array([0.2, 0.3, 0.9, 1]));
+
+function position(i, f) {
+  var x = (i % columns + 0.5) * width / columns;
+  var y = (Math.floor(i / columns) + 0.5) * height / rows;
+  if (i === 0) {
+    x += (f * 3) % (width - size);
+  }
+  return [x, y];
+}
+
+function immediate(f) {
+  util.start();
+  openVG.setPaint(paint, openVG.VGPaintMode.VG_FILL_PATH);
+  for (var i = 0; i < nodes; i++) {
+    var p = position(i, f);
+    openVG.pushMatrix();
+    openVG.translate(p[0], p[1]);
+    openVG.drawPath(path, openVG.VGPaintMode.VG_FILL_PATH);
+    openVG.popMatrix();
+  }
+}
+
+var root = openVG.createSceneNode();
+openVG.setSceneBackground(root, 1, 1, 1, 1);
+var squares = [];
+for (var i = 0; i < nodes; i++) {
+  var node = openVG.createSceneNode();
+  openVG.setNodePath(node, path, { fillPaint: paint });
+  var p = position(i, 0);
+  openVG.setNodeTransform(node, [1, 0, 0, 0, 1, 0, p[0], p[1], 1]);
+  openVG.appendSceneNode(root, node);
+  squares.push(node);
+}
+
+var moved = new Float32Array([1, 0, 0, 0, 1, 0, 0, 0, 1]);
+
+function retained(f) {
+  var p = position(0, f);
+  moved[6] = p[0];
+  moved[7] = p[1];
+  openVG.setNodeTransform(squares[0], moved);
+  openVG.renderScene(root);
+}
+
+function measure(label, frame) {
+  frame(0);
+  util.end();
+
+  var start = process.hrtime();
+  for (var f = 1; f <= frames; f++) {
+    frame(f);
+    util.end();
+  }
+  // Waits for the GPU (openVG.finish shuts down instead)
+  openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+  var elapsed = process.hrtime(start);
+
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms per frame');
+}
+
+measure('Immediate', immediate);
+measure('Retained scene', retained);
+
+var stats = {};
+openVG.getSceneStats(stats);
+console.log('  last frame: ' + stats.dirtyRects + ' rectangles, ' +
+            stats.updatedNodes + ' nodes updated, ' + stats.drawnNodes +
+            ' drawn');
+
+openVG.destroySceneNode(root);
+for (var s = 0; s < squares.length; s++) {
+  openVG.destroySceneNode(squares[s]);
+}
+openVG.destroyPaint(paint);
+openVG.destroyPath(path);
+
+util.finish();
@@ -0,0 +1,114 @@
+//
+// Draws 1000 and 10000 sprites from 8 small images per frame: one
+// drawImage per sprite with the matrix set from JS, drawImages with
+// translations, drawImages sorted by image, and drawImages with a color
+// transform per sprite. Prints the time per frame.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var P = openVG.VGParamType;
+
+var kinds = 8, size = 16, frames = 30;
+
+util.init({ loadFonts: false });
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var sync = new Buffer(4);
+
+var icons = [];
+for (var k = 0; k < kinds; k++) {
+  var image = openVG.createImage(F.VG_sRGBA_8888, size, size,
+                                 openVG.VGImageQuality.VG_IMAGE_QUALITY_BETTER);
+  openVG.setFV(P.VG_CLEAR_COLOR,
+               new Float32Array([k / kinds, 1 - k / kinds, 0.5, 1]));
+  openVG.clearImage(image, 0, 0, size, size);
+  icons.push(image);
+}
+
+function setup(count) {
+  var sprites = {
+    count: count,
+    images: new Uint32Array(count),
+    translations: new Float32Array(count * 2),
+    colorTransforms: new Float32Array(count * 8)
+  };
+  for (var i = 0; i < count; i++) {
+    sprites.images[i] = icons[i % kinds];
+    sprites.colorTransforms.set([1, 1, 1, (i % 4 + 1) / 4, 0, 0, 0, 0], i * 8);
+  }
+  return sprites;
+}
+
+function move(sprites, f) {
+  for (var i = 0; i < sprites.count; i++) {
+    sprites.translations[i * 2] = (i * 37 + f * 2) % (width - size);
+    sprites.translations[i * 2 + 1] = (i * 53 + f) % (height - size);
+  }
+}
+
+function oneByOne(sprites) {
+  var matrix = new Float32Array([1, 0, 0, 0, 1, 0, 0, 0, 1]);
+  openVG.setI(P.VG_MATRIX_MODE,
+              openVG.VGMatrixMode.VG_MATRIX_IMAGE_USER_TO_SURFACE);
+  for (var i = 0; i < sprites.count; i++) {
+    matrix[6] = sprites.translations[i * 2];
+    matrix[7] = sprites.translations[i * 2 + 1];
+    openVG.loadMatrix(matrix);
+    openVG.drawImage(sprites.images[i]);
+  }
+  openVG.setI(P.VG_MATRIX_MODE,
+              openVG.VGMatrixMode.VG_MATRIX_PATH_USER_TO_SURFACE);
+}
+
+function batched(sprites) {
+  openVG.drawImages(sprites.images, sprites.translations, null, sprites.count);
+}
+
+function sorted(sprites) {
+  openVG.drawImages(sprites.images, sprites.translations, null, sprites.count,
+                    { sort: true });
+}
+
+function faded(sprites) {
+  openVG.drawImages(sprites.images, sprites.translations,
+                    sprites.colorTransforms, sprites.count);
+}
+
+function measure(label, sprites, draw) {
+  var elapsed = [0, 0];
+  for (var f = 0; f <= frames; f++) {
+    move(sprites, f);
+    var start = process.hrtime();
+    util.start();
+    draw(sprites);
+    // Waits for the GPU (openVG.finish shuts down instead)
+    openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+    if (f > 0) {
+      var frame = process.hrtime(start);
+      elapsed[0] += frame[0];
+      elapsed[1] += frame[1];
+    }
+  }
+
+  console.log(label + ', ' + sprites.count + ' sprites: ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms per frame');
+}
+
+[1000, 10000].forEach(function(count) {
+  var sprites = setup(count);
+  measure('drawImage each', sprites, oneByOne);
+  measure('drawImages', sprites, batched);
+  measure('drawImages sorted', sprites, sorted);
+  measure('drawImages with color transforms', sprites, faded);
+});
+
+for (var i = 0; i < icons.length; i++) {
+  openVG.destroyImage(icons[i]);
+}
+
+util.finish();
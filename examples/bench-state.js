@@ -0,0 +1,102 @@
+//
+// Draws 2000 small rectangles per frame, setting the stroke width, cap,
+// join, fill rule and matrix mode before each one like typical drawing code
+// does, with the shadow state cache off and on, and prints the time per
+// frame and how many calls the cache skipped. Then alternates between two
+// stroke styles per rectangle, with setters and with state blocks.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var P = openVG.VGParamType;
+
+var shapes = 2000, columns = 50, frames = 50;
+
+util.init({ loadFonts: false });
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var rows = shapes / columns;
+var sync = new Buffer(4);
+
+function setters(i) {
+  util.strokeWidth(1);
+  openVG.setI(P.VG_FILL_RULE, openVG.VGFillRule.VG_NON_ZERO);
+  openVG.setI(P.VG_MATRIX_MODE, openVG.VGMatrixMode.VG_MATRIX_PATH_USER_TO_SURFACE);
+}
+
+var dashes = new Float32Array([4, 2]);
+
+function styleSetters(i) {
+  var thin = i % 2 == 0;
+  openVG.setF(P.VG_STROKE_LINE_WIDTH, thin ? 1 : 3);
+  openVG.setI(P.VG_STROKE_CAP_STYLE, thin ? openVG.VGCapStyle.VG_CAP_BUTT :
+                                            openVG.VGCapStyle.VG_CAP_ROUND);
+  openVG.setI(P.VG_STROKE_JOIN_STYLE, thin ? openVG.VGJoinStyle.VG_JOIN_MITER :
+                                             openVG.VGJoinStyle.VG_JOIN_ROUND);
+  openVG.setFV(P.VG_STROKE_DASH_PATTERN, thin ? new Float32Array(0) : dashes);
+}
+
+var thinStyle = openVG.createStateBlock({
+  lineWidth: 1,
+  capStyle: openVG.VGCapStyle.VG_CAP_BUTT,
+  joinStyle: openVG.VGJoinStyle.VG_JOIN_MITER,
+  dashPattern: []
+});
+var dashedStyle = openVG.createStateBlock({
+  lineWidth: 3,
+  capStyle: openVG.VGCapStyle.VG_CAP_ROUND,
+  joinStyle: openVG.VGJoinStyle.VG_JOIN_ROUND,
+  dashPattern: [4, 2]
+});
+
+function styleBlocks(i) {
+  openVG.applyStateBlock(i % 2 == 0 ? thinStyle : dashedStyle);
+}
+
+function frame(style) {
+  util.start();
+  util.fill(44, 77, 232, 1);
+  util.stroke(255, 255, 255, 1);
+  for (var i = 0; i < shapes; i++) {
+    style(i);
+    util.rect((i % columns) * width / columns, Math.floor(i / columns) * height / rows,
+              width / columns - 2, height / rows - 2);
+  }
+  // Waits for the GPU (openVG.finish shuts down instead)
+  openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+}
+
+function measure(label, style) {
+  frame(style);
+
+  var start = process.hrtime();
+  for (var f = 0; f < frames; f++) {
+    frame(style);
+  }
+  var elapsed = process.hrtime(start);
+
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms per frame');
+}
+
+openVG.setStateCacheEnabled(false);
+measure('Without state cache', setters);
+
+openVG.setStateCacheEnabled(true);
+var before = {};
+openVG.getStateCacheStats(before);
+measure('With state cache', setters);
+
+var stats = {};
+openVG.getStateCacheStats(stats);
+console.log('  ' + (stats.hits - before.hits) + ' calls skipped, ' +
+            (stats.misses - before.misses) + ' made');
+
+measure('Two styles, setters', styleSetters);
+measure('Two styles, state blocks', styleBlocks);
+
+util.finish();
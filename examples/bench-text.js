@@ -0,0 +1,103 @@
+//
+// Draws 400 small labels per frame, from glyph outlines and from the glyph
+// bitmap cache, and prints the time per frame. Then measures the labels'
+// widths in JS, natively one by one and natively in one batch.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+var text = require('./modules/text');
+
+var F = openVG.VGImageFormat;
+
+var labels = 400, columns = 10, frames = 50, pointSize = 12;
+
+util.init();
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var rows = labels / columns;
+var sync = new Buffer(4);
+
+function frame() {
+  util.start();
+  for (var i = 0; i < labels; i++) {
+    var x = (i % columns) * width / columns + 4;
+    var y = Math.floor(i / columns) * height / rows + 4;
+    text.drawText(x, y, 'Label ' + i, util.sansTypeface, pointSize);
+  }
+  // Waits for the GPU (openVG.finish shuts down instead)
+  openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+}
+
+function measure(label) {
+  frame();  // Warm up, fills the cache
+
+  var start = process.hrtime();
+  for (var f = 0; f < frames; f++) {
+    frame();
+  }
+  var elapsed = process.hrtime(start);
+
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms per frame');
+}
+
+openVG.setGlyphCacheThreshold(0);
+measure('Outlines');
+
+openVG.setGlyphCacheThreshold(24);
+measure('Glyph bitmaps');
+
+var stats = {};
+openVG.getGlyphCacheStats(stats);
+console.log('  ' + stats.glyphs + ' glyphs in ' + stats.strikes + ' strikes, ' +
+            stats.pages + ' atlas pages, ' + stats.hits + ' hits, ' +
+            stats.misses + ' misses');
+
+var font = util.sansTypeface, names = [];
+for (var i = 0; i < labels; i++) {
+  names.push('Label ' + i);
+}
+
+// The former JS measurement loop
+function jsTextWidth(s, f, size) {
+  var tw = 0.0;
+  for (var i = 0; i < s.length; i++) {
+    var glyph = f.characterMap[s.charCodeAt(i)];
+    if (glyph == -1) {
+      continue;
+    }
+    tw += size * f.glyphAdvances[glyph] / 65536.0;
+  }
+  return tw;
+}
+
+function measureWidths(label, fn) {
+  var start = process.hrtime();
+  for (var f = 0; f < frames; f++) {
+    fn();
+  }
+  var elapsed = process.hrtime(start);
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e6 + elapsed[1] / 1e3) / frames).toFixed(1) +
+              ' us per ' + labels + ' labels');
+}
+
+var widths = new Float32Array(labels);
+measureWidths('JS textWidth', function() {
+  for (var i = 0; i < labels; i++) {
+    widths[i] = jsTextWidth(names[i], font, pointSize);
+  }
+});
+measureWidths('textWidth', function() {
+  for (var i = 0; i < labels; i++) {
+    widths[i] = openVG.textWidth(font.face, names[i], pointSize);
+  }
+});
+measureWidths('textWidths', function() {
+  openVG.textWidths(font.face, names, pointSize, widths);
+});
+
+util.finish();
@@ -0,0 +1,73 @@
+//
+// Draws a board of 400 labels per frame, at 12 and at 32 points, from
+// outlines (with the glyph bitmap cache for the small ones) and from text
+// layers, and prints the time per frame.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+var text = require('./modules/text');
+
+var F = openVG.VGImageFormat;
+
+var labels = 400, columns = 10, frames = 50;
+
+util.init();
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var rows = labels / columns;
+var sync = new Buffer(4);
+var font = util.sansTypeface;
+
+function position(i) {
+  return [(i % columns) * width / columns + 4,
+          Math.floor(i / columns) * height / rows + 4];
+}
+
+function measure(label, draw) {
+  draw();  // Warm up, renders the layers
+
+  var start = process.hrtime();
+  for (var f = 0; f < frames; f++) {
+    util.start();
+    draw();
+    // Waits for the GPU (openVG.finish shuts down instead)
+    openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+  }
+  var elapsed = process.hrtime(start);
+
+  console.log(label + ': ' +
+              ((elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames).toFixed(2) +
+              ' ms per frame');
+}
+
+[12, 32].forEach(function(pointSize) {
+  var layers = [];
+  for (var i = 0; i < labels; i++) {
+    layers.push(openVG.createTextLayer(font.face, 'Label ' + i, pointSize));
+  }
+
+  measure(pointSize + ' pt text', function() {
+    for (var i = 0; i < labels; i++) {
+      var p = position(i);
+      text.drawText(p[0], p[1], 'Label ' + i, font, pointSize);
+    }
+  });
+
+  measure(pointSize + ' pt text layers', function() {
+    for (var i = 0; i < labels; i++) {
+      var p = position(i);
+      openVG.drawTextLayer(layers[i], p[0], p[1]);
+    }
+  });
+
+  var info = {};
+  openVG.getTextLayerInfo(layers[0], info);
+  console.log('  ' + info.width + 'x' + info.height + ' pixels per layer, ' +
+              info.renders + ' render(s) for ' + info.draws + ' draws');
+
+  layers.forEach(openVG.destroyTextLayer);
+});
+
+util.finish();
@@ -0,0 +1,82 @@
+//
+// Draws a grid of 200 thumbnails of a 1024x1024 image, with and without an
+// image pyramid (setImagePyramid), and prints the time per frame.
+//
+
+var openVG = require('../openvg');
+
+var util = require('./modules/util');
+
+var F = openVG.VGImageFormat;
+var Q = openVG.VGImageQuality;
+var P = openVG.VGParamType;
+
+var size = 1024, columns = 20, rows = 10, frames = 50;
+
+util.init({ loadFonts: false });
+
+var width = openVG.screen.width, height = openVG.screen.height;
+var cell = Math.min(width / columns, height / rows);
+
+var image = openVG.createImage(F.VG_sRGBA_8888, size, size,
+                               Q.VG_IMAGE_QUALITY_BETTER);
+
+// Fine checkerboard, which aliases badly when minified without filtering
+var pixels = new Buffer(size * size * 4);
+for (var y = 0; y < size; y++) {
+  for (var x = 0; x < size; x++) {
+    var i = (y * size + x) * 4, on = ((x >> 1) ^ (y >> 1)) & 1;
+    pixels[i] = on ? 255 : 0;
+    pixels[i + 1] = (x * 255 / size) | 0;
+    pixels[i + 2] = (y * 255 / size) | 0;
+    pixels[i + 3] = 255;
+  }
+}
+openVG.imageSubData(image, pixels, size * 4, F.VG_sABGR_8888, 0, 0, size, size);
+
+var sync = new Buffer(4);
+
+function frame() {
+  openVG.clear(0, 0, width, height);
+  openVG.setI(P.VG_MATRIX_MODE,
+              openVG.VGMatrixMode.VG_MATRIX_IMAGE_USER_TO_SURFACE);
+  openVG.setI(P.VG_IMAGE_QUALITY, Q.VG_IMAGE_QUALITY_BETTER);
+  for (var r = 0; r < rows; r++) {
+    for (var c = 0; c < columns; c++) {
+      openVG.loadIdentity();
+      openVG.translate(c * cell, r * cell);
+      openVG.scale(cell / size, cell / size);
+      openVG.drawImage(image);
+    }
+  }
+  // Waits for the GPU (openVG.finish shuts down instead)
+  openVG.readPixels(sync, 4, F.VG_sRGBA_8888, 0, 0, 1, 1);
+}
+
+function measure(label) {
+  frame();  // Warm up
+
+  var start = process.hrtime();
+  for (var f = 0; f < frames; f++) {
+    frame();
+  }
+  var elapsed = process.hrtime(start);
+  var ms = (elapsed[0] * 1e3 + elapsed[1] / 1e6) / frames;
+
+  console.log(label + ": " + ms.toFixed(2) + " ms/frame");
+}
+
+measure('Full size image');
+
+var start = process.hrtime();
+var built = openVG.setImagePyramid(image, true);
+var elapsed = process.hrtime(start);
+console.log('Pyramid ' + (built ? 'built' : 'NOT built') + ' in ' +
+            (elapsed[0] * 1e3 + elapsed[1] / 1e6).toFixed(2) + " ms");
+
+measure('Pyramid');
+
+util.end();
+
+openVG.destroyImage(image);
+util.finish();
@@ -451,6 +451,20 @@ var VGImageFormatReverse = openVG.VGImageFormatReverse =
   }, {});
 
 
+// Packed 24 bit layouts, only understood by convertPixels and
+// imageSubDataConvert.
+var VGImageFormatExt = openVG.VGImageFormatExt = {
+  VG_sRGB_888_EXT                             : 0x100,
+  VG_sBGR_888_EXT                             : 0x100 | (1 << 7)
+};
+
+var VGImageFormatExtReverse = openVG.VGImageFormatExtReverse =
+  Object.keys(VGImageFormatExt).reduce(function(previous, current) {
+    previous[VGImageFormatExt[current]] = current;
+    return previous;
+  }, {});
+
+
 var VGImageQuality = openVG.VGImageQuality = {
   VG_IMAGE_QUALITY_NONANTIALIASED             : (1 << 0),
   VG_IMAGE_QUALITY_FASTER                     : (1 << 1),
@@ -740,6 +754,820 @@ var VGPathCommandNdsReverse = openVG.VGPathCommandNdsReverse =
   }, {});
 
 
+// Stage ops for createFilterGraph. Each stage is
+//   { op: VGFilterOp.X, inputs: [stage or -1 for the source], params: [...] }
+// where inputs defaults to the previous stage, and params follow the matching
+// filter function after its images:
+//   GAUSSIAN_BLUR          stdDeviationX, stdDeviationY, tilingMode
+//   COLOR_MATRIX           the 20 matrix values
+//   LOOKUP                 outputLinear, outputPremultiplied
+//                          (table: red, green, blue and alpha LUTs, 1024 bytes)
+//   LOOKUP_SINGLE          sourceChannel, outputLinear, outputPremultiplied
+//                          (table: 256 entries)
+//   ITERATIVE_AVERAGE_BLUR dimX, dimY, iterative, tilingMode
+//   PARAMETRIC_FILTER      strength, offsetX, offsetY, filterFlags,
+//                          highlightPaint, shadowPaint
+//                          (inputs: [source, blur])
+//   DROP_SHADOW            dimX, dimY, iterative, strength, distance, angle,
+//                          filterFlags, allowedQuality, shadowColorRGBA
+//   GLOW                   dimX, dimY, iterative, strength, filterFlags,
+//                          allowedQuality, glowColorRGBA
+//   BEVEL                  dimX, dimY, iterative, strength, distance, angle,
+//                          filterFlags, allowedQuality, highlightColorRGBA,
+//                          shadowColorRGBA
+//   GRADIENT_GLOW/_BEVEL   dimX, dimY, iterative, strength, distance, angle,
+//                          filterFlags, allowedQuality, then color ramp stops
+var VGFilterOp = openVG.VGFilterOp = {
+  GAUSSIAN_BLUR                               : 0,
+  COLOR_MATRIX                                : 1,
+  LOOKUP                                      : 2,
+  LOOKUP_SINGLE                               : 3,
+  ITERATIVE_AVERAGE_BLUR                      : 4,
+  PARAMETRIC_FILTER                           : 5,
+  DROP_SHADOW                                 : 6,
+  GLOW                                        : 7,
+  BEVEL                                       : 8,
+  GRADIENT_GLOW                               : 9,
+  GRADIENT_BEVEL                              : 10
+};
+
+var VGFilterOpReverse = openVG.VGFilterOpReverse =
+  Object.keys(VGFilterOp).reduce(function(previous, current) {
+    previous[VGFilterOp[current]] = current;
+    return previous;
+  }, {});
+
+// Tile encodings in captureFrameDiff output
+var VGFrameDiffEncoding = openVG.VGFrameDiffEncoding = {
+  RAW                                         : 0,
+  RLE                                         : 1
+};
+
+var VGFrameDiffEncodingReverse = openVG.VGFrameDiffEncodingReverse =
+  Object.keys(VGFrameDiffEncoding).reduce(function(previous, current) {
+    previous[VGFrameDiffEncoding[current]] = current;
+    return previous;
+  }, {});
+
+// What addAnimationTrack animates
+var VGAnimationTarget = openVG.VGAnimationTarget = {
+  NODE_X                                      : 0,
+  NODE_Y                                      : 1,
+  NODE_ROTATION                               : 2,
+  NODE_SCALE_X                                : 3,
+  NODE_SCALE_Y                                : 4,
+  NODE_OPACITY                                : 5,
+  NODE_STROKE_WIDTH                           : 6,
+  PAINT_COLOR                                 : 7,
+  PARAMETER                                   : 8,
+  PATH_INTERPOLATION                          : 9
+};
+
+var VGAnimationTargetReverse = openVG.VGAnimationTargetReverse =
+  Object.keys(VGAnimationTarget).reduce(function(previous, current) {
+    previous[VGAnimationTarget[current]] = current;
+    return previous;
+  }, {});
+
+var VGDecimationMethod = openVG.VGDecimationMethod = {
+  MIN_MAX                                     : 0,
+  LTTB                                        : 1
+};
+
+var VGDecimationMethodReverse = openVG.VGDecimationMethodReverse =
+  Object.keys(VGDecimationMethod).reduce(function(previous, current) {
+    previous[VGDecimationMethod[current]] = current;
+    return previous;
+  }, {});
+
+
+// loadImageAsync(pathOrBuffer, [options], callback(err, image, width, height))
+// Decoding happens off the main thread; options.format is the VGImageFormat
+// the image is created with, options.quality its allowed VGImageQuality.
+var loadImageAsyncNative = openVG.loadImageAsync;
+openVG.loadImageAsync = function(source, options, callback) {
+  if (typeof options === 'function') {
+    callback = options;
+    options = {};
+  }
+
+  var format = options.format !== undefined ? options.format :
+    VGImageFormat.VG_sRGBA_8888_PRE;
+  var quality = options.quality !== undefined ? options.quality :
+    VGImageQuality.VG_IMAGE_QUALITY_NONANTIALIASED |
+    VGImageQuality.VG_IMAGE_QUALITY_FASTER |
+    VGImageQuality.VG_IMAGE_QUALITY_BETTER;
+
+  loadImageAsyncNative(source, format, quality, callback);
+};
+
+// createFrameDiff(x, y, width, height, [options])
+// options.format is the 32 bit VGImageFormat the tiles are read in (default
+// VG_sRGBA_8888), options.tileSize their size (default 64) and options.rle
+// whether to run-length encode them when it's smaller (default false).
+var createFrameDiffNative = openVG.createFrameDiff;
+openVG.createFrameDiff = function(x, y, width, height, options) {
+  options = options || {};
+
+  var format = options.format !== undefined ? options.format :
+    VGImageFormat.VG_sRGBA_8888;
+  var tileSize = options.tileSize !== undefined ? options.tileSize : 64;
+
+  return createFrameDiffNative(x, y, width, height, format, tileSize, !!options.rle);
+};
+
+// createTextLayer(face, text, size, [options])
+// setTextLayer(layer, face, text, size, [options])
+// options.lineHeight is the distance between the lines of the text (default
+// 1.2 times size).
+var createTextLayerNative = openVG.createTextLayer;
+openVG.createTextLayer = function(face, text, size, options) {
+  options = options || {};
+
+  var lineHeight = options.lineHeight !== undefined ? options.lineHeight :
+    1.2 * size;
+
+  return createTextLayerNative(face, text, size, lineHeight);
+};
+
+var setTextLayerNative = openVG.setTextLayer;
+openVG.setTextLayer = function(layer, face, text, size, options) {
+  options = options || {};
+
+  var lineHeight = options.lineHeight !== undefined ? options.lineHeight :
+    1.2 * size;
+
+  return setTextLayerNative(layer, face, text, size, lineHeight);
+};
+
+// createStateBlock(params) packs a drawing style to apply with
+// applyStateBlock(block) in one call. params names any of the properties
+// below, each taking what setF, setI, setFV or setIV would for it; vectors
+// are arrays.
+var stateBlockParams = {
+  lineWidth            : VGParamType.VG_STROKE_LINE_WIDTH,
+  capStyle             : VGParamType.VG_STROKE_CAP_STYLE,
+  joinStyle            : VGParamType.VG_STROKE_JOIN_STYLE,
+  miterLimit           : VGParamType.VG_STROKE_MITER_LIMIT,
+  dashPattern          : VGParamType.VG_STROKE_DASH_PATTERN,
+  dashPhase            : VGParamType.VG_STROKE_DASH_PHASE,
+  dashPhaseReset       : VGParamType.VG_STROKE_DASH_PHASE_RESET,
+  fillRule             : VGParamType.VG_FILL_RULE,
+  blendMode            : VGParamType.VG_BLEND_MODE,
+  renderingQuality     : VGParamType.VG_RENDERING_QUALITY,
+  imageMode            : VGParamType.VG_IMAGE_MODE,
+  masking              : VGParamType.VG_MASKING,
+  scissoring           : VGParamType.VG_SCISSORING,
+  scissorRects         : VGParamType.VG_SCISSOR_RECTS,
+  colorTransform       : VGParamType.VG_COLOR_TRANSFORM,
+  colorTransformValues : VGParamType.VG_COLOR_TRANSFORM_VALUES,
+  clearColor           : VGParamType.VG_CLEAR_COLOR,
+  tileFillColor        : VGParamType.VG_TILE_FILL_COLOR
+};
+
+var createStateBlockNative = openVG.createStateBlock;
+openVG.createStateBlock = function(params) {
+  var packed = {};
+  for (var name in params) {
+    if (!stateBlockParams.hasOwnProperty(name)) {
+      throw new TypeError('createStateBlock: unknown parameter ' + name);
+    }
+    var value = params[name];
+    packed[stateBlockParams[name]] =
+      ArrayBuffer.isView(value) ? Array.prototype.slice.call(value) : value;
+  }
+  return createStateBlockNative(packed);
+};
+
+// getGradientPaint(type, geometry, stops, [options])
+// Returns a cached VGPaint for a VG_PAINT_TYPE_LINEAR_GRADIENT (geometry
+// x0, y0, x1, y1) or VG_PAINT_TYPE_RADIAL_GRADIENT (cx, cy, fx, fy, r) with
+// stops as offset, R, G, B, A quintuples. Arrays or Float32Arrays.
+// options.spreadMode defaults to VG_COLOR_RAMP_SPREAD_PAD and
+// options.premultiplied to false. The paint belongs to the cache: ask for
+// it again rather than keeping it, and don't destroy it.
+var getGradientPaintNative = openVG.getGradientPaint;
+openVG.getGradientPaint = function(type, geometry, stops, options) {
+  options = options || {};
+
+  var spreadMode = options.spreadMode !== undefined ? options.spreadMode :
+    VGColorRampSpreadMode.VG_COLOR_RAMP_SPREAD_PAD;
+
+  return getGradientPaintNative(type,
+                                geometry instanceof Float32Array ? geometry : new Float32Array(geometry),
+                                stops instanceof Float32Array ? stops : new Float32Array(stops),
+                                spreadMode, !!options.premultiplied);
+};
+
+// pushClip(path) or pushClip(x, y, width, height)
+// Clips drawing to a path or rectangle, intersected with the clips already
+// pushed, until the matching popClip(). Axis aligned rectangles become
+// scissor rectangles, anything else is rendered into the mask.
+openVG.pushClip = function(path, y, width, height) {
+  if (arguments.length >= 4) {
+    openVG.pushClipRect(path, y, width, height);
+  } else {
+    openVG.pushClipPath(path);
+  }
+};
+
+// setNodePath(node, path, [options])
+// Makes a scene node draw a path, filled with options.fillPaint and stroked
+// with options.strokePaint options.strokeWidth wide (1 by default); either
+// paint may be left out.
+var setNodePathNative = openVG.setNodePath;
+openVG.setNodePath = function(node, path, options) {
+  options = options || {};
+
+  setNodePathNative(node, path,
+                    options.fillPaint || 0, options.strokePaint || 0,
+                    options.strokeWidth !== undefined ? options.strokeWidth : 1);
+};
+
+// setNodeText(node, layer, [fillPaint])
+var setNodeTextNative = openVG.setNodeText;
+openVG.setNodeText = function(node, layer, fillPaint) {
+  setNodeTextNative(node, layer, fillPaint || 0);
+};
+
+// setNodeTransform(node, matrix)
+// matrix is an array or Float32Array of 9 values, column major as in
+// loadMatrix.
+var setNodeTransformNative = openVG.setNodeTransform;
+openVG.setNodeTransform = function(node, matrix) {
+  setNodeTransformNative(node, matrix instanceof Float32Array ?
+                               matrix : new Float32Array(matrix));
+};
+
+// drawImages(images, transforms, [colorTransforms], [count], [options])
+// Draws count images (all of images by default) in one call, each under the
+// image matrix times its transform from transforms: 2 values (tx, ty) or 6
+// (sx, shy, shx, sy, tx, ty) per sprite, as options.stride says. Without
+// it, transforms must hold exactly count sprites' worth of either.
+// colorTransforms, when given, holds 8 VG_COLOR_TRANSFORM_VALUES per
+// sprite. options.sort groups the sprites by image when the order they
+// overlap in doesn't matter.
+var drawImagesNative = openVG.drawImages;
+openVG.drawImages = function(images, transforms, colorTransforms, count, options) {
+  options = options || {};
+  if (count === undefined) {
+    count = images.length;
+  }
+
+  var stride = options.stride;
+  if (!stride) {
+    if (transforms.length === count * 6) {
+      stride = 6;
+    } else if (transforms.length === count * 2) {
+      stride = 2;
+    } else {
+      throw new TypeError('drawImages: options.stride needed, transforms ' +
+                          'isn\'t 2 or 6 values per sprite long');
+    }
+  }
+
+  drawImagesNative(images, transforms, stride, colorTransforms || null,
+                   count, !!options.sort);
+};
+
+// addAnimationTrack(animation, target, keyframes)
+// target is one of
+//   { node, property }  property being 'x', 'y', 'rotation' (degrees),
+//                       'scaleX', 'scaleY', 'opacity' or 'strokeWidth'
+//   { paint, component, [node] }  component 0 to 3, or 'r', 'g', 'b', 'a'
+//   { parameter }       VG_STROKE_LINE_WIDTH, VG_STROKE_MITER_LIMIT or
+//                       VG_STROKE_DASH_PHASE
+//   { path, from, to, [node] }  path set to from interpolated towards to
+// node, for paints and paths, is the scene node to redraw when they change.
+// keyframes is an array of { time, value, [easing] }, time in seconds and
+// easing, towards the next keyframe, 'linear' (default), 'step', 'ease',
+// 'ease-in', 'ease-out', 'ease-in-out' or [x1, y1, x2, y2] as in CSS
+// cubic-bezier().
+var animationNodeProperties = {
+  x           : VGAnimationTarget.NODE_X,
+  y           : VGAnimationTarget.NODE_Y,
+  rotation    : VGAnimationTarget.NODE_ROTATION,
+  scaleX      : VGAnimationTarget.NODE_SCALE_X,
+  scaleY      : VGAnimationTarget.NODE_SCALE_Y,
+  opacity     : VGAnimationTarget.NODE_OPACITY,
+  strokeWidth : VGAnimationTarget.NODE_STROKE_WIDTH
+};
+
+var animationEasings = {
+  'ease'        : [0.25, 0.1, 0.25, 1],
+  'ease-in'     : [0.42, 0, 1, 1],
+  'ease-out'    : [0, 0, 0.58, 1],
+  'ease-in-out' : [0.42, 0, 0.58, 1]
+};
+
+var addAnimationTrackNative = openVG.addAnimationTrack;
+openVG.addAnimationTrack = function(animation, target, keyframes) {
+  var kind, handle = 0, component = 0, from = 0, to = 0;
+  if (target.property !== undefined) {
+    kind = animationNodeProperties[target.property];
+    if (kind === undefined) {
+      throw new TypeError('addAnimationTrack: unknown property ' + target.property);
+    }
+    handle = target.node;
+  } else if (target.paint !== undefined) {
+    kind = VGAnimationTarget.PAINT_COLOR;
+    handle = target.paint;
+    component = typeof target.component === 'string' ?
+      'rgba'.indexOf(target.component) : target.component;
+  } else if (target.parameter !== undefined) {
+    kind = VGAnimationTarget.PARAMETER;
+    component = target.parameter;
+  } else {
+    kind = VGAnimationTarget.PATH_INTERPOLATION;
+    handle = target.path;
+    from = target.from;
+    to = target.to;
+  }
+
+  var packed = new Float32Array(keyframes.length * 7);
+  keyframes.forEach(function(keyframe, i) {
+    var easing = keyframe.easing || 'linear';
+    var bezier = Array.isArray(easing) ? easing : animationEasings[easing];
+    packed[i * 7] = keyframe.time;
+    packed[i * 7 + 1] = keyframe.value;
+    if (bezier) {
+      packed[i * 7 + 2] = 2;
+      packed.set(bezier, i * 7 + 3);
+    } else if (easing === 'step') {
+      packed[i * 7 + 2] = 1;
+    } else if (easing !== 'linear') {
+      throw new TypeError('addAnimationTrack: unknown easing ' + easing);
+    }
+  });
+
+  addAnimationTrackNative(animation, kind, handle, component, from, to,
+                          target.node !== undefined && target.property === undefined ?
+                            target.node : 0,
+                          packed);
+};
+
+// playAnimation(animation, [options])
+// Plays from where the animation was paused or seeked to, or from the start
+// once it has ended; options.loop repeats it.
+var playAnimationNative = openVG.playAnimation;
+openVG.playAnimation = function(animation, options) {
+  options = options || {};
+
+  playAnimationNative(animation, !!options.loop);
+};
+
+// createCanvasContext(width, height) returns a CanvasRenderingContext2D
+// drawing natively on the current surface, width by height pixels, with
+// its origin at the top left. Each path call, fill, stroke and state change
+// is one native call. Colors are CSS color strings (#rgb, #rrggbb, rgb(),
+// rgba() or one of canvasColors); fonts are "<size>px <family>" with the
+// family registered as a face in openVG.canvasFonts, or set with
+// setFont(face, size). createRadialGradient ignores r0, the gradient
+// starting at (x0, y0). destroy() frees the native context.
+var canvasColors = openVG.canvasColors = {
+  transparent : [0, 0, 0, 0],
+  black       : [0, 0, 0, 1],
+  white       : [1, 1, 1, 1],
+  red         : [1, 0, 0, 1],
+  lime        : [0, 1, 0, 1],
+  green       : [0, 0.5, 0, 1],
+  blue        : [0, 0, 1, 1],
+  yellow      : [1, 1, 0, 1],
+  cyan        : [0, 1, 1, 1],
+  magenta     : [1, 0, 1, 1],
+  gray        : [0.5, 0.5, 0.5, 1],
+  grey        : [0.5, 0.5, 0.5, 1],
+  orange      : [1, 0.647, 0, 1]
+};
+
+var canvasFonts = openVG.canvasFonts = {};
+
+var canvasCompositeOperations = {
+  'source-over'      : VGBlendMode.VG_BLEND_SRC_OVER,
+  'destination-over' : VGBlendMode.VG_BLEND_DST_OVER,
+  'source-in'        : VGBlendMode.VG_BLEND_SRC_IN,
+  'destination-in'   : VGBlendMode.VG_BLEND_DST_IN,
+  'copy'             : VGBlendMode.VG_BLEND_SRC,
+  'lighter'          : VGBlendMode.VG_BLEND_ADDITIVE,
+  'multiply'         : VGBlendMode.VG_BLEND_MULTIPLY,
+  'screen'           : VGBlendMode.VG_BLEND_SCREEN,
+  'darken'           : VGBlendMode.VG_BLEND_DARKEN,
+  'lighten'          : VGBlendMode.VG_BLEND_LIGHTEN
+};
+
+var canvasLineCaps = {
+  butt   : VGCapStyle.VG_CAP_BUTT,
+  round  : VGCapStyle.VG_CAP_ROUND,
+  square : VGCapStyle.VG_CAP_SQUARE
+};
+
+var canvasLineJoins = {
+  miter : VGJoinStyle.VG_JOIN_MITER,
+  round : VGJoinStyle.VG_JOIN_ROUND,
+  bevel : VGJoinStyle.VG_JOIN_BEVEL
+};
+
+var canvasTextAligns = { left : 0, start : 0, center : 1, right : 2, end : 2 };
+
+var parsedColors = {};
+
+function parseCanvasColor(color) {
+  var parsed = parsedColors[color];
+  if (parsed !== undefined) {
+    return parsed;
+  }
+
+  var value = color.trim().toLowerCase(), match;
+  parsed = null;
+  if (canvasColors.hasOwnProperty(value)) {
+    parsed = canvasColors[value];
+  } else if ((match = /^#([0-9a-f]{3}|[0-9a-f]{6})$/.exec(value))) {
+    var hex = match[1];
+    if (hex.length === 3) {
+      hex = hex[0] + hex[0] + hex[1] + hex[1] + hex[2] + hex[2];
+    }
+    parsed = [parseInt(hex.substr(0, 2), 16) / 255,
+              parseInt(hex.substr(2, 2), 16) / 255,
+              parseInt(hex.substr(4, 2), 16) / 255, 1];
+  } else if ((match = /^rgba?\(([^)]*)\)$/.exec(value))) {
+    var parts = match[1].split(',').map(parseFloat);
+    if ((parts.length === 3 || parts.length === 4) &&
+        parts.every(function(part) { return !isNaN(part); })) {
+      parsed = [parts[0] / 255, parts[1] / 255, parts[2] / 255,
+                parts.length === 4 ? Math.min(Math.max(parts[3], 0), 1) : 1];
+    }
+  }
+
+  parsedColors[color] = parsed;
+  return parsed;
+}
+
+function CanvasGradient(type, geometry) {
+  this.type = type;
+  this.geometry = new Float32Array(geometry);
+  this.colorStops = [];
+  this.stops = null;  // Float32Array, built on first use
+}
+
+CanvasGradient.prototype.addColorStop = function(offset, color) {
+  var parsed = parseCanvasColor(color);
+  if (!(offset >= 0 && offset <= 1) || parsed === null) {
+    throw new RangeError('addColorStop: invalid offset or color');
+  }
+  // Kept sorted, stops at the same offset in the order added
+  var i = this.colorStops.length;
+  while (i > 0 && this.colorStops[i - 1][0] > offset) {
+    i--;
+  }
+  this.colorStops.splice(i, 0, [offset].concat(parsed));
+  this.stops = null;
+};
+
+function CanvasContext(width, height) {
+  this.id = createCanvasContextNative(width, height);
+  this.width = width;
+  this.height = height;
+  this._state = {
+    fillStyle : '#000000',
+    strokeStyle : '#000000',
+    lineWidth : 1,
+    lineCap : 'butt',
+    lineJoin : 'miter',
+    miterLimit : 10,
+    lineDash : [],
+    lineDashOffset : 0,
+    globalAlpha : 1,
+    globalCompositeOperation : 'source-over',
+    font : '10px sans-serif',
+    textAlign : 'start'
+  };
+  this._saved = [];
+}
+
+function setCanvasStyle(context, style, stroke) {
+  if (style instanceof CanvasGradient) {
+    if (style.stops === null) {
+      style.stops = new Float32Array([].concat.apply([], style.colorStops));
+    }
+    openVG.canvasSetGradient(context.id, stroke, style.type,
+                             style.geometry, style.stops);
+    return true;
+  }
+
+  var color = parseCanvasColor(String(style));
+  if (color === null) {
+    return false;
+  }
+  openVG.canvasSetColor(context.id, stroke,
+                        color[0], color[1], color[2], color[3]);
+  return true;
+}
+
+function defineCanvasProperty(name, set) {
+  Object.defineProperty(CanvasContext.prototype, name, {
+    get : function() { return this._state[name]; },
+    set : function(value) {
+      // Ignored like invalid values on the canvas
+      if ((value !== this._state[name] || value instanceof CanvasGradient) &&
+          set(this, value) !== false) {
+        this._state[name] = value;
+      }
+    }
+  });
+}
+
+defineCanvasProperty('fillStyle', function(context, value) {
+  return setCanvasStyle(context, value, false);
+});
+defineCanvasProperty('strokeStyle', function(context, value) {
+  return setCanvasStyle(context, value, true);
+});
+defineCanvasProperty('lineWidth', function(context, value) {
+  if (!(value > 0 && isFinite(value))) return false;
+  openVG.canvasSetLineWidth(context.id, value);
+});
+defineCanvasProperty('lineCap', function(context, value) {
+  if (!canvasLineCaps.hasOwnProperty(value)) return false;
+  openVG.canvasSetLineCap(context.id, canvasLineCaps[value]);
+});
+defineCanvasProperty('lineJoin', function(context, value) {
+  if (!canvasLineJoins.hasOwnProperty(value)) return false;
+  openVG.canvasSetLineJoin(context.id, canvasLineJoins[value]);
+});
+defineCanvasProperty('miterLimit', function(context, value) {
+  if (!(value > 0 && isFinite(value))) return false;
+  openVG.canvasSetMiterLimit(context.id, value);
+});
+defineCanvasProperty('lineDashOffset', function(context, value) {
+  if (!isFinite(value)) return false;
+  openVG.canvasSetLineDashOffset(context.id, value);
+});
+defineCanvasProperty('globalAlpha', function(context, value) {
+  if (!(value >= 0 && value <= 1)) return false;
+  openVG.canvasSetGlobalAlpha(context.id, value);
+});
+defineCanvasProperty('globalCompositeOperation', function(context, value) {
+  if (!canvasCompositeOperations.hasOwnProperty(value)) return false;
+  openVG.canvasSetBlendMode(context.id, canvasCompositeOperations[value]);
+});
+defineCanvasProperty('font', function(context, value) {
+  var match = /([0-9.]+)px\s+(.+)$/.exec(value);
+  if (!match || !canvasFonts.hasOwnProperty(match[2].trim())) return false;
+  openVG.canvasSetFont(context.id, canvasFonts[match[2].trim()],
+                       parseFloat(match[1]));
+});
+defineCanvasProperty('textAlign', function(context, value) {
+  if (!canvasTextAligns.hasOwnProperty(value)) return false;
+  openVG.canvasSetTextAlign(context.id, canvasTextAligns[value]);
+});
+
+CanvasContext.prototype.setFont = function(face, size) {
+  openVG.canvasSetFont(this.id, face, size);
+  this._state.font = size + 'px';
+};
+
+CanvasContext.prototype.setLineDash = function(segments) {
+  openVG.canvasSetLineDash(this.id, new Float32Array(segments));
+  this._state.lineDash = Array.prototype.slice.call(segments);
+};
+
+CanvasContext.prototype.getLineDash = function() {
+  var dash = this._state.lineDash;
+  return dash.length % 2 === 1 ? dash.concat(dash) : dash.slice();
+};
+
+CanvasContext.prototype.save = function() {
+  var saved = {};
+  for (var name in this._state) {
+    saved[name] = this._state[name];
+  }
+  this._saved.push(saved);
+  openVG.canvasSave(this.id);
+};
+
+CanvasContext.prototype.restore = function() {
+  if (this._saved.length > 0) {
+    this._state = this._saved.pop();
+  }
+  openVG.canvasRestore(this.id);
+};
+
+CanvasContext.prototype.transform = function(a, b, c, d, e, f) {
+  openVG.canvasTransform(this.id, a, b, c, d, e, f);
+};
+
+CanvasContext.prototype.setTransform = function(a, b, c, d, e, f) {
+  openVG.canvasSetTransform(this.id, a, b, c, d, e, f);
+};
+
+CanvasContext.prototype.resetTransform = function() {
+  openVG.canvasSetTransform(this.id, 1, 0, 0, 1, 0, 0);
+};
+
+CanvasContext.prototype.translate = function(x, y) {
+  openVG.canvasTranslate(this.id, x, y);
+};
+
+CanvasContext.prototype.scale = function(x, y) {
+  openVG.canvasScale(this.id, x, y);
+};
+
+CanvasContext.prototype.rotate = function(angle) {
+  openVG.canvasRotate(this.id, angle);
+};
+
+CanvasContext.prototype.beginPath = function() {
+  openVG.canvasBeginPath(this.id);
+};
+
+CanvasContext.prototype.closePath = function() {
+  openVG.canvasClosePath(this.id);
+};
+
+CanvasContext.prototype.moveTo = function(x, y) {
+  openVG.canvasMoveTo(this.id, x, y);
+};
+
+CanvasContext.prototype.lineTo = function(x, y) {
+  openVG.canvasLineTo(this.id, x, y);
+};
+
+CanvasContext.prototype.quadraticCurveTo = function(cpx, cpy, x, y) {
+  openVG.canvasQuadraticCurveTo(this.id, cpx, cpy, x, y);
+};
+
+CanvasContext.prototype.bezierCurveTo = function(cp1x, cp1y, cp2x, cp2y, x, y) {
+  openVG.canvasBezierCurveTo(this.id, cp1x, cp1y, cp2x, cp2y, x, y);
+};
+
+CanvasContext.prototype.arc = function(x, y, radius, startAngle, endAngle, anticlockwise) {
+  openVG.canvasArc(this.id, x, y, radius, startAngle, endAngle, !!anticlockwise);
+};
+
+CanvasContext.prototype.arcTo = function(x1, y1, x2, y2, radius) {
+  openVG.canvasArcTo(this.id, x1, y1, x2, y2, radius);
+};
+
+CanvasContext.prototype.rect = function(x, y, width, height) {
+  openVG.canvasRect(this.id, x, y, width, height);
+};
+
+function canvasFillRule(fillRule) {
+  return fillRule === 'evenodd' ? VGFillRule.VG_EVEN_ODD : VGFillRule.VG_NON_ZERO;
+}
+
+CanvasContext.prototype.fill = function(fillRule) {
+  openVG.canvasFill(this.id, canvasFillRule(fillRule));
+};
+
+CanvasContext.prototype.stroke = function() {
+  openVG.canvasStroke(this.id);
+};
+
+CanvasContext.prototype.clip = function(fillRule) {
+  openVG.canvasClip(this.id, canvasFillRule(fillRule));
+};
+
+CanvasContext.prototype.fillRect = function(x, y, width, height) {
+  openVG.canvasFillRect(this.id, x, y, width, height);
+};
+
+CanvasContext.prototype.strokeRect = function(x, y, width, height) {
+  openVG.canvasStrokeRect(this.id, x, y, width, height);
+};
+
+CanvasContext.prototype.clearRect = function(x, y, width, height) {
+  openVG.canvasClearRect(this.id, x, y, width, height);
+};
+
+CanvasContext.prototype.fillText = function(text, x, y) {
+  openVG.canvasFillText(this.id, String(text), x, y);
+};
+
+CanvasContext.prototype.strokeText = function(text, x, y) {
+  openVG.canvasStrokeText(this.id, String(text), x, y);
+};
+
+CanvasContext.prototype.measureText = function(text) {
+  return { width : openVG.canvasMeasureText(this.id, String(text)) };
+};
+
+CanvasContext.prototype.drawImage = function(image, x, y, width, height) {
+  openVG.canvasDrawImage(this.id, image, x, y,
+                         width !== undefined ? width : NaN,
+                         height !== undefined ? height : NaN);
+};
+
+CanvasContext.prototype.createLinearGradient = function(x0, y0, x1, y1) {
+  return new CanvasGradient(VGPaintType.VG_PAINT_TYPE_LINEAR_GRADIENT,
+                            [x0, y0, x1, y1]);
+};
+
+CanvasContext.prototype.createRadialGradient = function(x0, y0, r0, x1, y1, r1) {
+  return new CanvasGradient(VGPaintType.VG_PAINT_TYPE_RADIAL_GRADIENT,
+                            [x1, y1, x0, y0, r1]);
+};
+
+CanvasContext.prototype.destroy = function() {
+  openVG.destroyCanvasContext(this.id);
+};
+
+var createCanvasContextNative = openVG.createCanvasContext;
+openVG.createCanvasContext = function(width, height) {
+  return new CanvasContext(width, height);
+};
+
+// chartPolyline(path, ys, axis, [options])
+// chartArea(path, ys, axis, [options])
+// chartBars(path, ys, axis, [options])
+// Append a whole series to a VG_PATH_DATATYPE_F path, cleared first unless
+// options.append, and return the segments appended: a line through the
+// points, the area between them and options.baseline (0) or a bar for each,
+// options.barWidth (0.8) wide in data units. ys is a Float32Array, and
+// options.x one with the x values, which are 0, 1, 2... otherwise. NaN
+// values leave gaps. axis maps the data to the surface: { xMin, xMax, yMin,
+// yMax, left, bottom, width, height }, xMin and xMax defaulting to the
+// first and last index and left and bottom to 0.
+function packChartAxis(ys, axis) {
+  if (axis instanceof Float32Array) {
+    return axis;
+  }
+  return new Float32Array([
+    axis.xMin !== undefined ? axis.xMin : 0,
+    axis.xMax !== undefined ? axis.xMax : ys.length - 1,
+    axis.yMin, axis.yMax,
+    axis.left || 0, axis.bottom || 0, axis.width, axis.height
+  ]);
+}
+
+var chartPolylineNative = openVG.chartPolyline;
+openVG.chartPolyline = function(path, ys, axis, options) {
+  options = options || {};
+
+  return chartPolylineNative(path, options.x || null, ys,
+                             packChartAxis(ys, axis), !options.append);
+};
+
+var chartAreaNative = openVG.chartArea;
+openVG.chartArea = function(path, ys, axis, options) {
+  options = options || {};
+
+  return chartAreaNative(path, options.x || null, ys, packChartAxis(ys, axis),
+                         options.baseline || 0, !options.append);
+};
+
+var chartBarsNative = openVG.chartBars;
+openVG.chartBars = function(path, ys, axis, options) {
+  options = options || {};
+
+  var barWidth = options.barWidth !== undefined ? options.barWidth : 0.8;
+  return chartBarsNative(path, options.x || null, ys, packChartAxis(ys, axis),
+                         barWidth, options.baseline || 0, !options.append);
+};
+
+// chartDecimated(path, ys, axis, [options])
+// As chartPolyline, for series with far more points than the axis is
+// pixels wide: options.method, a VGDecimationMethod, keeps the lowest and
+// highest point of each pixel column (MIN_MAX, the default) or a point per
+// column following the shape of the series (LTTB), options.columns (the
+// axis width) being how many. Only the points within xMin..xMax are read,
+// and options.x must be ascending.
+function decimationColumns(axis, options) {
+  if (options.columns !== undefined) {
+    return options.columns;
+  }
+  return Math.ceil(axis instanceof Float32Array ? axis[6] : axis.width);
+}
+
+var chartDecimatedNative = openVG.chartDecimated;
+openVG.chartDecimated = function(path, ys, axis, options) {
+  options = options || {};
+
+  return chartDecimatedNative(path, options.x || null, ys,
+                              packChartAxis(ys, axis),
+                              options.method || VGDecimationMethod.MIN_MAX,
+                              decimationColumns(axis, options),
+                              !options.append);
+};
+
+// decimateSeries(ys, axis, [options]) returns { x, y }, the Float32Arrays
+// of the points chartDecimated would draw, in data units.
+var decimateSeriesNative = openVG.decimateSeries;
+openVG.decimateSeries = function(ys, axis, options) {
+  options = options || {};
+
+  var method = options.method || VGDecimationMethod.MIN_MAX;
+  var columns = decimationColumns(axis, options);
+  var capacity = method === VGDecimationMethod.MIN_MAX ? columns * 2 : columns;
+  capacity = Math.min(capacity, ys.length);
+  var x = new Float32Array(capacity), y = new Float32Array(capacity);
+
+  var count = decimateSeriesNative(options.x || null, ys,
+                                   packChartAxis(ys, axis), method, columns,
+                                   x, y);
+  return { x: x.subarray(0, count), y: y.subarray(0, count) };
+};
+
 openVG.init = function() {
   openVG.startUp(screen);
 };
@@ -0,0 +1,585 @@
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <map>
+
+#include "VG/openvg.h"
+
+#include "animation_timeline.h"
+#include "scene_graph.h"
+#include "state_cache.h"
+#include "draw_reorder.h"
+#include "typed_array.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+struct animation_t {
+  std::vector<animations::track_t> tracks;
+  double duration;  // Of the longest track
+  bool playing;
+  bool loop;
+  double origin;    // Clock time at time 0, when playing
+  double time;      // When not playing
+  bool pending;     // Values to set at the next evaluation
+};
+
+// A node's transform as animated parts, kept between evaluations so that
+// setting one part doesn't lose the others to a round trip through the
+// matrix: the rotation of a node scaled to 0 wide, or float error. They are
+// taken from the matrix again whenever it changed behind our back.
+struct node_parts_t {
+  VGfloat parts[animations::kNodeScaleY + 1];
+  VGfloat shear;
+  VGfloat transform[9];  // As last composed
+};
+
+std::map<uint32_t, animation_t> timeline;
+uint32_t nextAnimation = 1;
+std::map<uint32_t, node_parts_t> nodeParts;
+
+size_t evaluations = 0, updates = 0, unchanged = 0;
+
+double Now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+bool ByTime(const animations::keyframe_t &a, const animations::keyframe_t &b) {
+  return a.time < b.time;
+}
+
+VGfloat Bezier(VGfloat a, VGfloat b, VGfloat t) {
+  // One coordinate of a cubic from 0 to 1 with control values a and b
+  VGfloat u = 1 - t;
+  return 3 * u * u * t * a + 3 * u * t * t * b + t * t * t;
+}
+
+VGfloat BezierSlope(VGfloat a, VGfloat b, VGfloat t) {
+  VGfloat u = 1 - t;
+  return 3 * u * u * a + 6 * u * t * (b - a) + 3 * t * t * (1 - b);
+}
+
+VGfloat Value(const animations::track_t &track, double time) {
+  const std::vector<animations::keyframe_t> &keyframes = track.keyframes;
+  if (time <= keyframes.front().time) {
+    return keyframes.front().value;
+  }
+  if (time >= keyframes.back().time) {
+    return keyframes.back().value;
+  }
+
+  animations::keyframe_t key;
+  key.time = (VGfloat) time;
+  std::vector<animations::keyframe_t>::const_iterator next =
+    std::upper_bound(keyframes.begin(), keyframes.end(), key, ByTime);
+  const animations::keyframe_t &previous = *(next - 1);
+  VGfloat progress = (VGfloat) ((time - previous.time) /
+                                (next->time - previous.time));
+  return previous.value +
+         (next->value - previous.value) * animations::Ease(previous, progress);
+}
+
+// Translation, rotation in degrees, scale and shear of an affine matrix,
+// and back: the linear part is the rotation times [scaleX shear; 0 scaleY].
+void Decompose(const VGfloat *m, node_parts_t *node) {
+  VGfloat *parts = node->parts;
+  VGfloat scaleX = sqrtf(m[0] * m[0] + m[1] * m[1]);
+  VGfloat radians = atan2f(m[1], m[0]);
+  VGfloat c = cosf(radians), s = sinf(radians);
+  parts[animations::kNodeX] = m[6];
+  parts[animations::kNodeY] = m[7];
+  parts[animations::kNodeRotation] = radians * (VGfloat) (180 / M_PI);
+  parts[animations::kNodeScaleX] = scaleX;
+  parts[animations::kNodeScaleY] = c * m[4] - s * m[3];
+  node->shear = c * m[3] + s * m[4];
+}
+
+void Compose(const node_parts_t &node, VGfloat *m) {
+  const VGfloat *parts = node.parts;
+  VGfloat radians = parts[animations::kNodeRotation] * (VGfloat) (M_PI / 180);
+  VGfloat c = cosf(radians), s = sinf(radians);
+  m[0] = parts[animations::kNodeScaleX] * c;
+  m[1] = parts[animations::kNodeScaleX] * s;
+  m[2] = 0;
+  m[3] = c * node.shear - s * parts[animations::kNodeScaleY];
+  m[4] = s * node.shear + c * parts[animations::kNodeScaleY];
+  m[5] = 0;
+  m[6] = parts[animations::kNodeX];
+  m[7] = parts[animations::kNodeY];
+  m[8] = 1;
+}
+
+void Redraw(uint32_t id) {
+  if (id != 0 && scene::Get(id) != NULL) {
+    scene::MarkDirty(id);
+  }
+}
+
+void Set(const animations::track_t &track, VGfloat value) {
+  switch (track.target) {
+    case animations::kNodeX:
+    case animations::kNodeY:
+    case animations::kNodeRotation:
+    case animations::kNodeScaleX:
+    case animations::kNodeScaleY: {
+      scene::node_t *node = scene::Get(track.handle);
+      if (node == NULL) {
+        nodeParts.erase(track.handle);
+        break;
+      }
+      std::map<uint32_t, node_parts_t>::iterator it = nodeParts.find(track.handle);
+      if (it == nodeParts.end() ||
+          memcmp(node->transform, it->second.transform,
+                 sizeof(it->second.transform)) != 0) {
+        it = nodeParts.insert(std::make_pair(track.handle, node_parts_t())).first;
+        Decompose(node->transform, &it->second);
+      }
+      VGfloat transform[9];
+      it->second.parts[track.target] = value;
+      Compose(it->second, transform);
+      memcpy(it->second.transform, transform, sizeof(transform));
+      if (memcmp(node->transform, transform, sizeof(transform)) != 0) {
+        memcpy(node->transform, transform, sizeof(transform));
+        scene::MarkMoved(track.handle);
+      }
+      break;
+    }
+
+    case animations::kNodeOpacity: {
+      scene::node_t *node = scene::Get(track.handle);
+      if (node == NULL) {
+        break;
+      }
+      node->opacity = value < 0 ? 0 : (value > 1 ? 1 : value);
+      scene::MarkMoved(track.handle);
+      break;
+    }
+
+    case animations::kNodeStrokeWidth: {
+      scene::node_t *node = scene::Get(track.handle);
+      if (node == NULL) {
+        break;
+      }
+      node->strokeWidth = value;
+      scene::MarkDirty(track.handle);
+      break;
+    }
+
+    case animations::kPaintColor: {
+      reorder::Barrier();
+      VGfloat color[4];
+      vgGetParameterfv(track.handle, VG_PAINT_COLOR, 4, color);
+      color[track.component] = value;
+      vgSetParameterfv(track.handle, VG_PAINT_COLOR, 4, color);
+      Redraw(track.node);
+      break;
+    }
+
+    case animations::kParameter:
+      state::SetF(static_cast<VGParamType>(track.component), value);
+      break;
+
+    case animations::kPathInterpolation:
+      reorder::Barrier();
+      vgClearPath(track.handle, VG_PATH_CAPABILITY_ALL);
+      vgInterpolatePath(track.handle, track.from, track.to, value);
+      if (track.node != 0 && scene::Get(track.node) != NULL) {
+        // New segments, new bounds
+        scene::Invalidate(track.node);
+      }
+      break;
+  }
+}
+
+void Apply(animation_t &animation, double time) {
+  for (size_t i = 0; i < animation.tracks.size(); i++) {
+    animations::track_t &track = animation.tracks[i];
+    VGfloat value = Value(track, time);
+    if (track.applied && track.lastValue == value) {
+      unchanged++;
+      continue;
+    }
+    Set(track, value);
+    track.applied = true;
+    track.lastValue = value;
+    updates++;
+  }
+}
+
+}
+
+uint32_t animations::Create() {
+  uint32_t id = nextAnimation++;
+  animation_t &animation = timeline[id];
+  animation.duration = 0;
+  animation.playing = false;
+  animation.loop = false;
+  animation.origin = 0;
+  animation.time = 0;
+  animation.pending = false;
+  return id;
+}
+
+void animations::Destroy(uint32_t id) {
+  timeline.erase(id);
+}
+
+bool animations::AddTrack(uint32_t id, const track_t &track) {
+  std::map<uint32_t, animation_t>::iterator it = timeline.find(id);
+  if (it == timeline.end() || track.keyframes.empty()) {
+    return false;
+  }
+
+  animation_t &animation = it->second;
+  animation.tracks.push_back(track);
+  track_t &added = animation.tracks.back();
+  std::stable_sort(added.keyframes.begin(), added.keyframes.end(), ByTime);
+  added.applied = false;
+  added.lastValue = 0;
+  animation.duration = std::max(animation.duration,
+                                (double) added.keyframes.back().time);
+  animation.pending = true;
+  return true;
+}
+
+bool animations::Play(uint32_t id, bool loop) {
+  std::map<uint32_t, animation_t>::iterator it = timeline.find(id);
+  if (it == timeline.end()) {
+    return false;
+  }
+
+  animation_t &animation = it->second;
+  animation.loop = loop;
+  if (!animation.playing) {
+    if (animation.time >= animation.duration) {
+      // Played to the end: from the start again
+      animation.time = 0;
+    }
+    animation.origin = Now() - animation.time;
+    animation.playing = true;
+  }
+  return true;
+}
+
+bool animations::Pause(uint32_t id) {
+  std::map<uint32_t, animation_t>::iterator it = timeline.find(id);
+  if (it == timeline.end()) {
+    return false;
+  }
+
+  animation_t &animation = it->second;
+  if (animation.playing) {
+    double time = Now() - animation.origin;
+    if (animation.loop && animation.duration > 0) {
+      time = fmod(time, animation.duration);
+    }
+    animation.time = std::min(time, animation.duration);
+    animation.playing = false;
+    animation.pending = true;
+  }
+  return true;
+}
+
+bool animations::Seek(uint32_t id, double time) {
+  std::map<uint32_t, animation_t>::iterator it = timeline.find(id);
+  if (it == timeline.end()) {
+    return false;
+  }
+
+  animation_t &animation = it->second;
+  animation.time = std::max(0.0, std::min(time, animation.duration));
+  if (animation.playing) {
+    animation.origin = Now() - animation.time;
+  }
+  animation.pending = true;
+  return true;
+}
+
+double animations::Time(uint32_t id, double *duration, bool *playing) {
+  std::map<uint32_t, animation_t>::iterator it = timeline.find(id);
+  if (it == timeline.end()) {
+    return -1;
+  }
+
+  animation_t &animation = it->second;
+  *duration = animation.duration;
+  *playing = animation.playing;
+  if (!animation.playing) {
+    return animation.time;
+  }
+  double time = Now() - animation.origin;
+  if (animation.loop && animation.duration > 0) {
+    return fmod(time, animation.duration);
+  }
+  return std::min(time, animation.duration);
+}
+
+void animations::Evaluate() {
+  if (!timeline.empty()) {
+    EvaluateAt(Now());
+  }
+}
+
+void animations::EvaluateAt(double now) {
+  evaluations++;
+  for (std::map<uint32_t, animation_t>::iterator it = timeline.begin();
+       it != timeline.end(); ++it) {
+    animation_t &animation = it->second;
+    if (animation.playing) {
+      double time = now - animation.origin;
+      if (animation.loop && animation.duration > 0) {
+        time = fmod(time, animation.duration);
+      } else if (time >= animation.duration) {
+        // Ends on its last values
+        time = animation.duration;
+        animation.time = time;
+        animation.playing = false;
+      }
+      Apply(animation, std::max(time, 0.0));
+    } else if (animation.pending) {
+      Apply(animation, animation.time);
+    }
+    animation.pending = false;
+  }
+}
+
+VGfloat animations::Ease(const keyframe_t &keyframe, VGfloat progress) {
+  switch (keyframe.easing) {
+    case kStep:
+      return progress < 1 ? 0 : 1;
+
+    case kCubicBezier: {
+      const VGfloat *b = keyframe.bezier;
+      // The curve's parameter for x = progress: Newton's method, falling
+      // back to bisection where the slope is too flat
+      VGfloat t = progress;
+      for (int i = 0; i < 8; i++) {
+        VGfloat error = Bezier(b[0], b[2], t) - progress;
+        if (fabsf(error) < 1e-6f) {
+          return Bezier(b[1], b[3], t);
+        }
+        VGfloat slope = BezierSlope(b[0], b[2], t);
+        if (fabsf(slope) < 1e-6f) {
+          break;
+        }
+        t -= error / slope;
+      }
+      VGfloat low = 0, high = 1;
+      t = progress;
+      for (int i = 0; i < 32; i++) {
+        VGfloat x = Bezier(b[0], b[2], t);
+        if (fabsf(x - progress) < 1e-6f) {
+          break;
+        }
+        if (x < progress) {
+          low = t;
+        } else {
+          high = t;
+        }
+        t = (low + high) / 2;
+      }
+      return Bezier(b[1], b[3], t);
+    }
+
+    case kLinear:
+    default:
+      return progress;
+  }
+}
+
+void animations::GetStats(stats_t *stats) {
+  stats->animations = timeline.size();
+  stats->playing = 0;
+  stats->tracks = 0;
+  for (std::map<uint32_t, animation_t>::iterator it = timeline.begin();
+       it != timeline.end(); ++it) {
+    stats->playing += it->second.playing ? 1 : 0;
+    stats->tracks += it->second.tracks.size();
+  }
+  stats->evaluations = evaluations;
+  stats->updates = updates;
+  stats->unchanged = unchanged;
+}
+
+
+extern void animations::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "createAnimation"   , animations::CreateAnimation);
+  NODE_SET_METHOD(target, "destroyAnimation"  , animations::DestroyAnimation);
+  NODE_SET_METHOD(target, "addAnimationTrack" , animations::AddAnimationTrack);
+  NODE_SET_METHOD(target, "playAnimation"     , animations::PlayAnimation);
+  NODE_SET_METHOD(target, "pauseAnimation"    , animations::PauseAnimation);
+  NODE_SET_METHOD(target, "seekAnimation"     , animations::SeekAnimation);
+  NODE_SET_METHOD(target, "getAnimationInfo"  , animations::GetAnimationInfo);
+  NODE_SET_METHOD(target, "evaluateAnimations", animations::EvaluateAnimations);
+  NODE_SET_METHOD(target, "getAnimationStats" , animations::GetAnimationStats);
+}
+
+V8_METHOD(animations::CreateAnimation) {
+  HandleScope scope;
+
+  CheckArgs0(createAnimation);
+
+  V8_RETURN(Uint32::New(Create()));
+}
+
+V8_METHOD(animations::DestroyAnimation) {
+  HandleScope scope;
+
+  CheckArgs1(destroyAnimation, animation, Uint32);
+
+  Destroy(args[0]->Uint32Value());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(animations::AddAnimationTrack) {
+  HandleScope scope;
+
+  // Always checked: the array is read below
+  if (!(args.Length() == 8 && args[0]->IsUint32() && args[1]->IsUint32() &&
+        args[2]->IsUint32() && args[3]->IsInt32() && args[4]->IsUint32() &&
+        args[5]->IsUint32() && args[6]->IsUint32() &&
+        IsFloat32Array(args[7]))) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected addAnimationTrack(animation, target, handle, component, from, to, node, Float32Array)")));
+  }
+
+  uint32_t target = args[1]->Uint32Value();
+  if (target > kPathInterpolation) {
+    V8_THROW(Exception::TypeError(String::New("addAnimationTrack: unknown target")));
+  }
+
+  track_t track;
+  track.target = static_cast<target_t>(target);
+  track.handle = args[2]->Uint32Value();
+  track.component = args[3]->Int32Value();
+  track.from = args[4]->Uint32Value();
+  track.to = args[5]->Uint32Value();
+  track.node = args[6]->Uint32Value();
+  if (track.target == kPaintColor &&
+      (track.component < 0 || track.component > 3)) {
+    V8_THROW(Exception::RangeError(String::New("addAnimationTrack: color component out of range")));
+  }
+  // The scalar float parameters, the only ones state::SetF() takes
+  if (track.target == kParameter &&
+      track.component != VG_STROKE_LINE_WIDTH &&
+      track.component != VG_STROKE_MITER_LIMIT &&
+      track.component != VG_STROKE_DASH_PHASE) {
+    V8_THROW(Exception::TypeError(String::New("addAnimationTrack: not a float parameter")));
+  }
+
+  TypedArrayWrapper<VGfloat> keyframes(args[7]);
+  size_t count = keyframes.length() / kKeyframeValues;
+  if (count == 0 || (size_t) keyframes.length() % kKeyframeValues != 0) {
+    V8_THROW(Exception::TypeError(String::New("addAnimationTrack: expected keyframes of 7 values")));
+  }
+  const VGfloat *values = keyframes.pointer();
+  for (size_t i = 0; i < count; i++, values += kKeyframeValues) {
+    keyframe_t keyframe;
+    keyframe.time = values[0];
+    keyframe.value = values[1];
+    if (!(values[2] >= kLinear && values[2] <= kCubicBezier)) {
+      V8_THROW(Exception::TypeError(String::New("addAnimationTrack: unknown easing")));
+    }
+    keyframe.easing = static_cast<easing_t>((int) values[2]);
+    memcpy(keyframe.bezier, values + 3, sizeof(keyframe.bezier));
+    track.keyframes.push_back(keyframe);
+  }
+
+  if (!AddTrack(args[0]->Uint32Value(), track)) {
+    V8_THROW(Exception::TypeError(String::New("addAnimationTrack: unknown animation")));
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(animations::PlayAnimation) {
+  HandleScope scope;
+
+  CheckArgs2(playAnimation, animation, Uint32, loop, Boolean);
+
+  if (!Play(args[0]->Uint32Value(), args[1]->BooleanValue())) {
+    V8_THROW(Exception::TypeError(String::New("playAnimation: unknown animation")));
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(animations::PauseAnimation) {
+  HandleScope scope;
+
+  CheckArgs1(pauseAnimation, animation, Uint32);
+
+  if (!Pause(args[0]->Uint32Value())) {
+    V8_THROW(Exception::TypeError(String::New("pauseAnimation: unknown animation")));
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(animations::SeekAnimation) {
+  HandleScope scope;
+
+  CheckArgs2(seekAnimation, animation, Uint32, time, Number);
+
+  if (!Seek(args[0]->Uint32Value(), args[1]->NumberValue())) {
+    V8_THROW(Exception::TypeError(String::New("seekAnimation: unknown animation")));
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(animations::GetAnimationInfo) {
+  HandleScope scope;
+
+  CheckArgs2(getAnimationInfo, animation, Uint32, info, Object);
+
+  double duration;
+  bool playing;
+  double time = Time(args[0]->Uint32Value(), &duration, &playing);
+  if (time < 0) {
+    V8_THROW(Exception::TypeError(String::New("getAnimationInfo: unknown animation")));
+  }
+
+  Local<Object> result = args[1].As<Object>();
+  result->Set(String::NewSymbol("time"), Number::New(time));
+  result->Set(String::NewSymbol("duration"), Number::New(duration));
+  result->Set(String::NewSymbol("playing"), Boolean::New(playing));
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(animations::EvaluateAnimations) {
+  HandleScope scope;
+
+  CheckArgs0(evaluateAnimations);
+
+  Evaluate();
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(animations::GetAnimationStats) {
+  HandleScope scope;
+
+  CheckArgs1(getAnimationStats, stats, Object);
+
+  stats_t stats;
+  GetStats(&stats);
+
+  Local<Object> result = args[0].As<Object>();
+  result->Set(String::NewSymbol("animations"), Number::New(stats.animations));
+  result->Set(String::NewSymbol("playing"), Number::New(stats.playing));
+  result->Set(String::NewSymbol("tracks"), Number::New(stats.tracks));
+  result->Set(String::NewSymbol("evaluations"), Number::New(stats.evaluations));
+  result->Set(String::NewSymbol("updates"), Number::New(stats.updates));
+  result->Set(String::NewSymbol("unchanged"), Number::New(stats.unchanged));
+
+  V8_RETURN(Undefined());
+}
@@ -0,0 +1,123 @@
+#ifndef NODE_OPENVG_ANIMATION_TIMELINE_H_
+#define NODE_OPENVG_ANIMATION_TIMELINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// Animations played natively: each one a set of tracks, each track a
+// keyframed value bound to a target and eased between keyframes. Playing
+// animations are evaluated against a monotonic clock by Evaluate(), which
+// scene::Render calls before updating a scene; immediate mode drawing
+// relies on JS calling evaluateAnimations() once per frame. Otherwise JS
+// only plays, pauses and seeks them.
+//
+// Targets are the parts of a scene node's transform (translation, rotation
+// in degrees and scale, kept per node along with any shear and only taken
+// from the matrix again after it was changed otherwise), its opacity and
+// stroke width, a component of a paint's VG_PAINT_COLOR, the stroke line
+// width, miter limit or dash phase, set through the shadow state cache,
+// or the amount a path is interpolated between two others with
+// vgInterpolatePath. Paint and path tracks may name the scene node drawing
+// with them, to redraw it. A target is only touched when its value
+// changed since the track last set it, so a finished or paused animation
+// leaves scenes with nothing to redraw.
+namespace animations {
+
+enum target_t {
+  kNodeX = 0,
+  kNodeY,
+  kNodeRotation,
+  kNodeScaleX,
+  kNodeScaleY,
+  kNodeOpacity,
+  kNodeStrokeWidth,
+  kPaintColor,
+  kParameter,
+  kPathInterpolation
+};
+
+enum easing_t {
+  kLinear = 0,
+  kStep,        // Holds the value until the next keyframe
+  kCubicBezier  // CSS cubic-bezier(x1, y1, x2, y2)
+};
+
+struct keyframe_t {
+  VGfloat time;  // Seconds
+  VGfloat value;
+  easing_t easing;  // Towards the next keyframe
+  VGfloat bezier[4];
+};
+
+// Time, value, easing, then the four cubic-bezier values.
+const size_t kKeyframeValues = 7;
+
+struct track_t {
+  target_t target;
+  uint32_t handle;     // Scene node, paint or destination path
+  VGint component;     // Color component or VGParamType
+  VGPath from, to;     // Interpolated paths
+  uint32_t node;       // To redraw for paint and path targets, or 0
+  std::vector<keyframe_t> keyframes;  // By time
+  bool applied;
+  VGfloat lastValue;
+};
+
+struct stats_t {
+  size_t animations;
+  size_t playing;
+  size_t tracks;
+  size_t evaluations;
+  size_t updates;  // Targets set
+  size_t unchanged;  // Targets left alone, their value being the same
+};
+
+uint32_t Create();
+void Destroy(uint32_t animation);
+
+// Returns false if there's no such animation. Keyframes are sorted.
+bool AddTrack(uint32_t animation, const track_t &track);
+
+bool Play(uint32_t animation, bool loop);
+bool Pause(uint32_t animation);
+// The time is clamped to the animation's duration; the values are set at
+// the next evaluation, playing or not.
+bool Seek(uint32_t animation, double time);
+
+// Returns the animation's time, or -1 if there's no such animation.
+double Time(uint32_t animation, double *duration, bool *playing);
+
+// Sets the values of the animations playing or seeked since.
+void Evaluate();
+void EvaluateAt(double now);
+
+VGfloat Ease(const keyframe_t &keyframe, VGfloat progress);
+
+void GetStats(stats_t *stats);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(CreateAnimation);
+V8_FUNCTION_DECL(DestroyAnimation);
+V8_FUNCTION_DECL(AddAnimationTrack);
+V8_FUNCTION_DECL(PlayAnimation);
+V8_FUNCTION_DECL(PauseAnimation);
+V8_FUNCTION_DECL(SeekAnimation);
+V8_FUNCTION_DECL(GetAnimationInfo);
+V8_FUNCTION_DECL(EvaluateAnimations);
+V8_FUNCTION_DECL(GetAnimationStats);
+
+}
+
+#endif
@@ -0,0 +1,1436 @@
+#include <math.h>
+#include <string.h>
+
+#include <map>
+
+#include "VG/openvg.h"
+
+#include "canvas_context.h"
+#include "clip_stack.h"
+#include "font_face.h"
+#include "image_registry.h"
+#include "matrix_stack.h"
+#include "paint_cache.h"
+#include "state_cache.h"
+#include "typed_array.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+const VGfloat kIdentity[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+const VGfloat kTransparent[4] = { 0, 0, 0, 0 };
+const VGfloat kTwoPi = (VGfloat) (2 * M_PI);
+
+std::map<uint32_t, canvas::context_t> contexts;
+uint32_t nextContext = 1;
+
+size_t pathBuilds = 0, pathReuses = 0, draws = 0;
+
+// Path points in user space, kept between builds
+std::vector<VGfloat> points;
+
+// Affine, column major: result = a * b.
+void Multiply(const VGfloat *a, const VGfloat *b, VGfloat *result) {
+  VGfloat m[9];
+  for (int column = 0; column < 3; column++) {
+    const VGfloat *bc = b + column * 3;
+    m[column * 3 + 0] = a[0] * bc[0] + a[3] * bc[1] + a[6] * bc[2];
+    m[column * 3 + 1] = a[1] * bc[0] + a[4] * bc[1] + a[7] * bc[2];
+    m[column * 3 + 2] = bc[2];
+  }
+  memcpy(result, m, sizeof(m));
+}
+
+// Returns false for singular matrices.
+bool Invert(const VGfloat *m, VGfloat *inverse) {
+  VGfloat det = m[0] * m[4] - m[3] * m[1];
+  if (det == 0 || !isfinite(det)) {
+    return false;
+  }
+  inverse[0] = m[4] / det;
+  inverse[1] = -m[1] / det;
+  inverse[2] = 0;
+  inverse[3] = -m[3] / det;
+  inverse[4] = m[0] / det;
+  inverse[5] = 0;
+  inverse[6] = (m[3] * m[7] - m[4] * m[6]) / det;
+  inverse[7] = (m[1] * m[6] - m[0] * m[7]) / det;
+  inverse[8] = 1;
+  return true;
+}
+
+bool Invertible(const VGfloat *m) {
+  VGfloat det = m[0] * m[4] - m[3] * m[1];
+  return det != 0 && isfinite(det);
+}
+
+// a, b, c, d, e, f to column major.
+void FromCanvas(const VGfloat *matrix, VGfloat *m) {
+  m[0] = matrix[0]; m[1] = matrix[1]; m[2] = 0;
+  m[3] = matrix[2]; m[4] = matrix[3]; m[5] = 0;
+  m[6] = matrix[4]; m[7] = matrix[5]; m[8] = 1;
+}
+
+void Changed(canvas::context_t *context) {
+  context->pathBuilt = false;
+}
+
+void AddPoint(canvas::context_t *context, VGfloat x, VGfloat y) {
+  const VGfloat *m = context->state.transform;
+  context->points.push_back(m[0] * x + m[3] * y + m[6]);
+  context->points.push_back(m[1] * x + m[4] * y + m[7]);
+}
+
+void EnsureSubpath(canvas::context_t *context, VGfloat x, VGfloat y) {
+  if (!context->hasCurrentPoint) {
+    canvas::MoveTo(context, x, y);
+  }
+}
+
+// The current point in user space, false if there's none or the transform
+// can't be inverted.
+bool CurrentPoint(canvas::context_t *context, VGfloat *x, VGfloat *y) {
+  VGfloat inverse[9];
+  if (!context->hasCurrentPoint ||
+      !Invert(context->state.transform, inverse)) {
+    return false;
+  }
+  size_t n = context->points.size();
+  VGfloat dx = context->points[n - 2], dy = context->points[n - 1];
+  if (context->segments.back() == VG_CLOSE_PATH) {
+    dx = context->startX;
+    dy = context->startY;
+  }
+  *x = inverse[0] * dx + inverse[3] * dy + inverse[6];
+  *y = inverse[1] * dx + inverse[4] * dy + inverse[7];
+  return true;
+}
+
+// Cubics of at most a quarter turn each, from the current point on.
+void AppendArc(canvas::context_t *context, VGfloat cx, VGfloat cy,
+               VGfloat radius, VGfloat start, VGfloat sweep) {
+  int count = (int) ceilf(fabsf(sweep) / (VGfloat) (M_PI / 2) - 1e-4f);
+  if (count < 1) {
+    return;
+  }
+  VGfloat step = sweep / count;
+  VGfloat k = 4.0f / 3.0f * tanf(step / 4);
+
+  VGfloat a = start;
+  VGfloat cosA = cosf(a), sinA = sinf(a);
+  for (int i = 0; i < count; i++) {
+    VGfloat b = i == count - 1 ? start + sweep : a + step;
+    VGfloat cosB = cosf(b), sinB = sinf(b);
+    context->segments.push_back(VG_CUBIC_TO_ABS);
+    AddPoint(context, cx + radius * (cosA - k * sinA),
+                      cy + radius * (sinA + k * cosA));
+    AddPoint(context, cx + radius * (cosB + k * sinB),
+                      cy + radius * (sinB - k * cosB));
+    AddPoint(context, cx + radius * cosB, cy + radius * sinB);
+    a = b;
+    cosA = cosB;
+    sinA = sinB;
+  }
+}
+
+// Makes the path's data the current path mapped by the inverse of matrix,
+// for drawing under it. Returns false if matrix is singular.
+bool Build(canvas::context_t *context, const VGfloat *matrix) {
+  if (context->pathBuilt &&
+      memcmp(context->builtFor, matrix, sizeof(context->builtFor)) == 0) {
+    pathReuses++;
+    return true;
+  }
+
+  VGfloat inverse[9];
+  if (!Invert(matrix, inverse)) {
+    return false;
+  }
+
+  vgClearPath(context->path, VG_PATH_CAPABILITY_ALL);
+  if (memcmp(matrix, kIdentity, sizeof(kIdentity)) == 0) {
+    vgAppendPathData(context->path, (VGint) context->segments.size(),
+                     &context->segments[0], &context->points[0]);
+  } else {
+    points.resize(context->points.size());
+    for (size_t i = 0; i < points.size(); i += 2) {
+      VGfloat x = context->points[i], y = context->points[i + 1];
+      points[i] = inverse[0] * x + inverse[3] * y + inverse[6];
+      points[i + 1] = inverse[1] * x + inverse[4] * y + inverse[7];
+    }
+    vgAppendPathData(context->path, (VGint) context->segments.size(),
+                     &context->segments[0], &points[0]);
+  }
+
+  memcpy(context->builtFor, matrix, sizeof(context->builtFor));
+  context->pathBuilt = true;
+  pathBuilds++;
+  return true;
+}
+
+void LoadMatrix(VGint mode, const VGfloat *matrix) {
+  VGint matrixMode = state::MatrixMode();
+  state::SetI(VG_MATRIX_MODE, mode);
+  matrices::Load(matrix);
+  state::SetI(VG_MATRIX_MODE, matrixMode);
+}
+
+// Sets the paint for one mode, gradients mapped by paintToUser. Returns
+// false, drawing nothing, if there's no paint to draw with.
+bool UsePaint(canvas::context_t *context, VGbitfield paintMode,
+              const VGfloat *paintToUser) {
+  bool fill = paintMode == VG_FILL_PATH;
+  const canvas::style_t &style = fill ? context->state.fill :
+                                        context->state.stroke;
+
+  VGPaint paint;
+  if (style.type == VG_PAINT_TYPE_COLOR) {
+    paint = fill ? context->fillPaint : context->strokePaint;
+    VGfloat *color = fill ? context->fillPaintColor :
+                            context->strokePaintColor;
+    if (memcmp(color, style.color, sizeof(style.color)) != 0) {
+      vgSetParameterfv(paint, VG_PAINT_COLOR, 4, style.color);
+      memcpy(color, style.color, sizeof(style.color));
+    }
+  } else {
+    paint = gradients::Get(style.type,
+                           &style.geometry[0], style.geometry.size(),
+                           style.stops.empty() ? NULL : &style.stops[0],
+                           style.stops.size() / gradients::kStopValues,
+                           VG_COLOR_RAMP_SPREAD_PAD, false);
+    if (paint == VG_INVALID_HANDLE) {
+      return false;
+    }
+    LoadMatrix(fill ? VG_MATRIX_FILL_PAINT_TO_USER :
+                      VG_MATRIX_STROKE_PAINT_TO_USER, paintToUser);
+  }
+  state::SetPaint(paint, paintMode);
+  return true;
+}
+
+void UseCompositing(canvas::context_t *context) {
+  state::SetI(VG_BLEND_MODE, context->state.blendMode);
+  if (context->state.globalAlpha < 1) {
+    VGfloat values[8] = { 1, 1, 1, context->state.globalAlpha, 0, 0, 0, 0 };
+    state::SetFV(VG_COLOR_TRANSFORM_VALUES, 8, values);
+    state::SetI(VG_COLOR_TRANSFORM, VG_TRUE);
+  } else {
+    state::SetI(VG_COLOR_TRANSFORM, VG_FALSE);
+  }
+}
+
+void UseStroke(canvas::context_t *context) {
+  const canvas::state_t &s = context->state;
+  state::SetF(VG_STROKE_LINE_WIDTH, s.lineWidth);
+  state::SetI(VG_STROKE_CAP_STYLE, s.lineCap);
+  state::SetI(VG_STROKE_JOIN_STYLE, s.lineJoin);
+  state::SetF(VG_STROKE_MITER_LIMIT, s.miterLimit);
+  state::SetFV(VG_STROKE_DASH_PATTERN, (VGint) s.lineDash.size(),
+               s.lineDash.empty() ? NULL : &s.lineDash[0]);
+  state::SetF(VG_STROKE_DASH_PHASE, s.lineDashOffset);
+}
+
+void SetRectPath(canvas::context_t *context, VGfloat x, VGfloat y,
+                 VGfloat width, VGfloat height) {
+  static const VGubyte segments[] = {
+    VG_MOVE_TO_ABS, VG_LINE_TO_ABS, VG_LINE_TO_ABS, VG_LINE_TO_ABS,
+    VG_CLOSE_PATH
+  };
+  const VGfloat points[] = {
+    x, y, x + width, y, x + width, y + height, x, y + height
+  };
+  vgClearPath(context->rectPath, VG_PATH_CAPABILITY_ALL);
+  vgAppendPathData(context->rectPath, 5, segments, points);
+}
+
+// Pops the clip stack back to where it was before a state's clips. Clips
+// pushed above them go as well: the stack can't lose one from the middle.
+void PopClips(const canvas::state_t &state) {
+  if (state.clips == 0) {
+    return;
+  }
+  while (clips::Depth() > state.clipDepth) {
+    clips::Pop();
+  }
+}
+
+void DefaultState(canvas::context_t *context) {
+  canvas::state_t &s = context->state;
+  s.fill.type = s.stroke.type = VG_PAINT_TYPE_COLOR;
+  s.fill.color[0] = s.fill.color[1] = s.fill.color[2] = 0;
+  s.fill.color[3] = 1;
+  memcpy(s.stroke.color, s.fill.color, sizeof(s.fill.color));
+  s.lineWidth = 1;
+  s.lineCap = VG_CAP_BUTT;
+  s.lineJoin = VG_JOIN_MITER;
+  s.miterLimit = 10;
+  s.lineDashOffset = 0;
+  s.globalAlpha = 1;
+  s.blendMode = VG_BLEND_SRC_OVER;
+  s.face = 0;
+  s.fontSize = 10;
+  s.textAlign = canvas::kAlignLeft;
+  s.clips = 0;
+  s.clipDepth = 0;
+
+  const VGfloat identity[6] = { 1, 0, 0, 1, 0, 0 };
+  canvas::SetTransform(context, identity);
+}
+
+}
+
+uint32_t canvas::Create(VGint width, VGint height) {
+  uint32_t id = nextContext++;
+  context_t &context = contexts[id];
+  context.width = width;
+  context.height = height;
+  context.hasCurrentPoint = false;
+  context.isRect = false;
+  context.pathBuilt = false;
+
+  context.path = vgCreatePath(VG_PATH_FORMAT_STANDARD, VG_PATH_DATATYPE_F,
+                              1, 0, 0, 0, VG_PATH_CAPABILITY_ALL);
+  context.rectPath = vgCreatePath(VG_PATH_FORMAT_STANDARD, VG_PATH_DATATYPE_F,
+                                  1, 0, 5, 8, VG_PATH_CAPABILITY_ALL);
+  context.fillPaint = vgCreatePaint();
+  context.strokePaint = vgCreatePaint();
+  context.clearPaint = vgCreatePaint();
+  vgSetParameterfv(context.clearPaint, VG_PAINT_COLOR, 4, kTransparent);
+  // Paints start out opaque black, the canvas default
+  context.fillPaintColor[0] = context.fillPaintColor[1] =
+    context.fillPaintColor[2] = 0;
+  context.fillPaintColor[3] = 1;
+  memcpy(context.strokePaintColor, context.fillPaintColor,
+         sizeof(context.fillPaintColor));
+
+  DefaultState(&context);
+  return id;
+}
+
+void canvas::Destroy(uint32_t id) {
+  std::map<uint32_t, context_t>::iterator it = contexts.find(id);
+  if (it == contexts.end()) {
+    return;
+  }
+
+  context_t &context = it->second;
+  // The outermost state's clips are the deepest
+  for (size_t i = 0; i < context.saved.size(); i++) {
+    PopClips(context.saved[i]);
+  }
+  PopClips(context.state);
+  vgDestroyPath(context.path);
+  vgDestroyPath(context.rectPath);
+  VGPaint paints[] = {
+    context.fillPaint, context.strokePaint, context.clearPaint
+  };
+  for (size_t i = 0; i < 3; i++) {
+    vgDestroyPaint(paints[i]);
+    state::ForgetPaint(paints[i]);
+  }
+  contexts.erase(it);
+}
+
+canvas::context_t *canvas::Get(uint32_t id) {
+  std::map<uint32_t, context_t>::iterator it = contexts.find(id);
+  return it == contexts.end() ? NULL : &it->second;
+}
+
+void canvas::Save(context_t *context) {
+  context->saved.push_back(context->state);
+  context->state.clips = 0;
+}
+
+bool canvas::Restore(context_t *context) {
+  if (context->saved.empty()) {
+    return false;
+  }
+  PopClips(context->state);
+  context->state = context->saved.back();
+  context->saved.pop_back();
+  return true;
+}
+
+void canvas::Transform(context_t *context, const VGfloat *matrix) {
+  VGfloat m[9];
+  FromCanvas(matrix, m);
+  Multiply(context->state.transform, m, context->state.transform);
+}
+
+void canvas::SetTransform(context_t *context, const VGfloat *matrix) {
+  // Top left origin, y down
+  const VGfloat flip[9] = { 1, 0, 0, 0, -1, 0, 0, (VGfloat) context->height, 1 };
+  VGfloat m[9];
+  FromCanvas(matrix, m);
+  Multiply(flip, m, context->state.transform);
+}
+
+void canvas::BeginPath(context_t *context) {
+  context->segments.clear();
+  context->points.clear();
+  context->hasCurrentPoint = false;
+  context->isRect = false;
+  Changed(context);
+}
+
+void canvas::ClosePath(context_t *context) {
+  if (!context->hasCurrentPoint) {
+    return;
+  }
+  context->segments.push_back(VG_CLOSE_PATH);
+  context->isRect = false;
+  Changed(context);
+}
+
+void canvas::MoveTo(context_t *context, VGfloat x, VGfloat y) {
+  context->segments.push_back(VG_MOVE_TO_ABS);
+  AddPoint(context, x, y);
+  context->startX = context->points[context->points.size() - 2];
+  context->startY = context->points[context->points.size() - 1];
+  context->hasCurrentPoint = true;
+  context->isRect = false;
+  Changed(context);
+}
+
+void canvas::LineTo(context_t *context, VGfloat x, VGfloat y) {
+  if (!context->hasCurrentPoint) {
+    MoveTo(context, x, y);
+    return;
+  }
+  context->segments.push_back(VG_LINE_TO_ABS);
+  AddPoint(context, x, y);
+  context->isRect = false;
+  Changed(context);
+}
+
+void canvas::QuadraticCurveTo(context_t *context,
+                              VGfloat cpx, VGfloat cpy, VGfloat x, VGfloat y) {
+  EnsureSubpath(context, cpx, cpy);
+  context->segments.push_back(VG_QUAD_TO_ABS);
+  AddPoint(context, cpx, cpy);
+  AddPoint(context, x, y);
+  context->isRect = false;
+  Changed(context);
+}
+
+void canvas::BezierCurveTo(context_t *context,
+                           VGfloat cp1x, VGfloat cp1y,
+                           VGfloat cp2x, VGfloat cp2y, VGfloat x, VGfloat y) {
+  EnsureSubpath(context, cp1x, cp1y);
+  context->segments.push_back(VG_CUBIC_TO_ABS);
+  AddPoint(context, cp1x, cp1y);
+  AddPoint(context, cp2x, cp2y);
+  AddPoint(context, x, y);
+  context->isRect = false;
+  Changed(context);
+}
+
+void canvas::Arc(context_t *context, VGfloat x, VGfloat y, VGfloat radius,
+                 VGfloat startAngle, VGfloat endAngle, bool anticlockwise) {
+  VGfloat sweep = endAngle - startAngle;
+  if (!anticlockwise) {
+    if (sweep >= kTwoPi) {
+      sweep = kTwoPi;
+    } else {
+      sweep = fmodf(sweep, kTwoPi);
+      if (sweep < 0) sweep += kTwoPi;
+    }
+  } else {
+    if (sweep <= -kTwoPi) {
+      sweep = -kTwoPi;
+    } else {
+      sweep = fmodf(sweep, kTwoPi);
+      if (sweep > 0) sweep -= kTwoPi;
+    }
+  }
+
+  VGfloat startX = x + radius * cosf(startAngle);
+  VGfloat startY = y + radius * sinf(startAngle);
+  LineTo(context, startX, startY);
+  AppendArc(context, x, y, radius, startAngle, sweep);
+  context->isRect = false;
+  Changed(context);
+}
+
+void canvas::ArcTo(context_t *context, VGfloat x1, VGfloat y1,
+                   VGfloat x2, VGfloat y2, VGfloat radius) {
+  EnsureSubpath(context, x1, y1);
+
+  VGfloat x0, y0;
+  if (!CurrentPoint(context, &x0, &y0)) {
+    LineTo(context, x1, y1);
+    return;
+  }
+
+  VGfloat ux = x0 - x1, uy = y0 - y1, vx = x2 - x1, vy = y2 - y1;
+  VGfloat uLength = sqrtf(ux * ux + uy * uy);
+  VGfloat vLength = sqrtf(vx * vx + vy * vy);
+  VGfloat cross = ux * vy - uy * vx;
+  if (uLength == 0 || vLength == 0 || radius == 0 ||
+      fabsf(cross) <= 1e-6f * uLength * vLength) {
+    // Coincident or collinear points
+    LineTo(context, x1, y1);
+    return;
+  }
+  ux /= uLength; uy /= uLength;
+  vx /= vLength; vy /= vLength;
+
+  // Half the angle between the lines at (x1, y1)
+  VGfloat half = acosf(fmaxf(-1, fminf(1, ux * vx + uy * vy))) / 2;
+  VGfloat tangent = radius / tanf(half);
+  VGfloat bx = ux + vx, by = uy + vy;
+  VGfloat bLength = sqrtf(bx * bx + by * by);
+  VGfloat centerDistance = radius / sinf(half);
+  VGfloat cx = x1 + bx / bLength * centerDistance;
+  VGfloat cy = y1 + by / bLength * centerDistance;
+
+  VGfloat t1x = x1 + ux * tangent, t1y = y1 + uy * tangent;
+  VGfloat t2x = x1 + vx * tangent, t2y = y1 + vy * tangent;
+  VGfloat start = atan2f(t1y - cy, t1x - cx);
+  VGfloat sweep = atan2f(t2y - cy, t2x - cx) - start;
+  // The short way round, in the direction of the turn
+  if (cross > 0 && sweep > 0) sweep -= kTwoPi;
+  if (cross < 0 && sweep < 0) sweep += kTwoPi;
+
+  LineTo(context, t1x, t1y);
+  AppendArc(context, cx, cy, radius, start, sweep);
+  context->isRect = false;
+  Changed(context);
+}
+
+void canvas::Rect(context_t *context, VGfloat x, VGfloat y,
+                  VGfloat width, VGfloat height) {
+  bool first = context->segments.empty();
+  MoveTo(context, x, y);
+  LineTo(context, x + width, y);
+  LineTo(context, x + width, y + height);
+  LineTo(context, x, y + height);
+  ClosePath(context);
+  MoveTo(context, x, y);
+  context->isRect = first;
+}
+
+void canvas::Fill(context_t *context, VGFillRule rule) {
+  if (context->segments.empty() || !Build(context, context->state.transform) ||
+      !UsePaint(context, VG_FILL_PATH, kIdentity)) {
+    return;
+  }
+  UseCompositing(context);
+  state::SetI(VG_FILL_RULE, rule);
+  LoadMatrix(VG_MATRIX_PATH_USER_TO_SURFACE, context->state.transform);
+  matrices::Sync();
+  vgDrawPath(context->path, VG_FILL_PATH);
+  draws++;
+}
+
+void canvas::Stroke(context_t *context) {
+  if (context->segments.empty() || !Build(context, context->state.transform) ||
+      !UsePaint(context, VG_STROKE_PATH, kIdentity)) {
+    return;
+  }
+  UseCompositing(context);
+  UseStroke(context);
+  LoadMatrix(VG_MATRIX_PATH_USER_TO_SURFACE, context->state.transform);
+  matrices::Sync();
+  vgDrawPath(context->path, VG_STROKE_PATH);
+  draws++;
+}
+
+bool canvas::Clip(context_t *context, VGFillRule rule) {
+  LoadMatrix(VG_MATRIX_PATH_USER_TO_SURFACE, kIdentity);
+  size_t depth = clips::Depth();
+
+  bool pushed;
+  const VGfloat *p = context->points.empty() ? NULL : &context->points[0];
+  if (context->isRect &&
+      ((p[0] == p[2] && p[4] == p[6] && p[3] == p[5] && p[7] == p[1]) ||
+       (p[1] == p[3] && p[5] == p[7] && p[2] == p[4] && p[6] == p[0]))) {
+    // Axis aligned on the surface: a scissor rectangle
+    VGfloat x = fminf(p[0], p[4]), y = fminf(p[1], p[5]);
+    pushed = clips::PushRect(x, y, fmaxf(p[0], p[4]) - x,
+                             fmaxf(p[1], p[5]) - y);
+  } else {
+    if (context->segments.empty()) {
+      // Clipping to nothing
+      pushed = clips::PushRect(0, 0, 0, 0);
+    } else {
+      Build(context, kIdentity);
+      state::SetI(VG_FILL_RULE, rule);
+      matrices::Sync();
+      pushed = clips::PushPath(context->path);
+    }
+  }
+
+  if (pushed) {
+    if (context->state.clips == 0) {
+      context->state.clipDepth = depth;
+    }
+    context->state.clips++;
+  }
+  return pushed;
+}
+
+void canvas::FillRect(context_t *context, VGfloat x, VGfloat y,
+                      VGfloat width, VGfloat height) {
+  if (!Invertible(context->state.transform) ||
+      !UsePaint(context, VG_FILL_PATH, kIdentity)) {
+    return;
+  }
+  SetRectPath(context, x, y, width, height);
+  UseCompositing(context);
+  state::SetI(VG_FILL_RULE, VG_NON_ZERO);
+  LoadMatrix(VG_MATRIX_PATH_USER_TO_SURFACE, context->state.transform);
+  matrices::Sync();
+  vgDrawPath(context->rectPath, VG_FILL_PATH);
+  draws++;
+}
+
+void canvas::StrokeRect(context_t *context, VGfloat x, VGfloat y,
+                        VGfloat width, VGfloat height) {
+  if (!Invertible(context->state.transform) ||
+      !UsePaint(context, VG_STROKE_PATH, kIdentity)) {
+    return;
+  }
+  SetRectPath(context, x, y, width, height);
+  UseCompositing(context);
+  UseStroke(context);
+  LoadMatrix(VG_MATRIX_PATH_USER_TO_SURFACE, context->state.transform);
+  matrices::Sync();
+  vgDrawPath(context->rectPath, VG_STROKE_PATH);
+  draws++;
+}
+
+void canvas::ClearRect(context_t *context, VGfloat x, VGfloat y,
+                       VGfloat width, VGfloat height) {
+  if (!Invertible(context->state.transform)) {
+    return;
+  }
+  SetRectPath(context, x, y, width, height);
+  // Transparent black replacing what's there, clipped
+  state::SetPaint(context->clearPaint, VG_FILL_PATH);
+  state::SetI(VG_BLEND_MODE, VG_BLEND_SRC);
+  state::SetI(VG_COLOR_TRANSFORM, VG_FALSE);
+  state::SetI(VG_FILL_RULE, VG_NON_ZERO);
+  LoadMatrix(VG_MATRIX_PATH_USER_TO_SURFACE, context->state.transform);
+  matrices::Sync();
+  vgDrawPath(context->rectPath, VG_FILL_PATH);
+  draws++;
+}
+
+void canvas::DrawText(context_t *context, const uint16_t *text, size_t length,
+                      VGfloat x, VGfloat y, VGbitfield paintModes) {
+  const state_t &s = context->state;
+  if (faces::Get(s.face) == NULL || !Invertible(s.transform)) {
+    return;
+  }
+
+  // Glyphs are y up: text space is the user space at (x, y), flipped back
+  const VGfloat toText[9] = { 1, 0, 0, 0, -1, 0, x, y, 1 };
+  const VGfloat paintToText[9] = { 1, 0, 0, 0, -1, 0, -x, y, 1 };
+  if (!UsePaint(context, paintModes, paintToText)) {
+    return;
+  }
+  UseCompositing(context);
+  if (paintModes == VG_STROKE_PATH) {
+    UseStroke(context);
+  }
+
+  VGfloat pen = 0;
+  if (s.textAlign != kAlignLeft) {
+    VGfloat width = faces::Width(s.face, text, length) * s.fontSize;
+    pen = s.textAlign == kAlignCenter ? -width / 2 : -width;
+  }
+
+  VGfloat m[9];
+  Multiply(s.transform, toText, m);
+  LoadMatrix(VG_MATRIX_PATH_USER_TO_SURFACE, m);
+  faces::Draw(s.face, text, length, pen, 0, s.fontSize, paintModes);
+  draws++;
+}
+
+VGfloat canvas::MeasureText(context_t *context,
+                            const uint16_t *text, size_t length) {
+  return faces::Width(context->state.face, text, length) *
+         context->state.fontSize;
+}
+
+void canvas::DrawImage(context_t *context, VGImage image,
+                       VGfloat x, VGfloat y, VGfloat width, VGfloat height) {
+  VGImage handle = registry::Read(image);
+  VGint imageWidth = vgGetParameteri(handle, VG_IMAGE_WIDTH);
+  VGint imageHeight = vgGetParameteri(handle, VG_IMAGE_HEIGHT);
+  if (isnan(width)) width = (VGfloat) imageWidth;
+  if (isnan(height)) height = (VGfloat) imageHeight;
+  if (imageWidth <= 0 || imageHeight <= 0 || width == 0 || height == 0 ||
+      !Invertible(context->state.transform)) {
+    return;
+  }
+
+  // Image rows are stored top down, which the flipped transform keeps
+  // upright
+  const VGfloat placement[9] = {
+    width / imageWidth, 0, 0, 0, height / imageHeight, 0, x, y, 1
+  };
+  VGfloat m[9];
+  Multiply(context->state.transform, placement, m);
+  // Affine in the projective image mode
+  m[2] = m[5] = 0;
+  m[8] = 1;
+
+  UseCompositing(context);
+  state::SetI(VG_IMAGE_MODE, VG_DRAW_IMAGE_NORMAL);
+  LoadMatrix(VG_MATRIX_IMAGE_USER_TO_SURFACE, m);
+  matrices::Sync();
+  registry::Draw(image);
+  draws++;
+}
+
+void canvas::GetStats(stats_t *stats) {
+  stats->contexts = contexts.size();
+  stats->pathBuilds = pathBuilds;
+  stats->pathReuses = pathReuses;
+  stats->draws = draws;
+}
+
+
+extern void canvas::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "createCanvasContext"    , canvas::CreateCanvasContext);
+  NODE_SET_METHOD(target, "destroyCanvasContext"   , canvas::DestroyCanvasContext);
+  NODE_SET_METHOD(target, "canvasSave"             , canvas::CanvasSave);
+  NODE_SET_METHOD(target, "canvasRestore"          , canvas::CanvasRestore);
+  NODE_SET_METHOD(target, "canvasTransform"        , canvas::CanvasTransform);
+  NODE_SET_METHOD(target, "canvasSetTransform"     , canvas::CanvasSetTransform);
+  NODE_SET_METHOD(target, "canvasTranslate"        , canvas::CanvasTranslate);
+  NODE_SET_METHOD(target, "canvasScale"            , canvas::CanvasScale);
+  NODE_SET_METHOD(target, "canvasRotate"           , canvas::CanvasRotate);
+  NODE_SET_METHOD(target, "canvasBeginPath"        , canvas::CanvasBeginPath);
+  NODE_SET_METHOD(target, "canvasClosePath"        , canvas::CanvasClosePath);
+  NODE_SET_METHOD(target, "canvasMoveTo"           , canvas::CanvasMoveTo);
+  NODE_SET_METHOD(target, "canvasLineTo"           , canvas::CanvasLineTo);
+  NODE_SET_METHOD(target, "canvasQuadraticCurveTo" , canvas::CanvasQuadraticCurveTo);
+  NODE_SET_METHOD(target, "canvasBezierCurveTo"    , canvas::CanvasBezierCurveTo);
+  NODE_SET_METHOD(target, "canvasArc"              , canvas::CanvasArc);
+  NODE_SET_METHOD(target, "canvasArcTo"            , canvas::CanvasArcTo);
+  NODE_SET_METHOD(target, "canvasRect"             , canvas::CanvasRect);
+  NODE_SET_METHOD(target, "canvasFill"             , canvas::CanvasFill);
+  NODE_SET_METHOD(target, "canvasStroke"           , canvas::CanvasStroke);
+  NODE_SET_METHOD(target, "canvasClip"             , canvas::CanvasClip);
+  NODE_SET_METHOD(target, "canvasFillRect"         , canvas::CanvasFillRect);
+  NODE_SET_METHOD(target, "canvasStrokeRect"       , canvas::CanvasStrokeRect);
+  NODE_SET_METHOD(target, "canvasClearRect"        , canvas::CanvasClearRect);
+  NODE_SET_METHOD(target, "canvasFillText"         , canvas::CanvasFillText);
+  NODE_SET_METHOD(target, "canvasStrokeText"       , canvas::CanvasStrokeText);
+  NODE_SET_METHOD(target, "canvasMeasureText"      , canvas::CanvasMeasureText);
+  NODE_SET_METHOD(target, "canvasDrawImage"        , canvas::CanvasDrawImage);
+  NODE_SET_METHOD(target, "canvasSetColor"         , canvas::CanvasSetColor);
+  NODE_SET_METHOD(target, "canvasSetGradient"      , canvas::CanvasSetGradient);
+  NODE_SET_METHOD(target, "canvasSetLineWidth"     , canvas::CanvasSetLineWidth);
+  NODE_SET_METHOD(target, "canvasSetLineCap"       , canvas::CanvasSetLineCap);
+  NODE_SET_METHOD(target, "canvasSetLineJoin"      , canvas::CanvasSetLineJoin);
+  NODE_SET_METHOD(target, "canvasSetMiterLimit"    , canvas::CanvasSetMiterLimit);
+  NODE_SET_METHOD(target, "canvasSetLineDash"      , canvas::CanvasSetLineDash);
+  NODE_SET_METHOD(target, "canvasSetLineDashOffset", canvas::CanvasSetLineDashOffset);
+  NODE_SET_METHOD(target, "canvasSetGlobalAlpha"   , canvas::CanvasSetGlobalAlpha);
+  NODE_SET_METHOD(target, "canvasSetBlendMode"     , canvas::CanvasSetBlendMode);
+  NODE_SET_METHOD(target, "canvasSetFont"          , canvas::CanvasSetFont);
+  NODE_SET_METHOD(target, "canvasSetTextAlign"     , canvas::CanvasSetTextAlign);
+  NODE_SET_METHOD(target, "getCanvasStats"         , canvas::GetCanvasStats);
+}
+
+V8_METHOD(canvas::CreateCanvasContext) {
+  HandleScope scope;
+
+  CheckArgs2(createCanvasContext, width, Int32, height, Int32);
+
+  V8_RETURN(Uint32::New(Create(args[0]->Int32Value(), args[1]->Int32Value())));
+}
+
+V8_METHOD(canvas::DestroyCanvasContext) {
+  HandleScope scope;
+
+  CheckArgs1(destroyCanvasContext, context, Uint32);
+
+  Destroy(args[0]->Uint32Value());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasSave) {
+  HandleScope scope;
+
+  CheckArgs1(canvasSave, context, Uint32);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasSave: unknown canvas context")));
+  }
+  Save(context);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasRestore) {
+  HandleScope scope;
+
+  CheckArgs1(canvasRestore, context, Uint32);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasRestore: unknown canvas context")));
+  }
+  // Like the canvas, restoring with nothing saved does nothing
+  Restore(context);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasTransform) {
+  HandleScope scope;
+
+  CheckArgs7(canvasTransform, context, Uint32, a, Number, b, Number,
+             c, Number, d, Number, e, Number, f, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasTransform: unknown canvas context")));
+  }
+  VGfloat matrix[6];
+  for (int i = 0; i < 6; i++) {
+    matrix[i] = (VGfloat) args[i + 1]->NumberValue();
+  }
+  Transform(context, matrix);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasSetTransform) {
+  HandleScope scope;
+
+  CheckArgs7(canvasSetTransform, context, Uint32, a, Number, b, Number,
+             c, Number, d, Number, e, Number, f, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasSetTransform: unknown canvas context")));
+  }
+  VGfloat matrix[6];
+  for (int i = 0; i < 6; i++) {
+    matrix[i] = (VGfloat) args[i + 1]->NumberValue();
+  }
+  SetTransform(context, matrix);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasTranslate) {
+  HandleScope scope;
+
+  CheckArgs3(canvasTranslate, context, Uint32, x, Number, y, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasTranslate: unknown canvas context")));
+  }
+  const VGfloat matrix[6] = {
+    1, 0, 0, 1,
+    (VGfloat) args[1]->NumberValue(), (VGfloat) args[2]->NumberValue()
+  };
+  Transform(context, matrix);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasScale) {
+  HandleScope scope;
+
+  CheckArgs3(canvasScale, context, Uint32, x, Number, y, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasScale: unknown canvas context")));
+  }
+  const VGfloat matrix[6] = {
+    (VGfloat) args[1]->NumberValue(), 0, 0, (VGfloat) args[2]->NumberValue(),
+    0, 0
+  };
+  Transform(context, matrix);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasRotate) {
+  HandleScope scope;
+
+  CheckArgs2(canvasRotate, context, Uint32, angle, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasRotate: unknown canvas context")));
+  }
+  // Radians, clockwise on the canvas
+  VGfloat angle = (VGfloat) args[1]->NumberValue();
+  VGfloat c = cosf(angle), s = sinf(angle);
+  const VGfloat matrix[6] = { c, s, -s, c, 0, 0 };
+  Transform(context, matrix);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasBeginPath) {
+  HandleScope scope;
+
+  CheckArgs1(canvasBeginPath, context, Uint32);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasBeginPath: unknown canvas context")));
+  }
+  BeginPath(context);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasClosePath) {
+  HandleScope scope;
+
+  CheckArgs1(canvasClosePath, context, Uint32);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasClosePath: unknown canvas context")));
+  }
+  ClosePath(context);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasMoveTo) {
+  HandleScope scope;
+
+  CheckArgs3(canvasMoveTo, context, Uint32, x, Number, y, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasMoveTo: unknown canvas context")));
+  }
+  MoveTo(context, (VGfloat) args[1]->NumberValue(),
+         (VGfloat) args[2]->NumberValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasLineTo) {
+  HandleScope scope;
+
+  CheckArgs3(canvasLineTo, context, Uint32, x, Number, y, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasLineTo: unknown canvas context")));
+  }
+  LineTo(context, (VGfloat) args[1]->NumberValue(),
+         (VGfloat) args[2]->NumberValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasQuadraticCurveTo) {
+  HandleScope scope;
+
+  CheckArgs5(canvasQuadraticCurveTo, context, Uint32, cpx, Number, cpy, Number,
+             x, Number, y, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasQuadraticCurveTo: unknown canvas context")));
+  }
+  QuadraticCurveTo(context,
+                   (VGfloat) args[1]->NumberValue(), (VGfloat) args[2]->NumberValue(),
+                   (VGfloat) args[3]->NumberValue(), (VGfloat) args[4]->NumberValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasBezierCurveTo) {
+  HandleScope scope;
+
+  CheckArgs7(canvasBezierCurveTo, context, Uint32, cp1x, Number, cp1y, Number,
+             cp2x, Number, cp2y, Number, x, Number, y, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasBezierCurveTo: unknown canvas context")));
+  }
+  BezierCurveTo(context,
+                (VGfloat) args[1]->NumberValue(), (VGfloat) args[2]->NumberValue(),
+                (VGfloat) args[3]->NumberValue(), (VGfloat) args[4]->NumberValue(),
+                (VGfloat) args[5]->NumberValue(), (VGfloat) args[6]->NumberValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasArc) {
+  HandleScope scope;
+
+  CheckArgs7(canvasArc, context, Uint32, x, Number, y, Number,
+             radius, Number, startAngle, Number, endAngle, Number,
+             anticlockwise, Boolean);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasArc: unknown canvas context")));
+  }
+  VGfloat radius = (VGfloat) args[3]->NumberValue();
+  if (radius < 0) {
+    V8_THROW(Exception::RangeError(String::New("canvasArc: negative radius")));
+  }
+  Arc(context, (VGfloat) args[1]->NumberValue(), (VGfloat) args[2]->NumberValue(),
+      radius, (VGfloat) args[4]->NumberValue(), (VGfloat) args[5]->NumberValue(),
+      args[6]->BooleanValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasArcTo) {
+  HandleScope scope;
+
+  CheckArgs6(canvasArcTo, context, Uint32, x1, Number, y1, Number,
+             x2, Number, y2, Number, radius, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasArcTo: unknown canvas context")));
+  }
+  VGfloat radius = (VGfloat) args[5]->NumberValue();
+  if (radius < 0) {
+    V8_THROW(Exception::RangeError(String::New("canvasArcTo: negative radius")));
+  }
+  ArcTo(context, (VGfloat) args[1]->NumberValue(), (VGfloat) args[2]->NumberValue(),
+        (VGfloat) args[3]->NumberValue(), (VGfloat) args[4]->NumberValue(),
+        radius);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasRect) {
+  HandleScope scope;
+
+  CheckArgs5(canvasRect, context, Uint32, x, Number, y, Number,
+             width, Number, height, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasRect: unknown canvas context")));
+  }
+  Rect(context, (VGfloat) args[1]->NumberValue(), (VGfloat) args[2]->NumberValue(),
+       (VGfloat) args[3]->NumberValue(), (VGfloat) args[4]->NumberValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasFill) {
+  HandleScope scope;
+
+  CheckArgs2(canvasFill, context, Uint32, fillRule, Uint32);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasFill: unknown canvas context")));
+  }
+  Fill(context, static_cast<VGFillRule>(args[1]->Uint32Value()));
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasStroke) {
+  HandleScope scope;
+
+  CheckArgs1(canvasStroke, context, Uint32);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasStroke: unknown canvas context")));
+  }
+  Stroke(context);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasClip) {
+  HandleScope scope;
+
+  CheckArgs2(canvasClip, context, Uint32, fillRule, Uint32);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasClip: unknown canvas context")));
+  }
+  if (!Clip(context, static_cast<VGFillRule>(args[1]->Uint32Value()))) {
+    V8_THROW(Exception::Error(String::New("canvasClip: couldn't save the mask")));
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasFillRect) {
+  HandleScope scope;
+
+  CheckArgs5(canvasFillRect, context, Uint32, x, Number, y, Number,
+             width, Number, height, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasFillRect: unknown canvas context")));
+  }
+  FillRect(context, (VGfloat) args[1]->NumberValue(), (VGfloat) args[2]->NumberValue(),
+           (VGfloat) args[3]->NumberValue(), (VGfloat) args[4]->NumberValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasStrokeRect) {
+  HandleScope scope;
+
+  CheckArgs5(canvasStrokeRect, context, Uint32, x, Number, y, Number,
+             width, Number, height, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasStrokeRect: unknown canvas context")));
+  }
+  StrokeRect(context, (VGfloat) args[1]->NumberValue(), (VGfloat) args[2]->NumberValue(),
+             (VGfloat) args[3]->NumberValue(), (VGfloat) args[4]->NumberValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasClearRect) {
+  HandleScope scope;
+
+  CheckArgs5(canvasClearRect, context, Uint32, x, Number, y, Number,
+             width, Number, height, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasClearRect: unknown canvas context")));
+  }
+  ClearRect(context, (VGfloat) args[1]->NumberValue(), (VGfloat) args[2]->NumberValue(),
+            (VGfloat) args[3]->NumberValue(), (VGfloat) args[4]->NumberValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasFillText) {
+  HandleScope scope;
+
+  CheckArgs4(canvasFillText, context, Uint32, text, String, x, Number, y, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasFillText: unknown canvas context")));
+  }
+  String::Value text(args[1]);
+  DrawText(context, *text, text.length(),
+           (VGfloat) args[2]->NumberValue(), (VGfloat) args[3]->NumberValue(),
+           VG_FILL_PATH);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasStrokeText) {
+  HandleScope scope;
+
+  CheckArgs4(canvasStrokeText, context, Uint32, text, String, x, Number, y, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasStrokeText: unknown canvas context")));
+  }
+  String::Value text(args[1]);
+  DrawText(context, *text, text.length(),
+           (VGfloat) args[2]->NumberValue(), (VGfloat) args[3]->NumberValue(),
+           VG_STROKE_PATH);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasMeasureText) {
+  HandleScope scope;
+
+  CheckArgs2(canvasMeasureText, context, Uint32, text, String);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasMeasureText: unknown canvas context")));
+  }
+  String::Value text(args[1]);
+
+  V8_RETURN(Number::New(MeasureText(context, *text, text.length())));
+}
+
+V8_METHOD(canvas::CanvasDrawImage) {
+  HandleScope scope;
+
+  CheckArgs6(canvasDrawImage, context, Uint32, image, Uint32, x, Number,
+             y, Number, width, Number, height, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasDrawImage: unknown canvas context")));
+  }
+  DrawImage(context, static_cast<VGImage>(args[1]->Uint32Value()),
+            (VGfloat) args[2]->NumberValue(), (VGfloat) args[3]->NumberValue(),
+            (VGfloat) args[4]->NumberValue(), (VGfloat) args[5]->NumberValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasSetColor) {
+  HandleScope scope;
+
+  CheckArgs6(canvasSetColor, context, Uint32, stroke, Boolean,
+             r, Number, g, Number, b, Number, a, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasSetColor: unknown canvas context")));
+  }
+  style_t &style = args[1]->BooleanValue() ? context->state.stroke :
+                                             context->state.fill;
+  style.type = VG_PAINT_TYPE_COLOR;
+  for (int i = 0; i < 4; i++) {
+    style.color[i] = (VGfloat) args[i + 2]->NumberValue();
+  }
+  style.geometry.clear();
+  style.stops.clear();
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasSetGradient) {
+  HandleScope scope;
+
+  // Always checked: the arrays are read below
+  if (!(args.Length() == 5 && args[0]->IsUint32() && args[1]->IsBoolean() &&
+        args[2]->IsUint32() && args[3]->IsObject() && args[4]->IsObject())) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected canvasSetGradient(Number, Boolean, VGPaintType, Float32Array, Float32Array)")));
+  }
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasSetGradient: unknown canvas context")));
+  }
+  VGPaintType type = static_cast<VGPaintType>(args[2]->Uint32Value());
+  TypedArrayWrapper<VGfloat> geometry(args[3]);
+  TypedArrayWrapper<VGfloat> stops(args[4]);
+  size_t expected = type == VG_PAINT_TYPE_LINEAR_GRADIENT ? 4 :
+                    type == VG_PAINT_TYPE_RADIAL_GRADIENT ? 5 : 0;
+  if (expected == 0 || (size_t) geometry.length() != expected) {
+    V8_THROW(Exception::TypeError(String::New("canvasSetGradient: expected a linear gradient with 4 values or a radial gradient with 5")));
+  }
+
+  style_t &style = args[1]->BooleanValue() ? context->state.stroke :
+                                             context->state.fill;
+  style.type = type;
+  style.geometry.assign(geometry.pointer(), geometry.pointer() + expected);
+  style.stops.assign(stops.pointer(), stops.pointer() + stops.length());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasSetLineWidth) {
+  HandleScope scope;
+
+  CheckArgs2(canvasSetLineWidth, context, Uint32, width, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasSetLineWidth: unknown canvas context")));
+  }
+  // Like the canvas, values that aren't positive are ignored
+  VGfloat width = (VGfloat) args[1]->NumberValue();
+  if (width > 0 && isfinite(width)) {
+    context->state.lineWidth = width;
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasSetLineCap) {
+  HandleScope scope;
+
+  CheckArgs2(canvasSetLineCap, context, Uint32, capStyle, Uint32);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasSetLineCap: unknown canvas context")));
+  }
+  context->state.lineCap = args[1]->Uint32Value();
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasSetLineJoin) {
+  HandleScope scope;
+
+  CheckArgs2(canvasSetLineJoin, context, Uint32, joinStyle, Uint32);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasSetLineJoin: unknown canvas context")));
+  }
+  context->state.lineJoin = args[1]->Uint32Value();
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasSetMiterLimit) {
+  HandleScope scope;
+
+  CheckArgs2(canvasSetMiterLimit, context, Uint32, limit, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasSetMiterLimit: unknown canvas context")));
+  }
+  VGfloat limit = (VGfloat) args[1]->NumberValue();
+  if (limit > 0 && isfinite(limit)) {
+    context->state.miterLimit = limit;
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasSetLineDash) {
+  HandleScope scope;
+
+  // Always checked: the array is read below
+  if (!(args.Length() == 2 && args[0]->IsUint32() && args[1]->IsObject())) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected canvasSetLineDash(Number, Float32Array)")));
+  }
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasSetLineDash: unknown canvas context")));
+  }
+  TypedArrayWrapper<VGfloat> segments(args[1]);
+  const VGfloat *values = segments.pointer();
+  size_t length = segments.length();
+  for (size_t i = 0; i < length; i++) {
+    if (!(values[i] >= 0 && isfinite(values[i]))) {
+      // Like the canvas, the whole list is ignored
+      V8_RETURN(Undefined());
+    }
+  }
+
+  std::vector<VGfloat> &dash = context->state.lineDash;
+  dash.assign(values, values + length);
+  if (length % 2 == 1) {
+    // Odd lists are repeated to make them even
+    dash.insert(dash.end(), values, values + length);
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasSetLineDashOffset) {
+  HandleScope scope;
+
+  CheckArgs2(canvasSetLineDashOffset, context, Uint32, offset, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasSetLineDashOffset: unknown canvas context")));
+  }
+  VGfloat offset = (VGfloat) args[1]->NumberValue();
+  if (isfinite(offset)) {
+    context->state.lineDashOffset = offset;
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasSetGlobalAlpha) {
+  HandleScope scope;
+
+  CheckArgs2(canvasSetGlobalAlpha, context, Uint32, alpha, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasSetGlobalAlpha: unknown canvas context")));
+  }
+  // Like the canvas, values out of [0, 1] are ignored
+  VGfloat alpha = (VGfloat) args[1]->NumberValue();
+  if (alpha >= 0 && alpha <= 1) {
+    context->state.globalAlpha = alpha;
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasSetBlendMode) {
+  HandleScope scope;
+
+  CheckArgs2(canvasSetBlendMode, context, Uint32, blendMode, Uint32);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasSetBlendMode: unknown canvas context")));
+  }
+  context->state.blendMode = args[1]->Uint32Value();
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasSetFont) {
+  HandleScope scope;
+
+  CheckArgs3(canvasSetFont, context, Uint32, face, Uint32, size, Number);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasSetFont: unknown canvas context")));
+  }
+  context->state.face = args[1]->Uint32Value();
+  context->state.fontSize = (VGfloat) args[2]->NumberValue();
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::CanvasSetTextAlign) {
+  HandleScope scope;
+
+  CheckArgs2(canvasSetTextAlign, context, Uint32, align, Uint32);
+
+  context_t *context = Get(args[0]->Uint32Value());
+  if (context == NULL) {
+    V8_THROW(Exception::TypeError(String::New("canvasSetTextAlign: unknown canvas context")));
+  }
+  uint32_t align = args[1]->Uint32Value();
+  if (align > kAlignRight) {
+    V8_THROW(Exception::RangeError(String::New("canvasSetTextAlign: expected 0 (left), 1 (center) or 2 (right)")));
+  }
+  context->state.textAlign = static_cast<text_align_t>(align);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(canvas::GetCanvasStats) {
+  HandleScope scope;
+
+  CheckArgs1(getCanvasStats, stats, Object);
+
+  stats_t stats;
+  GetStats(&stats);
+
+  Local<Object> result = args[0].As<Object>();
+  result->Set(String::NewSymbol("contexts"), Number::New(stats.contexts));
+  result->Set(String::NewSymbol("pathBuilds"), Number::New(stats.pathBuilds));
+  result->Set(String::NewSymbol("pathReuses"), Number::New(stats.pathReuses));
+  result->Set(String::NewSymbol("draws"), Number::New(stats.draws));
+
+  V8_RETURN(Undefined());
+}
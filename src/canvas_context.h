@@ -0,0 +1,199 @@
+#ifndef NODE_OPENVG_CANVAS_CONTEXT_H_
+#define NODE_OPENVG_CANVAS_CONTEXT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// The core of a CanvasRenderingContext2D kept natively, so a canvas draws
+// with one binding call per canvas call instead of the several vg calls
+// each of them takes.
+//
+// Path points are transformed by the current transform as they're added,
+// as the canvas specifies, and kept in surface coordinates. fill() and
+// stroke() hand them to the driver in one vgAppendPathData, mapped back by
+// the inverse of the transform drawn under (the line width and dashes are
+// in user space); the path is only rebuilt when it or the transform
+// changed, so filling then stroking it builds it once. Arcs are appended
+// as cubic Beziers.
+//
+// The transform starts out flipping y, for a canvas origin at the top left
+// of a surface height pixels high. Colors are set on paints of the
+// context's own, only when they change; gradients come from the gradient
+// paint cache. clip() pushes onto the clip stack, as a scissor rectangle
+// when the path is an axis aligned rect(), and restore() pops the stack
+// back to its depth before the first clip() since the matching save(),
+// along with any clip pushed above those by others. globalAlpha is applied
+// with VG_COLOR_TRANSFORM.
+//
+// Drawing sets the parameters, paints and matrices it uses through the
+// shadow state cache and the matrix stack, leaving them set like the
+// bindings it stands for would. The current matrix mode is kept.
+namespace canvas {
+
+enum text_align_t { kAlignLeft, kAlignCenter, kAlignRight };
+
+struct style_t {
+  VGPaintType type;  // VG_PAINT_TYPE_COLOR or one of the gradients
+  VGfloat color[4];
+  std::vector<VGfloat> geometry;
+  std::vector<VGfloat> stops;
+};
+
+// What save() and restore() keep.
+struct state_t {
+  VGfloat transform[9];  // Column major, user to surface
+  style_t fill;
+  style_t stroke;
+  VGfloat lineWidth;
+  VGint lineCap;
+  VGint lineJoin;
+  VGfloat miterLimit;
+  std::vector<VGfloat> lineDash;
+  VGfloat lineDashOffset;
+  VGfloat globalAlpha;
+  VGint blendMode;
+  uint32_t face;
+  VGfloat fontSize;
+  text_align_t textAlign;
+  size_t clips;      // Pushed since save()
+  size_t clipDepth;  // Of the clip stack before the first of them
+};
+
+struct context_t {
+  VGint width, height;
+  state_t state;
+  std::vector<state_t> saved;
+
+  // The current path, in surface coordinates
+  std::vector<VGubyte> segments;
+  std::vector<VGfloat> points;
+  bool hasCurrentPoint;
+  VGfloat startX, startY;  // Of the current subpath
+  bool isRect;             // A single rect() so far
+
+  // Built from the current path for the transform in builtFor
+  VGPath path;
+  bool pathBuilt;
+  VGfloat builtFor[9];
+
+  VGPath rectPath;  // fillRect, strokeRect, clearRect
+  VGPaint fillPaint, strokePaint, clearPaint;
+  VGfloat fillPaintColor[4], strokePaintColor[4];
+};
+
+struct stats_t {
+  size_t contexts;
+  size_t pathBuilds;
+  size_t pathReuses;  // Draws of a path already built
+  size_t draws;
+};
+
+uint32_t Create(VGint width, VGint height);
+void Destroy(uint32_t context);
+context_t *Get(uint32_t context);
+
+void Save(context_t *context);
+// Returns false if nothing was saved.
+bool Restore(context_t *context);
+
+// Canvas order: a, b, c, d, e, f.
+void Transform(context_t *context, const VGfloat *matrix);
+void SetTransform(context_t *context, const VGfloat *matrix);
+
+void BeginPath(context_t *context);
+void ClosePath(context_t *context);
+void MoveTo(context_t *context, VGfloat x, VGfloat y);
+void LineTo(context_t *context, VGfloat x, VGfloat y);
+void QuadraticCurveTo(context_t *context,
+                      VGfloat cpx, VGfloat cpy, VGfloat x, VGfloat y);
+void BezierCurveTo(context_t *context,
+                   VGfloat cp1x, VGfloat cp1y, VGfloat cp2x, VGfloat cp2y,
+                   VGfloat x, VGfloat y);
+void Arc(context_t *context, VGfloat x, VGfloat y, VGfloat radius,
+         VGfloat startAngle, VGfloat endAngle, bool anticlockwise);
+void ArcTo(context_t *context, VGfloat x1, VGfloat y1,
+           VGfloat x2, VGfloat y2, VGfloat radius);
+void Rect(context_t *context, VGfloat x, VGfloat y,
+          VGfloat width, VGfloat height);
+
+void Fill(context_t *context, VGFillRule rule);
+void Stroke(context_t *context);
+// Returns false, clipping nothing, if the clip couldn't be pushed.
+bool Clip(context_t *context, VGFillRule rule);
+
+void FillRect(context_t *context, VGfloat x, VGfloat y,
+              VGfloat width, VGfloat height);
+void StrokeRect(context_t *context, VGfloat x, VGfloat y,
+                VGfloat width, VGfloat height);
+void ClearRect(context_t *context, VGfloat x, VGfloat y,
+               VGfloat width, VGfloat height);
+
+// Alphabetic baseline; paintModes is VG_FILL_PATH or VG_STROKE_PATH.
+void DrawText(context_t *context, const uint16_t *text, size_t length,
+              VGfloat x, VGfloat y, VGbitfield paintModes);
+VGfloat MeasureText(context_t *context, const uint16_t *text, size_t length);
+
+// NaN for the width or height of the image itself.
+void DrawImage(context_t *context, VGImage image,
+               VGfloat x, VGfloat y, VGfloat width, VGfloat height);
+
+void GetStats(stats_t *stats);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(CreateCanvasContext);
+V8_FUNCTION_DECL(DestroyCanvasContext);
+V8_FUNCTION_DECL(CanvasSave);
+V8_FUNCTION_DECL(CanvasRestore);
+V8_FUNCTION_DECL(CanvasTransform);
+V8_FUNCTION_DECL(CanvasSetTransform);
+V8_FUNCTION_DECL(CanvasTranslate);
+V8_FUNCTION_DECL(CanvasScale);
+V8_FUNCTION_DECL(CanvasRotate);
+V8_FUNCTION_DECL(CanvasBeginPath);
+V8_FUNCTION_DECL(CanvasClosePath);
+V8_FUNCTION_DECL(CanvasMoveTo);
+V8_FUNCTION_DECL(CanvasLineTo);
+V8_FUNCTION_DECL(CanvasQuadraticCurveTo);
+V8_FUNCTION_DECL(CanvasBezierCurveTo);
+V8_FUNCTION_DECL(CanvasArc);
+V8_FUNCTION_DECL(CanvasArcTo);
+V8_FUNCTION_DECL(CanvasRect);
+V8_FUNCTION_DECL(CanvasFill);
+V8_FUNCTION_DECL(CanvasStroke);
+V8_FUNCTION_DECL(CanvasClip);
+V8_FUNCTION_DECL(CanvasFillRect);
+V8_FUNCTION_DECL(CanvasStrokeRect);
+V8_FUNCTION_DECL(CanvasClearRect);
+V8_FUNCTION_DECL(CanvasFillText);
+V8_FUNCTION_DECL(CanvasStrokeText);
+V8_FUNCTION_DECL(CanvasMeasureText);
+V8_FUNCTION_DECL(CanvasDrawImage);
+V8_FUNCTION_DECL(CanvasSetColor);
+V8_FUNCTION_DECL(CanvasSetGradient);
+V8_FUNCTION_DECL(CanvasSetLineWidth);
+V8_FUNCTION_DECL(CanvasSetLineCap);
+V8_FUNCTION_DECL(CanvasSetLineJoin);
+V8_FUNCTION_DECL(CanvasSetMiterLimit);
+V8_FUNCTION_DECL(CanvasSetLineDash);
+V8_FUNCTION_DECL(CanvasSetLineDashOffset);
+V8_FUNCTION_DECL(CanvasSetGlobalAlpha);
+V8_FUNCTION_DECL(CanvasSetBlendMode);
+V8_FUNCTION_DECL(CanvasSetFont);
+V8_FUNCTION_DECL(CanvasSetTextAlign);
+V8_FUNCTION_DECL(GetCanvasStats);
+
+}
+
+#endif
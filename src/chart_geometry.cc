@@ -0,0 +1,298 @@
+#include <math.h>
+
+#include <string>
+#include <vector>
+
+#include "VG/openvg.h"
+
+#include "chart_geometry.h"
+#include "draw_reorder.h"
+#include "typed_array.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+size_t seriesCount = 0, pointCount = 0, segmentCount = 0;
+
+// Kept between series
+std::vector<VGubyte> segments;
+std::vector<VGfloat> coords;
+
+struct mapping_t {
+  VGfloat x0, sx, y0, sy;
+
+  explicit mapping_t(const charts::axis_t &axis) {
+    VGfloat dx = axis.xMax - axis.xMin, dy = axis.yMax - axis.yMin;
+    sx = dx != 0 ? axis.width / dx : 0;
+    sy = dy != 0 ? axis.height / dy : 0;
+    x0 = axis.left - axis.xMin * sx;
+    y0 = axis.bottom - axis.yMin * sy;
+  }
+
+  VGfloat X(VGfloat x) const { return x0 + x * sx; }
+  VGfloat Y(VGfloat y) const { return y0 + y * sy; }
+};
+
+void Begin(size_t segmentCapacity, size_t coordCapacity) {
+  segments.clear();
+  coords.clear();
+  segments.reserve(segmentCapacity);
+  coords.reserve(coordCapacity);
+}
+
+inline void Segment(VGubyte segment) {
+  segments.push_back(segment);
+}
+
+inline void Point(VGfloat x, VGfloat y) {
+  coords.push_back(x);
+  coords.push_back(y);
+}
+
+size_t Append(VGPath path, size_t points) {
+  seriesCount++;
+  pointCount += points;
+  if (segments.empty()) {
+    return 0;
+  }
+  reorder::Barrier();
+  vgAppendPathData(path, (VGint) segments.size(), &segments[0], &coords[0]);
+  segmentCount += segments.size();
+  return segments.size();
+}
+
+}
+
+size_t charts::Polyline(VGPath path, const series_t &series,
+                        const axis_t &axis) {
+  mapping_t map(axis);
+  Begin(series.count, series.count * 2);
+
+  bool gap = true;
+  for (size_t i = 0; i < series.count; i++) {
+    if (charts::Missing(series, i)) {
+      gap = true;
+      continue;
+    }
+    Segment(gap ? VG_MOVE_TO_ABS : VG_LINE_TO_ABS);
+    Point(map.X(charts::DataX(series, i)), map.Y(series.y[i]));
+    gap = false;
+  }
+
+  return Append(path, series.count);
+}
+
+size_t charts::Area(VGPath path, const series_t &series, const axis_t &axis,
+                    VGfloat baseline) {
+  mapping_t map(axis);
+  VGfloat base = map.Y(baseline);
+  Begin(series.count + 3, series.count * 2 + 4);
+
+  // Each run of points between gaps down to the baseline and closed
+  VGfloat lastX = 0;
+  bool gap = true;
+  for (size_t i = 0; i <= series.count; i++) {
+    if (i == series.count || charts::Missing(series, i)) {
+      if (!gap) {
+        Segment(VG_LINE_TO_ABS);
+        Point(lastX, base);
+        Segment(VG_CLOSE_PATH);
+      }
+      gap = true;
+      continue;
+    }
+    VGfloat x = map.X(charts::DataX(series, i));
+    if (gap) {
+      Segment(VG_MOVE_TO_ABS);
+      Point(x, base);
+    }
+    Segment(VG_LINE_TO_ABS);
+    Point(x, map.Y(series.y[i]));
+    lastX = x;
+    gap = false;
+  }
+
+  return Append(path, series.count);
+}
+
+size_t charts::Bars(VGPath path, const series_t &series, const axis_t &axis,
+                    VGfloat barWidth, VGfloat baseline) {
+  mapping_t map(axis);
+  VGfloat base = map.Y(baseline), half = barWidth / 2;
+  Begin(series.count * 5, series.count * 5);
+
+  for (size_t i = 0; i < series.count; i++) {
+    if (charts::Missing(series, i)) {
+      continue;
+    }
+    VGfloat x = charts::DataX(series, i);
+    Segment(VG_MOVE_TO_ABS);
+    Point(map.X(x - half), base);
+    Segment(VG_VLINE_TO_ABS);
+    coords.push_back(map.Y(series.y[i]));
+    Segment(VG_HLINE_TO_ABS);
+    coords.push_back(map.X(x + half));
+    Segment(VG_VLINE_TO_ABS);
+    coords.push_back(base);
+    Segment(VG_CLOSE_PATH);
+  }
+
+  return Append(path, series.count);
+}
+
+void charts::GetStats(stats_t *stats) {
+  stats->series = seriesCount;
+  stats->points = pointCount;
+  stats->segments = segmentCount;
+}
+
+const char *charts::PreparePath(VGPath path, bool clear) {
+  if (vgGetParameteri(path, VG_PATH_DATATYPE) != VG_PATH_DATATYPE_F) {
+    return "expected a VG_PATH_DATATYPE_F path";
+  }
+  if (clear) {
+    reorder::Barrier();
+    vgClearPath(path, vgGetPathCapabilities(path));
+  }
+  return NULL;
+}
+
+const char *charts::ReadSeries(Handle<Value> xs, Handle<Value> ys,
+                               Handle<Value> axisValues,
+                               series_t *series, axis_t *axis) {
+  if (!IsFloat32Array(ys) || !(xs->IsNull() || IsFloat32Array(xs)) ||
+      !IsFloat32Array(axisValues)) {
+    return "values and axis must be Float32Arrays";
+  }
+
+  TypedArrayWrapper<VGfloat> y(ys);
+  series->y = y.pointer();
+  series->count = y.length();
+  series->x = NULL;
+  if (xs->IsObject()) {
+    TypedArrayWrapper<VGfloat> x(xs);
+    if ((size_t) x.length() < series->count) {
+      return "fewer x values than y values";
+    }
+    series->x = x.pointer();
+  }
+
+  TypedArrayWrapper<VGfloat> values(axisValues);
+  if ((size_t) values.length() < kAxisValues) {
+    return "an axis takes 8 values";
+  }
+  const VGfloat *a = values.pointer();
+  axis->xMin = a[0]; axis->xMax = a[1]; axis->yMin = a[2]; axis->yMax = a[3];
+  axis->left = a[4]; axis->bottom = a[5]; axis->width = a[6]; axis->height = a[7];
+  return NULL;
+}
+
+Handle<Value> charts::ArgumentError(const char *function, const char *error) {
+  std::string message(function);
+  message += ": ";
+  message += error;
+  return Exception::TypeError(String::New(message.c_str()));
+}
+
+
+extern void charts::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "chartPolyline", charts::ChartPolyline);
+  NODE_SET_METHOD(target, "chartArea"    , charts::ChartArea);
+  NODE_SET_METHOD(target, "chartBars"    , charts::ChartBars);
+  NODE_SET_METHOD(target, "getChartStats", charts::GetChartStats);
+}
+
+V8_METHOD(charts::ChartPolyline) {
+  HandleScope scope;
+
+  // Always checked: the arrays are read below
+  if (!(args.Length() == 5 && args[0]->IsUint32() &&
+        (args[1]->IsObject() || args[1]->IsNull()) && args[2]->IsObject() &&
+        args[3]->IsObject() && args[4]->IsBoolean())) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected chartPolyline(Number, Float32Array|null, Float32Array, Float32Array, Boolean)")));
+  }
+
+  VGPath path = (VGPath) args[0]->Uint32Value();
+  series_t series;
+  axis_t axis;
+  const char *error = ReadSeries(args[1], args[2], args[3], &series, &axis);
+  if (!error) {
+    error = PreparePath(path, args[4]->BooleanValue());
+  }
+  if (error) {
+    V8_THROW(ArgumentError("chartPolyline", error));
+  }
+
+  V8_RETURN(Integer::New(Polyline(path, series, axis)));
+}
+
+V8_METHOD(charts::ChartArea) {
+  HandleScope scope;
+
+  // Always checked: the arrays are read below
+  if (!(args.Length() == 6 && args[0]->IsUint32() &&
+        (args[1]->IsObject() || args[1]->IsNull()) && args[2]->IsObject() &&
+        args[3]->IsObject() && args[4]->IsNumber() && args[5]->IsBoolean())) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected chartArea(Number, Float32Array|null, Float32Array, Float32Array, Number, Boolean)")));
+  }
+
+  VGPath path = (VGPath) args[0]->Uint32Value();
+  series_t series;
+  axis_t axis;
+  const char *error = ReadSeries(args[1], args[2], args[3], &series, &axis);
+  if (!error) {
+    error = PreparePath(path, args[5]->BooleanValue());
+  }
+  if (error) {
+    V8_THROW(ArgumentError("chartArea", error));
+  }
+
+  V8_RETURN(Integer::New(Area(path, series, axis,
+                              (VGfloat) args[4]->NumberValue())));
+}
+
+V8_METHOD(charts::ChartBars) {
+  HandleScope scope;
+
+  // Always checked: the arrays are read below
+  if (!(args.Length() == 7 && args[0]->IsUint32() &&
+        (args[1]->IsObject() || args[1]->IsNull()) && args[2]->IsObject() &&
+        args[3]->IsObject() && args[4]->IsNumber() && args[5]->IsNumber() &&
+        args[6]->IsBoolean())) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected chartBars(Number, Float32Array|null, Float32Array, Float32Array, Number, Number, Boolean)")));
+  }
+
+  VGPath path = (VGPath) args[0]->Uint32Value();
+  series_t series;
+  axis_t axis;
+  const char *error = ReadSeries(args[1], args[2], args[3], &series, &axis);
+  if (!error) {
+    error = PreparePath(path, args[6]->BooleanValue());
+  }
+  if (error) {
+    V8_THROW(ArgumentError("chartBars", error));
+  }
+
+  V8_RETURN(Integer::New(Bars(path, series, axis,
+                              (VGfloat) args[4]->NumberValue(),
+                              (VGfloat) args[5]->NumberValue())));
+}
+
+V8_METHOD(charts::GetChartStats) {
+  HandleScope scope;
+
+  CheckArgs1(getChartStats, stats, Object);
+
+  stats_t stats;
+  GetStats(&stats);
+
+  Local<Object> result = args[0].As<Object>();
+  result->Set(String::NewSymbol("series"), Number::New(stats.series));
+  result->Set(String::NewSymbol("points"), Number::New(stats.points));
+  result->Set(String::NewSymbol("segments"), Number::New(stats.segments));
+
+  V8_RETURN(Undefined());
+}
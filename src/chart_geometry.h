@@ -0,0 +1,84 @@
+#ifndef NODE_OPENVG_CHART_GEOMETRY_H_
+#define NODE_OPENVG_CHART_GEOMETRY_H_
+
+#include <math.h>
+#include <stddef.h>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// Chart geometry built from whole data series: a polyline, a filled area
+// down to a baseline, or every bar of a series, each appended to one
+// VG_PATH_DATATYPE_F path with a single vgAppendPathData so a series is
+// drawn with one vgDrawPath. Data is mapped to the surface by an axis, the
+// x and y data ranges stretched over a rectangle. NaN values leave gaps:
+// the polyline starts a new subpath and the area closes and starts again
+// after them, and bars are left out.
+//
+// Bars are a vertical line, a horizontal one and a vertical one from the
+// baseline, then closed: five segments and five coordinates each.
+namespace charts {
+
+struct axis_t {
+  VGfloat xMin, xMax, yMin, yMax;      // Data
+  VGfloat left, bottom, width, height;  // Surface
+};
+
+const size_t kAxisValues = 8;
+
+struct series_t {
+  const VGfloat *x;  // NULL for 0, 1, 2...
+  const VGfloat *y;
+  size_t count;
+};
+
+inline VGfloat DataX(const series_t &series, size_t i) {
+  return series.x ? series.x[i] : (VGfloat) i;
+}
+
+// A NaN x or y, leaving a gap
+inline bool Missing(const series_t &series, size_t i) {
+  return isnan(series.y[i]) || (series.x && isnan(series.x[i]));
+}
+
+struct stats_t {
+  size_t series;
+  size_t points;
+  size_t segments;  // Appended
+};
+
+// Each returns the segments appended.
+size_t Polyline(VGPath path, const series_t &series, const axis_t &axis);
+size_t Area(VGPath path, const series_t &series, const axis_t &axis,
+            VGfloat baseline);
+// Bars barWidth wide in data units, centered on their x.
+size_t Bars(VGPath path, const series_t &series, const axis_t &axis,
+            VGfloat barWidth, VGfloat baseline);
+
+void GetStats(stats_t *stats);
+
+// For bindings generating into paths: each returns an error message, or
+// NULL. PreparePath clears the path if asked, once it is known to be a
+// float path.
+const char *PreparePath(VGPath path, bool clear);
+const char *ReadSeries(Handle<Value> xs, Handle<Value> ys,
+                       Handle<Value> axisValues,
+                       series_t *series, axis_t *axis);
+Handle<Value> ArgumentError(const char *function, const char *error);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(ChartPolyline);
+V8_FUNCTION_DECL(ChartArea);
+V8_FUNCTION_DECL(ChartBars);
+V8_FUNCTION_DECL(GetChartStats);
+
+}
+
+#endif
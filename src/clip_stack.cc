@@ -0,0 +1,363 @@
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "EGL/egl.h"
+#include "VG/openvg.h"
+#include "VG/vgu.h"
+
+#include "clip_stack.h"
+#include "egl.h"
+#include "draw_reorder.h"
+#include "matrix_stack.h"
+#include "state_cache.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+struct clip_t {
+  bool masked;         // Rendered into the mask rather than scissored
+  VGMaskLayer saved;   // The mask it replaced, if masking was on
+  VGint width, height; // Of the surface, for restoring the mask
+
+  bool scissored;      // The scissor rectangle it replaced, if any
+  VGint scissor[4];
+};
+
+struct pooled_layer_t {
+  VGMaskLayer layer;
+  VGint width, height;
+};
+
+struct clip_state_t {
+  std::vector<clip_t> stack;
+  bool scissored;
+  VGint scissor[4];
+  size_t maskDepth;
+};
+
+std::vector<clip_t> stack;
+std::vector<pooled_layer_t> pool;
+
+bool scissored = false;
+VGint scissor[4] = { 0, 0, 0, 0 };
+size_t maskDepth = 0;
+
+std::vector<clip_state_t> suspended;
+
+VGPath rectPath = VG_INVALID_HANDLE;
+
+size_t scissorClips = 0, maskClips = 0, maskSaves = 0, layers = 0;
+
+void PathMatrix(VGfloat *m) {
+  VGint matrixMode = state::MatrixMode();
+  if (matrixMode != VG_MATRIX_PATH_USER_TO_SURFACE) {
+    state::SetI(VG_MATRIX_MODE, VG_MATRIX_PATH_USER_TO_SURFACE);
+  }
+  matrices::Get(m);
+  if (matrixMode != VG_MATRIX_PATH_USER_TO_SURFACE) {
+    state::SetI(VG_MATRIX_MODE, matrixMode);
+  }
+}
+
+void SurfaceSize(VGint *width, VGint *height) {
+  EGLSurface surface = eglGetCurrentSurface(EGL_DRAW);
+  EGLint value = 0;
+  eglQuerySurface(egl::State.display, surface, EGL_WIDTH, &value);
+  *width = value;
+  value = 0;
+  eglQuerySurface(egl::State.display, surface, EGL_HEIGHT, &value);
+  *height = value;
+}
+
+VGMaskLayer AcquireLayer(VGint width, VGint height) {
+  for (size_t i = 0; i < pool.size(); i++) {
+    if (pool[i].width == width && pool[i].height == height) {
+      VGMaskLayer layer = pool[i].layer;
+      pool.erase(pool.begin() + i);
+      return layer;
+    }
+  }
+
+  VGMaskLayer layer = vgCreateMaskLayer(width, height);
+  if (layer != VG_INVALID_HANDLE) {
+    layers++;
+  }
+  return layer;
+}
+
+void ReleaseLayer(VGMaskLayer layer, VGint width, VGint height) {
+  pooled_layer_t pooled = { layer, width, height };
+  pool.push_back(pooled);
+}
+
+void SetScissor() {
+  if (scissored) {
+    state::SetIV(VG_SCISSOR_RECTS, 4, scissor);
+    state::SetI(VG_SCISSORING, VG_TRUE);
+  } else {
+    state::SetI(VG_SCISSORING, VG_FALSE);
+  }
+}
+
+void Save(clip_t *clip) {
+  clip->masked = false;
+  clip->saved = VG_INVALID_HANDLE;
+  clip->width = clip->height = 0;
+  clip->scissored = scissored;
+  std::copy(scissor, scissor + 4, clip->scissor);
+}
+
+bool PushMask(VGPath path) {
+  clip_t clip;
+  Save(&clip);
+  clip.masked = true;
+  SurfaceSize(&clip.width, &clip.height);
+
+  if (maskDepth > 0) {
+    clip.saved = AcquireLayer(clip.width, clip.height);
+    if (clip.saved == VG_INVALID_HANDLE) {
+      return false;
+    }
+    vgCopyMask(clip.saved, 0, 0, 0, 0, clip.width, clip.height);
+    maskSaves++;
+  }
+
+  matrices::Sync();
+  // The first clip replaces whatever the mask held before the stack did
+  vgRenderToMask(path, VG_FILL_PATH,
+                 maskDepth > 0 ? VG_INTERSECT_MASK : VG_SET_MASK);
+  state::SetI(VG_MASKING, VG_TRUE);
+
+  stack.push_back(clip);
+  maskDepth++;
+  maskClips++;
+  return true;
+}
+
+}
+
+bool clips::PushRect(VGfloat x, VGfloat y, VGfloat width, VGfloat height) {
+  if (width < 0) {
+    x += width;
+    width = -width;
+  }
+  if (height < 0) {
+    y += height;
+    height = -height;
+  }
+
+  VGfloat m[9];
+  PathMatrix(m);
+
+  // Scaled, translated and turned by multiples of 90 degrees only
+  if (!((m[1] == 0 && m[3] == 0) || (m[0] == 0 && m[4] == 0))) {
+    if (rectPath == VG_INVALID_HANDLE) {
+      rectPath = vgCreatePath(VG_PATH_FORMAT_STANDARD, VG_PATH_DATATYPE_F,
+                              1.0f, 0.0f, 5, 5, VG_PATH_CAPABILITY_APPEND_TO);
+    }
+    vgClearPath(rectPath, VG_PATH_CAPABILITY_APPEND_TO);
+    // An empty rectangle leaves the path empty, which clips everything
+    vguRect(rectPath, x, y, width, height);
+    return PushMask(rectPath);
+  }
+
+  VGfloat x0 = m[0] * x + m[3] * y + m[6];
+  VGfloat y0 = m[1] * x + m[4] * y + m[7];
+  VGfloat x1 = m[0] * (x + width) + m[3] * (y + height) + m[6];
+  VGfloat y1 = m[1] * (x + width) + m[4] * (y + height) + m[7];
+
+  VGint left = (VGint) floorf(std::min(x0, x1) + 0.5f);
+  VGint right = (VGint) floorf(std::max(x0, x1) + 0.5f);
+  VGint bottom = (VGint) floorf(std::min(y0, y1) + 0.5f);
+  VGint top = (VGint) floorf(std::max(y0, y1) + 0.5f);
+
+  if (scissored) {
+    left = std::max(left, scissor[0]);
+    bottom = std::max(bottom, scissor[1]);
+    right = std::min(right, scissor[0] + scissor[2]);
+    top = std::min(top, scissor[1] + scissor[3]);
+  }
+
+  clip_t clip;
+  Save(&clip);
+  stack.push_back(clip);
+
+  // An empty rectangle is ignored by the driver, leaving none to draw in
+  scissored = true;
+  scissor[0] = left;
+  scissor[1] = bottom;
+  scissor[2] = std::max(right - left, 0);
+  scissor[3] = std::max(top - bottom, 0);
+  SetScissor();
+
+  scissorClips++;
+  return true;
+}
+
+bool clips::PushPath(VGPath path) {
+  return PushMask(path);
+}
+
+bool clips::Pop() {
+  if (stack.empty()) {
+    return false;
+  }
+
+  clip_t clip = stack.back();
+  stack.pop_back();
+
+  if (clip.masked) {
+    maskDepth--;
+    if (clip.saved != VG_INVALID_HANDLE) {
+      // Held back draws were recorded inside this clip
+      reorder::Barrier();
+      vgMask(clip.saved, VG_SET_MASK, 0, 0, clip.width, clip.height);
+      ReleaseLayer(clip.saved, clip.width, clip.height);
+    } else {
+      state::SetI(VG_MASKING, VG_FALSE);
+    }
+    return true;
+  }
+
+  scissored = clip.scissored;
+  std::copy(clip.scissor, clip.scissor + 4, scissor);
+  SetScissor();
+  return true;
+}
+
+size_t clips::Depth() {
+  return stack.size();
+}
+
+void clips::Suspend() {
+  clip_state_t saved;
+  saved.stack.swap(stack);
+  saved.scissored = scissored;
+  std::copy(scissor, scissor + 4, saved.scissor);
+  saved.maskDepth = maskDepth;
+  suspended.push_back(saved);
+
+  scissored = false;
+  maskDepth = 0;
+  SetScissor();
+  state::SetI(VG_MASKING, VG_FALSE);
+}
+
+void clips::Resume() {
+  if (suspended.empty()) {
+    return;
+  }
+  // Clips left pushed since Suspend() are dropped
+  while (!stack.empty()) {
+    Pop();
+  }
+
+  clip_state_t &saved = suspended.back();
+  stack.swap(saved.stack);
+  scissored = saved.scissored;
+  std::copy(saved.scissor, saved.scissor + 4, scissor);
+  maskDepth = saved.maskDepth;
+  suspended.pop_back();
+
+  SetScissor();
+  state::SetI(VG_MASKING, maskDepth > 0 ? VG_TRUE : VG_FALSE);
+}
+
+void clips::ReleaseLayers() {
+  for (size_t i = 0; i < pool.size(); i++) {
+    vgDestroyMaskLayer(pool[i].layer);
+  }
+  layers -= pool.size();
+  pool.clear();
+}
+
+void clips::GetStats(stats_t *stats) {
+  stats->depth = stack.size();
+  stats->scissorClips = scissorClips;
+  stats->maskClips = maskClips;
+  stats->maskSaves = maskSaves;
+  stats->layers = layers;
+  stats->pooledLayers = pool.size();
+}
+
+
+extern void clips::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "pushClipRect"     , clips::PushClipRect);
+  NODE_SET_METHOD(target, "pushClipPath"     , clips::PushClipPath);
+  NODE_SET_METHOD(target, "popClip"          , clips::PopClip);
+  NODE_SET_METHOD(target, "releaseClipLayers", clips::ReleaseClipLayers);
+  NODE_SET_METHOD(target, "getClipStats"     , clips::GetClipStats);
+}
+
+V8_METHOD(clips::PushClipRect) {
+  HandleScope scope;
+
+  CheckArgs4(pushClipRect, x, Number, y, Number, width, Number, height, Number);
+
+  if (!PushRect((VGfloat) args[0]->NumberValue(),
+                (VGfloat) args[1]->NumberValue(),
+                (VGfloat) args[2]->NumberValue(),
+                (VGfloat) args[3]->NumberValue())) {
+    V8_THROW(Exception::Error(String::New("pushClipRect: out of memory for mask layers")));
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(clips::PushClipPath) {
+  HandleScope scope;
+
+  CheckArgs1(pushClipPath, VGPath, Uint32);
+
+  if (!PushPath((VGPath) args[0]->Uint32Value())) {
+    V8_THROW(Exception::Error(String::New("pushClipPath: out of memory for mask layers")));
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(clips::PopClip) {
+  HandleScope scope;
+
+  CheckArgs0(popClip);
+
+  if (!Pop()) {
+    V8_THROW(Exception::RangeError(String::New("popClip: clip stack is empty")));
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(clips::ReleaseClipLayers) {
+  HandleScope scope;
+
+  CheckArgs0(releaseClipLayers);
+
+  ReleaseLayers();
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(clips::GetClipStats) {
+  HandleScope scope;
+
+  CheckArgs1(getClipStats, stats, Object);
+
+  stats_t stats;
+  GetStats(&stats);
+
+  Local<Object> result = args[0].As<Object>();
+  result->Set(String::NewSymbol("depth"), Number::New(stats.depth));
+  result->Set(String::NewSymbol("scissorClips"), Number::New(stats.scissorClips));
+  result->Set(String::NewSymbol("maskClips"), Number::New(stats.maskClips));
+  result->Set(String::NewSymbol("maskSaves"), Number::New(stats.maskSaves));
+  result->Set(String::NewSymbol("layers"), Number::New(stats.layers));
+  result->Set(String::NewSymbol("pooledLayers"), Number::New(stats.pooledLayers));
+
+  V8_RETURN(Undefined());
+}
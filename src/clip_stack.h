@@ -0,0 +1,71 @@
+#ifndef NODE_OPENVG_CLIP_STACK_H_
+#define NODE_OPENVG_CLIP_STACK_H_
+
+#include <stddef.h>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// Nested clipping, each clip intersecting the ones below it until popped.
+//
+// Rectangles the path matrix keeps axis aligned are intersected with the
+// current scissor rectangle, their edges rounded to whole pixels, without
+// touching the mask. Other rectangles and paths are rendered into the mask
+// with VG_INTERSECT_MASK; the mask they replace is copied into a mask layer
+// first and copied back when they're popped. Layers go back to a pool
+// rather than being destroyed, so a clip pushed every frame allocates
+// nothing after the first one.
+//
+// While clips are pushed the stack owns VG_SCISSORING, VG_SCISSOR_RECTS and
+// VG_MASKING, which it sets through the shadow state cache, and popping the
+// last clip turns scissoring and masking off. Clips apply to the surface
+// they were pushed on and must be popped, or suspended, before another one
+// is made current.
+namespace clips {
+
+struct stats_t {
+  size_t depth;
+  size_t scissorClips;  // Pushed as scissor rectangles
+  size_t maskClips;     // Rendered into the mask
+  size_t maskSaves;     // Masks copied into layers
+  size_t layers;        // Mask layers alive
+  size_t pooledLayers;  // Of those, waiting in the pool
+};
+
+// Return false, pushing nothing, if the mask couldn't be saved.
+bool PushRect(VGfloat x, VGfloat y, VGfloat width, VGfloat height);
+bool PushPath(VGPath path);
+
+// Returns false if there's no clip to pop.
+bool Pop();
+
+// Clips pushed and not popped, while not suspended.
+size_t Depth();
+
+// Sets the clips aside, turning scissoring and masking off, while drawing
+// into another surface, and puts them back. Suspensions nest.
+void Suspend();
+void Resume();
+
+// Destroys the pooled mask layers.
+void ReleaseLayers();
+
+void GetStats(stats_t *stats);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(PushClipRect);
+V8_FUNCTION_DECL(PushClipPath);
+V8_FUNCTION_DECL(PopClip);
+V8_FUNCTION_DECL(ReleaseClipLayers);
+V8_FUNCTION_DECL(GetClipStats);
+
+}
+
+#endif
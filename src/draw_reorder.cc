@@ -0,0 +1,469 @@
+#include <math.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "VG/openvg.h"
+
+#include "draw_reorder.h"
+#include "image_registry.h"
+#include "matrix_stack.h"
+#include "state_cache.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+// Runs of draws looked back through for one with a draw's paints
+const size_t kWindow = 32;
+// Tiles across and down the area the draws of a flush cover
+const int kTiles = 64;
+// Draws a tile keeps the bounds of, later ones blocking all its area
+const size_t kTileDraws = 16;
+// Pixels antialiasing may touch around a draw's bounds
+const VGfloat kMargin = 1;
+
+struct bounds_t {
+  VGfloat minX, minY, maxX, maxY;
+};
+
+const bounds_t kUnbounded = { -INFINITY, -INFINITY, INFINITY, INFINITY };
+
+struct draw_t {
+  bool image;
+  VGHandle handle;
+  VGbitfield paintModes;  // The paints used; the fill paint for images
+  VGPaint fill, stroke;   // drawn in a mode using it
+  VGfloat matrix[9];
+  bounds_t bounds;        // On the surface
+};
+
+struct run_t {
+  bool image;
+  VGbitfield paintModes;
+  VGPaint fill, stroke;
+  std::vector<uint32_t> draws;
+};
+
+bool recording = false, flushing = false;
+
+// As last recorded, set once draws are flushed
+VGPaint fillPaint = VG_INVALID_HANDLE, strokePaint = VG_INVALID_HANDLE;
+bool paintsDeferred = false;
+
+// Read at the first draw recorded after a flush, state changes flushing
+bool haveState = false;
+VGfloat strokeReach;  // Out of a path's bounds, in user units
+bool imagesUsePaint;
+
+std::vector<draw_t> draws;
+std::vector<run_t> runs;
+std::vector<uint32_t> order;
+
+struct tile_t {
+  std::vector<uint32_t> draws;  // Touching the tile
+  int floor;  // The last run of those not kept, or -1
+};
+
+std::vector<tile_t> tiles;
+std::vector<int> runOf;  // Of each draw
+
+// Of the paths and images drawn, until the next flush
+std::map<VGHandle, bounds_t> pathBounds, imageBounds;
+
+size_t drawCount = 0, flushCount = 0, movedCount = 0;
+size_t changesInOrder = 0, changeCount = 0;
+
+void ReadState() {
+  VGfloat width = vgGetf(VG_STROKE_LINE_WIDTH);
+  VGfloat miterLimit = vgGetf(VG_STROKE_MITER_LIMIT);
+  // Miter joins reach furthest, square caps sqrt(2) half widths
+  strokeReach = width / 2 * std::max(miterLimit, (VGfloat) M_SQRT2);
+  imagesUsePaint = vgGeti(VG_IMAGE_MODE) != VG_DRAW_IMAGE_NORMAL;
+  haveState = true;
+}
+
+const bounds_t &UserBounds(bool image, VGHandle handle) {
+  std::map<VGHandle, bounds_t> &known = image ? imageBounds : pathBounds;
+  std::map<VGHandle, bounds_t>::iterator it = known.find(handle);
+  if (it != known.end()) {
+    return it->second;
+  }
+
+  bounds_t bounds = kUnbounded;
+  if (image) {
+    VGImage driverImage = registry::Read((VGImage) handle);
+    bounds.minX = bounds.minY = 0;
+    bounds.maxX = (VGfloat) vgGetParameteri(driverImage, VG_IMAGE_WIDTH);
+    bounds.maxY = (VGfloat) vgGetParameteri(driverImage, VG_IMAGE_HEIGHT);
+  } else if (vgGetPathCapabilities((VGPath) handle) &
+             VG_PATH_CAPABILITY_PATH_BOUNDS) {
+    VGfloat x, y, width = -1, height = -1;
+    vgPathBounds((VGPath) handle, &x, &y, &width, &height);
+    if (width >= 0 && height >= 0) {
+      bounds.minX = x;
+      bounds.minY = y;
+      bounds.maxX = x + width;
+      bounds.maxY = y + height;
+    }
+  }
+  return known[handle] = bounds;
+}
+
+bounds_t Transform(const VGfloat *m, const bounds_t &user, VGfloat reach) {
+  if (isinf(user.minX) || m[2] != 0 || m[5] != 0 || m[8] != 1) {
+    return kUnbounded;
+  }
+
+  VGfloat xs[2] = { user.minX - reach, user.maxX + reach };
+  VGfloat ys[2] = { user.minY - reach, user.maxY + reach };
+  bounds_t bounds = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+  for (int i = 0; i < 4; i++) {
+    VGfloat x = xs[i & 1], y = ys[i >> 1];
+    VGfloat sx = m[0] * x + m[3] * y + m[6];
+    VGfloat sy = m[1] * x + m[4] * y + m[7];
+    bounds.minX = std::min(bounds.minX, sx);
+    bounds.minY = std::min(bounds.minY, sy);
+    bounds.maxX = std::max(bounds.maxX, sx);
+    bounds.maxY = std::max(bounds.maxY, sy);
+  }
+  if (!(bounds.minX <= bounds.maxX && bounds.minY <= bounds.maxY)) {
+    return kUnbounded;  // NaN
+  }
+  bounds.minX -= kMargin;
+  bounds.minY -= kMargin;
+  bounds.maxX += kMargin;
+  bounds.maxY += kMargin;
+  return bounds;
+}
+
+bool SameState(const run_t &run, const draw_t &draw) {
+  return run.image == draw.image && run.paintModes == draw.paintModes &&
+         run.fill == draw.fill && run.stroke == draw.stroke;
+}
+
+inline bool Overlaps(const bounds_t &a, const bounds_t &b) {
+  return a.minX <= b.maxX && b.minX <= a.maxX &&
+         a.minY <= b.maxY && b.minY <= a.maxY;
+}
+
+// Each draw joins the latest run with its state that comes after the runs
+// of the draws it overlaps, found through the tiles it touches, else starts
+// one. Unbounded draws only join the last run, and nothing moves ahead of
+// them.
+void Group() {
+  bounds_t extent = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+  for (size_t i = 0; i < draws.size(); i++) {
+    const bounds_t &bounds = draws[i].bounds;
+    if (!isinf(bounds.minX)) {
+      extent.minX = std::min(extent.minX, bounds.minX);
+      extent.minY = std::min(extent.minY, bounds.minY);
+      extent.maxX = std::max(extent.maxX, bounds.maxX);
+      extent.maxY = std::max(extent.maxY, bounds.maxY);
+    }
+  }
+  VGfloat tileWidth = std::max((extent.maxX - extent.minX) / kTiles, kMargin);
+  VGfloat tileHeight = std::max((extent.maxY - extent.minY) / kTiles, kMargin);
+  tiles.resize(kTiles * kTiles);
+  for (size_t t = 0; t < tiles.size(); t++) {
+    tiles[t].draws.clear();
+    tiles[t].floor = -1;
+  }
+  runOf.resize(draws.size());
+  int floor = -1;
+
+  runs.clear();
+  for (uint32_t i = 0; i < draws.size(); i++) {
+    const draw_t &draw = draws[i];
+    const bounds_t &bounds = draw.bounds;
+    bool unbounded = isinf(bounds.minX);
+
+    int x0 = 0, y0 = 0, x1 = -1, y1 = -1;
+    int after = floor;
+    if (unbounded) {
+      after = (int) runs.size() - 1;
+    } else {
+      x0 = std::min((int) ((bounds.minX - extent.minX) / tileWidth), kTiles - 1);
+      y0 = std::min((int) ((bounds.minY - extent.minY) / tileHeight), kTiles - 1);
+      x1 = std::min((int) ((bounds.maxX - extent.minX) / tileWidth), kTiles - 1);
+      y1 = std::min((int) ((bounds.maxY - extent.minY) / tileHeight), kTiles - 1);
+      for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+          const tile_t &tile = tiles[y * kTiles + x];
+          after = std::max(after, tile.floor);
+          for (size_t k = 0; k < tile.draws.size(); k++) {
+            uint32_t other = tile.draws[k];
+            if (runOf[other] > after && Overlaps(draws[other].bounds, bounds)) {
+              after = runOf[other];
+            }
+          }
+        }
+      }
+    }
+
+    int target = (int) runs.size();
+    int stop = std::max(after, target - (int) kWindow);
+    for (int r = target - 1; r >= 0 && r >= stop; r--) {
+      if (SameState(runs[r], draw)) {
+        target = r;
+        break;
+      }
+    }
+
+    if (target == (int) runs.size()) {
+      run_t run;
+      run.image = draw.image;
+      run.paintModes = draw.paintModes;
+      run.fill = draw.fill;
+      run.stroke = draw.stroke;
+      runs.push_back(run);
+    } else if (target + 1 != (int) runs.size()) {
+      movedCount++;
+    }
+    runs[target].draws.push_back(i);
+    runOf[i] = target;
+
+    if (unbounded) {
+      floor = target;
+    }
+    for (int y = y0; y <= y1; y++) {
+      for (int x = x0; x <= x1; x++) {
+        tile_t &tile = tiles[y * kTiles + x];
+        if (tile.draws.size() < kTileDraws) {
+          tile.draws.push_back(i);
+        } else {
+          tile.floor = std::max(tile.floor, target);
+        }
+      }
+    }
+  }
+}
+
+// Paint and matrix mode changes drawing in this order takes
+size_t Changes(const std::vector<uint32_t> &drawOrder) {
+  size_t changes = 0;
+  bool fillKnown = false, strokeKnown = false;
+  VGPaint fill = VG_INVALID_HANDLE, stroke = VG_INVALID_HANDLE;
+  for (size_t i = 0; i < drawOrder.size(); i++) {
+    const draw_t &draw = draws[drawOrder[i]];
+    if ((draw.paintModes & VG_FILL_PATH) && (!fillKnown || draw.fill != fill)) {
+      fill = draw.fill;
+      fillKnown = true;
+      changes++;
+    }
+    if ((draw.paintModes & VG_STROKE_PATH) &&
+        (!strokeKnown || draw.stroke != stroke)) {
+      stroke = draw.stroke;
+      strokeKnown = true;
+      changes++;
+    }
+    if (i > 0 && draw.image != draws[drawOrder[i - 1]].image) {
+      changes++;
+    }
+  }
+  return changes;
+}
+
+void Flush() {
+  flushing = true;
+
+  if (!draws.empty()) {
+    Group();
+
+    order.resize(draws.size());
+    for (size_t i = 0; i < draws.size(); i++) {
+      order[i] = (uint32_t) i;
+    }
+    changesInOrder += Changes(order);
+    order.clear();
+    for (size_t r = 0; r < runs.size(); r++) {
+      order.insert(order.end(), runs[r].draws.begin(), runs[r].draws.end());
+    }
+    changeCount += Changes(order);
+
+    VGfloat pathMatrix[9], imageMatrix[9];
+    matrices::GetFor(VG_MATRIX_PATH_USER_TO_SURFACE, pathMatrix);
+    matrices::GetFor(VG_MATRIX_IMAGE_USER_TO_SURFACE, imageMatrix);
+
+    for (size_t i = 0; i < order.size(); i++) {
+      const draw_t &draw = draws[order[i]];
+      if (draw.paintModes & VG_FILL_PATH) {
+        state::SetPaint(draw.fill, VG_FILL_PATH);
+      }
+      if (draw.paintModes & VG_STROKE_PATH) {
+        state::SetPaint(draw.stroke, VG_STROKE_PATH);
+      }
+      if (draw.image) {
+        matrices::LoadFor(VG_MATRIX_IMAGE_USER_TO_SURFACE, draw.matrix);
+        matrices::Sync();
+        registry::Draw((VGImage) draw.handle);
+      } else {
+        matrices::LoadFor(VG_MATRIX_PATH_USER_TO_SURFACE, draw.matrix);
+        matrices::Sync();
+        vgDrawPath((VGPath) draw.handle, draw.paintModes);
+      }
+    }
+
+    matrices::LoadFor(VG_MATRIX_PATH_USER_TO_SURFACE, pathMatrix);
+    matrices::LoadFor(VG_MATRIX_IMAGE_USER_TO_SURFACE, imageMatrix);
+
+    flushCount++;
+    draws.clear();
+    runs.clear();
+    pathBounds.clear();
+    imageBounds.clear();
+    haveState = false;
+  }
+
+  if (paintsDeferred) {
+    state::SetPaint(fillPaint, VG_FILL_PATH);
+    state::SetPaint(strokePaint, VG_STROKE_PATH);
+    paintsDeferred = false;
+  }
+
+  flushing = false;
+}
+
+void Record(bool image, VGHandle handle, VGbitfield paintModes) {
+  if (!haveState) {
+    ReadState();
+  }
+
+  draw_t draw;
+  draw.image = image;
+  draw.handle = handle;
+  draw.paintModes = image ? (imagesUsePaint ? VG_FILL_PATH : 0) : paintModes;
+  draw.fill = draw.paintModes & VG_FILL_PATH ? fillPaint : VG_INVALID_HANDLE;
+  draw.stroke = draw.paintModes & VG_STROKE_PATH ? strokePaint : VG_INVALID_HANDLE;
+  matrices::GetFor(image ? VG_MATRIX_IMAGE_USER_TO_SURFACE :
+                           VG_MATRIX_PATH_USER_TO_SURFACE, draw.matrix);
+  VGfloat reach = !image && (paintModes & VG_STROKE_PATH) ? strokeReach : 0;
+  draw.bounds = Transform(draw.matrix, UserBounds(image, handle), reach);
+
+  draws.push_back(draw);
+  drawCount++;
+}
+
+}
+
+void reorder::Begin() {
+  if (recording) {
+    return;
+  }
+  recording = true;
+  fillPaint = vgGetPaint(VG_FILL_PATH);
+  strokePaint = vgGetPaint(VG_STROKE_PATH);
+  paintsDeferred = false;
+}
+
+void reorder::End() {
+  Barrier();
+  recording = false;
+}
+
+bool reorder::DrawPath(VGPath path, VGbitfield paintModes) {
+  if (!recording) {
+    return false;
+  }
+  Record(false, path, paintModes);
+  return true;
+}
+
+bool reorder::DrawImage(VGImage image) {
+  if (!recording) {
+    return false;
+  }
+  Record(true, image, 0);
+  return true;
+}
+
+bool reorder::SetPaint(VGPaint paint, VGbitfield paintModes) {
+  if (!recording ||
+      (paintModes & ~(VGbitfield) (VG_FILL_PATH | VG_STROKE_PATH)) != 0) {
+    return false;
+  }
+  if (paintModes & VG_FILL_PATH) {
+    fillPaint = paint;
+  }
+  if (paintModes & VG_STROKE_PATH) {
+    strokePaint = paint;
+  }
+  paintsDeferred = true;
+  return true;
+}
+
+void reorder::Barrier() {
+  if (!recording || flushing || (draws.empty() && !paintsDeferred)) {
+    return;
+  }
+  Flush();
+}
+
+void reorder::GetStats(stats_t *stats) {
+  stats->recording = recording;
+  stats->draws = drawCount;
+  stats->flushes = flushCount;
+  stats->moved = movedCount;
+  stats->changesInOrder = changesInOrder;
+  stats->changes = changeCount;
+}
+
+
+extern void reorder::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "beginDrawBatch"   , reorder::BeginDrawBatch);
+  NODE_SET_METHOD(target, "flushDrawBatch"   , reorder::FlushDrawBatch);
+  NODE_SET_METHOD(target, "endDrawBatch"     , reorder::EndDrawBatch);
+  NODE_SET_METHOD(target, "getDrawBatchStats", reorder::GetDrawBatchStats);
+}
+
+V8_METHOD(reorder::BeginDrawBatch) {
+  HandleScope scope;
+
+  CheckArgs0(beginDrawBatch);
+
+  Begin();
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(reorder::FlushDrawBatch) {
+  HandleScope scope;
+
+  CheckArgs0(flushDrawBatch);
+
+  Barrier();
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(reorder::EndDrawBatch) {
+  HandleScope scope;
+
+  CheckArgs0(endDrawBatch);
+
+  End();
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(reorder::GetDrawBatchStats) {
+  HandleScope scope;
+
+  CheckArgs1(getDrawBatchStats, stats, Object);
+
+  stats_t stats;
+  GetStats(&stats);
+
+  Local<Object> result = args[0].As<Object>();
+  result->Set(String::NewSymbol("recording"), Boolean::New(stats.recording));
+  result->Set(String::NewSymbol("draws"), Number::New(stats.draws));
+  result->Set(String::NewSymbol("flushes"), Number::New(stats.flushes));
+  result->Set(String::NewSymbol("moved"), Number::New(stats.moved));
+  result->Set(String::NewSymbol("changesInOrder"), Number::New(stats.changesInOrder));
+  result->Set(String::NewSymbol("changes"), Number::New(stats.changes));
+
+  V8_RETURN(Undefined());
+}
@@ -0,0 +1,63 @@
+#ifndef NODE_OPENVG_DRAW_REORDER_H_
+#define NODE_OPENVG_DRAW_REORDER_H_
+
+#include <stddef.h>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// Opt-in reordering of the draws made through drawPath and drawImage to
+// set paints fewer times. While recording, those draws and setPaint calls
+// are kept with the paints and matrix each draw would have used and the
+// surface bounds it covers, path and image bounds being looked up once per
+// flush. A flush draws them grouped by the paints they use, paths apart
+// from images, a draw moving ahead of those recorded before it only past
+// ones its bounds don't overlap, so the picture is the same.
+//
+// Anything else changing what draws look like flushes first: the state
+// cache setters, but for VG_MATRIX_MODE, matrices::Sync(), which native
+// drawing calls, and the bindings changing paths, paints, images or pixels
+// or reading them back. Native code changing the paths, paints or images of
+// recorded draws directly must call Barrier() first.
+namespace reorder {
+
+struct stats_t {
+  bool recording;
+  size_t draws;          // Recorded
+  size_t flushes;
+  size_t moved;          // Drawn ahead of draws recorded before them
+  size_t changesInOrder; // Paint and matrix mode changes, as recorded
+  size_t changes;        // The same, as drawn
+};
+
+void Begin();
+// Flushes and stops recording.
+void End();
+
+// Each returns false when not recording, the caller drawing or setting the
+// paint itself.
+bool DrawPath(VGPath path, VGbitfield paintModes);
+bool DrawImage(VGImage image);
+bool SetPaint(VGPaint paint, VGbitfield paintModes);
+
+// Draws what was recorded and sets the paints last recorded.
+void Barrier();
+
+void GetStats(stats_t *stats);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(BeginDrawBatch);
+V8_FUNCTION_DECL(FlushDrawBatch);
+V8_FUNCTION_DECL(EndDrawBatch);
+V8_FUNCTION_DECL(GetDrawBatchStats);
+
+}
+
+#endif
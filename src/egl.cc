@@ -9,7 +9,13 @@
 #undef False
 #include "egl.h"
 
+#include <map>
+
 #include "argchecks.h"
+#include "image_registry.h"
+#include "state_cache.h"
+#include "matrix_stack.h"
+#include "draw_reorder.h"
 
 using namespace v8;
 using namespace node;
@@ -17,6 +23,16 @@ using namespace node;
 egl::state_t egl::State;
 EGLConfig egl::Config;
 
+// Image keys of the surfaces made with createPbufferFromClientBuffer
+static std::map<EGLSurface, VGImage> imageSurfaces;
+
+static const EGLint pbuffer_attribute_list[] = {
+  EGL_TEXTURE_FORMAT, EGL_TEXTURE_RGBA,
+  EGL_TEXTURE_TARGET, EGL_TEXTURE_2D,
+  EGL_MIPMAP_TEXTURE, EGL_FALSE,
+  EGL_NONE
+};
+
 extern void egl::InitBindings(Handle<Object> target) {
   NODE_SET_METHOD(target, "getError"      , egl::GetError);
   NODE_SET_METHOD(target, "swapBuffers"   , egl::SwapBuffers);
@@ -115,6 +131,8 @@ extern void egl::Init() {
   result =
     eglMakeCurrent(State.display, State.surface, State.surface, State.context);
   assert(EGL_FALSE != result);
+  state::Invalidate();
+  matrices::Invalidate();
 
   // preserve color buffer when swapping
   eglSurfaceAttrib(State.display, State.surface,
@@ -143,6 +161,38 @@ extern void egl::Finish() {
   eglTerminate(State.display);
 }
 
+extern bool egl::BeginImageTarget(VGImage image, image_target_t *target) {
+  // Draws held back belong on the current surface
+  reorder::Barrier();
+
+  target->previous = eglGetCurrentSurface(EGL_DRAW);
+  target->context = eglGetCurrentContext();
+  target->surface =
+    eglCreatePbufferFromClientBuffer(State.display,
+                                     EGL_OPENVG_IMAGE,
+                                     reinterpret_cast<EGLClientBuffer>(image),
+                                     egl::Config,
+                                     pbuffer_attribute_list);
+  if (target->surface == EGL_NO_SURFACE) {
+    return false;
+  }
+
+  if (!eglMakeCurrent(State.display, target->surface, target->surface,
+                      target->context)) {
+    eglDestroySurface(State.display, target->surface);
+    target->surface = EGL_NO_SURFACE;
+    return false;
+  }
+  return true;
+}
+
+extern void egl::EndImageTarget(image_target_t *target) {
+  eglMakeCurrent(State.display, target->previous, target->previous,
+                 target->context);
+  eglDestroySurface(State.display, target->surface);
+  target->surface = EGL_NO_SURFACE;
+}
+
 
 V8_METHOD(egl::GetError) {
   HandleScope scope;
@@ -160,6 +210,7 @@ V8_METHOD(egl::SwapBuffers) {
 
   EGLSurface surface = (EGLSurface) External::Cast(*args[0])->Value();
 
+  reorder::Barrier();
   EGLBoolean result = eglSwapBuffers(State.display, surface);
 
   V8_RETURN(scope.Close(Boolean::New(result)));
@@ -176,22 +227,19 @@ V8_METHOD(egl::CreatePbufferFromClientBuffer) {
 
   CheckArgs1(CreatePbufferFromClientBuffer, vgImage, Number);
 
+  VGImage image = (VGImage) args[0]->Uint32Value();
   EGLClientBuffer buffer =
-    reinterpret_cast<EGLClientBuffer>(args[0]->Uint32Value());
-
-  static const EGLint attribute_list[] = {
-    EGL_TEXTURE_FORMAT, EGL_TEXTURE_RGBA,
-    EGL_TEXTURE_TARGET, EGL_TEXTURE_2D,
-    EGL_MIPMAP_TEXTURE, EGL_FALSE,
-    EGL_NONE
-  };
+    reinterpret_cast<EGLClientBuffer>(registry::Use(image));
 
   EGLSurface surface =
     eglCreatePbufferFromClientBuffer(State.display,
                                      EGL_OPENVG_IMAGE,
                                      buffer,
                                      egl::Config,
-                                     attribute_list);
+                                     pbuffer_attribute_list);
+  if (surface != EGL_NO_SURFACE) {
+    imageSurfaces[surface] = image;
+  }
 
   V8_RETURN(scope.Close(External::New(surface)));
 }
@@ -204,6 +252,7 @@ V8_METHOD(egl::DestroySurface) {
   EGLSurface surface = (EGLSurface) External::Cast(*args[0])->Value();
 
   EGLBoolean result = eglDestroySurface(State.display, surface);
+  imageSurfaces.erase(surface);
 
   V8_RETURN(scope.Close(Boolean::New(result)));
 }
@@ -218,8 +267,21 @@ V8_METHOD(egl::MakeCurrent) {
 
   // According to EGL 1.4 spec, 3.7.3, for OpenVG contexts, draw and read
   // surfaces must be the same
+  // Matrices changed for the current context go to it first
+  matrices::Sync();
+
   EGLBoolean result = eglMakeCurrent(State.display, surface, surface, context);
 
+  // Drawing to an image changes it under its pyramid
+  std::map<EGLSurface, VGImage>::iterator image = imageSurfaces.find(surface);
+  if (image != imageSurfaces.end()) {
+    registry::Written(image->second);
+  }
+
+  // The context may be another one, with its own state
+  state::Invalidate();
+  matrices::Invalidate();
+
   V8_RETURN(scope.Close(Boolean::New(result)));
 }
 
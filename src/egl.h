@@ -4,6 +4,7 @@
 #include <v8.h>
 #include <node.h>
 #include "EGL/egl.h"
+#include "VG/openvg.h"
 
 #include "v8_helpers.h"
 
@@ -29,6 +30,20 @@ void Init();
 void InitOpenGLES();
 void Finish();
 
+// Drawing into a VGImage through a pbuffer. Begin makes it the current
+// surface, End makes the previous one current again and destroys the
+// pbuffer. The image must be VG_sRGBA_8888_PRE (the config's format) and
+// can't be used as a source in between. Begin returns false if the driver
+// refused the image.
+struct image_target_t {
+  EGLSurface surface;
+  EGLSurface previous;
+  EGLContext context;
+};
+
+bool BeginImageTarget(VGImage image, image_target_t *target);
+void EndImageTarget(image_target_t *target);
+
 V8_FUNCTION_DECL(GetError);
 V8_FUNCTION_DECL(SwapBuffers);
 V8_FUNCTION_DECL(CreatePbufferFromClientBuffer);
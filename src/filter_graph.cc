@@ -0,0 +1,530 @@
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "VG/openvg.h"
+#include "VG/vgu.h"
+#include "VG/vgext.h"
+
+#include "filter_graph.h"
+#include "draw_reorder.h"
+#include "image_registry.h"
+#include "khr_filters.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+struct op_info_t {
+  size_t inputs;
+  size_t params;  // Minimum count
+};
+
+const op_info_t kOps[filters::kOpCount] = {
+  { 1,  3 },  // kGaussianBlur
+  { 1, 20 },  // kColorMatrix
+  { 1,  2 },  // kLookup
+  { 1,  3 },  // kLookupSingle
+  { 1,  4 },  // kIterativeAverageBlur
+  { 2,  6 },  // kParametricFilter
+  { 1,  9 },  // kDropShadow
+  { 1,  7 },  // kGlow
+  { 1, 10 },  // kBevel
+  { 1,  8 },  // kGradientGlow
+  { 1,  8 }   // kGradientBevel
+};
+
+const VGbitfield kScratchQuality = VG_IMAGE_QUALITY_NONANTIALIASED |
+                                   VG_IMAGE_QUALITY_FASTER |
+                                   VG_IMAGE_QUALITY_BETTER;
+
+std::map<uint32_t, filters::graph_t> graphs;
+uint32_t nextGraph = 1;
+
+
+/* Scratch image pool */
+
+struct pool_key_t {
+  VGImageFormat format;
+  VGint width;
+  VGint height;
+
+  bool operator<(const pool_key_t &other) const {
+    if (format != other.format) return format < other.format;
+    if (width != other.width) return width < other.width;
+    return height < other.height;
+  }
+};
+
+typedef std::map<pool_key_t, std::vector<VGImage> > pool_t;
+
+pool_t pool;
+size_t scratchImages = 0;
+size_t scratchBytes = 0;
+
+VGImage Acquire(const pool_key_t &key) {
+  std::vector<VGImage> &free = pool[key];
+  if (!free.empty()) {
+    VGImage image = free.back();
+    free.pop_back();
+    return image;
+  }
+
+  VGImage image = registry::Create(key.format, key.width, key.height,
+                                   kScratchQuality);
+  if (image != VG_INVALID_HANDLE) {
+    scratchImages++;
+    scratchBytes += registry::EstimateBytes(key.format, key.width, key.height);
+  }
+  return image;
+}
+
+void Release(const pool_key_t &key, VGImage image) {
+  pool[key].push_back(image);
+}
+
+
+/* Stages */
+
+bool IsIdentity(const std::vector<double> &m) {
+  for (int i = 0; i < 20; i++) {
+    if (m[i] != (i < 16 && i % 5 == 0 ? 1.0 : 0.0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool IsNoOp(const filters::stage_t &stage) {
+  const std::vector<double> &p = stage.params;
+  switch (stage.op) {
+  case filters::kGaussianBlur:
+  case filters::kIterativeAverageBlur:
+    return p[0] <= 0 && p[1] <= 0;
+  case filters::kColorMatrix:
+    return IsIdentity(p);
+  default:
+    return false;
+  }
+}
+
+// vgColorMatrix matrices are column major, with the offsets in the last
+// column: c' = M * c + o. Returns second(first(c)) as a single matrix. Values
+// aren't clamped between the two steps any more.
+std::vector<double> Compose(const std::vector<double> &first,
+                            const std::vector<double> &second) {
+  std::vector<double> result(20, 0.0);
+  for (int row = 0; row < 4; row++) {
+    for (int column = 0; column < 5; column++) {
+      double sum = column == 4 ? second[16 + row] : 0.0;
+      for (int k = 0; k < 4; k++) {
+        sum += second[k * 4 + row] * first[column * 4 + k];
+      }
+      result[column * 4 + row] = sum;
+    }
+  }
+  return result;
+}
+
+void Apply(const filters::stage_t &stage,
+           VGImage dst, VGImage src, VGImage blur) {
+  const std::vector<double> &p = stage.params;
+
+  switch (stage.op) {
+  case filters::kGaussianBlur:
+    vgGaussianBlur(dst, src, (VGfloat) p[0], (VGfloat) p[1],
+                   (VGTilingMode) p[2]);
+    break;
+  case filters::kColorMatrix: {
+    VGfloat matrix[20];
+    for (int i = 0; i < 20; i++) {
+      matrix[i] = (VGfloat) p[i];
+    }
+    vgColorMatrix(dst, src, matrix);
+    break;
+  }
+  case filters::kLookup:
+    vgLookup(dst, src, &stage.lut[0], &stage.lut[256],
+             &stage.lut[512], &stage.lut[768],
+             (VGboolean) (p[0] != 0), (VGboolean) (p[1] != 0));
+    break;
+  case filters::kLookupSingle:
+    vgLookupSingle(dst, src, &stage.table[0], (VGImageChannel) p[0],
+                   (VGboolean) (p[1] != 0), (VGboolean) (p[2] != 0));
+    break;
+  case filters::kIterativeAverageBlur:
+    khr::IterativeAverageBlur(dst, src, (VGfloat) p[0], (VGfloat) p[1],
+                              (VGuint) p[2], (VGTilingMode) p[3]);
+    break;
+  case filters::kParametricFilter:
+    khr::ParametricFilter(dst, src, blur, (VGfloat) p[0],
+                          (VGfloat) p[1], (VGfloat) p[2],
+                          (VGbitfield) p[3], (VGPaint) p[4], (VGPaint) p[5]);
+    break;
+  case filters::kDropShadow:
+    khr::DropShadow(dst, src, (VGfloat) p[0], (VGfloat) p[1], (VGuint) p[2],
+                    (VGfloat) p[3], (VGfloat) p[4], (VGfloat) p[5],
+                    (VGbitfield) p[6], (VGbitfield) p[7], (VGuint) p[8]);
+    break;
+  case filters::kGlow:
+    khr::Glow(dst, src, (VGfloat) p[0], (VGfloat) p[1], (VGuint) p[2],
+              (VGfloat) p[3], (VGbitfield) p[4], (VGbitfield) p[5],
+              (VGuint) p[6]);
+    break;
+  case filters::kBevel:
+    khr::Bevel(dst, src, (VGfloat) p[0], (VGfloat) p[1], (VGuint) p[2],
+               (VGfloat) p[3], (VGfloat) p[4], (VGfloat) p[5],
+               (VGbitfield) p[6], (VGbitfield) p[7],
+               (VGuint) p[8], (VGuint) p[9]);
+    break;
+  case filters::kGradientGlow:
+  case filters::kGradientBevel: {
+    std::vector<VGfloat> stops(p.begin() + 8, p.end());
+    VGuint count = (VGuint) (stops.size() / 5);
+    if (stage.op == filters::kGradientGlow) {
+      khr::GradientGlow(dst, src, (VGfloat) p[0], (VGfloat) p[1],
+                        (VGuint) p[2], (VGfloat) p[3], (VGfloat) p[4],
+                        (VGfloat) p[5], (VGbitfield) p[6], (VGbitfield) p[7],
+                        count, stops.empty() ? NULL : &stops[0]);
+    } else {
+      khr::GradientBevel(dst, src, (VGfloat) p[0], (VGfloat) p[1],
+                         (VGuint) p[2], (VGfloat) p[3], (VGfloat) p[4],
+                         (VGfloat) p[5], (VGbitfield) p[6], (VGbitfield) p[7],
+                         count, stops.empty() ? NULL : &stops[0]);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+// Follows dropped stages back to the image they pass through.
+int Resolve(const std::vector<int> &alias, int input) {
+  while (input != filters::kSource && alias[input] != input) {
+    input = alias[input];
+  }
+  return input;
+}
+
+// Reads one stage description, returning an error message on failure.
+const char *ParseStage(const Local<Object> &object, int index,
+                       filters::stage_t *stage) {
+  Local<Value> op = object->Get(String::NewSymbol("op"));
+  if (!op->IsUint32() || op->Uint32Value() >= filters::kOpCount) {
+    return "invalid op";
+  }
+  stage->op = (filters::op_t) op->Uint32Value();
+  const op_info_t &info = kOps[stage->op];
+
+  // Stages read the previous one by default
+  stage->inputs[0] = stage->inputs[1] = index - 1;
+  Local<Value> inputs = object->Get(String::NewSymbol("inputs"));
+  if (inputs->IsArray()) {
+    Local<Array> array = inputs.As<Array>();
+    if (array->Length() != info.inputs) {
+      return "wrong number of inputs";
+    }
+    for (size_t i = 0; i < info.inputs; i++) {
+      stage->inputs[i] = array->Get(i)->Int32Value();
+    }
+  } else if (!inputs->IsUndefined() || info.inputs != 1) {
+    return "inputs must be an array";
+  }
+  for (size_t i = 0; i < info.inputs; i++) {
+    if (stage->inputs[i] < filters::kSource || stage->inputs[i] >= index) {
+      return "inputs must be -1 or earlier stages";
+    }
+  }
+
+  Local<Value> params = object->Get(String::NewSymbol("params"));
+  if (params->IsObject()) {
+    Local<Object> array = params.As<Object>();
+    uint32_t length = array->Get(String::NewSymbol("length"))->Uint32Value();
+    for (uint32_t i = 0; i < length; i++) {
+      stage->params.push_back(array->Get(i)->NumberValue());
+    }
+  }
+  if (stage->params.size() < info.params) {
+    return "too few params";
+  }
+  if ((stage->op == filters::kGradientGlow ||
+       stage->op == filters::kGradientBevel) &&
+      (stage->params.size() - info.params) % 5 != 0) {
+    return "color ramp stops must come in groups of 5";
+  }
+
+  if (stage->op == filters::kLookup || stage->op == filters::kLookupSingle) {
+    size_t size = stage->op == filters::kLookup ? 1024 : 256;
+    Local<Value> table = object->Get(String::NewSymbol("table"));
+    if (!table->IsObject() ||
+        table.As<Object>()->Get(String::NewSymbol("length"))->Uint32Value() != size) {
+      return "lookup tables must have 1024 (lookup) or 256 (lookupSingle) entries";
+    }
+    Local<Object> array = table.As<Object>();
+    for (uint32_t i = 0; i < size; i++) {
+      if (stage->op == filters::kLookup) {
+        stage->lut.push_back((VGubyte) array->Get(i)->Uint32Value());
+      } else {
+        stage->table.push_back((VGuint) array->Get(i)->Uint32Value());
+      }
+    }
+  }
+
+  return NULL;
+}
+
+}
+
+void filters::Optimize(graph_t *graph) {
+  std::vector<stage_t> &stages = graph->stages;
+  size_t count = stages.size();
+
+  std::vector<int> alias(count);
+  std::vector<bool> live(count, false);
+  graph->fused = 0;
+  graph->dropped = 0;
+
+  // Drop no-ops and fold color matrices into the color matrix reading them,
+  // as long as nothing else reads the first one.
+  std::vector<int> readers(count, 0);
+  for (size_t i = 0; i < count; i++) {
+    for (size_t k = 0; k < kOps[stages[i].op].inputs; k++) {
+      if (stages[i].inputs[k] != kSource) {
+        readers[stages[i].inputs[k]]++;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    stage_t &stage = stages[i];
+    alias[i] = i;
+
+    for (size_t k = 0; k < kOps[stage.op].inputs; k++) {
+      stage.inputs[k] = Resolve(alias, stage.inputs[k]);
+    }
+
+    int input = stage.inputs[0];
+    if (stage.op == kColorMatrix && input != kSource &&
+        stages[input].op == kColorMatrix && readers[input] == 1) {
+      stage.params = Compose(stages[input].params, stage.params);
+      stage.inputs[0] = stages[input].inputs[0];
+      alias[input] = stage.inputs[0];
+      graph->fused++;
+    }
+
+    if (IsNoOp(stage)) {
+      alias[i] = stage.inputs[0];
+      if (stage.inputs[0] != kSource) {
+        readers[stage.inputs[0]] += readers[i] - 1;
+      }
+    }
+  }
+
+  // Keep what the output depends on, counting readers again
+  graph->output = count == 0 ? kSource : Resolve(alias, count - 1);
+  graph->readers.assign(count, 0);
+  if (graph->output != kSource) {
+    live[graph->output] = true;
+  }
+  for (int i = (int) count - 1; i >= 0; i--) {
+    if (!live[i]) {
+      continue;
+    }
+    for (size_t k = 0; k < kOps[stages[i].op].inputs; k++) {
+      int input = stages[i].inputs[k];
+      if (input != kSource) {
+        live[input] = true;
+        graph->readers[input]++;
+      }
+    }
+  }
+
+  graph->order.clear();
+  for (size_t i = 0; i < count; i++) {
+    if (live[i]) {
+      graph->order.push_back(i);
+    }
+  }
+  graph->dropped = count - graph->order.size() - graph->fused;
+  graph->passes = 0;
+}
+
+bool filters::Run(graph_t *graph, VGImage dst, VGImage src) {
+  reorder::Barrier();
+
+  VGImage source = registry::Read(src);
+  pool_key_t key;
+  key.format = (VGImageFormat) vgGetParameteri(source, VG_IMAGE_FORMAT);
+  key.width = vgGetParameteri(source, VG_IMAGE_WIDTH);
+  key.height = vgGetParameteri(source, VG_IMAGE_HEIGHT);
+
+  graph->passes = 0;
+
+  if (graph->output == kSource) {
+    vgCopyImage(registry::Use(dst), 0, 0, source, 0, 0,
+                key.width, key.height, VG_FALSE);
+    return true;
+  }
+
+  bool complete = true;
+
+  std::vector<VGImage> results(graph->stages.size(), VG_INVALID_HANDLE);
+  std::vector<int> pending(graph->readers);
+
+  for (size_t i = 0; i < graph->order.size(); i++) {
+    int index = graph->order[i];
+    const stage_t &stage = graph->stages[index];
+    size_t inputs = kOps[stage.op].inputs;
+
+    VGImage images[2] = { VG_INVALID_HANDLE, VG_INVALID_HANDLE };
+    for (size_t k = 0; k < inputs; k++) {
+      images[k] = stage.inputs[k] == kSource ?
+                  src : results[stage.inputs[k]];
+    }
+
+    VGImage output = index == graph->output ? dst : Acquire(key);
+    results[index] = output;
+
+    // Out of memory: no result, and no stage reading it can run
+    if (output != VG_INVALID_HANDLE &&
+        (images[0] != VG_INVALID_HANDLE || inputs == 0) &&
+        (images[1] != VG_INVALID_HANDLE || inputs < 2)) {
+      Apply(stage, registry::Use(output), registry::Read(images[0]),
+            inputs > 1 ? registry::Read(images[1]) : VG_INVALID_HANDLE);
+      graph->passes++;
+    } else {
+      complete = false;
+    }
+
+    for (size_t k = 0; k < inputs; k++) {
+      int input = stage.inputs[k];
+      if (input != kSource && --pending[input] == 0 &&
+          results[input] != VG_INVALID_HANDLE) {
+        Release(key, results[input]);
+      }
+    }
+  }
+
+  return complete;
+}
+
+void filters::TrimPool() {
+  for (pool_t::iterator it = pool.begin(); it != pool.end(); ++it) {
+    const pool_key_t &key = it->first;
+    for (size_t i = 0; i < it->second.size(); i++) {
+      registry::Destroy(it->second[i]);
+      scratchImages--;
+      scratchBytes -= registry::EstimateBytes(key.format, key.width, key.height);
+    }
+  }
+  pool.clear();
+}
+
+
+extern void filters::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "createFilterGraph" , filters::CreateFilterGraph);
+  NODE_SET_METHOD(target, "destroyFilterGraph", filters::DestroyFilterGraph);
+  NODE_SET_METHOD(target, "runFilterGraph"    , filters::RunFilterGraph);
+  NODE_SET_METHOD(target, "getFilterGraphInfo", filters::GetFilterGraphInfo);
+  NODE_SET_METHOD(target, "trimFilterPool"    , filters::TrimFilterPool);
+}
+
+V8_METHOD(filters::CreateFilterGraph) {
+  HandleScope scope;
+
+  // Always checked: the description is walked below
+  if (!(args.Length() == 1 && args[0]->IsArray())) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected createFilterGraph(stages)")));
+  }
+
+  Local<Array> stages = args[0].As<Array>();
+  graph_t graph;
+
+  for (uint32_t i = 0; i < stages->Length(); i++) {
+    Local<Value> stage = stages->Get(i);
+    graph.stages.push_back(stage_t());
+
+    const char *error = stage->IsObject() ?
+      ParseStage(stage.As<Object>(), i, &graph.stages.back()) :
+      "stages must be objects";
+    if (error != NULL) {
+      std::string message = std::string("createFilterGraph: ") + error;
+      V8_THROW(Exception::TypeError(String::New(message.c_str())));
+    }
+  }
+
+  Optimize(&graph);
+
+  uint32_t id = nextGraph++;
+  graphs[id] = graph;
+
+  V8_RETURN(Uint32::New(id));
+}
+
+V8_METHOD(filters::DestroyFilterGraph) {
+  HandleScope scope;
+
+  CheckArgs1(destroyFilterGraph, graph, Uint32);
+
+  graphs.erase(args[0]->Uint32Value());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(filters::RunFilterGraph) {
+  HandleScope scope;
+
+  CheckArgs3(runFilterGraph, graph, Uint32,
+             dstVGImage, Number, srcVGImage, Number);
+
+  std::map<uint32_t, graph_t>::iterator it = graphs.find(args[0]->Uint32Value());
+  if (it == graphs.end()) {
+    V8_THROW(Exception::TypeError(String::New("runFilterGraph: unknown graph")));
+  }
+
+  if (!Run(&it->second,
+           (VGImage) args[1]->Uint32Value(),
+           (VGImage) args[2]->Uint32Value())) {
+    V8_THROW(Exception::Error(String::New("runFilterGraph: out of memory for intermediate images")));
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(filters::GetFilterGraphInfo) {
+  HandleScope scope;
+
+  CheckArgs2(getFilterGraphInfo, graph, Uint32, info, Object);
+
+  std::map<uint32_t, graph_t>::iterator it = graphs.find(args[0]->Uint32Value());
+  if (it == graphs.end()) {
+    V8_THROW(Exception::TypeError(String::New("getFilterGraphInfo: unknown graph")));
+  }
+  const graph_t &graph = it->second;
+
+  Local<Object> result = args[1].As<Object>();
+  result->Set(String::NewSymbol("stages"), Number::New(graph.stages.size()));
+  result->Set(String::NewSymbol("liveStages"), Number::New(graph.order.size()));
+  result->Set(String::NewSymbol("fused"), Number::New(graph.fused));
+  result->Set(String::NewSymbol("dropped"), Number::New(graph.dropped));
+  result->Set(String::NewSymbol("passes"), Number::New(graph.passes));
+  result->Set(String::NewSymbol("scratchImages"), Number::New(scratchImages));
+  result->Set(String::NewSymbol("scratchBytes"), Number::New(scratchBytes));
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(filters::TrimFilterPool) {
+  HandleScope scope;
+
+  CheckArgs0(trimFilterPool);
+
+  TrimPool();
+
+  V8_RETURN(Undefined());
+}
@@ -0,0 +1,82 @@
+#ifndef NODE_OPENVG_FILTER_GRAPH_H_
+#define NODE_OPENVG_FILTER_GRAPH_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// Chains of image filters run in one call. A graph is a list of stages, each
+// reading the graph source or earlier stages, the last one being the output.
+// When it is created the graph drops stages that do nothing or don't reach
+// the output, and folds consecutive color matrices into one. Intermediate
+// results go to scratch images pooled by format and size, handed back as
+// soon as their last reader has run.
+namespace filters {
+
+enum op_t {
+  kGaussianBlur = 0,
+  kColorMatrix,
+  kLookup,
+  kLookupSingle,
+  kIterativeAverageBlur,
+  kParametricFilter,
+  kDropShadow,
+  kGlow,
+  kBevel,
+  kGradientGlow,
+  kGradientBevel,
+  kOpCount
+};
+
+const int kSource = -1;
+
+struct stage_t {
+  op_t op;
+  int inputs[2];               // Stage indices or kSource
+  std::vector<double> params;  // See VGFilterOp in openvg.js
+  std::vector<VGubyte> lut;    // kLookup: red, green, blue, alpha tables
+  std::vector<VGuint> table;   // kLookupSingle
+};
+
+struct graph_t {
+  std::vector<stage_t> stages;
+
+  // Execution plan, filled by Optimize()
+  std::vector<int> order;
+  std::vector<int> readers;
+  int output;  // kSource if the whole graph is a no-op
+
+  size_t fused;
+  size_t dropped;
+  size_t passes;  // Filter calls made by the last run
+};
+
+void Optimize(graph_t *graph);
+
+// Runs the graph from src into dst, which must differ and have the same
+// size. Returns false if scratch images ran out, leaving dst incomplete.
+bool Run(graph_t *graph, VGImage dst, VGImage src);
+
+// Destroys the scratch images not currently in use.
+void TrimPool();
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(CreateFilterGraph);
+V8_FUNCTION_DECL(DestroyFilterGraph);
+V8_FUNCTION_DECL(RunFilterGraph);
+V8_FUNCTION_DECL(GetFilterGraphInfo);
+V8_FUNCTION_DECL(TrimFilterPool);
+
+}
+
+#endif
@@ -0,0 +1,589 @@
+#include <string.h>
+
+#include <map>
+
+#include "VG/openvg.h"
+
+#include "font_face.h"
+#include "glyph_cache.h"
+#include "matrix_stack.h"
+#include "state_cache.h"
+#include "typed_array.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+struct cache_key_t {
+  uint64_t hash;
+  uint32_t face;
+  std::vector<uint16_t> text;  // UTF-16 code units
+
+  bool operator<(const cache_key_t &other) const {
+    if (hash != other.hash) return hash < other.hash;
+    if (face != other.face) return face < other.face;
+    return text < other.text;
+  }
+};
+
+struct cache_entry_t {
+  cache_key_t key;
+  VGfloat width;
+};
+
+typedef std::list<cache_entry_t> lru_t;
+
+std::map<uint32_t, faces::face_t> faceTable;
+uint32_t nextFace = 1;
+
+lru_t lru;  // Most recently used first
+std::map<cache_key_t, lru_t::iterator> cache;
+size_t capacity = 4096;
+size_t hits = 0, misses = 0;
+
+// Coordinates taken by each segment command (VGPathSegment >> 1)
+const int kSegmentCoordinates[13] = { 0, 2, 2, 1, 1, 4, 6, 2, 4, 5, 5, 5, 5 };
+
+// FNV-1a over the UTF-16 code units
+uint64_t Hash(const uint16_t *text, size_t length) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ (text[i] & 0xff)) * 1099511628211ULL;
+    hash = (hash ^ (text[i] >> 8)) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+VGfloat Measure(const faces::face_t *face, const uint16_t *text, size_t length) {
+  VGfloat width = 0;
+  for (size_t i = 0; i < length;) {
+    VGint glyph = faces::GlyphOf(face, faces::NextCodePoint(text, length, &i));
+    if (glyph != faces::kNoGlyph) {
+      width += face->advances[glyph];
+    }
+  }
+  return width;
+}
+
+void Trim() {
+  while (cache.size() > capacity) {
+    cache.erase(lru.back().key);
+    lru.pop_back();
+  }
+}
+
+// Whether an outline's instructions are known segments whose coordinates
+// are all within the points.
+bool ValidOutline(const faces::face_t &face, const faces::outline_t &outline) {
+  if ((size_t) outline.instructions + outline.count > face.instructions.size()) {
+    return false;
+  }
+
+  size_t coordinates = 0;
+  for (uint32_t i = 0; i < outline.count; i++) {
+    size_t segment = (face.instructions[outline.instructions + i] & 0x1e) >> 1;
+    if (segment >= sizeof(kSegmentCoordinates) / sizeof(kSegmentCoordinates[0])) {
+      return false;
+    }
+    coordinates += kSegmentCoordinates[segment];
+  }
+  return (size_t) outline.points + coordinates <= face.points.size();
+}
+
+VGPath CreateOutline(const faces::face_t &face, VGuint glyph) {
+  const faces::outline_t &outline = face.outlines[glyph];
+  VGPath path = vgCreatePath(VG_PATH_FORMAT_STANDARD, VG_PATH_DATATYPE_S_32,
+                             1.0f / 65536.0f, 0.0f, 0, 0,
+                             VG_PATH_CAPABILITY_ALL);
+  if (outline.count > 0) {
+    vgAppendPathData(path, outline.count,
+                     &face.instructions[outline.instructions],
+                     &face.points[outline.points]);
+  }
+  return path;
+}
+
+void Evict(faces::face_t *face) {
+  while (face->glyphLimit > 0 && face->recent.size() > face->glyphLimit) {
+    VGuint glyph = face->recent.back();
+    face->recent.pop_back();
+    vgDestroyPath(face->paths[glyph]);
+    face->paths[glyph] = VG_INVALID_HANDLE;
+    face->evicted++;
+  }
+}
+
+uint32_t LengthOf(const Local<Object> &array) {
+  return array->Get(String::NewSymbol("length"))->Uint32Value();
+}
+
+// Dense arrays are indexed by code point; other objects map code points
+// to glyphs.
+void ReadCharacterMap(const Local<Object> &source, size_t glyphCount,
+                      faces::character_map_t *map) {
+  Local<Array> codePoints;
+  uint32_t count;
+  if (source->IsArray()) {
+    count = LengthOf(source);
+  } else {
+    codePoints = source->GetPropertyNames();
+    count = codePoints->Length();
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t codePoint = codePoints.IsEmpty() ? i : codePoints->Get(i)->Uint32Value();
+    Local<Value> glyph = codePoints.IsEmpty() ?
+      source->Get(i) : source->Get(codePoints->Get(i));
+    VGint index = glyph->Int32Value();
+    if (index >= 0 && (size_t) index < glyphCount) {
+      faces::SetGlyph(map, codePoint, index);
+    }
+  }
+}
+
+}
+
+void faces::SetGlyph(character_map_t *map, uint32_t codePoint, VGint glyph) {
+  if (codePoint > kMaxCodePoint) {
+    return;
+  }
+  if (map->glyphs.empty()) {
+    map->glyphs.assign(256, kNoGlyph);
+  }
+
+  uint32_t block = codePoint >> 8;
+  if (block >= map->blocks.size()) {
+    map->blocks.resize(block + 1, 0);
+  }
+  if (map->blocks[block] == 0) {
+    map->blocks[block] = (uint16_t) (map->glyphs.size() >> 8);
+    map->glyphs.resize(map->glyphs.size() + 256, kNoGlyph);
+  }
+  map->glyphs[((size_t) map->blocks[block] << 8) | (codePoint & 0xff)] = glyph;
+}
+
+uint32_t faces::Add(const face_t &face) {
+  uint32_t id = nextFace++;
+  face_t &added = faceTable[id] = face;
+  if (!added.outlines.empty()) {
+    added.paths.assign(added.outlines.size(), VG_INVALID_HANDLE);
+    added.positions.resize(added.outlines.size());
+  }
+  added.advances.resize(added.paths.size(), 0.0f);
+  added.recent.clear();
+  added.created = added.evicted = 0;
+  return id;
+}
+
+void faces::Remove(uint32_t face) {
+  std::map<uint32_t, face_t>::iterator found = faceTable.find(face);
+  if (found == faceTable.end()) {
+    return;
+  }
+
+  glyphs::DropFace(face);
+
+  lru_t::iterator it = lru.begin();
+  while (it != lru.end()) {
+    if (it->key.face == face) {
+      cache.erase(it->key);
+      it = lru.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  face_t &removed = found->second;
+  if (!removed.outlines.empty()) {
+    for (size_t i = 0; i < removed.paths.size(); i++) {
+      if (removed.paths[i] != VG_INVALID_HANDLE) {
+        vgDestroyPath(removed.paths[i]);
+      }
+    }
+  }
+  faceTable.erase(found);
+}
+
+const faces::face_t *faces::Get(uint32_t face) {
+  std::map<uint32_t, face_t>::const_iterator it = faceTable.find(face);
+  return it != faceTable.end() ? &it->second : NULL;
+}
+
+VGPath faces::Path(uint32_t faceId, VGuint glyph) {
+  std::map<uint32_t, face_t>::iterator found = faceTable.find(faceId);
+  if (found == faceTable.end() || glyph >= found->second.paths.size()) {
+    return VG_INVALID_HANDLE;
+  }
+  face_t &face = found->second;
+  if (face.outlines.empty()) {
+    return face.paths[glyph];
+  }
+
+  if (face.paths[glyph] == VG_INVALID_HANDLE) {
+    face.paths[glyph] = CreateOutline(face, glyph);
+    face.created++;
+    face.recent.push_front(glyph);
+    face.positions[glyph] = face.recent.begin();
+    Evict(&face);
+  } else {
+    face.recent.splice(face.recent.begin(), face.recent, face.positions[glyph]);
+  }
+  return face.paths[glyph];
+}
+
+void faces::SetGlyphLimit(uint32_t faceId, size_t paths) {
+  std::map<uint32_t, face_t>::iterator found = faceTable.find(faceId);
+  if (found != faceTable.end()) {
+    found->second.glyphLimit = paths;
+    Evict(&found->second);
+  }
+}
+
+void faces::GlyphsOf(const face_t *face, const uint16_t *text, size_t length,
+                     std::vector<VGuint> *glyphs) {
+  glyphs->clear();
+  for (size_t i = 0; i < length;) {
+    VGint glyph = GlyphOf(face, NextCodePoint(text, length, &i));
+    if (glyph != kNoGlyph) {
+      glyphs->push_back((VGuint) glyph);
+    }
+  }
+}
+
+void faces::Draw(uint32_t faceId, const uint16_t *text, size_t length,
+                 VGfloat x, VGfloat y, VGfloat size, VGbitfield paintModes) {
+  const face_t *face = Get(faceId);
+  if (face == NULL) {
+    return;
+  }
+
+  matrices::Sync();
+  std::vector<VGuint> glyphs;
+  GlyphsOf(face, text, length, &glyphs);
+  // Cached glyphs are filled coverage only
+  if (paintModes == VG_FILL_PATH &&
+      glyphs::Draw(faceId, glyphs, x, y, size)) {
+    return;
+  }
+
+  VGint matrixMode = state::MatrixMode();
+  state::SetI(VG_MATRIX_MODE, VG_MATRIX_PATH_USER_TO_SURFACE);
+  VGfloat matrix[9];
+  vgGetMatrix(matrix);
+  VGfloat pen = x;
+  for (size_t i = 0; i < glyphs.size(); i++) {
+    vgLoadMatrix(matrix);
+    vgTranslate(pen, y);
+    vgScale(size, size);
+    vgDrawPath(Path(faceId, glyphs[i]), paintModes);
+    pen += size * face->advances[glyphs[i]];
+  }
+  vgLoadMatrix(matrix);
+  state::SetI(VG_MATRIX_MODE, matrixMode);
+}
+
+VGfloat faces::Width(uint32_t face, const uint16_t *text, size_t length) {
+  const face_t *found = Get(face);
+  if (found == NULL) {
+    return 0;
+  }
+
+  cache_key_t key;
+  key.hash = Hash(text, length);
+  key.face = face;
+  key.text.assign(text, text + length);
+  std::map<cache_key_t, lru_t::iterator>::iterator it = cache.find(key);
+  if (it != cache.end()) {
+    lru.splice(lru.begin(), lru, it->second);
+    hits++;
+    return it->second->width;
+  }
+
+  misses++;
+  VGfloat width = Measure(found, text, length);
+  if (capacity > 0) {
+    cache_entry_t entry = { key, width };
+    lru.push_front(entry);
+    cache[key] = lru.begin();
+    Trim();
+  }
+  return width;
+}
+
+size_t faces::FitIndex(uint32_t face, const uint16_t *text, size_t length,
+                       VGfloat size, VGfloat maxWidth) {
+  const face_t *found = Get(face);
+  if (found == NULL || Width(face, text, length) * size <= maxWidth) {
+    return length;
+  }
+
+  VGfloat width = 0;
+  for (size_t i = 0; i < length;) {
+    size_t start = i;
+    VGint glyph = GlyphOf(found, NextCodePoint(text, length, &i));
+    if (glyph != kNoGlyph) {
+      width += found->advances[glyph] * size;
+      if (width > maxWidth) {
+        return start;
+      }
+    }
+  }
+  return length;
+}
+
+void faces::SetCacheCapacity(size_t entries) {
+  capacity = entries;
+  Trim();
+}
+
+void faces::GetStats(stats_t *stats) {
+  stats->entries = cache.size();
+  stats->capacity = capacity;
+  stats->hits = hits;
+  stats->misses = misses;
+}
+
+
+extern void faces::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "createFace"            , faces::CreateFace);
+  NODE_SET_METHOD(target, "registerFace"          , faces::RegisterFace);
+  NODE_SET_METHOD(target, "unregisterFace"        , faces::UnregisterFace);
+  NODE_SET_METHOD(target, "setFaceGlyphLimit"     , faces::SetFaceGlyphLimit);
+  NODE_SET_METHOD(target, "getFaceStats"          , faces::GetFaceStats);
+  NODE_SET_METHOD(target, "drawFaceText"          , faces::DrawFaceText);
+  NODE_SET_METHOD(target, "textWidth"             , faces::TextWidth);
+  NODE_SET_METHOD(target, "textWidths"            , faces::TextWidths);
+  NODE_SET_METHOD(target, "textFitIndex"          , faces::TextFitIndex);
+  NODE_SET_METHOD(target, "setTextWidthCacheSize" , faces::SetTextWidthCacheSize);
+  NODE_SET_METHOD(target, "getTextWidthCacheStats", faces::GetTextWidthCacheStats);
+}
+
+V8_METHOD(faces::CreateFace) {
+  HandleScope scope;
+
+  // Always checked: the arrays are copied below
+  if (!(args.Length() == 7 &&
+        args[0]->IsObject() && args[1]->IsObject() && args[2]->IsObject() &&
+        args[3]->IsObject() && args[4]->IsObject() && args[5]->IsObject() &&
+        args[6]->IsObject())) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected createFace(glyphPoints,glyphInstructions,glyphInstructionIndices,glyphInstructionCounts,glyphPointIndices,glyphAdvances,characterMap)")));
+  }
+
+  // The font2openvg layout: points and instructions in typed arrays, the
+  // rest in arrays with one entry per glyph
+  face_t face;
+  TypedArrayWrapper<VGint> points(args[0]);
+  TypedArrayWrapper<VGubyte> instructions(args[1]);
+  face.points.resize(points.length());
+  face.instructions.resize(instructions.length());
+  if (!face.points.empty()) {
+    memcpy(&face.points[0], points.pointer(), face.points.size() * sizeof(VGint));
+  }
+  if (!face.instructions.empty()) {
+    memcpy(&face.instructions[0], instructions.pointer(), face.instructions.size());
+  }
+
+  Local<Object> instructionIndices = args[2].As<Object>();
+  Local<Object> instructionCounts = args[3].As<Object>();
+  Local<Object> pointIndices = args[4].As<Object>();
+  Local<Object> advances = args[5].As<Object>();
+  uint32_t count = LengthOf(advances);
+  if (LengthOf(instructionIndices) < count ||
+      LengthOf(instructionCounts) < count || LengthOf(pointIndices) < count) {
+    V8_THROW(Exception::TypeError(String::New("createFace: glyph arrays shorter than glyphAdvances")));
+  }
+
+  face.outlines.resize(count);
+  face.advances.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    outline_t &outline = face.outlines[i];
+    outline.instructions = instructionIndices->Get(i)->Uint32Value();
+    outline.count = instructionCounts->Get(i)->Uint32Value();
+    outline.points = 2 * pointIndices->Get(i)->Uint32Value();
+    if (!ValidOutline(face, outline)) {
+      outline.count = 0;
+    }
+    face.advances[i] = (VGfloat) (advances->Get(i)->NumberValue() / 65536.0);
+  }
+  face.glyphLimit = 0;
+
+  ReadCharacterMap(args[6].As<Object>(), count, &face.characters);
+
+  V8_RETURN(Uint32::New(Add(face)));
+}
+
+V8_METHOD(faces::RegisterFace) {
+  HandleScope scope;
+
+  // Always checked: the arrays are walked below
+  if (!((args.Length() == 2 || args.Length() == 3) &&
+        args[0]->IsObject() && args[1]->IsObject() &&
+        (args.Length() == 2 || args[2]->IsObject()))) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected registerFace(glyphPaths,glyphAdvances[,characterMap])")));
+  }
+
+  // Advances are 16.16 fixed point, like the font2openvg data
+  Local<Object> paths = args[0].As<Object>();
+  Local<Object> advances = args[1].As<Object>();
+  uint32_t count = LengthOf(advances);
+  if (LengthOf(paths) < count) {
+    count = LengthOf(paths);
+  }
+
+  face_t face;
+  face.paths.resize(count);
+  face.advances.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    face.paths[i] = (VGPath) paths->Get(i)->Uint32Value();
+    face.advances[i] = (VGfloat) (advances->Get(i)->NumberValue() / 65536.0);
+  }
+  face.glyphLimit = 0;
+
+  if (args.Length() == 3) {
+    ReadCharacterMap(args[2].As<Object>(), count, &face.characters);
+  }
+
+  V8_RETURN(Uint32::New(Add(face)));
+}
+
+V8_METHOD(faces::UnregisterFace) {
+  HandleScope scope;
+
+  CheckArgs1(unregisterFace, face, Uint32);
+
+  Remove(args[0]->Uint32Value());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(faces::SetFaceGlyphLimit) {
+  HandleScope scope;
+
+  CheckArgs2(setFaceGlyphLimit, face, Uint32, paths, Uint32);
+
+  SetGlyphLimit(args[0]->Uint32Value(), args[1]->Uint32Value());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(faces::GetFaceStats) {
+  HandleScope scope;
+
+  CheckArgs2(getFaceStats, face, Uint32, stats, Object);
+
+  const face_t *face = Get(args[0]->Uint32Value());
+  if (face == NULL) {
+    V8_THROW(Exception::TypeError(String::New("getFaceStats: unknown face")));
+  }
+
+  size_t characters = 0;
+  for (size_t i = 256; i < face->characters.glyphs.size(); i++) {
+    characters += face->characters.glyphs[i] != kNoGlyph;
+  }
+
+  Local<Object> result = args[1].As<Object>();
+  result->Set(String::NewSymbol("glyphs"), Number::New(face->advances.size()));
+  result->Set(String::NewSymbol("characters"), Number::New(characters));
+  result->Set(String::NewSymbol("mapBlocks"), Number::New(face->characters.glyphs.size() / 256));
+  result->Set(String::NewSymbol("livePaths"), Number::New(face->outlines.empty() ? face->paths.size() : face->recent.size()));
+  result->Set(String::NewSymbol("createdPaths"), Number::New(face->created));
+  result->Set(String::NewSymbol("evictedPaths"), Number::New(face->evicted));
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(faces::DrawFaceText) {
+  HandleScope scope;
+
+  CheckArgs6(drawFaceText, face, Uint32, text, String, x, Number, y, Number,
+             size, Number, paintModes, Uint32);
+
+  String::Value text(args[1]);
+  Draw(args[0]->Uint32Value(), *text, text.length(),
+       (VGfloat) args[2]->NumberValue(), (VGfloat) args[3]->NumberValue(),
+       (VGfloat) args[4]->NumberValue(), (VGbitfield) args[5]->Uint32Value());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(faces::TextWidth) {
+  HandleScope scope;
+
+  CheckArgs3(textWidth, face, Uint32, text, String, size, Number);
+
+  String::Value text(args[1]);
+  VGfloat width = Width(args[0]->Uint32Value(), *text, text.length());
+
+  V8_RETURN(Number::New(width * args[2]->NumberValue()));
+}
+
+V8_METHOD(faces::TextWidths) {
+  HandleScope scope;
+
+  // Always checked: the arrays are walked below
+  if (!(args.Length() == 4 && args[0]->IsUint32() && args[1]->IsArray() &&
+        args[2]->IsNumber() && IsFloat32Array(args[3]))) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected textWidths(face,texts,size,Float32Array)")));
+  }
+
+  uint32_t face = args[0]->Uint32Value();
+  Local<Array> texts = args[1].As<Array>();
+  VGfloat size = (VGfloat) args[2]->NumberValue();
+  TypedArrayWrapper<VGfloat> widths(args[3]);
+
+  uint32_t count = texts->Length();
+  if ((uint32_t) widths.length() < count) {
+    V8_THROW(Exception::RangeError(String::New("textWidths: widths shorter than texts")));
+  }
+
+  VGfloat *out = widths.pointer();
+  for (uint32_t i = 0; i < count; i++) {
+    String::Value text(texts->Get(i));
+    out[i] = Width(face, *text, text.length()) * size;
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(faces::TextFitIndex) {
+  HandleScope scope;
+
+  CheckArgs4(textFitIndex, face, Uint32, text, String, size, Number,
+             maxWidth, Number);
+
+  String::Value text(args[1]);
+  size_t index = FitIndex(args[0]->Uint32Value(), *text, text.length(),
+                          (VGfloat) args[2]->NumberValue(),
+                          (VGfloat) args[3]->NumberValue());
+
+  V8_RETURN(Uint32::New(index));
+}
+
+V8_METHOD(faces::SetTextWidthCacheSize) {
+  HandleScope scope;
+
+  CheckArgs1(setTextWidthCacheSize, entries, Uint32);
+
+  SetCacheCapacity(args[0]->Uint32Value());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(faces::GetTextWidthCacheStats) {
+  HandleScope scope;
+
+  CheckArgs1(getTextWidthCacheStats, stats, Object);
+
+  stats_t stats;
+  GetStats(&stats);
+
+  Local<Object> result = args[0].As<Object>();
+  result->Set(String::NewSymbol("entries"), Number::New(stats.entries));
+  result->Set(String::NewSymbol("capacity"), Number::New(stats.capacity));
+  result->Set(String::NewSymbol("hits"), Number::New(stats.hits));
+  result->Set(String::NewSymbol("misses"), Number::New(stats.misses));
+
+  V8_RETURN(Undefined());
+}
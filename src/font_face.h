@@ -0,0 +1,141 @@
+#ifndef NODE_OPENVG_FONT_FACE_H_
+#define NODE_OPENVG_FONT_FACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <vector>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// Fonts held natively: glyph outlines (VGPaths in em units), advances and a
+// sparse code point to glyph map covering all of Unicode. Faces created from
+// font data keep the outlines as data and only create a glyph's VGPath the
+// first time it is drawn; past an optional limit the least recently used
+// paths are destroyed again. Text measurement works on these, with the em
+// widths of recently measured strings kept in an LRU cache keyed by a hash
+// of the string.
+namespace faces {
+
+const VGint kNoGlyph = -1;
+const uint32_t kMaxCodePoint = 0x10ffff;
+
+// Two-level table: code point >> 8 picks a block of 256 glyphs. Blocks are
+// allocated on first use, block 0 being shared by every empty range.
+struct character_map_t {
+  std::vector<uint16_t> blocks;
+  std::vector<VGint> glyphs;
+};
+
+struct outline_t {
+  uint32_t instructions;  // Offset and count in face_t::instructions
+  uint32_t count;
+  uint32_t points;        // Offset in face_t::points
+};
+
+struct face_t {
+  std::vector<VGPath> paths;  // VG_INVALID_HANDLE until created
+  std::vector<VGfloat> advances;  // Em units
+  character_map_t characters;
+
+  // Outline data when the paths are owned, created lazily
+  std::vector<outline_t> outlines;
+  std::vector<VGubyte> instructions;
+  std::vector<VGint> points;  // S_32, 16.16 em units
+
+  size_t glyphLimit;  // Live paths, 0 for no limit
+  std::list<VGuint> recent;  // Live paths, most recently used first
+  std::vector<std::list<VGuint>::iterator> positions;
+  size_t created;
+  size_t evicted;
+};
+
+struct stats_t {
+  size_t entries;
+  size_t capacity;
+  size_t hits;
+  size_t misses;
+};
+
+void SetGlyph(character_map_t *map, uint32_t codePoint, VGint glyph);
+
+inline VGint GlyphOf(const face_t *face, uint32_t codePoint) {
+  const character_map_t &map = face->characters;
+  uint32_t block = codePoint >> 8;
+  if (block >= map.blocks.size()) {
+    return kNoGlyph;
+  }
+  return map.glyphs[((size_t) map.blocks[block] << 8) | (codePoint & 0xff)];
+}
+
+// Next code point of UTF-16 text, advancing *i past it. Unpaired
+// surrogates are returned as is.
+inline uint32_t NextCodePoint(const uint16_t *text, size_t length, size_t *i) {
+  uint32_t unit = text[(*i)++];
+  if (unit >= 0xd800 && unit < 0xdc00 && *i < length &&
+      text[*i] >= 0xdc00 && text[*i] < 0xe000) {
+    return 0x10000 + ((unit - 0xd800) << 10) + (text[(*i)++] - 0xdc00);
+  }
+  return unit;
+}
+
+// Faces with outlines own the paths made from them; paths given directly
+// stay the caller's.
+uint32_t Add(const face_t &face);
+void Remove(uint32_t face);
+
+// NULL if unknown
+const face_t *Get(uint32_t face);
+
+// A glyph's path, created if needed. VG_INVALID_HANDLE for unknown glyphs.
+VGPath Path(uint32_t face, VGuint glyph);
+
+void SetGlyphLimit(uint32_t face, size_t paths);
+
+// Glyphs of a string, characters without one left out.
+void GlyphsOf(const face_t *face, const uint16_t *text, size_t length,
+              std::vector<VGuint> *glyphs);
+
+// Draws a string with the pen starting at (x, y) in the path user to
+// surface matrix, whatever the matrix mode, size being the em size: from
+// cached bitmaps when it's small enough (see glyph_cache.h), otherwise
+// glyph by glyph with vgDrawPath.
+void Draw(uint32_t face, const uint16_t *text, size_t length,
+          VGfloat x, VGfloat y, VGfloat size, VGbitfield paintModes);
+
+// Width of a string in em units; characters without a glyph take no space.
+VGfloat Width(uint32_t face, const uint16_t *text, size_t length);
+
+// Number of leading UTF-16 code units whose width at size is at most
+// maxWidth. Surrogate pairs aren't split.
+size_t FitIndex(uint32_t face, const uint16_t *text, size_t length,
+                VGfloat size, VGfloat maxWidth);
+
+void SetCacheCapacity(size_t entries);
+void GetStats(stats_t *stats);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(CreateFace);
+V8_FUNCTION_DECL(RegisterFace);
+V8_FUNCTION_DECL(UnregisterFace);
+V8_FUNCTION_DECL(SetFaceGlyphLimit);
+V8_FUNCTION_DECL(GetFaceStats);
+V8_FUNCTION_DECL(DrawFaceText);
+V8_FUNCTION_DECL(TextWidth);
+V8_FUNCTION_DECL(TextWidths);
+V8_FUNCTION_DECL(TextFitIndex);
+V8_FUNCTION_DECL(SetTextWidthCacheSize);
+V8_FUNCTION_DECL(GetTextWidthCacheStats);
+
+}
+
+#endif
@@ -0,0 +1,316 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+
+#include "VG/openvg.h"
+
+#include <node_buffer.h>
+
+#include "frame_diff.h"
+#include "draw_reorder.h"
+#include "pixel_convert.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+const size_t kHeaderBytes = 4;
+const size_t kTileHeaderBytes = 16;
+const uint32_t kRunFlag = 0x80000000u;
+
+std::map<uint32_t, diff::frame_diff_t> diffs;
+uint32_t nextDiff = 1;
+
+// Contiguous copy of the tile being encoded
+uint32_t *tile = NULL;
+size_t tileCapacity = 0;
+
+void Put16(uint8_t *out, uint32_t value) {
+  out[0] = (uint8_t) value;
+  out[1] = (uint8_t) (value >> 8);
+}
+
+void Put32(uint8_t *out, uint32_t value) {
+  out[0] = (uint8_t) value;
+  out[1] = (uint8_t) (value >> 8);
+  out[2] = (uint8_t) (value >> 16);
+  out[3] = (uint8_t) (value >> 24);
+}
+
+bool TileChanged(const diff::frame_diff_t *diff,
+                 VGint tx, VGint ty, VGint tw, VGint th) {
+  size_t stride = (size_t) diff->width * 4;
+  size_t offset = (size_t) ty * stride + (size_t) tx * 4;
+  for (VGint row = 0; row < th; row++, offset += stride) {
+    if (memcmp(diff->frames[0] + offset, diff->frames[1] + offset, tw * 4) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Run-length encodes count pixels into out. Runs shorter than three pixels
+// go into literal spans. Returns 0 if the result would exceed limit bytes.
+size_t EncodeRLE(const uint32_t *pixels, size_t count,
+                 uint8_t *out, size_t limit) {
+  size_t length = 0;
+  size_t i = 0;
+  while (i < count) {
+    size_t run = 1;
+    while (i + run < count && pixels[i + run] == pixels[i] && run < ~kRunFlag) {
+      run++;
+    }
+
+    if (run >= 3) {
+      if (length + 8 > limit) {
+        return 0;
+      }
+      Put32(out + length, kRunFlag | (uint32_t) run);
+      memcpy(out + length + 4, &pixels[i], 4);
+      length += 8;
+      i += run;
+    } else {
+      size_t start = i;
+      while (i < count &&
+             !(i + 2 < count &&
+               pixels[i] == pixels[i + 1] && pixels[i] == pixels[i + 2])) {
+        i++;
+      }
+      size_t literal = i - start;
+      if (length + 4 + literal * 4 > limit) {
+        return 0;
+      }
+      Put32(out + length, (uint32_t) literal);
+      memcpy(out + length + 4, &pixels[start], literal * 4);
+      length += 4 + literal * 4;
+    }
+  }
+  return length;
+}
+
+}
+
+bool diff::Init(frame_diff_t *diff, VGint x, VGint y, VGint width, VGint height,
+                VGImageFormat format, VGint tileSize, bool rle) {
+  if (width <= 0 || height <= 0 || tileSize <= 0 || tileSize > 0xffff ||
+      width > 0xffff || height > 0xffff ||
+      pixels::BytesPerPixel(format) != 4) {
+    return false;
+  }
+
+  diff->x = x;
+  diff->y = y;
+  diff->width = width;
+  diff->height = height;
+  diff->format = format;
+  diff->tileSize = tileSize;
+  diff->rle = rle;
+  diff->hasPrevious = false;
+  diff->changedTiles = diff->rleTiles = diff->bytes = 0;
+
+  size_t size = (size_t) width * height * 4;
+  diff->frames[0] = (uint8_t*) malloc(size);
+  diff->frames[1] = (uint8_t*) malloc(size);
+  if (diff->frames[0] == NULL || diff->frames[1] == NULL) {
+    Destroy(diff);
+    return false;
+  }
+  return true;
+}
+
+void diff::Destroy(frame_diff_t *diff) {
+  free(diff->frames[0]);
+  free(diff->frames[1]);
+  diff->frames[0] = diff->frames[1] = NULL;
+}
+
+size_t diff::TileCount(const frame_diff_t *diff) {
+  size_t columns = (diff->width + diff->tileSize - 1) / diff->tileSize;
+  size_t rows = (diff->height + diff->tileSize - 1) / diff->tileSize;
+  return columns * rows;
+}
+
+size_t diff::MaxBytes(const frame_diff_t *diff) {
+  // RLE output never exceeds the raw size, the encoder falls back to raw
+  return kHeaderBytes + TileCount(diff) * kTileHeaderBytes +
+         (size_t) diff->width * diff->height * 4;
+}
+
+size_t diff::Encode(frame_diff_t *diff, uint8_t *out) {
+  size_t tilePixels = (size_t) diff->tileSize * diff->tileSize;
+  if (diff->rle && tileCapacity < tilePixels) {
+    free(tile);
+    tile = (uint32_t*) malloc(tilePixels * 4);
+    tileCapacity = tile != NULL ? tilePixels : 0;
+  }
+  bool rle = diff->rle && tile != NULL;
+
+  size_t stride = (size_t) diff->width * 4;
+  size_t length = kHeaderBytes;
+  diff->changedTiles = diff->rleTiles = 0;
+
+  for (VGint ty = 0; ty < diff->height; ty += diff->tileSize) {
+    VGint th = diff->height - ty < diff->tileSize ? diff->height - ty : diff->tileSize;
+    for (VGint tx = 0; tx < diff->width; tx += diff->tileSize) {
+      VGint tw = diff->width - tx < diff->tileSize ? diff->width - tx : diff->tileSize;
+      if (diff->hasPrevious && !TileChanged(diff, tx, ty, tw, th)) {
+        continue;
+      }
+
+      uint8_t *header = out + length;
+      uint8_t *data = header + kTileHeaderBytes;
+      const uint8_t *src = diff->frames[0] + (size_t) ty * stride + (size_t) tx * 4;
+      size_t rowBytes = (size_t) tw * 4;
+      size_t rawBytes = rowBytes * th;
+
+      size_t dataBytes = 0;
+      if (rle) {
+        for (VGint row = 0; row < th; row++) {
+          memcpy((uint8_t*) tile + row * rowBytes, src + row * stride, rowBytes);
+        }
+        dataBytes = EncodeRLE(tile, (size_t) tw * th, data, rawBytes - 1);
+      }
+
+      encoding_t encoding = kRLE;
+      if (dataBytes == 0) {
+        encoding = kRaw;
+        for (VGint row = 0; row < th; row++) {
+          memcpy(data + row * rowBytes, src + row * stride, rowBytes);
+        }
+        dataBytes = rawBytes;
+      } else {
+        diff->rleTiles++;
+      }
+
+      Put16(header, tx);
+      Put16(header + 2, ty);
+      Put16(header + 4, tw);
+      Put16(header + 6, th);
+      Put32(header + 8, encoding);
+      Put32(header + 12, (uint32_t) dataBytes);
+      length += kTileHeaderBytes + dataBytes;
+      diff->changedTiles++;
+    }
+  }
+  Put32(out, (uint32_t) diff->changedTiles);
+
+  uint8_t *previous = diff->frames[1];
+  diff->frames[1] = diff->frames[0];
+  diff->frames[0] = previous;
+  diff->hasPrevious = true;
+
+  diff->bytes = length;
+  return length;
+}
+
+size_t diff::Capture(frame_diff_t *diff, uint8_t *out) {
+  reorder::Barrier();
+  vgReadPixels(diff->frames[0], diff->width * 4, diff->format,
+               diff->x, diff->y, diff->width, diff->height);
+  return Encode(diff, out);
+}
+
+
+extern void diff::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "createFrameDiff" , diff::CreateFrameDiff);
+  NODE_SET_METHOD(target, "destroyFrameDiff", diff::DestroyFrameDiff);
+  NODE_SET_METHOD(target, "captureFrameDiff", diff::CaptureFrameDiff);
+  NODE_SET_METHOD(target, "resetFrameDiff"  , diff::ResetFrameDiff);
+  NODE_SET_METHOD(target, "getFrameDiffInfo", diff::GetFrameDiffInfo);
+}
+
+V8_METHOD(diff::CreateFrameDiff) {
+  HandleScope scope;
+
+  CheckArgs7(createFrameDiff, x, Int32, y, Int32, width, Int32, height, Int32,
+             VGImageFormat, Uint32, tileSize, Int32, rle, Boolean);
+
+  frame_diff_t diff;
+  if (!Init(&diff,
+            (VGint) args[0]->Int32Value(), (VGint) args[1]->Int32Value(),
+            (VGint) args[2]->Int32Value(), (VGint) args[3]->Int32Value(),
+            static_cast<VGImageFormat>(args[4]->Uint32Value()),
+            (VGint) args[5]->Int32Value(), args[6]->BooleanValue())) {
+    V8_THROW(Exception::Error(String::New("createFrameDiff: invalid area or format, or out of memory")));
+  }
+
+  uint32_t id = nextDiff++;
+  diffs[id] = diff;
+
+  V8_RETURN(Uint32::New(id));
+}
+
+V8_METHOD(diff::DestroyFrameDiff) {
+  HandleScope scope;
+
+  CheckArgs1(destroyFrameDiff, diff, Uint32);
+
+  std::map<uint32_t, frame_diff_t>::iterator it = diffs.find(args[0]->Uint32Value());
+  if (it != diffs.end()) {
+    Destroy(&it->second);
+    diffs.erase(it);
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(diff::CaptureFrameDiff) {
+  HandleScope scope;
+
+  // Always checked: the output is written to
+  if (!(args.Length() == 2 && args[0]->IsUint32() &&
+        Buffer::HasInstance(args[1]))) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected captureFrameDiff(diff,Buffer)")));
+  }
+
+  std::map<uint32_t, frame_diff_t>::iterator it = diffs.find(args[0]->Uint32Value());
+  if (it == diffs.end()) {
+    V8_THROW(Exception::TypeError(String::New("captureFrameDiff: unknown frame diff")));
+  }
+
+  Local<Object> buffer = args[1]->ToObject();
+  if (Buffer::Length(buffer) < MaxBytes(&it->second)) {
+    V8_THROW(Exception::RangeError(String::New("captureFrameDiff: buffer smaller than getFrameDiffInfo().maxBytes")));
+  }
+
+  size_t length = Capture(&it->second, (uint8_t*) Buffer::Data(buffer));
+
+  V8_RETURN(Number::New(length));
+}
+
+V8_METHOD(diff::ResetFrameDiff) {
+  HandleScope scope;
+
+  CheckArgs1(resetFrameDiff, diff, Uint32);
+
+  std::map<uint32_t, frame_diff_t>::iterator it = diffs.find(args[0]->Uint32Value());
+  if (it != diffs.end()) {
+    it->second.hasPrevious = false;
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(diff::GetFrameDiffInfo) {
+  HandleScope scope;
+
+  CheckArgs2(getFrameDiffInfo, diff, Uint32, info, Object);
+
+  std::map<uint32_t, frame_diff_t>::iterator it = diffs.find(args[0]->Uint32Value());
+  if (it == diffs.end()) {
+    V8_THROW(Exception::TypeError(String::New("getFrameDiffInfo: unknown frame diff")));
+  }
+  const frame_diff_t &diff = it->second;
+
+  Local<Object> result = args[1].As<Object>();
+  result->Set(String::NewSymbol("tiles"), Number::New(TileCount(&diff)));
+  result->Set(String::NewSymbol("changedTiles"), Number::New(diff.changedTiles));
+  result->Set(String::NewSymbol("rleTiles"), Number::New(diff.rleTiles));
+  result->Set(String::NewSymbol("bytes"), Number::New(diff.bytes));
+  result->Set(String::NewSymbol("maxBytes"), Number::New(MaxBytes(&diff)));
+
+  V8_RETURN(Undefined());
+}
@@ -0,0 +1,83 @@
+#ifndef NODE_OPENVG_FRAME_DIFF_H_
+#define NODE_OPENVG_FRAME_DIFF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// Captures of a surface area that only carry the tiles which changed since
+// the previous capture, for mirroring a display over the network. Each
+// capture reads the area with vgReadPixels, compares it tile by tile with
+// the previous frame and writes the changed tiles, raw or run-length
+// encoded, into a caller supplied buffer.
+//
+// Output layout, little-endian:
+//   uint32 tileCount
+//   tileCount times:
+//     uint16 x, y, width, height  (pixels, relative to the area, y up)
+//     uint32 encoding             (kRaw or kRLE)
+//     uint32 length               (bytes of data that follow)
+//     data                        (tile rows bottom-up, tightly packed)
+//
+// RLE data is a sequence of uint32 control words: with the top bit set, the
+// next pixel repeated (word & 0x7fffffff) times; otherwise that many literal
+// pixels follow. Runs continue across tile rows.
+namespace diff {
+
+enum encoding_t {
+  kRaw = 0,
+  kRLE = 1
+};
+
+struct frame_diff_t {
+  VGint x, y, width, height;
+  VGImageFormat format;  // 32 bits per pixel
+  VGint tileSize;
+  bool rle;
+
+  uint8_t *frames[2];  // Current and previous, width * 4 bytes per row
+  bool hasPrevious;
+
+  // Last capture
+  size_t changedTiles;
+  size_t rleTiles;
+  size_t bytes;
+};
+
+bool Init(frame_diff_t *diff, VGint x, VGint y, VGint width, VGint height,
+          VGImageFormat format, VGint tileSize, bool rle);
+void Destroy(frame_diff_t *diff);
+
+size_t TileCount(const frame_diff_t *diff);
+
+// Output buffer size that fits any capture.
+size_t MaxBytes(const frame_diff_t *diff);
+
+// Compares frames[0] with frames[1] (or takes every tile when there is no
+// previous frame), writes the changed tiles to out, which must hold
+// MaxBytes(), and makes frames[0] the previous frame. Returns the bytes
+// written.
+size_t Encode(frame_diff_t *diff, uint8_t *out);
+
+// Reads the area and encodes it.
+size_t Capture(frame_diff_t *diff, uint8_t *out);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(CreateFrameDiff);
+V8_FUNCTION_DECL(DestroyFrameDiff);
+V8_FUNCTION_DECL(CaptureFrameDiff);
+V8_FUNCTION_DECL(ResetFrameDiff);
+V8_FUNCTION_DECL(GetFrameDiffInfo);
+
+}
+
+#endif
@@ -0,0 +1,604 @@
+#include <math.h>
+
+#include <map>
+
+#include "VG/openvg.h"
+
+#include "glyph_cache.h"
+#include "font_face.h"
+#include "image_registry.h"
+#include "egl.h"
+#include "matrix_stack.h"
+#include "state_cache.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+const int kSizeSteps = 4;      // Strikes every quarter pixel
+const int kSubpixelSteps = 4;  // Horizontal pen offsets
+const VGint kPadding = 1;
+
+const VGint kPageSize = 512;
+const size_t kMaxPages = 8;
+const VGint kScratchSize = 512;
+
+// Above this the cells may not fit the scratch image
+const VGfloat kMaxPixelSize = 128.0f;
+
+const VGbitfield kQuality = VG_IMAGE_QUALITY_NONANTIALIASED;
+
+struct shelf_t {
+  VGint y, height, x;
+};
+
+struct packer_t {
+  VGint width, height, top;
+  std::vector<shelf_t> shelves;
+};
+
+struct page_t {
+  VGImage image;
+  packer_t packer;
+};
+
+enum glyph_state_t {
+  kMissing = 0,
+  kQueued,
+  kReady
+};
+
+struct strike_key_t {
+  uint32_t face;
+  int size;      // Pixels * kSizeSteps
+  int subpixel;  // Pen offset * kSubpixelSteps
+
+  bool operator<(const strike_key_t &other) const {
+    if (face != other.face) return face < other.face;
+    if (size != other.size) return size < other.size;
+    return subpixel < other.subpixel;
+  }
+};
+
+struct strike_t {
+  VGFont font;
+  std::vector<unsigned char> states;
+  std::vector<VGImage> images;
+};
+
+// A glyph waiting to be rasterized
+struct pending_t {
+  strike_t *strike;
+  uint32_t face;
+  VGuint glyph;
+  VGfloat size, offsetX;
+  VGint originX, originY;  // Pen position in the cell
+  VGint width, height;
+  VGint x, y;              // Cell position in the scratch image
+};
+
+std::map<strike_key_t, strike_t> strikes;
+std::vector<page_t> pages;
+
+VGImage scratch = VG_INVALID_HANDLE;
+VGPaint white = VG_INVALID_HANDLE;
+
+// Set when the driver can't draw into images
+bool unsupported = false;
+
+VGfloat threshold = 24.0f;
+size_t hits = 0, misses = 0, resets = 0;
+
+uint32_t LengthOf(const Local<Object> &array) {
+  return array->Get(String::NewSymbol("length"))->Uint32Value();
+}
+
+void ResetPacker(packer_t *packer, VGint width, VGint height) {
+  packer->width = width;
+  packer->height = height;
+  packer->top = 0;
+  packer->shelves.clear();
+}
+
+// Shelf packing: a shelf takes items up to a quarter shorter than itself.
+bool Pack(packer_t *packer, VGint width, VGint height, VGint *x, VGint *y) {
+  for (size_t i = 0; i < packer->shelves.size(); i++) {
+    shelf_t &shelf = packer->shelves[i];
+    if (height <= shelf.height && height >= shelf.height * 3 / 4 &&
+        shelf.x + width <= packer->width) {
+      *x = shelf.x;
+      *y = shelf.y;
+      shelf.x += width;
+      return true;
+    }
+  }
+
+  if (width > packer->width || packer->top + height > packer->height) {
+    return false;
+  }
+  shelf_t shelf = { packer->top, height, width };
+  packer->shelves.push_back(shelf);
+  packer->top += height;
+  *x = 0;
+  *y = shelf.y;
+  return true;
+}
+
+bool AllocateInAtlas(VGint width, VGint height,
+                     VGImage *page, VGint *x, VGint *y) {
+  for (size_t i = 0; i < pages.size(); i++) {
+    if (Pack(&pages[i].packer, width, height, x, y)) {
+      *page = pages[i].image;
+      return true;
+    }
+  }
+
+  if (pages.size() >= kMaxPages) {
+    return false;
+  }
+  page_t created;
+  created.image = registry::Create(VG_A_8, kPageSize, kPageSize, kQuality);
+  if (created.image == VG_INVALID_HANDLE) {
+    return false;
+  }
+  ResetPacker(&created.packer, kPageSize, kPageSize);
+  pages.push_back(created);
+  *page = created.image;
+  return Pack(&pages.back().packer, width, height, x, y);
+}
+
+void DestroyStrike(strike_t *strike) {
+  vgDestroyFont(strike->font);
+  for (size_t i = 0; i < strike->images.size(); i++) {
+    if (strike->images[i] != VG_INVALID_HANDLE) {
+      registry::Destroy(strike->images[i]);
+    }
+  }
+}
+
+strike_t *GetStrike(uint32_t face, size_t glyphCount, int size, int subpixel) {
+  strike_key_t key = { face, size, subpixel };
+  std::map<strike_key_t, strike_t>::iterator it = strikes.find(key);
+  if (it != strikes.end()) {
+    return &it->second;
+  }
+
+  strike_t &strike = strikes[key];
+  strike.font = vgCreateFont((VGint) glyphCount);
+  strike.states.assign(glyphCount, kMissing);
+  strike.images.assign(glyphCount, VG_INVALID_HANDLE);
+  return &strike;
+}
+
+// Cell size and pen position of a glyph, from its outline bounds. Returns
+// false for glyphs with nothing to draw.
+bool Measure(pending_t *glyph) {
+  VGfloat minX = 0, minY = 0, width = -1, height = -1;
+  vgPathBounds(faces::Path(glyph->face, glyph->glyph),
+               &minX, &minY, &width, &height);
+  if (width <= 0 || height <= 0) {
+    return false;
+  }
+
+  VGint left = (VGint) floorf(minX * glyph->size + glyph->offsetX) - kPadding;
+  VGint bottom = (VGint) floorf(minY * glyph->size) - kPadding;
+  VGint right = (VGint) ceilf((minX + width) * glyph->size + glyph->offsetX) + kPadding;
+  VGint top = (VGint) ceilf((minY + height) * glyph->size) + kPadding;
+
+  glyph->originX = -left;
+  glyph->originY = -bottom;
+  glyph->width = right - left;
+  glyph->height = top - bottom;
+  return true;
+}
+
+// Draws the cells' outlines into the scratch image.
+bool DrawCells(const std::vector<pending_t> &cells, VGint usedHeight) {
+  std::vector<glyphs::outline_t> outlines(cells.size());
+  for (size_t i = 0; i < cells.size(); i++) {
+    const pending_t &cell = cells[i];
+    outlines[i].face = cell.face;
+    outlines[i].glyph = cell.glyph;
+    outlines[i].x = (VGfloat) (cell.x + cell.originX) + cell.offsetX;
+    outlines[i].y = (VGfloat) (cell.y + cell.originY);
+    outlines[i].size = cell.size;
+  }
+  return glyphs::RenderOutlines(scratch, kScratchSize, usedHeight, outlines);
+}
+
+// Moves rasterized cells into the atlas and their fonts.
+bool StoreCells(const std::vector<pending_t> &cells) {
+  static const VGfloat escapement[2] = { 0, 0 };
+
+  for (size_t i = 0; i < cells.size(); i++) {
+    const pending_t &cell = cells[i];
+    VGImage page;
+    VGint x, y;
+    if (!AllocateInAtlas(cell.width, cell.height, &page, &x, &y)) {
+      return false;
+    }
+
+    vgCopyImage(registry::Use(page), x, y, registry::Read(scratch),
+                cell.x, cell.y, cell.width, cell.height, VG_FALSE);
+    VGImage image = registry::CreateChild(page, x, y, cell.width, cell.height);
+    VGfloat origin[2] = { (VGfloat) cell.originX, (VGfloat) cell.originY };
+    vgSetGlyphToImage(cell.strike->font, cell.glyph, registry::Read(image),
+                      origin, escapement);
+
+    cell.strike->images[cell.glyph] = image;
+    cell.strike->states[cell.glyph] = kReady;
+  }
+  return true;
+}
+
+bool Rasterize(std::vector<pending_t> &glyphs) {
+  static const VGfloat zero[2] = { 0, 0 };
+
+  if (scratch == VG_INVALID_HANDLE) {
+    scratch = registry::Create(VG_sRGBA_8888_PRE, kScratchSize, kScratchSize,
+                               kQuality);
+    if (scratch == VG_INVALID_HANDLE) {
+      return false;
+    }
+  }
+  packer_t packer;
+  ResetPacker(&packer, kScratchSize, kScratchSize);
+  std::vector<pending_t> cells;
+
+  for (size_t i = 0; i <= glyphs.size(); i++) {
+    pending_t *glyph = i < glyphs.size() ? &glyphs[i] : NULL;
+    if (glyph != NULL && !Measure(glyph)) {
+      // Nothing to draw, only the glyph's place in the font
+      vgSetGlyphToImage(glyph->strike->font, glyph->glyph, VG_INVALID_HANDLE,
+                        zero, zero);
+      glyph->strike->states[glyph->glyph] = kReady;
+      continue;
+    }
+    if (glyph != NULL &&
+        (glyph->width > kScratchSize || glyph->height > kScratchSize)) {
+      return false;
+    }
+
+    if (glyph == NULL ||
+        !Pack(&packer, glyph->width, glyph->height, &glyph->x, &glyph->y)) {
+      // Scratch image full, or last glyph
+      if (!cells.empty() &&
+          !(DrawCells(cells, packer.top) && StoreCells(cells))) {
+        return false;
+      }
+      cells.clear();
+      ResetPacker(&packer, kScratchSize, kScratchSize);
+      if (glyph == NULL) {
+        break;
+      }
+      Pack(&packer, glyph->width, glyph->height, &glyph->x, &glyph->y);
+    }
+    cells.push_back(*glyph);
+  }
+  return true;
+}
+
+}
+
+bool glyphs::RenderOutlines(VGImage image, VGint width, VGint height,
+                            const std::vector<outline_t> &outlines) {
+  if (unsupported) {
+    return false;
+  }
+
+  matrices::Sync();
+
+  egl::image_target_t target;
+  if (!egl::BeginImageTarget(registry::Use(image), &target)) {
+    unsupported = true;
+    return false;
+  }
+
+  if (white == VG_INVALID_HANDLE) {
+    static const VGfloat color[4] = { 1, 1, 1, 1 };
+    white = vgCreatePaint();
+    vgSetParameterfv(white, VG_PAINT_COLOR, 4, color);
+  }
+
+  VGint matrixMode = state::MatrixMode();
+  VGint blendMode = vgGeti(VG_BLEND_MODE);
+  VGint masking = vgGeti(VG_MASKING);
+  VGint scissoring = vgGeti(VG_SCISSORING);
+  VGint fillRule = vgGeti(VG_FILL_RULE);
+  VGint colorTransform = vgGeti(VG_COLOR_TRANSFORM);
+  VGint renderingQuality = vgGeti(VG_RENDERING_QUALITY);
+  VGfloat clearColor[4];
+  vgGetfv(VG_CLEAR_COLOR, 4, clearColor);
+  VGPaint fillPaint = vgGetPaint(VG_FILL_PATH);
+
+  state::SetI(VG_MATRIX_MODE, VG_MATRIX_PATH_USER_TO_SURFACE);
+  VGfloat pathMatrix[9];
+  vgGetMatrix(pathMatrix);
+
+  static const VGfloat transparent[4] = { 0, 0, 0, 0 };
+  state::SetI(VG_BLEND_MODE, VG_BLEND_SRC_OVER);
+  state::SetI(VG_MASKING, VG_FALSE);
+  state::SetI(VG_SCISSORING, VG_FALSE);
+  state::SetI(VG_FILL_RULE, VG_NON_ZERO);
+  state::SetI(VG_COLOR_TRANSFORM, VG_FALSE);
+  state::SetI(VG_RENDERING_QUALITY, VG_RENDERING_QUALITY_BETTER);
+  state::SetFV(VG_CLEAR_COLOR, 4, transparent);
+  state::SetPaint(white, VG_FILL_PATH);
+
+  vgClear(0, 0, width, height);
+  for (size_t i = 0; i < outlines.size(); i++) {
+    vgLoadIdentity();
+    vgTranslate(outlines[i].x, outlines[i].y);
+    vgScale(outlines[i].size, outlines[i].size);
+    vgDrawPath(faces::Path(outlines[i].face, outlines[i].glyph), VG_FILL_PATH);
+  }
+
+  vgLoadMatrix(pathMatrix);
+  state::SetPaint(fillPaint, VG_FILL_PATH);
+  state::SetFV(VG_CLEAR_COLOR, 4, clearColor);
+  state::SetI(VG_RENDERING_QUALITY, renderingQuality);
+  state::SetI(VG_COLOR_TRANSFORM, colorTransform);
+  state::SetI(VG_FILL_RULE, fillRule);
+  state::SetI(VG_SCISSORING, scissoring);
+  state::SetI(VG_MASKING, masking);
+  state::SetI(VG_BLEND_MODE, blendMode);
+  state::SetI(VG_MATRIX_MODE, matrixMode);
+
+  egl::EndImageTarget(&target);
+  return true;
+}
+
+bool glyphs::CanRenderOutlines() {
+  return !unsupported;
+}
+
+void glyphs::DropFace(uint32_t face) {
+  std::map<strike_key_t, strike_t>::iterator it = strikes.begin();
+  while (it != strikes.end()) {
+    if (it->first.face == face) {
+      DestroyStrike(&it->second);
+      strikes.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool glyphs::Draw(uint32_t faceId, const std::vector<VGuint> &glyphs,
+                  VGfloat x, VGfloat y, VGfloat size) {
+  const faces::face_t *face = faces::Get(faceId);
+  if (unsupported || face == NULL) {
+    return false;
+  }
+
+  matrices::Sync();
+  VGint matrixMode = state::MatrixMode();
+  state::SetI(VG_MATRIX_MODE, VG_MATRIX_PATH_USER_TO_SURFACE);
+  VGfloat m[9];
+  vgGetMatrix(m);
+  state::SetI(VG_MATRIX_MODE, matrixMode);
+
+  if (!(m[0] > 0 && m[0] == m[4] && m[1] == 0 && m[3] == 0 &&
+        m[2] == 0 && m[5] == 0 && m[8] == 1)) {
+    return false;
+  }
+  VGfloat pixelSize = size * m[0];
+  if (pixelSize <= 0 || pixelSize > threshold || pixelSize > kMaxPixelSize) {
+    return false;
+  }
+
+  int sizeKey = (int) (pixelSize * kSizeSteps + 0.5f);
+  if (sizeKey < 1) {
+    sizeKey = 1;
+  }
+  VGfloat rasterSize = (VGfloat) sizeKey / kSizeSteps;
+
+  // Surface pen positions, split into whole pixels and strike offsets
+  size_t count = glyphs.size();
+  std::vector<VGint> penX(count);
+  std::vector<strike_t*> owners(count, (strike_t*) NULL);
+  std::vector<pending_t> pending;
+  size_t valid = 0;
+  VGint penY = (VGint) floorf(m[4] * y + m[7] + 0.5f);
+  VGfloat pen = x;
+
+  for (size_t i = 0; i < count; i++) {
+    VGuint glyph = glyphs[i];
+    if (glyph >= face->advances.size()) {
+      continue;
+    }
+
+    VGfloat surfaceX = m[0] * pen + m[6];
+    VGint whole = (VGint) floorf(surfaceX);
+    int subpixel = (int) ((surfaceX - whole) * kSubpixelSteps + 0.5f);
+    if (subpixel == kSubpixelSteps) {
+      whole++;
+      subpixel = 0;
+    }
+    penX[i] = whole;
+    valid++;
+
+    strike_t *strike = GetStrike(faceId, face->advances.size(), sizeKey, subpixel);
+    owners[i] = strike;
+    if (strike->states[glyph] == kMissing) {
+      pending_t item;
+      item.strike = strike;
+      item.glyph = glyph;
+      item.face = faceId;
+      item.size = rasterSize;
+      item.offsetX = (VGfloat) subpixel / kSubpixelSteps;
+      pending.push_back(item);
+      strike->states[glyph] = kQueued;
+    }
+
+    pen += size * face->advances[glyph];
+  }
+
+  if (!pending.empty()) {
+    misses += pending.size();
+    if (!Rasterize(pending)) {
+      // Atlas full, or no way to draw into images: outlines this time
+      if (!unsupported) {
+        Flush();
+      } else {
+        for (size_t i = 0; i < pending.size(); i++) {
+          pending[i].strike->states[pending[i].glyph] = kMissing;
+        }
+      }
+      return false;
+    }
+  }
+  hits += valid - pending.size();
+
+  VGint imageMode = vgGeti(VG_IMAGE_MODE);
+  VGfloat glyphOrigin[2];
+  vgGetfv(VG_GLYPH_ORIGIN, 2, glyphOrigin);
+  state::SetI(VG_IMAGE_MODE, VG_DRAW_IMAGE_STENCIL);
+  state::SetI(VG_MATRIX_MODE, VG_MATRIX_GLYPH_USER_TO_SURFACE);
+  VGfloat glyphMatrix[9];
+  vgGetMatrix(glyphMatrix);
+  vgLoadIdentity();
+
+  // One vgDrawGlyphs per strike, the escapements being zero and the
+  // adjustments the whole pixel distances between pens
+  std::vector<VGuint> indices;
+  std::vector<VGfloat> adjustments;
+  std::vector<bool> drawn(count, false);
+  for (size_t i = 0; i < count; i++) {
+    if (owners[i] == NULL || drawn[i]) {
+      continue;
+    }
+    strike_t *strike = owners[i];
+    indices.clear();
+    adjustments.clear();
+    size_t last = i;
+    for (size_t j = i; j < count; j++) {
+      if (owners[j] != strike) {
+        continue;
+      }
+      if (!indices.empty()) {
+        adjustments.back() = (VGfloat) (penX[j] - penX[last]);
+      }
+      indices.push_back(glyphs[j]);
+      adjustments.push_back(0);
+      drawn[j] = true;
+      last = j;
+    }
+
+    VGfloat origin[2] = { (VGfloat) penX[i], (VGfloat) penY };
+    state::SetFV(VG_GLYPH_ORIGIN, 2, origin);
+    vgDrawGlyphs(strike->font, (VGint) indices.size(), &indices[0],
+                 &adjustments[0], NULL, VG_FILL_PATH, VG_FALSE);
+  }
+
+  vgLoadMatrix(glyphMatrix);
+  state::SetI(VG_MATRIX_MODE, matrixMode);
+  state::SetFV(VG_GLYPH_ORIGIN, 2, glyphOrigin);
+  state::SetI(VG_IMAGE_MODE, imageMode);
+  return true;
+}
+
+void glyphs::SetThreshold(VGfloat pixelSize) {
+  threshold = pixelSize;
+}
+
+void glyphs::Flush() {
+  for (std::map<strike_key_t, strike_t>::iterator it = strikes.begin();
+       it != strikes.end(); ++it) {
+    DestroyStrike(&it->second);
+  }
+  strikes.clear();
+
+  for (size_t i = 0; i < pages.size(); i++) {
+    registry::Destroy(pages[i].image);
+  }
+  pages.clear();
+  resets++;
+}
+
+void glyphs::GetStats(stats_t *stats) {
+  stats->strikes = strikes.size();
+  stats->glyphs = 0;
+  for (std::map<strike_key_t, strike_t>::const_iterator it = strikes.begin();
+       it != strikes.end(); ++it) {
+    for (size_t i = 0; i < it->second.images.size(); i++) {
+      stats->glyphs += it->second.images[i] != VG_INVALID_HANDLE;
+    }
+  }
+  stats->pages = pages.size();
+  stats->hits = hits;
+  stats->misses = misses;
+  stats->resets = resets;
+}
+
+
+extern void glyphs::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "drawGlyphsCached"      , glyphs::DrawGlyphsCached);
+  NODE_SET_METHOD(target, "setGlyphCacheThreshold", glyphs::SetGlyphCacheThreshold);
+  NODE_SET_METHOD(target, "flushGlyphCache"       , glyphs::FlushGlyphCache);
+  NODE_SET_METHOD(target, "getGlyphCacheStats"    , glyphs::GetGlyphCacheStats);
+}
+
+V8_METHOD(glyphs::DrawGlyphsCached) {
+  HandleScope scope;
+
+  // Always checked: the glyph array is walked below
+  if (!(args.Length() == 5 && args[0]->IsUint32() && args[1]->IsObject() &&
+        args[2]->IsNumber() && args[3]->IsNumber() && args[4]->IsNumber())) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected drawGlyphsCached(face,glyphs,x,y,size)")));
+  }
+
+  Local<Object> array = args[1].As<Object>();
+  std::vector<VGuint> indices(LengthOf(array));
+  for (uint32_t i = 0; i < indices.size(); i++) {
+    indices[i] = (VGuint) array->Get(i)->Uint32Value();
+  }
+
+  bool drawn = Draw(args[0]->Uint32Value(), indices,
+                    (VGfloat) args[2]->NumberValue(),
+                    (VGfloat) args[3]->NumberValue(),
+                    (VGfloat) args[4]->NumberValue());
+
+  V8_RETURN(Boolean::New(drawn));
+}
+
+V8_METHOD(glyphs::SetGlyphCacheThreshold) {
+  HandleScope scope;
+
+  CheckArgs1(setGlyphCacheThreshold, pixelSize, Number);
+
+  SetThreshold((VGfloat) args[0]->NumberValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(glyphs::FlushGlyphCache) {
+  HandleScope scope;
+
+  CheckArgs0(flushGlyphCache);
+
+  Flush();
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(glyphs::GetGlyphCacheStats) {
+  HandleScope scope;
+
+  CheckArgs1(getGlyphCacheStats, stats, Object);
+
+  stats_t stats;
+  GetStats(&stats);
+
+  Local<Object> result = args[0].As<Object>();
+  result->Set(String::NewSymbol("strikes"), Number::New(stats.strikes));
+  result->Set(String::NewSymbol("glyphs"), Number::New(stats.glyphs));
+  result->Set(String::NewSymbol("pages"), Number::New(stats.pages));
+  result->Set(String::NewSymbol("hits"), Number::New(stats.hits));
+  result->Set(String::NewSymbol("misses"), Number::New(stats.misses));
+  result->Set(String::NewSymbol("resets"), Number::New(stats.resets));
+
+  V8_RETURN(Undefined());
+}
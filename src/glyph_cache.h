@@ -0,0 +1,82 @@
+#ifndef NODE_OPENVG_GLYPH_CACHE_H_
+#define NODE_OPENVG_GLYPH_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// Bitmaps of small glyphs of the faces in font_face.h, whose outlines need
+// VG_PATH_CAPABILITY_PATH_BOUNDS. The first time a
+// glyph is drawn at a given pixel size and subpixel offset it is rasterized
+// once, through a pbuffer, into a region of a shared A_8 atlas, and set with
+// vgSetGlyphToImage in an image VGFont for that (face, size, offset). Text
+// is then drawn as stencil image glyphs with the current fill paint.
+namespace glyphs {
+
+struct stats_t {
+  size_t strikes;  // Image fonts, one per (face, pixel size, offset)
+  size_t glyphs;
+  size_t pages;
+  size_t hits;
+  size_t misses;
+  size_t resets;   // Times the atlas filled up and was cleared
+};
+
+// A glyph filled by RenderOutlines at (x, y) in image pixels, scaled by
+// size. Its path is only fetched when it's drawn, as fetching another
+// glyph's may destroy it (see faces::SetGlyphLimit).
+struct outline_t {
+  uint32_t face;
+  VGuint glyph;
+  VGfloat x, y, size;
+};
+
+// Drops the bitmaps of a face being removed.
+void DropFace(uint32_t face);
+
+// Draws glyphs of a face with the pen starting at (x, y) in path user
+// coordinates, size being the em size. Returns false, having drawn nothing,
+// when the caller has to draw the outlines instead: the text is larger than
+// the threshold on the surface, the path matrix isn't a uniform scale plus
+// translation, or the bitmaps couldn't be made.
+bool Draw(uint32_t face, const std::vector<VGuint> &glyphs,
+          VGfloat x, VGfloat y, VGfloat size);
+
+void SetThreshold(VGfloat pixelSize);
+
+// Drops every bitmap and atlas page.
+void Flush();
+
+// Clears the width x height bottom left corner of an image (a registry key)
+// to transparent and fills outlines into it in white, through a pbuffer,
+// putting back the context state it changes. Used for the atlas and by the
+// text layers (text_layer.h). Returns false, and keeps doing so, if the
+// driver can't draw into images.
+bool RenderOutlines(VGImage image, VGint width, VGint height,
+                    const std::vector<outline_t> &outlines);
+
+// False once RenderOutlines found images can't be drawn into.
+bool CanRenderOutlines();
+
+void GetStats(stats_t *stats);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(DrawGlyphsCached);
+V8_FUNCTION_DECL(SetGlyphCacheThreshold);
+V8_FUNCTION_DECL(FlushGlyphCache);
+V8_FUNCTION_DECL(GetGlyphCacheStats);
+
+}
+
+#endif
@@ -0,0 +1,219 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "VG/openvg.h"
+
+#include "image_blur.h"
+#include "draw_reorder.h"
+#include "image_registry.h"
+#include "khr_filters.h"
+#include "pixel_convert.h"
+#include "pixel_filter.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+const VGImageFormat kWorkFormat = (VGImageFormat) pixels::kRGBA_8888_PRE;
+const int kPasses = 3;
+
+// Downsampling stops before the blur gets narrower than this, in
+// downsampled pixels, where the box approximation would start to show.
+const VGfloat kMinScaledStdDeviation = 6.0f;
+const int kMaxDownsample = 16;
+
+VGfloat threshold = 8.0f;
+VGfloat maxStdDeviation = -1.0f;
+
+// Width of the box which, applied kPasses times, has the variance of a
+// Gaussian with the given standard deviation. A box of width w has a
+// variance of (w^2 - 1) / 12.
+VGfloat BoxWidth(VGfloat stdDeviation) {
+  return sqrtf(12.0f * stdDeviation * stdDeviation / kPasses + 1.0f);
+}
+
+// Integer box radii for each pass. Rounding a single width changes the
+// variance by up to a third at small deviations, so the first passes use
+// the odd width just below the ideal one and the rest the one just above,
+// split to match the variance.
+void BoxRadii(VGfloat stdDeviation, int radii[kPasses]) {
+  int lower = (int) BoxWidth(stdDeviation);
+  if (lower % 2 == 0) {
+    lower--;
+  }
+  if (lower < 1) {
+    lower = 1;
+  }
+  VGfloat variance = 12.0f * stdDeviation * stdDeviation;
+  int narrow = (int) floorf((variance - kPasses * lower * lower
+                             - 4 * kPasses * lower - 3 * kPasses) /
+                            (-4.0f * lower - 4.0f) + 0.5f);
+  for (int i = 0; i < kPasses; i++) {
+    radii[i] = (i < narrow ? lower : lower + 2) / 2;
+  }
+}
+
+VGint Stride(VGint width) {
+  return (width * 4 + 15) & ~15;
+}
+
+void *Allocate(size_t size) {
+  void *data = NULL;
+  return posix_memalign(&data, 16, size) == 0 ? data : NULL;
+}
+
+bool BlurCPU(VGImage dst, VGImage src,
+             VGfloat stdDeviationX, VGfloat stdDeviationY,
+             VGTilingMode tilingMode) {
+  VGint width = vgGetParameteri(src, VG_IMAGE_WIDTH);
+  VGint height = vgGetParameteri(src, VG_IMAGE_HEIGHT);
+  if (width <= 0 || height <= 0) {
+    return false;
+  }
+
+  VGfloat narrowest = stdDeviationX < stdDeviationY ? stdDeviationX : stdDeviationY;
+  int factor = 1;
+  while (factor < kMaxDownsample &&
+         narrowest / (2 * factor) >= kMinScaledStdDeviation &&
+         width >= 2 * factor && height >= 2 * factor) {
+    factor *= 2;
+  }
+
+  // Full size image plus two buffers to halve it back and forth
+  VGint stride = Stride(width);
+  uint8_t *full = (uint8_t*) Allocate((size_t) stride * height);
+  uint8_t *buffers[2] = {
+    (uint8_t*) Allocate((size_t) Stride(width / 2) * (height / 2) + 16),
+    (uint8_t*) Allocate((size_t) Stride(width / 4) * (height / 4) + 16)
+  };
+  if (full == NULL || buffers[0] == NULL || buffers[1] == NULL) {
+    free(full);
+    free(buffers[0]);
+    free(buffers[1]);
+    return false;
+  }
+
+  vgGetImageSubData(src, full, stride, kWorkFormat, 0, 0, width, height);
+
+  uint8_t *small = full;
+  VGint smallStride = stride, smallWidth = width, smallHeight = height;
+  for (int level = 0; (1 << level) < factor; level++) {
+    uint8_t *next = buffers[level % 2];
+    VGint nextWidth = smallWidth / 2, nextHeight = smallHeight / 2;
+    pixels::Downsample2x(next, Stride(nextWidth), small, smallStride,
+                         nextWidth, nextHeight);
+    small = next;
+    smallWidth = nextWidth;
+    smallHeight = nextHeight;
+    smallStride = Stride(nextWidth);
+  }
+
+  VGfloat fillColor[4];
+  vgGetfv(VG_TILE_FILL_COLOR, 4, fillColor);
+  VGubyte fill[4];
+  VGfloat alpha = fillColor[3] < 0 ? 0 : fillColor[3] > 1 ? 1 : fillColor[3];
+  for (int k = 0; k < 4; k++) {
+    VGfloat value = fillColor[k] < 0 ? 0 : fillColor[k] > 1 ? 1 : fillColor[k];
+    fill[k] = (VGubyte) ((k < 3 ? value * alpha : alpha) * 255 + 0.5f);
+  }
+
+  int radiiX[kPasses], radiiY[kPasses];
+  BoxRadii(stdDeviationX / factor, radiiX);
+  BoxRadii(stdDeviationY / factor, radiiY);
+  bool ok = true;
+  for (int i = 0; ok && i < kPasses; i++) {
+    ok = pixels::BoxBlur(small, smallStride, small, smallStride, 4,
+                         smallWidth, smallHeight, radiiX[i], radiiY[i],
+                         1, tilingMode, fill);
+  }
+  if (ok && small != full) {
+    ok = pixels::ResizeBilinear(full, stride, width, height,
+                                small, smallStride, smallWidth, smallHeight);
+  }
+
+  if (ok) {
+    VGint dstWidth = vgGetParameteri(dst, VG_IMAGE_WIDTH);
+    VGint dstHeight = vgGetParameteri(dst, VG_IMAGE_HEIGHT);
+    vgImageSubData(dst, full, stride, kWorkFormat, 0, 0,
+                   dstWidth < width ? dstWidth : width,
+                   dstHeight < height ? dstHeight : height);
+  }
+
+  free(full);
+  free(buffers[0]);
+  free(buffers[1]);
+  return ok;
+}
+
+}
+
+blur::path_t blur::GaussianBlur(VGImage dst, VGImage src,
+                                VGfloat stdDeviationX, VGfloat stdDeviationY,
+                                VGTilingMode tilingMode) {
+  reorder::Barrier();
+
+  if (maxStdDeviation <= 0.0f) {
+    maxStdDeviation = vgGetf(VG_MAX_GAUSSIAN_STD_DEVIATION);
+  }
+
+  VGfloat widest = stdDeviationX > stdDeviationY ? stdDeviationX : stdDeviationY;
+  if (widest <= threshold && widest <= maxStdDeviation) {
+    vgGaussianBlur(dst, src, stdDeviationX, stdDeviationY, tilingMode);
+    return kGaussian;
+  }
+
+  if (khr::NativeIterativeAverageBlur()) {
+    khr::IterativeAverageBlur(dst, src,
+                              BoxWidth(stdDeviationX),
+                              BoxWidth(stdDeviationY),
+                              kPasses, tilingMode);
+    return kAverageBlurKHR;
+  }
+
+  return BlurCPU(dst, src, stdDeviationX, stdDeviationY, tilingMode) ?
+         kBoxCPU : kFailed;
+}
+
+void blur::SetThreshold(VGfloat stdDeviation) {
+  threshold = stdDeviation;
+}
+
+
+extern void blur::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "fastGaussianBlur"    , blur::FastGaussianBlur);
+  NODE_SET_METHOD(target, "setFastBlurThreshold", blur::SetFastBlurThreshold);
+}
+
+V8_METHOD(blur::FastGaussianBlur) {
+  HandleScope scope;
+
+  CheckArgs5(fastGaussianBlur, dstVGImage, Number, srcVGImage, Number,
+             stdDeviationX, Number, stdDeviationY, Number,
+             tilingMode, Uint32);
+
+  static const char *names[] = { "gaussian", "averageBlurKHR", "boxCPU" };
+
+  path_t path = GaussianBlur(registry::Use((VGImage) args[0]->Uint32Value()),
+                             registry::Read((VGImage) args[1]->Uint32Value()),
+                             (VGfloat) args[2]->NumberValue(),
+                             (VGfloat) args[3]->NumberValue(),
+                             static_cast<VGTilingMode>(args[4]->Uint32Value()));
+  if (path == kFailed) {
+    V8_THROW(Exception::Error(String::New("fastGaussianBlur: out of memory")));
+  }
+
+  V8_RETURN(String::NewSymbol(names[path]));
+}
+
+V8_METHOD(blur::SetFastBlurThreshold) {
+  HandleScope scope;
+
+  CheckArgs1(setFastBlurThreshold, stdDeviation, Number);
+
+  SetThreshold((VGfloat) args[0]->NumberValue());
+
+  V8_RETURN(Undefined());
+}
@@ -0,0 +1,40 @@
+#ifndef NODE_OPENVG_IMAGE_BLUR_H_
+#define NODE_OPENVG_IMAGE_BLUR_H_
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// Gaussian blurs whose cost doesn't grow with the standard deviation. Up to
+// a threshold (and VG_MAX_GAUSSIAN_STD_DEVIATION) vgGaussianBlur is used as
+// is. Above it the blur is approximated by three box blur passes: through
+// vgIterativeAverageBlurKHR when the driver has it, otherwise on the CPU
+// over a downsampled copy of the image which is then scaled back up.
+namespace blur {
+
+enum path_t {
+  kGaussian,
+  kAverageBlurKHR,
+  kBoxCPU,
+  kFailed
+};
+
+path_t GaussianBlur(VGImage dst, VGImage src,
+                    VGfloat stdDeviationX, VGfloat stdDeviationY,
+                    VGTilingMode tilingMode);
+
+void SetThreshold(VGfloat stdDeviation);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(FastGaussianBlur);
+V8_FUNCTION_DECL(SetFastBlurThreshold);
+
+}
+
+#endif
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#include <png.h>
+#include <jpeglib.h>
+
+#include "image_decode.h"
+#include "pixel_convert.h"
+
+namespace {
+
+void *AllocatePixels(VGint width, VGint height, VGint format, VGint *stride) {
+  // Rows aligned to 16 bytes, so the SIMD paths get aligned loads
+  *stride = (width * pixels::BytesPerPixel(format) + 15) & ~15;
+
+  void *pixels = NULL;
+  if (posix_memalign(&pixels, 16, (size_t) *stride * height) != 0) {
+    return NULL;
+  }
+  return pixels;
+}
+
+struct png_reader_t {
+  const unsigned char *data;
+  size_t length;
+  size_t offset;
+};
+
+void PngError(png_structp png, png_const_charp message) {
+  std::string *error = (std::string*) png_get_error_ptr(png);
+  *error = message;
+  png_longjmp(png, 1);
+}
+
+void PngWarning(png_structp png, png_const_charp message) {
+}
+
+void ReadPngData(png_structp png, png_bytep out, png_size_t count) {
+  png_reader_t *reader = (png_reader_t*) png_get_io_ptr(png);
+  if (reader->length - reader->offset < count) {
+    png_error(png, "Truncated PNG data");
+  }
+  memcpy(out, reader->data + reader->offset, count);
+  reader->offset += count;
+}
+
+bool DecodePng(const unsigned char *data, size_t length, VGint format,
+               decode::image_t *image, std::string *error) {
+  png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                                           error, PngError, PngWarning);
+  if (png == NULL) {
+    *error = "Out of memory";
+    return false;
+  }
+
+  png_infop info = png_create_info_struct(png);
+  png_reader_t reader = { data, length, 0 };
+
+  // Touched after a longjmp, so kept out of registers
+  png_bytep * volatile rows = NULL;
+  void * volatile pixels = NULL;
+
+  if (info == NULL || setjmp(png_jmpbuf(png))) {
+    png_destroy_read_struct(&png, info ? &info : NULL, NULL);
+    free(rows);
+    free(pixels);
+    if (error->empty()) {
+      *error = "Invalid PNG data";
+    }
+    return false;
+  }
+
+  png_set_read_fn(png, &reader, ReadPngData);
+  png_read_info(png, info);
+
+  // Normalize everything to 8 bit RGBA
+  png_set_expand(png);
+  png_set_strip_16(png);
+  png_set_gray_to_rgb(png);
+  png_set_add_alpha(png, 0xff, PNG_FILLER_AFTER);
+  png_set_interlace_handling(png);
+  png_read_update_info(png, info);
+
+  VGint width = (VGint) png_get_image_width(png, info);
+  VGint height = (VGint) png_get_image_height(png, info);
+
+  // Decoded as RGBA, then converted in place (no target is wider)
+  VGint stride;
+  pixels = AllocatePixels(width, height, pixels::kRGBA_8888, &stride);
+  rows = (png_bytep*) malloc(sizeof(png_bytep) * height);
+  if (pixels == NULL || rows == NULL) {
+    png_error(png, "Out of memory");
+  }
+
+  for (VGint y = 0; y < height; y++) {
+    rows[y] = (png_bytep) pixels + (size_t) y * stride;
+  }
+
+  png_read_image(png, rows);
+  png_read_end(png, NULL);
+  png_destroy_read_struct(&png, &info, NULL);
+  free(rows);
+
+  pixels::Convert(pixels, stride, format,
+                  pixels, stride, pixels::kRGBA_8888,
+                  width, height);
+
+  image->pixels = pixels;
+  image->stride = stride;
+  image->width = width;
+  image->height = height;
+  image->format = format;
+  return true;
+}
+
+struct jpeg_error_t {
+  struct jpeg_error_mgr manager;
+  jmp_buf jump;
+  char message[JMSG_LENGTH_MAX];
+};
+
+void JpegErrorExit(j_common_ptr cinfo) {
+  jpeg_error_t *error = (jpeg_error_t*) cinfo->err;
+  (*cinfo->err->format_message)(cinfo, error->message);
+  longjmp(error->jump, 1);
+}
+
+bool DecodeJpeg(const unsigned char *data, size_t length, VGint format,
+                decode::image_t *image, std::string *error) {
+  struct jpeg_decompress_struct cinfo;
+  jpeg_error_t jerr;
+
+  void * volatile pixels = NULL;
+  JSAMPLE * volatile row = NULL;
+
+  cinfo.err = jpeg_std_error(&jerr.manager);
+  jerr.manager.error_exit = JpegErrorExit;
+
+  if (setjmp(jerr.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    free(row);
+    free(pixels);
+    *error = jerr.message;
+    return false;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, (unsigned char*) data, length);
+  jpeg_read_header(&cinfo, TRUE);
+
+  cinfo.out_color_space = JCS_RGB;
+  jpeg_start_decompress(&cinfo);
+
+  VGint width = (VGint) cinfo.output_width;
+  VGint height = (VGint) cinfo.output_height;
+
+  VGint stride;
+  pixels = AllocatePixels(width, height, format, &stride);
+  row = (JSAMPLE*) malloc((size_t) width * 3);
+  if (pixels == NULL || row == NULL) {
+    strcpy(jerr.message, "Out of memory");
+    longjmp(jerr.jump, 1);
+  }
+
+  // Scanlines are converted as they come out of the decoder, so there is
+  // never a full RGB copy of the image.
+  while (cinfo.output_scanline < cinfo.output_height) {
+    VGint y = (VGint) cinfo.output_scanline;
+    JSAMPROW rows[1] = { row };
+    jpeg_read_scanlines(&cinfo, rows, 1);
+    pixels::Convert((unsigned char*) pixels + (size_t) y * stride, stride, format,
+                    row, width * 3, pixels::kRGB_888,
+                    width, 1);
+  }
+
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  free(row);
+
+  image->pixels = pixels;
+  image->stride = stride;
+  image->width = width;
+  image->height = height;
+  image->format = format;
+  return true;
+}
+
+}
+
+bool decode::ReadFile(const char *path, std::vector<unsigned char> *data,
+                      std::string *error) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    *error = std::string("Can't open ") + path;
+    return false;
+  }
+
+  unsigned char chunk[64 * 1024];
+  size_t count;
+  while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    data->insert(data->end(), chunk, chunk + count);
+  }
+
+  bool ok = !ferror(file);
+  fclose(file);
+
+  if (!ok) {
+    *error = std::string("Can't read ") + path;
+  }
+  return ok;
+}
+
+bool decode::Decode(const unsigned char *data, size_t length, VGint format,
+                    image_t *image, std::string *error) {
+  if (!pixels::IsSupported(format) || format >= pixels::kRGB_888) {
+    *error = "Unsupported image format";
+    return false;
+  }
+
+  if (length >= 8 && png_sig_cmp((png_bytep) data, 0, 8) == 0) {
+    return DecodePng(data, length, format, image, error);
+  }
+
+  if (length >= 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff) {
+    return DecodeJpeg(data, length, format, image, error);
+  }
+
+  *error = "Unknown image type (expected PNG or JPEG)";
+  return false;
+}
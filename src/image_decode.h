@@ -0,0 +1,33 @@
+#ifndef NODE_OPENVG_IMAGE_DECODE_H_
+#define NODE_OPENVG_IMAGE_DECODE_H_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "VG/openvg.h"
+
+// PNG/JPEG decoding into VGImage ready pixel data. Nothing in here touches
+// V8 or OpenVG, so it can run on the libuv threadpool.
+namespace decode {
+
+struct image_t {
+  void *pixels;  // 16 byte aligned, release with free()
+  VGint stride;
+  VGint width;
+  VGint height;
+  VGint format;
+};
+
+bool ReadFile(const char *path, std::vector<unsigned char> *data,
+              std::string *error);
+
+// Decodes a PNG or JPEG held in memory straight into `format`, which must be
+// supported by pixels::Convert.
+bool Decode(const unsigned char *data, size_t length, VGint format,
+            image_t *image, std::string *error);
+
+}
+
+#endif
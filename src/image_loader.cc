@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "VG/openvg.h"
+
+#include <v8.h>
+#include <node.h>
+#include <node_buffer.h>
+#include <uv.h>
+
+#include "image_loader.h"
+#include "image_decode.h"
+#include "image_registry.h"
+
+using namespace v8;
+using namespace node;
+
+// Images are read and decoded on the libuv threadpool, straight into the
+// requested VGImageFormat. Only vgCreateImage and vgImageSubData run on the
+// main (rendering) thread, when the work completes.
+
+namespace {
+
+struct load_request_t {
+  uv_work_t work;
+
+  // Either a path, read on the threadpool, or the contents of a Buffer that
+  // is kept alive until the request completes.
+  std::string path;
+  Persistent<Object> buffer;
+  const unsigned char *data;
+  size_t length;
+
+  VGint format;
+  VGbitfield allowedQuality;
+
+  decode::image_t image;
+  std::string error;
+
+  Persistent<Function> callback;
+};
+
+void DecodeWork(uv_work_t *work) {
+  load_request_t *request = (load_request_t*) work->data;
+
+  const unsigned char *data = request->data;
+  size_t length = request->length;
+  std::vector<unsigned char> file;
+
+  if (!request->path.empty()) {
+    if (!decode::ReadFile(request->path.c_str(), &file, &request->error)) {
+      return;
+    }
+    data = file.empty() ? NULL : &file[0];
+    length = file.size();
+  }
+
+  decode::Decode(data, length, request->format,
+                 &request->image, &request->error);
+}
+
+#if UV_VERSION_MAJOR == 0 && UV_VERSION_MINOR < 9
+void UploadAfterWork(uv_work_t *work) {
+#else
+void UploadAfterWork(uv_work_t *work, int status) {
+#endif
+  HandleScope scope;
+
+  load_request_t *request = (load_request_t*) work->data;
+  decode::image_t &decoded = request->image;
+
+  VGImage image = VG_INVALID_HANDLE;
+
+  if (request->error.empty()) {
+    image = registry::Create(static_cast<VGImageFormat>(decoded.format),
+                             decoded.width, decoded.height,
+                             request->allowedQuality);
+    if (image == VG_INVALID_HANDLE) {
+      char buffer[100];
+      snprintf(&buffer[0], sizeof(buffer),
+               "vgCreateImage failed: 0x%04x", vgGetError());
+      request->error = buffer;
+    } else {
+      vgImageSubData(registry::Use(image), decoded.pixels, decoded.stride,
+                     static_cast<VGImageFormat>(decoded.format),
+                     0, 0, decoded.width, decoded.height);
+      // Images loaded from files can be evicted and reloaded
+      if (!request->path.empty()) {
+        registry::SetSource(image, request->path);
+      }
+    }
+  }
+
+  free(decoded.pixels);
+
+  Handle<Value> argv[4];
+  int argc;
+
+  if (!request->error.empty()) {
+    argv[0] = Exception::Error(String::New(request->error.c_str()));
+    argc = 1;
+  } else {
+    argv[0] = Null();
+    argv[1] = Uint32::New(image);
+    argv[2] = Integer::New(decoded.width);
+    argv[3] = Integer::New(decoded.height);
+    argc = 4;
+  }
+
+  Local<Function> callback = V8PersistentLocal(request->callback);
+  V8PersistentDispose(request->callback);
+  if (!request->buffer.IsEmpty()) {
+    V8PersistentDispose(request->buffer);
+  }
+  delete request;
+
+  TryCatch tryCatch;
+  callback->Call(Context::GetCurrent()->Global(), argc, argv);
+  if (tryCatch.HasCaught()) {
+    FatalException(tryCatch);
+  }
+}
+
+}
+
+extern void loader::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "loadImageAsync", loader::LoadImageAsync);
+}
+
+V8_METHOD(loader::LoadImageAsync) {
+  HandleScope scope;
+
+  // Always checked: the source type decides how it's read
+  if (!(args.Length() == 4 &&
+        (args[0]->IsString() || Buffer::HasInstance(args[0])) &&
+        args[1]->IsUint32() && args[2]->IsUint32() &&
+        args[3]->IsFunction())) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected loadImageAsync(source,VGImageFormat,allowedQuality,callback)")));
+  }
+
+  load_request_t *request = new load_request_t();
+  request->work.data = request;
+  request->data = NULL;
+  request->length = 0;
+  request->image.pixels = NULL;
+
+  if (args[0]->IsString()) {
+    String::Utf8Value path(args[0]);
+    request->path = *path;
+  } else {
+    Local<Object> buffer = args[0]->ToObject();
+    V8PersistentReset(request->buffer, buffer);
+    request->data = (const unsigned char*) Buffer::Data(buffer);
+    request->length = Buffer::Length(buffer);
+  }
+
+  request->format = (VGint) args[1]->Uint32Value();
+  request->allowedQuality = (VGbitfield) args[2]->Uint32Value();
+  V8PersistentReset(request->callback, Local<Function>::Cast(args[3]));
+
+  uv_queue_work(uv_default_loop(), &request->work, DecodeWork, UploadAfterWork);
+
+  V8_RETURN(Undefined());
+}
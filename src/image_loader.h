@@ -0,0 +1,19 @@
+#ifndef NODE_OPENVG_IMAGE_LOADER_H_
+#define NODE_OPENVG_IMAGE_LOADER_H_
+
+#include <v8.h>
+#include <node.h>
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+namespace loader {
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(LoadImageAsync);
+
+}
+
+#endif
@@ -0,0 +1,152 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "image_pyramid.h"
+#include "image_registry.h"
+#include "pixel_convert.h"
+#include "pixel_filter.h"
+#include "state_cache.h"
+
+namespace {
+
+// Levels smaller than this aren't worth their own draw
+const VGint kMinLevelSize = 4;
+
+// Box filtering is only correct on premultiplied data
+const VGImageFormat kWorkFormat = (VGImageFormat) pixels::kRGBA_8888_PRE;
+
+VGint Half(VGint size) {
+  return size / 2;
+}
+
+VGint Stride(VGint width) {
+  return (width * 4 + 15) & ~15;
+}
+
+}
+
+bool pyramid::Build(VGImage image, VGImageFormat format,
+                    VGint width, VGint height,
+                    VGbitfield allowedQuality, pyramid_t *out) {
+  out->atlas = VG_INVALID_HANDLE;
+  out->bytes = 0;
+  out->levels.clear();
+
+  // Levels are laid out left to right, so the atlas is a bit less than the
+  // original width and half its height.
+  VGint atlasWidth = 0;
+  for (VGint w = Half(width), h = Half(height);
+       w >= kMinLevelSize && h >= kMinLevelSize;
+       w = Half(w), h = Half(h)) {
+    atlasWidth += w;
+  }
+  if (atlasWidth == 0) {
+    return false;
+  }
+
+  VGint srcStride = Stride(width);
+  VGint dstStride = Stride(Half(width));
+  void *src = NULL, *dst = NULL;
+  if (posix_memalign(&src, 16, (size_t) srcStride * height) != 0) {
+    return false;
+  }
+  if (posix_memalign(&dst, 16, (size_t) dstStride * Half(height)) != 0) {
+    free(src);
+    return false;
+  }
+
+  out->atlas = vgCreateImage(format, atlasWidth, Half(height), allowedQuality);
+  if (out->atlas == VG_INVALID_HANDLE) {
+    free(src);
+    free(dst);
+    return false;
+  }
+  out->bytes = registry::EstimateBytes(format, atlasWidth, Half(height));
+
+  vgGetImageSubData(image, src, srcStride, kWorkFormat, 0, 0, width, height);
+
+  VGint x = 0;
+  VGint w = width, h = height;
+  while (Half(w) >= kMinLevelSize && Half(h) >= kMinLevelSize) {
+    VGint stride = srcStride;
+    w = Half(w);
+    h = Half(h);
+
+    pixels::Downsample2x(dst, dstStride, src, stride, w, h);
+    vgImageSubData(out->atlas, dst, dstStride, kWorkFormat, x, 0, w, h);
+
+    level_t level = { vgChildImage(out->atlas, x, 0, w, h), w, h };
+    if (level.image == VG_INVALID_HANDLE) {
+      break;
+    }
+    out->levels.push_back(level);
+    x += w;
+
+    // The next level reads from this one
+    void *swap = src;
+    src = dst;
+    dst = swap;
+    srcStride = dstStride;
+  }
+
+  free(src);
+  free(dst);
+
+  if (out->levels.empty()) {
+    Destroy(out);
+    return false;
+  }
+  return true;
+}
+
+void pyramid::Destroy(pyramid_t *pyramid) {
+  for (size_t i = 0; i < pyramid->levels.size(); i++) {
+    vgDestroyImage(pyramid->levels[i].image);
+  }
+  if (pyramid->atlas != VG_INVALID_HANDLE) {
+    vgDestroyImage(pyramid->atlas);
+  }
+  pyramid->atlas = VG_INVALID_HANDLE;
+  pyramid->bytes = 0;
+  pyramid->levels.clear();
+}
+
+void pyramid::Draw(VGImage image, VGint width, VGint height,
+                   const pyramid_t &pyramid) {
+  VGint mode = state::MatrixMode();
+  if (mode != VG_MATRIX_IMAGE_USER_TO_SURFACE) {
+    state::SetI(VG_MATRIX_MODE, VG_MATRIX_IMAGE_USER_TO_SURFACE);
+  }
+
+  VGfloat matrix[9];
+  vgGetMatrix(matrix);
+
+  // Largest axis scale of the affine part. Projective matrices keep the full
+  // size image, the scale varies across it.
+  const level_t *level = NULL;
+  if (matrix[2] == 0.0f && matrix[5] == 0.0f && matrix[8] == 1.0f) {
+    VGfloat scale = sqrtf(matrix[0] * matrix[0] + matrix[1] * matrix[1]);
+    VGfloat scaleY = sqrtf(matrix[3] * matrix[3] + matrix[4] * matrix[4]);
+    if (scaleY > scale) {
+      scale = scaleY;
+    }
+
+    VGfloat levelScale = 0.5f;
+    for (size_t i = 0; i < pyramid.levels.size() && scale <= levelScale; i++) {
+      level = &pyramid.levels[i];
+      levelScale *= 0.5f;
+    }
+  }
+
+  if (level == NULL) {
+    vgDrawImage(image);
+  } else {
+    vgScale((VGfloat) width / level->width, (VGfloat) height / level->height);
+    vgDrawImage(level->image);
+    vgLoadMatrix(matrix);
+  }
+
+  if (mode != VG_MATRIX_IMAGE_USER_TO_SURFACE) {
+    state::SetI(VG_MATRIX_MODE, mode);
+  }
+}
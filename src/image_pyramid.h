@@ -0,0 +1,41 @@
+#ifndef NODE_OPENVG_IMAGE_PYRAMID_H_
+#define NODE_OPENVG_IMAGE_PYRAMID_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "VG/openvg.h"
+
+// Pre-scaled copies of an image (1/2, 1/4, ...), so drawing it at a small
+// scale samples a level close to the target size instead of skipping most of
+// the source pixels. All levels are child images of a single atlas image.
+namespace pyramid {
+
+struct level_t {
+  VGImage image;
+  VGint width;
+  VGint height;
+};
+
+struct pyramid_t {
+  VGImage atlas;
+  size_t bytes;
+  std::vector<level_t> levels;  // levels[0] is half size
+};
+
+// Builds the levels of `image` (the driver handle) by reading it back and
+// repeatedly halving it with a box filter. Returns false, leaving `out`
+// empty, if the image is too small or any allocation fails.
+bool Build(VGImage image, VGImageFormat format, VGint width, VGint height,
+           VGbitfield allowedQuality, pyramid_t *out);
+
+void Destroy(pyramid_t *pyramid);
+
+// vgDrawImage, through the level closest to (but not smaller than) the size
+// `image` is drawn at by the current image-user-to-surface matrix.
+void Draw(VGImage image, VGint width, VGint height, const pyramid_t &pyramid);
+
+}
+
+#endif
@@ -0,0 +1,501 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "VG/openvg.h"
+
+#include "image_registry.h"
+#include "image_decode.h"
+#include "image_pyramid.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+struct entry_t {
+  VGImage image;  // Driver handle, VG_INVALID_HANDLE while evicted
+  VGImageFormat format;
+  VGint width;
+  VGint height;
+  VGbitfield allowedQuality;
+  size_t bytes;
+
+  uint32_t lastUse;
+  std::string source;
+
+  VGImage parent;  // Key of the parent for child images
+  int children;
+
+  bool wantsPyramid;
+  bool pyramidStale;  // Written to since the levels were built
+  pyramid::pyramid_t pyramid;
+};
+
+typedef std::map<VGImage, entry_t> entries_t;
+
+entries_t entries;
+std::map<VGImage, VGImage> keys;  // Driver handle -> key
+std::set<VGHandle> others;  // Non-image handles JS holds that are also keys
+
+uint32_t useClock = 0;
+VGImage nextSyntheticKey = 0xffffffff;
+
+size_t budget = 0;  // 0 means unlimited
+size_t used = 0;
+registry::stats_t counters;
+
+VGint maxImagePixels = -1;
+VGint maxImageBytes = -1;
+
+void BuildPyramid(entry_t &entry) {
+  entry.pyramidStale = false;
+  if (pyramid::Build(entry.image, entry.format, entry.width, entry.height,
+                     entry.allowedQuality, &entry.pyramid)) {
+    used += entry.pyramid.bytes;
+    if (used > counters.peakBytes) {
+      counters.peakBytes = used;
+    }
+  }
+}
+
+void DestroyPyramid(entry_t &entry) {
+  used -= entry.pyramid.bytes;
+  pyramid::Destroy(&entry.pyramid);
+}
+
+// Children share their parent's pixels, so writing to either changes both.
+void MarkStale(VGImage key, entry_t &entry) {
+  entry.pyramidStale = true;
+
+  if (entry.parent != VG_INVALID_HANDLE) {
+    entries_t::iterator parent = entries.find(entry.parent);
+    if (parent != entries.end()) {
+      parent->second.pyramidStale = true;
+    }
+  }
+  if (entry.children > 0) {
+    for (entries_t::iterator it = entries.begin(); it != entries.end(); ++it) {
+      if (it->second.parent == key) {
+        it->second.pyramidStale = true;
+      }
+    }
+  }
+}
+
+bool Evictable(const entry_t &entry) {
+  return entry.image != VG_INVALID_HANDLE && !entry.source.empty() &&
+         entry.parent == VG_INVALID_HANDLE && entry.children == 0;
+}
+
+void Evict(entry_t &entry) {
+  DestroyPyramid(entry);
+  vgDestroyImage(entry.image);
+  keys.erase(entry.image);
+  entry.image = VG_INVALID_HANDLE;
+  used -= entry.bytes;
+  counters.evictions++;
+}
+
+// Evicts least recently used images until `bytes` more fit in the budget,
+// or everything evictable is gone if `all` is set.
+void MakeRoom(size_t bytes, bool all) {
+  while (all || (budget != 0 && used + bytes > budget)) {
+    entry_t *victim = NULL;
+    for (entries_t::iterator it = entries.begin(); it != entries.end(); ++it) {
+      entry_t &entry = it->second;
+      if (Evictable(entry) &&
+          (victim == NULL ||
+           (int32_t) (entry.lastUse - victim->lastUse) < 0)) {
+        victim = &entry;
+      }
+    }
+    if (victim == NULL) {
+      return;
+    }
+    Evict(*victim);
+  }
+}
+
+bool WithinLimits(VGint width, VGint height, size_t bytes) {
+  if (maxImagePixels < 0) {
+    maxImagePixels = vgGeti(VG_MAX_IMAGE_PIXELS);
+    maxImageBytes = vgGeti(VG_MAX_IMAGE_BYTES);
+  }
+  return width > 0 && height > 0 &&
+         (double) width * height <= (double) maxImagePixels &&
+         bytes <= (size_t) maxImageBytes;
+}
+
+// vgCreateImage, making room for the image first and retrying once without
+// any evictable image if the driver runs out of memory.
+VGImage CreateDriverImage(VGImageFormat format, VGint width, VGint height,
+                          VGbitfield allowedQuality, size_t bytes) {
+  // Requests the driver will refuse anyway shouldn't cost any eviction
+  if (!WithinLimits(width, height, bytes)) {
+    return vgCreateImage(format, width, height, allowedQuality);
+  }
+
+  MakeRoom(bytes, false);
+
+  VGImage image = vgCreateImage(format, width, height, allowedQuality);
+  if (image == VG_INVALID_HANDLE && vgGetError() == VG_OUT_OF_MEMORY_ERROR) {
+    counters.outOfMemoryRetries++;
+    MakeRoom(bytes, true);
+    image = vgCreateImage(format, width, height, allowedQuality);
+  }
+  return image;
+}
+
+VGImage NewKey(VGImage image) {
+  if (entries.find(image) == entries.end()) {
+    return image;
+  }
+
+  // The driver reused the handle of an evicted image
+  while (entries.find(nextSyntheticKey) != entries.end() ||
+         keys.find(nextSyntheticKey) != keys.end()) {
+    nextSyntheticKey--;
+  }
+  return nextSyntheticKey--;
+}
+
+VGImage Register(VGImage image, VGImageFormat format,
+                 VGint width, VGint height, VGbitfield allowedQuality,
+                 size_t bytes, VGImage parent) {
+  VGImage key = NewKey(image);
+
+  entry_t &entry = entries[key];
+  entry.image = image;
+  entry.format = format;
+  entry.width = width;
+  entry.height = height;
+  entry.allowedQuality = allowedQuality;
+  entry.bytes = bytes;
+  entry.lastUse = ++useClock;
+  entry.parent = parent;
+  entry.children = 0;
+  entry.wantsPyramid = false;
+  entry.pyramidStale = false;
+  entry.pyramid.atlas = VG_INVALID_HANDLE;
+  entry.pyramid.bytes = 0;
+
+  keys[image] = key;
+  used += bytes;
+  if (used > counters.peakBytes) {
+    counters.peakBytes = used;
+  }
+
+  return key;
+}
+
+bool Reload(entry_t &entry) {
+  std::vector<unsigned char> data;
+  std::string error;
+  decode::image_t decoded;
+
+  if (!decode::ReadFile(entry.source.c_str(), &data, &error) ||
+      !decode::Decode(data.empty() ? NULL : &data[0], data.size(),
+                      entry.format, &decoded, &error)) {
+    return false;
+  }
+
+  VGImage image = CreateDriverImage(entry.format, decoded.width,
+                                    decoded.height, entry.allowedQuality,
+                                    entry.bytes);
+  if (image != VG_INVALID_HANDLE) {
+    vgImageSubData(image, decoded.pixels, decoded.stride, entry.format,
+                   0, 0, decoded.width, decoded.height);
+  }
+  free(decoded.pixels);
+
+  if (image == VG_INVALID_HANDLE) {
+    return false;
+  }
+
+  entry.image = image;
+  used += entry.bytes;
+  if (used > counters.peakBytes) {
+    counters.peakBytes = used;
+  }
+  counters.reloads++;
+
+  if (entry.wantsPyramid) {
+    BuildPyramid(entry);
+  }
+  return true;
+}
+
+}
+
+size_t registry::EstimateBytes(VGImageFormat format,
+                               VGint width, VGint height) {
+  size_t bits;
+  switch (format & 0x1f) {
+  case 3: case 4: case 5:      // 565, 5551, 4444
+    bits = 16;
+    break;
+  case 6: case 10: case 11:    // L_8, A_8
+    bits = 8;
+    break;
+  case 14:                     // A_4
+    bits = 4;
+    break;
+  case 12: case 13:            // BW_1, A_1
+    bits = 1;
+    break;
+  default:
+    bits = 32;
+    break;
+  }
+  return ((size_t) width * bits + 7) / 8 * (size_t) height;
+}
+
+VGImage registry::Create(VGImageFormat format, VGint width, VGint height,
+                         VGbitfield allowedQuality) {
+  size_t bytes = EstimateBytes(format, width, height);
+
+  VGImage image = CreateDriverImage(format, width, height,
+                                    allowedQuality, bytes);
+  if (image == VG_INVALID_HANDLE) {
+    return image;
+  }
+
+  return Register(image, format, width, height, allowedQuality,
+                  bytes, VG_INVALID_HANDLE);
+}
+
+VGImage registry::CreateChild(VGImage parent, VGint x, VGint y,
+                              VGint width, VGint height) {
+  VGImage image = vgChildImage(Use(parent), x, y, width, height);
+  if (image == VG_INVALID_HANDLE) {
+    return image;
+  }
+
+  entries_t::iterator it = entries.find(parent);
+  if (it == entries.end()) {
+    return image;
+  }
+  it->second.children++;
+
+  // Children share the parent's storage
+  return Register(image, it->second.format, width, height,
+                  it->second.allowedQuality, 0, parent);
+}
+
+void registry::Destroy(VGImage key) {
+  entries_t::iterator it = entries.find(key);
+  if (it == entries.end()) {
+    vgDestroyImage(key);
+    return;
+  }
+
+  entry_t &entry = it->second;
+  if (entry.image != VG_INVALID_HANDLE) {
+    DestroyPyramid(entry);
+    vgDestroyImage(entry.image);
+    keys.erase(entry.image);
+    used -= entry.bytes;
+  }
+
+  if (entry.parent != VG_INVALID_HANDLE) {
+    entries_t::iterator parent = entries.find(entry.parent);
+    if (parent != entries.end()) {
+      parent->second.children--;
+    }
+  }
+
+  entries.erase(it);
+}
+
+VGImage registry::Use(VGImage key) {
+  entries_t::iterator it = entries.find(key);
+  if (it == entries.end()) {
+    return key;
+  }
+
+  MarkStale(key, it->second);
+  return Read(key);
+}
+
+void registry::Written(VGImage key) {
+  entries_t::iterator it = entries.find(key);
+  if (it != entries.end()) {
+    MarkStale(key, it->second);
+  }
+}
+
+VGImage registry::Read(VGImage key) {
+  entries_t::iterator it = entries.find(key);
+  if (it == entries.end()) {
+    return key;
+  }
+
+  entry_t &entry = it->second;
+  entry.lastUse = ++useClock;
+
+  if (entry.image == VG_INVALID_HANDLE) {
+    // Synchronous: keep evictable images warm with loadImageAsync if the
+    // hitch matters.
+    if (!Reload(entry)) {
+      return VG_INVALID_HANDLE;
+    }
+    keys[entry.image] = key;
+  }
+
+  return entry.image;
+}
+
+bool registry::SetPyramid(VGImage key, bool enabled) {
+  entries_t::iterator it = entries.find(key);
+  if (it == entries.end()) {
+    return false;
+  }
+
+  entry_t &entry = it->second;
+  entry.wantsPyramid = enabled;
+  if (entry.image != VG_INVALID_HANDLE) {
+    DestroyPyramid(entry);
+    if (enabled) {
+      BuildPyramid(entry);
+    }
+  }
+  return !enabled || !entry.pyramid.levels.empty() ||
+         entry.image == VG_INVALID_HANDLE;
+}
+
+void registry::Draw(VGImage key) {
+  VGImage image = Read(key);
+  entries_t::iterator it = entries.find(key);
+  if (it == entries.end() || image == VG_INVALID_HANDLE) {
+    vgDrawImage(image);
+    return;
+  }
+
+  entry_t &entry = it->second;
+  if (entry.wantsPyramid && entry.pyramidStale) {
+    DestroyPyramid(entry);
+    BuildPyramid(entry);
+  }
+  if (entry.pyramid.levels.empty()) {
+    vgDrawImage(image);
+    return;
+  }
+  pyramid::Draw(image, entry.width, entry.height, entry.pyramid);
+}
+
+VGImage registry::KeyOf(VGImage image) {
+  std::map<VGImage, VGImage>::iterator it = keys.find(image);
+  return it == keys.end() ? image : it->second;
+}
+
+VGHandle registry::ReadHandle(VGHandle handle) {
+  if (others.find(handle) != others.end()) {
+    return handle;
+  }
+  return Read((VGImage) handle);
+}
+
+void registry::Created(VGHandle handle) {
+  if (entries.find((VGImage) handle) != entries.end()) {
+    others.insert(handle);
+  }
+}
+
+void registry::Destroyed(VGHandle handle) {
+  others.erase(handle);
+}
+
+void registry::SetSource(VGImage key, const std::string &path) {
+  entries_t::iterator it = entries.find(key);
+  if (it != entries.end()) {
+    it->second.source = path;
+  }
+}
+
+void registry::SetBudget(size_t bytes) {
+  budget = bytes;
+  MakeRoom(0, false);
+}
+
+void registry::GetStats(stats_t *stats) {
+  *stats = counters;
+  stats->images = entries.size();
+  stats->bytes = used;
+  stats->budget = budget;
+  stats->evictable = 0;
+  stats->evicted = 0;
+
+  for (entries_t::iterator it = entries.begin(); it != entries.end(); ++it) {
+    if (it->second.image == VG_INVALID_HANDLE) {
+      stats->evicted++;
+    } else if (Evictable(it->second)) {
+      stats->evictable++;
+    }
+  }
+}
+
+
+extern void registry::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "setImageBudget", registry::SetImageBudget);
+  NODE_SET_METHOD(target, "setImageSource", registry::SetImageSource);
+  NODE_SET_METHOD(target, "getImageStats" , registry::GetImageStats);
+  NODE_SET_METHOD(target, "setImagePyramid", registry::SetImagePyramid);
+}
+
+V8_METHOD(registry::SetImageBudget) {
+  HandleScope scope;
+
+  CheckArgs1(setImageBudget, bytes, Number);
+
+  SetBudget((size_t) args[0]->NumberValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(registry::SetImageSource) {
+  HandleScope scope;
+
+  CheckArgs2(setImageSource, VGImage, Number, path, String);
+
+  String::Utf8Value path(args[1]);
+  SetSource((VGImage) args[0]->Uint32Value(), *path);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(registry::GetImageStats) {
+  HandleScope scope;
+
+  CheckArgs1(getImageStats, stats, Object);
+
+  stats_t stats;
+  GetStats(&stats);
+
+  Local<Object> result = args[0].As<Object>();
+  result->Set(String::NewSymbol("images"), Number::New(stats.images));
+  result->Set(String::NewSymbol("bytes"), Number::New(stats.bytes));
+  result->Set(String::NewSymbol("peakBytes"), Number::New(stats.peakBytes));
+  result->Set(String::NewSymbol("budget"), Number::New(stats.budget));
+  result->Set(String::NewSymbol("evictable"), Number::New(stats.evictable));
+  result->Set(String::NewSymbol("evicted"), Number::New(stats.evicted));
+  result->Set(String::NewSymbol("evictions"), Number::New(stats.evictions));
+  result->Set(String::NewSymbol("reloads"), Number::New(stats.reloads));
+  result->Set(String::NewSymbol("outOfMemoryRetries"),
+              Number::New(stats.outOfMemoryRetries));
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(registry::SetImagePyramid) {
+  HandleScope scope;
+
+  CheckArgs2(setImagePyramid, VGImage, Number, enabled, Boolean);
+
+  V8_RETURN(Boolean::New(SetPyramid((VGImage) args[0]->Uint32Value(),
+                                    args[1]->BooleanValue())));
+}
@@ -0,0 +1,93 @@
+#ifndef NODE_OPENVG_IMAGE_REGISTRY_H_
+#define NODE_OPENVG_IMAGE_REGISTRY_H_
+
+#include <stddef.h>
+
+#include <string>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// Tracks every VGImage created through the bindings, with its estimated size.
+// Images that have a reload source (a PNG/JPEG path) may be evicted when the
+// configured budget is exceeded, least recently used first, and are reloaded
+// transparently the next time they are used.
+//
+// Because a reloaded image gets a new handle from the driver, the handles
+// given to JS are registry keys. They are the driver handles unless that
+// would clash with an evicted image's key, so bindings taking a VGImage must
+// go through Use(), or Read() if they only read it, and bindings returning
+// one through KeyOf().
+namespace registry {
+
+struct stats_t {
+  size_t images;
+  size_t bytes;
+  size_t peakBytes;
+  size_t budget;
+  size_t evictable;
+  size_t evicted;
+  size_t evictions;
+  size_t reloads;
+  size_t outOfMemoryRetries;
+};
+
+VGImage Create(VGImageFormat format, VGint width, VGint height,
+               VGbitfield allowedQuality);
+VGImage CreateChild(VGImage parent, VGint x, VGint y,
+                    VGint width, VGint height);
+void Destroy(VGImage image);
+
+// Returns the driver handle for a key, reloading it if it was evicted, and
+// marks it as recently used. Unknown handles are returned unchanged. The
+// image may be written to: its pyramid is rebuilt before it's next drawn.
+VGImage Use(VGImage image);
+
+// Use() for callers only reading the image, keeping its pyramid.
+VGImage Read(VGImage image);
+
+// For writes made later than Use(), such as rendering to a surface created
+// from the image.
+void Written(VGImage image);
+
+// Opt-in pre-scaled levels (see image_pyramid.h), rebuilt after a reload or
+// when drawn after a write. Returns false if they couldn't be built.
+bool SetPyramid(VGImage image, bool enabled);
+
+// vgDrawImage through Read(), picking a pyramid level if the image has one.
+void Draw(VGImage image);
+
+// Driver handle to key.
+VGImage KeyOf(VGImage image);
+
+// Read() for bindings taking any kind of handle, such as the parameter
+// functions and vgMask. An evicted image's key the driver has since given to
+// a path, paint, font or mask layer made through the bindings is that object.
+VGHandle ReadHandle(VGHandle handle);
+
+// Record the paths, paints, fonts and mask layers JS holds, for ReadHandle().
+void Created(VGHandle handle);
+void Destroyed(VGHandle handle);
+
+void SetSource(VGImage image, const std::string &path);
+void SetBudget(size_t bytes);
+void GetStats(stats_t *stats);
+
+size_t EstimateBytes(VGImageFormat format, VGint width, VGint height);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(SetImageBudget);
+V8_FUNCTION_DECL(SetImageSource);
+V8_FUNCTION_DECL(GetImageStats);
+V8_FUNCTION_DECL(SetImagePyramid);
+
+}
+
+#endif
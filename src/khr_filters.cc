@@ -0,0 +1,522 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "VG/openvg.h"
+#include "VG/vgu.h"
+#include "VG/vgext.h"
+
+#include "khr_filters.h"
+#include "pixel_convert.h"
+#include "pixel_filter.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+// VGPfTypeKHR, which older vgext.h headers lack
+const VGbitfield kObjectVisible = 1 << 0;
+const VGbitfield kKnockout      = 1 << 1;
+const VGbitfield kOuter         = 1 << 2;
+const VGbitfield kInner         = 1 << 3;
+
+const VGImageFormat kWorkFormat = (VGImageFormat) pixels::kRGBA_8888_PRE;
+
+bool probed = false;
+bool hasIterativeAverageBlur = false;
+bool hasParametricFilter = false;
+bool forceCPU = false;
+
+bool HasExtension(const char *extensions, const char *name) {
+  size_t length = strlen(name);
+  for (const char *p = strstr(extensions, name); p != NULL;
+       p = strstr(p + length, name)) {
+    if ((p == extensions || p[-1] == ' ') &&
+        (p[length] == ' ' || p[length] == '\0')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Probe() {
+  if (probed) {
+    return;
+  }
+
+  // NULL until there's a context, try again later
+  const char *extensions = (const char*) vgGetString(VG_EXTENSIONS);
+  if (extensions == NULL) {
+    return;
+  }
+
+  probed = true;
+  hasIterativeAverageBlur =
+    HasExtension(extensions, "VG_KHR_iterative_average_blur");
+  hasParametricFilter =
+    HasExtension(extensions, "VG_KHR_parametric_filter");
+}
+
+#ifdef VG_VGEXT_PROTOTYPES
+bool NativeBlur() {
+  return !forceCPU && khr::HasIterativeAverageBlur();
+}
+
+bool NativeParametric() {
+  return !forceCPU && khr::HasParametricFilter();
+}
+#endif
+
+
+/* CPU path */
+
+struct image_data_t {
+  uint8_t *pixels;  // kWorkFormat, tightly packed
+  VGint width;
+  VGint height;
+};
+
+VGUErrorCode Fetch(VGImage image, image_data_t *data) {
+  data->pixels = NULL;
+  data->width = vgGetParameteri(image, VG_IMAGE_WIDTH);
+  data->height = vgGetParameteri(image, VG_IMAGE_HEIGHT);
+  if (data->width <= 0 || data->height <= 0) {
+    return VGU_BAD_HANDLE_ERROR;
+  }
+
+  data->pixels = (uint8_t*) malloc((size_t) data->width * data->height * 4);
+  if (data->pixels == NULL) {
+    return VGU_OUT_OF_MEMORY_ERROR;
+  }
+
+  vgGetImageSubData(image, data->pixels, data->width * 4, kWorkFormat,
+                    0, 0, data->width, data->height);
+  return VGU_NO_ERROR;
+}
+
+// Like the native filters, only the area both images cover is written.
+void Store(VGImage image, const image_data_t &data) {
+  VGint width = vgGetParameteri(image, VG_IMAGE_WIDTH);
+  VGint height = vgGetParameteri(image, VG_IMAGE_HEIGHT);
+  vgImageSubData(image, data.pixels, data.width * 4, kWorkFormat, 0, 0,
+                 width < data.width ? width : data.width,
+                 height < data.height ? height : data.height);
+}
+
+int Radius(VGfloat dimension) {
+  return dimension < 1.0f ? 0 : (int) (dimension / 2);
+}
+
+inline float Clamp(float value) {
+  return value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+}
+
+struct color_t {
+  float c[4];  // Premultiplied, 0..1
+};
+
+color_t Premultiply(float r, float g, float b, float a) {
+  a = Clamp(a);
+  color_t color = { { Clamp(r) * a, Clamp(g) * a, Clamp(b) * a, a } };
+  return color;
+}
+
+color_t ColorFromRGBA(VGuint rgba) {
+  return Premultiply(((rgba >> 24) & 0xff) / 255.0f,
+                     ((rgba >> 16) & 0xff) / 255.0f,
+                     ((rgba >>  8) & 0xff) / 255.0f,
+                     ( rgba        & 0xff) / 255.0f);
+}
+
+color_t ColorFromPaint(VGPaint paint) {
+  VGfloat rgba[4] = { 0, 0, 0, 0 };
+  if (paint != VG_INVALID_HANDLE) {
+    vgGetParameterfv(paint, VG_PAINT_COLOR, 4, rgba);
+  }
+  return Premultiply(rgba[0], rgba[1], rgba[2], rgba[3]);
+}
+
+// 256 premultiplied colors sampled from (offset, r, g, b, a) stops.
+void BuildRamp(VGuint count, const VGfloat *stops, color_t *ramp) {
+  for (int i = 0; i < 256; i++) {
+    float t = i / 255.0f;
+    const VGfloat *a = stops, *b = stops;
+    for (VGuint s = 0; s < count; s++) {
+      b = stops + 5 * s;
+      if (b[0] >= t) {
+        break;
+      }
+      a = b;
+    }
+    float f = b[0] > a[0] ? (t - a[0]) / (b[0] - a[0]) : 0.0f;
+    f = Clamp(f);
+    ramp[i] = Premultiply(a[1] + (b[1] - a[1]) * f, a[2] + (b[2] - a[2]) * f,
+                          a[3] + (b[3] - a[3]) * f, a[4] + (b[4] - a[4]) * f);
+  }
+}
+
+struct effect_t {
+  VGfloat strength;
+  int offsetX;
+  int offsetY;
+  VGbitfield flags;
+  bool bevel;            // Highlight and shadow from the alpha gradient
+  color_t highlight;
+  color_t shadow;
+  const color_t *ramp;   // Gradient variants: 256 entries
+};
+
+inline float SampleMask(const uint8_t *mask, VGint width, VGint height,
+                        VGint x, VGint y) {
+  if (x < 0 || y < 0 || x >= width || y >= height) {
+    return 0.0f;
+  }
+  return mask[(size_t) y * width + x] * (1.0f / 255);
+}
+
+// Renders the effect driven by `mask` (the blurred source alpha, one byte a
+// pixel) into `pixels`, which holds the source image.
+void Composite(uint8_t *pixels, const uint8_t *mask,
+               VGint width, VGint height, const effect_t &effect) {
+  for (VGint y = 0; y < height; y++) {
+    uint8_t *row = pixels + (size_t) y * width * 4;
+    for (VGint x = 0; x < width; x++) {
+      uint8_t *pixel = row + 4 * x;
+      float a1 = SampleMask(mask, width, height,
+                            x - effect.offsetX, y - effect.offsetY);
+      float a2 = SampleMask(mask, width, height,
+                            x + effect.offsetX, y + effect.offsetY);
+      if (effect.flags & kInner) {
+        a1 = 1.0f - a1;
+        a2 = 1.0f - a2;
+      }
+
+      float e[4];
+      if (effect.bevel) {
+        float d = effect.strength * (a2 - a1);
+        if (effect.ramp != NULL) {
+          const color_t &c = effect.ramp[(int) (Clamp(0.5f + 0.5f * d) * 255 + 0.5f)];
+          for (int k = 0; k < 4; k++) e[k] = c.c[k];
+        } else {
+          float lit = Clamp(d), shaded = Clamp(-d);
+          for (int k = 0; k < 4; k++) {
+            e[k] = Clamp(effect.highlight.c[k] * lit + effect.shadow.c[k] * shaded);
+          }
+        }
+      } else {
+        float m = Clamp(effect.strength * a1);
+        if (effect.ramp != NULL) {
+          const color_t &c = effect.ramp[(int) (m * 255 + 0.5f)];
+          for (int k = 0; k < 4; k++) e[k] = c.c[k];
+        } else {
+          for (int k = 0; k < 4; k++) e[k] = effect.shadow.c[k] * m;
+        }
+      }
+
+      float srcAlpha = pixel[3] * (1.0f / 255);
+      float coverage = 1.0f;
+      if (effect.flags & kOuter) coverage *= 1.0f - srcAlpha;
+      if (effect.flags & kInner) coverage *= srcAlpha;
+      if (effect.flags & kKnockout) coverage *= 1.0f - srcAlpha;
+
+      // Source over the effect, or the effect alone
+      float under = effect.flags & kObjectVisible ? 1.0f - srcAlpha : 1.0f;
+      for (int k = 0; k < 4; k++) {
+        float src = effect.flags & kObjectVisible ? pixel[k] * (1.0f / 255) : 0.0f;
+        pixel[k] = (uint8_t) (Clamp(src + e[k] * coverage * under) * 255 + 0.5f);
+      }
+    }
+  }
+}
+
+// Blurred alpha of `image`, as the vgu*KHR filters build it.
+uint8_t *BlurredAlpha(const image_data_t &image, VGfloat dimX, VGfloat dimY,
+                      VGuint iterative) {
+  size_t count = (size_t) image.width * image.height;
+  uint8_t *mask = (uint8_t*) malloc(count);
+  if (mask == NULL) {
+    return NULL;
+  }
+  for (size_t i = 0; i < count; i++) {
+    mask[i] = image.pixels[4 * i + 3];
+  }
+
+  if (!pixels::BoxBlur(mask, image.width, mask, image.width, 1,
+                       image.width, image.height, Radius(dimX), Radius(dimY),
+                       iterative > 0 ? iterative : 1, VG_TILE_FILL, NULL)) {
+    free(mask);
+    return NULL;
+  }
+  return mask;
+}
+
+VGUErrorCode ApplyEffect(VGImage dst, VGImage src,
+                         VGfloat dimX, VGfloat dimY, VGuint iterative,
+                         VGfloat distance, VGfloat angle, effect_t &effect) {
+  image_data_t image;
+  VGUErrorCode error = Fetch(src, &image);
+  if (error != VGU_NO_ERROR) {
+    return error;
+  }
+
+  uint8_t *mask = BlurredAlpha(image, dimX, dimY, iterative);
+  if (mask == NULL) {
+    free(image.pixels);
+    return VGU_OUT_OF_MEMORY_ERROR;
+  }
+
+  const float radians = angle * 3.14159265f / 180.0f;
+  effect.offsetX = (int) lroundf(distance * cosf(radians));
+  effect.offsetY = (int) lroundf(distance * sinf(radians));
+
+  Composite(image.pixels, mask, image.width, image.height, effect);
+  Store(dst, image);
+
+  free(mask);
+  free(image.pixels);
+  return VGU_NO_ERROR;
+}
+
+effect_t Effect(VGfloat strength, VGbitfield filterFlags, bool bevel) {
+  effect_t effect;
+  memset(&effect, 0, sizeof(effect));
+  effect.strength = strength;
+  effect.flags = filterFlags;
+  effect.bevel = bevel;
+  return effect;
+}
+
+}
+
+bool khr::HasIterativeAverageBlur() {
+  Probe();
+  return hasIterativeAverageBlur;
+}
+
+bool khr::HasParametricFilter() {
+  Probe();
+  return hasParametricFilter;
+}
+
+void khr::ForceCPU(bool force) {
+  forceCPU = force;
+}
+
+bool khr::NativeIterativeAverageBlur() {
+#ifdef VG_VGEXT_PROTOTYPES
+  return NativeBlur();
+#else
+  return false;
+#endif
+}
+
+void khr::IterativeAverageBlur(VGImage dst, VGImage src,
+                               VGfloat dimX, VGfloat dimY, VGuint iterative,
+                               VGTilingMode tilingMode) {
+#ifdef VG_VGEXT_PROTOTYPES
+  if (NativeBlur()) {
+    vgIterativeAverageBlurKHR(dst, src, dimX, dimY, iterative, tilingMode);
+    return;
+  }
+#endif
+
+  image_data_t image;
+  if (Fetch(src, &image) != VGU_NO_ERROR) {
+    return;
+  }
+
+  VGfloat fillColor[4];
+  vgGetfv(VG_TILE_FILL_COLOR, 4, fillColor);
+  color_t color = Premultiply(fillColor[0], fillColor[1],
+                              fillColor[2], fillColor[3]);
+  VGubyte fill[4];
+  for (int k = 0; k < 4; k++) {
+    fill[k] = (VGubyte) (color.c[k] * 255 + 0.5f);
+  }
+
+  if (pixels::BoxBlur(image.pixels, image.width * 4,
+                      image.pixels, image.width * 4, 4,
+                      image.width, image.height, Radius(dimX), Radius(dimY),
+                      iterative > 0 ? iterative : 1, tilingMode, fill)) {
+    Store(dst, image);
+  }
+  free(image.pixels);
+}
+
+void khr::ParametricFilter(VGImage dst, VGImage src, VGImage blur,
+                           VGfloat strength, VGfloat offsetX, VGfloat offsetY,
+                           VGbitfield filterFlags,
+                           VGPaint highlightPaint, VGPaint shadowPaint) {
+#ifdef VG_VGEXT_PROTOTYPES
+  if (NativeParametric()) {
+    vgParametricFilterKHR(dst, src, blur, strength, offsetX, offsetY,
+                          filterFlags, highlightPaint, shadowPaint);
+    return;
+  }
+#endif
+
+  image_data_t image, blurred;
+  if (Fetch(src, &image) != VGU_NO_ERROR) {
+    return;
+  }
+  if (Fetch(blur, &blurred) != VGU_NO_ERROR ||
+      blurred.width != image.width || blurred.height != image.height) {
+    free(blurred.pixels);
+    free(image.pixels);
+    return;
+  }
+
+  // Only the blur's alpha matters, packed in place
+  size_t count = (size_t) image.width * image.height;
+  for (size_t i = 0; i < count; i++) {
+    blurred.pixels[i] = blurred.pixels[4 * i + 3];
+  }
+
+  effect_t effect = Effect(strength, filterFlags,
+                           highlightPaint != VG_INVALID_HANDLE);
+  effect.offsetX = (int) lroundf(offsetX);
+  effect.offsetY = (int) lroundf(offsetY);
+  effect.highlight = ColorFromPaint(highlightPaint);
+  effect.shadow = ColorFromPaint(shadowPaint);
+
+  Composite(image.pixels, blurred.pixels, image.width, image.height, effect);
+  Store(dst, image);
+
+  free(blurred.pixels);
+  free(image.pixels);
+}
+
+VGUErrorCode khr::DropShadow(VGImage dst, VGImage src,
+                             VGfloat dimX, VGfloat dimY, VGuint iterative,
+                             VGfloat strength, VGfloat distance, VGfloat angle,
+                             VGbitfield filterFlags, VGbitfield allowedQuality,
+                             VGuint shadowColorRGBA) {
+#ifdef VG_VGEXT_PROTOTYPES
+  if (NativeParametric()) {
+    return vguDropShadowKHR(dst, src, dimX, dimY, iterative, strength,
+                            distance, angle, filterFlags, allowedQuality,
+                            shadowColorRGBA);
+  }
+#endif
+
+  effect_t effect = Effect(strength, filterFlags, false);
+  effect.shadow = ColorFromRGBA(shadowColorRGBA);
+  return ApplyEffect(dst, src, dimX, dimY, iterative, distance, angle, effect);
+}
+
+VGUErrorCode khr::Glow(VGImage dst, VGImage src,
+                       VGfloat dimX, VGfloat dimY, VGuint iterative,
+                       VGfloat strength,
+                       VGbitfield filterFlags, VGbitfield allowedQuality,
+                       VGuint glowColorRGBA) {
+#ifdef VG_VGEXT_PROTOTYPES
+  if (NativeParametric()) {
+    return vguGlowKHR(dst, src, dimX, dimY, iterative, strength,
+                      filterFlags, allowedQuality, glowColorRGBA);
+  }
+#endif
+
+  effect_t effect = Effect(strength, filterFlags, false);
+  effect.shadow = ColorFromRGBA(glowColorRGBA);
+  return ApplyEffect(dst, src, dimX, dimY, iterative, 0, 0, effect);
+}
+
+VGUErrorCode khr::Bevel(VGImage dst, VGImage src,
+                        VGfloat dimX, VGfloat dimY, VGuint iterative,
+                        VGfloat strength, VGfloat distance, VGfloat angle,
+                        VGbitfield filterFlags, VGbitfield allowedQuality,
+                        VGuint highlightColorRGBA, VGuint shadowColorRGBA) {
+#ifdef VG_VGEXT_PROTOTYPES
+  if (NativeParametric()) {
+    return vguBevelKHR(dst, src, dimX, dimY, iterative, strength,
+                       distance, angle, filterFlags, allowedQuality,
+                       highlightColorRGBA, shadowColorRGBA);
+  }
+#endif
+
+  effect_t effect = Effect(strength, filterFlags, true);
+  effect.highlight = ColorFromRGBA(highlightColorRGBA);
+  effect.shadow = ColorFromRGBA(shadowColorRGBA);
+  return ApplyEffect(dst, src, dimX, dimY, iterative, distance, angle, effect);
+}
+
+VGUErrorCode khr::GradientGlow(VGImage dst, VGImage src,
+                               VGfloat dimX, VGfloat dimY, VGuint iterative,
+                               VGfloat strength, VGfloat distance, VGfloat angle,
+                               VGbitfield filterFlags, VGbitfield allowedQuality,
+                               VGuint stopsCount, const VGfloat *glowColorRampStops) {
+#ifdef VG_VGEXT_PROTOTYPES
+  if (NativeParametric()) {
+    return vguGradientGlowKHR(dst, src, dimX, dimY, iterative, strength,
+                              distance, angle, filterFlags, allowedQuality,
+                              stopsCount, glowColorRampStops);
+  }
+#endif
+
+  if (stopsCount == 0 || glowColorRampStops == NULL) {
+    return VGU_ILLEGAL_ARGUMENT_ERROR;
+  }
+
+  color_t ramp[256];
+  BuildRamp(stopsCount, glowColorRampStops, ramp);
+
+  effect_t effect = Effect(strength, filterFlags, false);
+  effect.ramp = ramp;
+  return ApplyEffect(dst, src, dimX, dimY, iterative, distance, angle, effect);
+}
+
+VGUErrorCode khr::GradientBevel(VGImage dst, VGImage src,
+                                VGfloat dimX, VGfloat dimY, VGuint iterative,
+                                VGfloat strength, VGfloat distance, VGfloat angle,
+                                VGbitfield filterFlags, VGbitfield allowedQuality,
+                                VGuint stopsCount, const VGfloat *bevelColorRampStops) {
+#ifdef VG_VGEXT_PROTOTYPES
+  if (NativeParametric()) {
+    return vguGradientBevelKHR(dst, src, dimX, dimY, iterative, strength,
+                               distance, angle, filterFlags, allowedQuality,
+                               stopsCount, bevelColorRampStops);
+  }
+#endif
+
+  if (stopsCount == 0 || bevelColorRampStops == NULL) {
+    return VGU_ILLEGAL_ARGUMENT_ERROR;
+  }
+
+  color_t ramp[256];
+  BuildRamp(stopsCount, bevelColorRampStops, ramp);
+
+  effect_t effect = Effect(strength, filterFlags, true);
+  effect.ramp = ramp;
+  return ApplyEffect(dst, src, dimX, dimY, iterative, distance, angle, effect);
+}
+
+
+extern void khr::InitBindings(Handle<Object> ext) {
+  NODE_SET_METHOD(ext, "hasNativeFiltersKHR", khr::HasNativeFiltersKHR);
+  NODE_SET_METHOD(ext, "forceCPUFiltersKHR" , khr::ForceCPUFiltersKHR);
+}
+
+V8_METHOD(khr::HasNativeFiltersKHR) {
+  HandleScope scope;
+
+  CheckArgs0(hasNativeFiltersKHR);
+
+#ifdef VG_VGEXT_PROTOTYPES
+  V8_RETURN(Boolean::New(HasIterativeAverageBlur() && HasParametricFilter()));
+#else
+  V8_RETURN(Boolean::New(false));
+#endif
+}
+
+V8_METHOD(khr::ForceCPUFiltersKHR) {
+  HandleScope scope;
+
+  CheckArgs1(forceCPUFiltersKHR, force, Boolean);
+
+  ForceCPU(args[0]->BooleanValue());
+
+  V8_RETURN(Undefined());
+}
@@ -0,0 +1,74 @@
+#ifndef NODE_OPENVG_KHR_FILTERS_H_
+#define NODE_OPENVG_KHR_FILTERS_H_
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+#include "VG/vgu.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// KHR_iterative_average_blur and KHR_parametric_filter, through the driver
+// when it advertises them in VG_EXTENSIONS and on the CPU otherwise: the
+// images are read back with vgGetImageSubData, filtered and written back.
+namespace khr {
+
+bool HasIterativeAverageBlur();
+bool HasParametricFilter();
+
+// Makes every call take the CPU path, for testing and benchmarks.
+void ForceCPU(bool force);
+
+// Whether IterativeAverageBlur currently goes to the driver.
+bool NativeIterativeAverageBlur();
+
+void IterativeAverageBlur(VGImage dst, VGImage src,
+                          VGfloat dimX, VGfloat dimY, VGuint iterative,
+                          VGTilingMode tilingMode);
+
+void ParametricFilter(VGImage dst, VGImage src, VGImage blur,
+                      VGfloat strength, VGfloat offsetX, VGfloat offsetY,
+                      VGbitfield filterFlags,
+                      VGPaint highlightPaint, VGPaint shadowPaint);
+
+VGUErrorCode DropShadow(VGImage dst, VGImage src,
+                        VGfloat dimX, VGfloat dimY, VGuint iterative,
+                        VGfloat strength, VGfloat distance, VGfloat angle,
+                        VGbitfield filterFlags, VGbitfield allowedQuality,
+                        VGuint shadowColorRGBA);
+
+VGUErrorCode Glow(VGImage dst, VGImage src,
+                  VGfloat dimX, VGfloat dimY, VGuint iterative,
+                  VGfloat strength,
+                  VGbitfield filterFlags, VGbitfield allowedQuality,
+                  VGuint glowColorRGBA);
+
+VGUErrorCode Bevel(VGImage dst, VGImage src,
+                   VGfloat dimX, VGfloat dimY, VGuint iterative,
+                   VGfloat strength, VGfloat distance, VGfloat angle,
+                   VGbitfield filterFlags, VGbitfield allowedQuality,
+                   VGuint highlightColorRGBA, VGuint shadowColorRGBA);
+
+VGUErrorCode GradientGlow(VGImage dst, VGImage src,
+                          VGfloat dimX, VGfloat dimY, VGuint iterative,
+                          VGfloat strength, VGfloat distance, VGfloat angle,
+                          VGbitfield filterFlags, VGbitfield allowedQuality,
+                          VGuint stopsCount, const VGfloat *glowColorRampStops);
+
+VGUErrorCode GradientBevel(VGImage dst, VGImage src,
+                           VGfloat dimX, VGfloat dimY, VGuint iterative,
+                           VGfloat strength, VGfloat distance, VGfloat angle,
+                           VGbitfield filterFlags, VGbitfield allowedQuality,
+                           VGuint stopsCount, const VGfloat *bevelColorRampStops);
+
+extern void InitBindings(Handle<Object> ext);
+
+V8_FUNCTION_DECL(HasNativeFiltersKHR);
+V8_FUNCTION_DECL(ForceCPUFiltersKHR);
+
+}
+
+#endif
@@ -0,0 +1,294 @@
+#include <math.h>
+#include <string.h>
+
+#include <vector>
+
+#include "VG/openvg.h"
+
+#include "matrix_stack.h"
+#include "state_cache.h"
+#include "draw_reorder.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+const VGint kFirstMode = VG_MATRIX_PATH_USER_TO_SURFACE;
+const int kModes = 5;
+
+struct matrix_t {
+  VGfloat m[9];
+};
+
+struct mode_state_t {
+  matrix_t current;
+  matrix_t uploaded;  // What the driver has
+  bool known;         // Whether current and uploaded are valid
+  bool dirty;
+  std::vector<matrix_t> stack;
+};
+
+mode_state_t modes[kModes];
+bool anyDirty = false;
+
+size_t uploads = 0, skippedUploads = 0, fetches = 0;
+
+const matrix_t kIdentity = { { 1, 0, 0, 0, 1, 0, 0, 0, 1 } };
+
+bool IsAffineMode(int index) {
+  return index + kFirstMode != VG_MATRIX_IMAGE_USER_TO_SURFACE;
+}
+
+// A mode, with its copy read back from the driver if unknown.
+int Fetch(VGint matrixMode) {
+  int index = matrixMode - kFirstMode;
+  if (index < 0 || index >= kModes) {
+    index = 0;
+  }
+
+  mode_state_t &mode = modes[index];
+  if (!mode.known) {
+    VGint current = state::MatrixMode();
+    if (current != kFirstMode + index) {
+      state::SetI(VG_MATRIX_MODE, kFirstMode + index);
+    }
+    vgGetMatrix(mode.current.m);
+    if (current != kFirstMode + index) {
+      state::SetI(VG_MATRIX_MODE, current);
+    }
+    mode.uploaded = mode.current;
+    mode.known = true;
+    fetches++;
+  }
+  return index;
+}
+
+int Current() {
+  return Fetch(state::MatrixMode());
+}
+
+void Changed(int index) {
+  modes[index].dirty = true;
+  anyDirty = true;
+}
+
+// The driver ignores the last row of affine matrices.
+void Normalize(int index, VGfloat *m) {
+  if (IsAffineMode(index)) {
+    m[2] = 0;
+    m[5] = 0;
+    m[8] = 1;
+  }
+}
+
+void Multiply(const VGfloat *a, const VGfloat *b, VGfloat *result) {
+  for (int column = 0; column < 3; column++) {
+    const VGfloat *bc = b + column * 3;
+    result[column * 3 + 0] = a[0] * bc[0] + a[3] * bc[1] + a[6] * bc[2];
+    result[column * 3 + 1] = a[1] * bc[0] + a[4] * bc[1] + a[7] * bc[2];
+    result[column * 3 + 2] = a[2] * bc[0] + a[5] * bc[1] + a[8] * bc[2];
+  }
+}
+
+}
+
+void matrices::LoadIdentity() {
+  int index = Current();
+  modes[index].current = kIdentity;
+  Changed(index);
+}
+
+void matrices::Load(const VGfloat *matrix) {
+  int index = Current();
+  VGfloat *m = modes[index].current.m;
+  memcpy(m, matrix, sizeof(VGfloat) * 9);
+  Normalize(index, m);
+  Changed(index);
+}
+
+void matrices::Get(VGfloat *matrix) {
+  memcpy(matrix, modes[Current()].current.m, sizeof(VGfloat) * 9);
+}
+
+void matrices::LoadFor(VGint matrixMode, const VGfloat *matrix) {
+  int index = Fetch(matrixMode);
+  VGfloat *m = modes[index].current.m;
+  memcpy(m, matrix, sizeof(VGfloat) * 9);
+  Normalize(index, m);
+  Changed(index);
+}
+
+void matrices::GetFor(VGint matrixMode, VGfloat *matrix) {
+  memcpy(matrix, modes[Fetch(matrixMode)].current.m, sizeof(VGfloat) * 9);
+}
+
+void matrices::Mult(const VGfloat *matrix) {
+  int index = Current();
+  VGfloat other[9], result[9];
+  memcpy(other, matrix, sizeof(other));
+  Normalize(index, other);
+
+  VGfloat *m = modes[index].current.m;
+  Multiply(m, other, result);
+  memcpy(m, result, sizeof(result));
+  Changed(index);
+}
+
+// The transforms below multiply on the right like their vg counterparts,
+// touching only the columns they change.
+
+void matrices::Translate(VGfloat tx, VGfloat ty) {
+  int index = Current();
+  VGfloat *m = modes[index].current.m;
+  m[6] += m[0] * tx + m[3] * ty;
+  m[7] += m[1] * tx + m[4] * ty;
+  m[8] += m[2] * tx + m[5] * ty;
+  Changed(index);
+}
+
+void matrices::Scale(VGfloat sx, VGfloat sy) {
+  int index = Current();
+  VGfloat *m = modes[index].current.m;
+  m[0] *= sx; m[1] *= sx; m[2] *= sx;
+  m[3] *= sy; m[4] *= sy; m[5] *= sy;
+  Changed(index);
+}
+
+void matrices::Shear(VGfloat shx, VGfloat shy) {
+  int index = Current();
+  VGfloat *m = modes[index].current.m;
+  for (int row = 0; row < 3; row++) {
+    VGfloat x = m[row], y = m[3 + row];
+    m[row] = x + shy * y;
+    m[3 + row] = shx * x + y;
+  }
+  Changed(index);
+}
+
+void matrices::Rotate(VGfloat angle) {
+  int index = Current();
+  VGfloat radians = angle * (VGfloat) (M_PI / 180.0);
+  VGfloat c = cosf(radians), s = sinf(radians);
+  VGfloat *m = modes[index].current.m;
+  for (int row = 0; row < 3; row++) {
+    VGfloat x = m[row], y = m[3 + row];
+    m[row] = c * x + s * y;
+    m[3 + row] = -s * x + c * y;
+  }
+  Changed(index);
+}
+
+void matrices::Push() {
+  mode_state_t &mode = modes[Current()];
+  mode.stack.push_back(mode.current);
+}
+
+bool matrices::Pop() {
+  int index = Current();
+  mode_state_t &mode = modes[index];
+  if (mode.stack.empty()) {
+    return false;
+  }
+  mode.current = mode.stack.back();
+  mode.stack.pop_back();
+  Changed(index);
+  return true;
+}
+
+void matrices::Sync() {
+  reorder::Barrier();
+
+  if (!anyDirty) {
+    return;
+  }
+  anyDirty = false;
+
+  VGint matrixMode = state::MatrixMode();
+  VGint loaded = matrixMode;
+  for (int i = 0; i < kModes; i++) {
+    mode_state_t &mode = modes[i];
+    if (!mode.dirty) {
+      continue;
+    }
+    mode.dirty = false;
+
+    if (memcmp(mode.current.m, mode.uploaded.m, sizeof(mode.current.m)) == 0) {
+      skippedUploads++;
+      continue;
+    }
+    if (loaded != kFirstMode + i) {
+      loaded = kFirstMode + i;
+      state::SetI(VG_MATRIX_MODE, loaded);
+    }
+    vgLoadMatrix(mode.current.m);
+    mode.uploaded = mode.current;
+    uploads++;
+  }
+
+  if (loaded != matrixMode) {
+    state::SetI(VG_MATRIX_MODE, matrixMode);
+  }
+}
+
+void matrices::Invalidate() {
+  for (int i = 0; i < kModes; i++) {
+    modes[i].known = false;
+    modes[i].dirty = false;
+  }
+  anyDirty = false;
+}
+
+void matrices::GetStats(stats_t *stats) {
+  stats->uploads = uploads;
+  stats->skippedUploads = skippedUploads;
+  stats->fetches = fetches;
+  stats->depth = modes[Current()].stack.size();
+}
+
+
+extern void matrices::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "pushMatrix"    , matrices::PushMatrix);
+  NODE_SET_METHOD(target, "popMatrix"     , matrices::PopMatrix);
+  NODE_SET_METHOD(target, "getMatrixStats", matrices::GetMatrixStats);
+}
+
+V8_METHOD(matrices::PushMatrix) {
+  HandleScope scope;
+
+  CheckArgs0(pushMatrix);
+
+  Push();
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(matrices::PopMatrix) {
+  HandleScope scope;
+
+  CheckArgs0(popMatrix);
+
+  if (!Pop()) {
+    V8_THROW(Exception::RangeError(String::New("popMatrix: matrix stack is empty")));
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(matrices::GetMatrixStats) {
+  HandleScope scope;
+
+  CheckArgs1(getMatrixStats, stats, Object);
+
+  stats_t stats;
+  GetStats(&stats);
+
+  Local<Object> result = args[0].As<Object>();
+  result->Set(String::NewSymbol("uploads"), Number::New(stats.uploads));
+  result->Set(String::NewSymbol("skippedUploads"), Number::New(stats.skippedUploads));
+  result->Set(String::NewSymbol("fetches"), Number::New(stats.fetches));
+  result->Set(String::NewSymbol("depth"), Number::New(stats.depth));
+
+  V8_RETURN(Undefined());
+}
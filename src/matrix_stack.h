@@ -0,0 +1,69 @@
+#ifndef NODE_OPENVG_MATRIX_STACK_H_
+#define NODE_OPENVG_MATRIX_STACK_H_
+
+#include <stddef.h>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// CPU copies of the five matrices, one per VG_MATRIX_MODE, that the matrix
+// bindings work on instead of the driver's, with a stack per mode for
+// saving and restoring them. A changed matrix is only given to the driver
+// with vgLoadMatrix by Sync(), which everything that draws or otherwise
+// uses the current matrices calls first, and not at all if it's back to
+// the last uploaded value by then.
+//
+// Matrices are column major as in vgLoadMatrix; those of the affine modes
+// keep (0, 0, 1) as their last row.
+namespace matrices {
+
+struct stats_t {
+  size_t uploads;
+  size_t skippedUploads;  // Changed matrices back to the uploaded value
+  size_t fetches;         // Copies read back from the driver
+  size_t depth;           // Stack depth of the current mode
+};
+
+void LoadIdentity();
+void Load(const VGfloat *matrix);
+void Get(VGfloat *matrix);
+void Mult(const VGfloat *matrix);
+void Translate(VGfloat tx, VGfloat ty);
+void Scale(VGfloat sx, VGfloat sy);
+void Shear(VGfloat shx, VGfloat shy);
+void Rotate(VGfloat angle);
+
+// The matrix of another mode than the current one, as draws recorded for
+// later keep them.
+void LoadFor(VGint matrixMode, const VGfloat *matrix);
+void GetFor(VGint matrixMode, VGfloat *matrix);
+
+void Push();
+
+// Returns false if the stack of the current mode is empty.
+bool Pop();
+
+// Uploads the matrices that changed.
+void Sync();
+
+// Forgets the copies of the driver's matrices, once synced, when another
+// context is made current.
+void Invalidate();
+
+void GetStats(stats_t *stats);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(PushMatrix);
+V8_FUNCTION_DECL(PopMatrix);
+V8_FUNCTION_DECL(GetMatrixStats);
+
+}
+
+#endif
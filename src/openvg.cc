@@ -11,8 +11,30 @@
 #include "openvg.h"
 #include "egl.h"
 #include "argchecks.h"
+#include "pixel_convert.h"
+#include "image_loader.h"
+#include "image_registry.h"
+#include "filter_graph.h"
+#include "khr_filters.h"
+#include "image_blur.h"
+#include "frame_diff.h"
+#include "font_face.h"
+#include "glyph_cache.h"
+#include "text_layer.h"
+#include "state_cache.h"
+#include "matrix_stack.h"
+#include "paint_cache.h"
+#include "clip_stack.h"
+#include "scene_graph.h"
+#include "sprite_batch.h"
+#include "canvas_context.h"
+#include "animation_timeline.h"
+#include "chart_geometry.h"
+#include "series_decimation.h"
+#include "draw_reorder.h"
 
 #include "v8_helpers.h"
+#include "typed_array.h"
 
 const bool kInitOpenGLES = false;
 
@@ -113,6 +135,8 @@ void init(Handle<Object> target) {
   NODE_SET_METHOD(target, "destroyImage"     , openvg::DestroyImage);
   NODE_SET_METHOD(target, "clearImage"       , openvg::ClearImage);
   NODE_SET_METHOD(target, "imageSubData"     , openvg::ImageSubData);
+  NODE_SET_METHOD(target, "imageSubDataConvert",
+                          openvg::ImageSubDataConvert);
   NODE_SET_METHOD(target, "getImageSubData"  , openvg::GetImageSubData);
   NODE_SET_METHOD(target, "childImage"       , openvg::ChildImage);
   NODE_SET_METHOD(target, "getParent"        , openvg::GetParent);
@@ -123,6 +147,7 @@ void init(Handle<Object> target) {
   NODE_SET_METHOD(target, "getPixels"        , openvg::GetPixels);
   NODE_SET_METHOD(target, "readPixels"       , openvg::ReadPixels);
   NODE_SET_METHOD(target, "copyPixels"       , openvg::CopyPixels);
+  NODE_SET_METHOD(target, "convertPixels"    , openvg::ConvertPixels);
 
   /* Text */
   NODE_SET_METHOD(target, "createFont"       , openvg::CreateFont);
@@ -186,6 +211,66 @@ void init(Handle<Object> target) {
   NODE_SET_METHOD(ext, "transformClipLineNDS",
                        openvg::ext::TransformClipLineNDS);
 
+  /* CPU fallbacks for the KHR filters */
+  khr::InitBindings(ext);
+
+  /* Asynchronous image loading */
+  loader::InitBindings(target);
+
+  /* Image memory budget and pyramids */
+  registry::InitBindings(target);
+
+  /* Filter graphs */
+  filters::InitBindings(target);
+
+  /* Large Gaussian blurs */
+  blur::InitBindings(target);
+
+  /* Changed-tile frame capture */
+  diff::InitBindings(target);
+
+  /* Native fonts and text measurement */
+  faces::InitBindings(target);
+
+  /* Glyph bitmap cache */
+  glyphs::InitBindings(target);
+
+  /* Cached text layers */
+  textlayers::InitBindings(target);
+
+  /* Shadow state cache */
+  state::InitBindings(target);
+
+  /* Matrix stacks */
+  matrices::InitBindings(target);
+
+  /* Gradient paint cache */
+  gradients::InitBindings(target);
+
+  /* Clip stack */
+  clips::InitBindings(target);
+
+  /* Retained scene graph */
+  scene::InitBindings(target);
+
+  /* Sprite batches */
+  sprites::InitBindings(target);
+
+  /* Canvas 2D context */
+  canvas::InitBindings(target);
+
+  /* Animation timeline */
+  animations::InitBindings(target);
+
+  /* Chart geometry */
+  charts::InitBindings(target);
+
+  /* Series decimation */
+  decimation::InitBindings(target);
+
+  /* State-sorted draw reordering */
+  reorder::InitBindings(target);
+
   /* EGL */
   Local<Object> egl = Object::New();
   target->Set(String::New("egl"), egl);
@@ -202,45 +287,54 @@ NODE_MODULE(openvg, init)
     }\
   }
 
-#ifdef TYPED_ARRAY_TYPE_PRE_0_11
-template<class C> class TypedArrayWrapper {
- private:
-  Local<Object> array;
-  Handle<Object> buffer;
-  int byteOffset;
- public:
-  inline __attribute__((always_inline)) TypedArrayWrapper(const Local<Value>& arg) :
-    array(arg->ToObject()),
-    buffer(array->Get(String::New("buffer"))->ToObject()),
-    byteOffset(array->Get(String::New("byteOffset"))->Int32Value()) {
-  }
+// Accepts both typed arrays and node Buffers
+static void *BufferData(const Local<Value>& arg) {
+  Local<Object> data = arg->ToObject();
 
-  inline __attribute__((always_inline)) C* pointer(int offset = 0) {
-    return (C*) &((char*) buffer->GetIndexedPropertiesExternalArrayData())[byteOffset + offset];
+  if (!data->Get(String::New("buffer"))->IsUndefined()) {
+    // Native array, from its byteOffset
+    TypedArrayWrapper<char> array(arg);
+    return (void *) array.pointer();
+  } else {
+    // Node buffer
+    return (void *) Buffer::Data(data);
   }
+}
 
-  inline __attribute__((always_inline)) int length() {
-    return array->Get(String::New("length"))->Uint32Value();
-  }
-};
-#else
-template<class C> class TypedArrayWrapper {
- private:
-  Local<TypedArray> array;
- public:
-  inline __attribute__((always_inline)) TypedArrayWrapper(const Local<Value>& arg) :
-    array(Handle<TypedArray>::Cast(arg->ToObject())) {
-  }
+// The bytes BufferData points to
+static size_t BufferLength(const Local<Value>& arg) {
+  Local<Object> data = arg->ToObject();
 
-  inline __attribute__((always_inline)) C* pointer(int offset = 0) {
-    return (C*) &((char*) array->BaseAddress())[offset];
+  if (!data->Get(String::New("buffer"))->IsUndefined()) {
+    return data->Get(String::New("byteLength"))->Uint32Value();
+  } else {
+    return Buffer::Length(data);
   }
+}
 
-  inline __attribute__((always_inline)) int length() {
-    return array->Length();
+// Whether a buffer holds height rows stride bytes apart of width pixels in
+// format. Negative strides would read before the start of it. Formats
+// Convert can't handle, left to the driver, are sized as images are.
+static bool HoldsPixels(const Local<Value>& arg, VGint stride, VGint format,
+                        VGint width, VGint height) {
+  if (width <= 0 || height <= 0) {
+    return true;
   }
-};
-#endif
+  if (stride < 0) {
+    return false;
+  }
+  size_t rowBytes = pixels::IsSupported(format) ?
+    (size_t) width * pixels::BytesPerPixel(format) :
+    registry::EstimateBytes(static_cast<VGImageFormat>(format), width, 1);
+  size_t needed = (size_t) stride * (height - 1) + rowBytes;
+  return BufferLength(arg) >= needed;
+}
+
+// Parameter functions take paths, paints and fonts as well as images, whose
+// handles in JS are registry keys
+static VGHandle ParameterHandle(const Local<Value>& arg) {
+  return registry::ReadHandle((VGHandle) arg->Int32Value());
+}
 
 V8_METHOD(openvg::StartUp) {
   HandleScope scope;
@@ -295,6 +389,8 @@ V8_METHOD(openvg::Flush) {
 
   CheckArgs0(flush);
 
+  reorder::Barrier();
+
   vgFlush();
 
   V8_RETURN(Undefined());
@@ -305,6 +401,8 @@ V8_METHOD(openvg::Finish) {
 
   CheckArgs0(finish);
 
+  reorder::Barrier();
+
   vgFinish();
 
   V8_RETURN(Undefined());
@@ -319,8 +417,8 @@ V8_METHOD(openvg::SetF) {
 
   CheckArgs2(setF, type, Int32, value, Number);
 
-  vgSetf((VGParamType) args[0]->Int32Value(),
-         (VGfloat) args[1]->NumberValue());
+  state::SetF((VGParamType) args[0]->Int32Value(),
+              (VGfloat) args[1]->NumberValue());
 
   V8_RETURN(Undefined());
 }
@@ -330,8 +428,8 @@ V8_METHOD(openvg::SetI) {
 
   CheckArgs2(setI, type, Int32, value, Int32);
 
-  vgSeti((VGParamType) args[0]->Int32Value(),
-         (VGint) args[1]->Int32Value());
+  state::SetI((VGParamType) args[0]->Int32Value(),
+              (VGint) args[1]->Int32Value());
 
   V8_RETURN(Undefined());
 }
@@ -343,9 +441,9 @@ V8_METHOD(openvg::SetFV) {
 
   TypedArrayWrapper<VGfloat> values(args[1]);
 
-  vgSetfv((VGParamType) args[0]->Int32Value(),
-          values.length(),
-          values.pointer());
+  state::SetFV((VGParamType) args[0]->Int32Value(),
+               values.length(),
+               values.pointer());
 
   V8_RETURN(Undefined());
 }
@@ -357,9 +455,9 @@ V8_METHOD(openvg::SetIV) {
 
   TypedArrayWrapper<VGint> values(args[1]);
 
-  vgSetiv((VGParamType) args[0]->Int32Value(),
-          values.length(),
-          values.pointer());
+  state::SetIV((VGParamType) args[0]->Int32Value(),
+               values.length(),
+               values.pointer());
 
   V8_RETURN(Undefined());
 }
@@ -371,9 +469,9 @@ V8_METHOD(openvg::SetFVOL) {
 
   TypedArrayWrapper<VGfloat> values(args[1]);
 
-  vgSetfv((VGParamType) args[0]->Int32Value(),
-          (VGint) args[3]->Int32Value(),
-          values.pointer(args[2]->Int32Value()));
+  state::SetFV((VGParamType) args[0]->Int32Value(),
+               (VGint) args[3]->Int32Value(),
+               values.pointer(args[2]->Int32Value()));
 
   V8_RETURN(Undefined());
 }
@@ -385,9 +483,9 @@ V8_METHOD(openvg::SetIVOL) {
 
   TypedArrayWrapper<VGint> values(args[1]);
 
-  vgSetiv((VGParamType) args[0]->Int32Value(),
-          (VGint) args[3]->Int32Value(),
-          values.pointer(args[2]->Int32Value()));
+  state::SetIV((VGParamType) args[0]->Int32Value(),
+               (VGint) args[3]->Int32Value(),
+               values.pointer(args[2]->Int32Value()));
 
   V8_RETURN(Undefined());
 }
@@ -478,7 +576,9 @@ V8_METHOD(openvg::SetParameterF) {
 
   CheckArgs3(setParameterF, VGHandle, Int32, VGParamType, Int32, value, Number);
 
-  vgSetParameterf((VGHandle) args[0]->Int32Value(),
+  reorder::Barrier();
+
+  vgSetParameterf(ParameterHandle(args[0]),
                   (VGParamType) args[1]->Int32Value(),
                   (VGfloat) args[2]->NumberValue());
 
@@ -490,7 +590,9 @@ V8_METHOD(openvg::SetParameterI) {
 
   CheckArgs3(setParameterI, VGHandle, Int32, VGParamType, Int32, value, Int32);
 
-  vgSetParameteri((VGHandle) args[0]->Int32Value(),
+  reorder::Barrier();
+
+  vgSetParameteri(ParameterHandle(args[0]),
                   (VGParamType) args[1]->Int32Value(),
                   (VGint) args[2]->Int32Value());
 
@@ -503,9 +605,11 @@ V8_METHOD(openvg::SetParameterFV) {
   CheckArgs3(setParameterFV,
              VGHandle, Int32, VGParamType, Int32, Float32Array, Object);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<VGfloat> values(args[2]);
 
-  vgSetParameterfv((VGHandle) args[0]->Int32Value(),
+  vgSetParameterfv(ParameterHandle(args[0]),
                    (VGParamType) args[1]->Int32Value(),
                    values.length(),
                    values.pointer());
@@ -519,9 +623,11 @@ V8_METHOD(openvg::SetParameterIV) {
   CheckArgs3(setParameterIV,
              VGHandle, Int32, VGParamType, Int32, Int32Array, Object);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<VGint> values(args[2]);
 
-  vgSetParameteriv((VGHandle) args[0]->Int32Value(),
+  vgSetParameteriv(ParameterHandle(args[0]),
                    (VGParamType) args[1]->Int32Value(),
                    values.length(),
                    values.pointer());
@@ -536,9 +642,11 @@ V8_METHOD(openvg::SetParameterFVOL) {
              VGHandle, Int32, VGParamType, Int32, Float32Array, Object,
              offset, Int32, length, Int32);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<VGfloat> values(args[2]);
 
-  vgSetParameterfv((VGHandle) args[0]->Int32Value(),
+  vgSetParameterfv(ParameterHandle(args[0]),
                    (VGParamType) args[1]->Int32Value(),
                    (VGint) args[4]->Int32Value(),
                    values.pointer(args[3]->Int32Value()));
@@ -553,9 +661,11 @@ V8_METHOD(openvg::SetParameterIVOL) {
              VGHandle, Int32, VGParamType, Int32, Int32Array, Object,
              offset, Int32, length, Int32);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<VGint> values(args[2]);
 
-  vgSetParameteriv((VGHandle) args[0]->Int32Value(),
+  vgSetParameteriv(ParameterHandle(args[0]),
                    (VGParamType) args[1]->Int32Value(),
                    (VGint) args[4]->Int32Value(),
                    values.pointer(args[3]->Int32Value()));
@@ -568,7 +678,7 @@ V8_METHOD(openvg::GetParameterF) {
 
   CheckArgs2(getParameterF, VGHandle, Int32, VGParamType, Int32);
 
-  V8_RETURN(Number::New(vgGetParameterf((VGHandle) args[0]->Int32Value(),
+  V8_RETURN(Number::New(vgGetParameterf(ParameterHandle(args[0]),
                                         (VGParamType) args[1]->Int32Value())));
 }
 
@@ -577,7 +687,7 @@ V8_METHOD(openvg::GetParameterI) {
 
   CheckArgs2(getParameterI, VGHandle, Int32, VGParamType, Int32);
 
-  V8_RETURN(Integer::New(vgGetParameteri((VGHandle) args[0]->Int32Value(),
+  V8_RETURN(Integer::New(vgGetParameteri(ParameterHandle(args[0]),
                                          (VGParamType) args[1]->Int32Value())));
 }
 
@@ -586,7 +696,7 @@ V8_METHOD(openvg::GetParameterVectorSize) {
 
   CheckArgs2(getParameterVectorSize, VGHandle, Int32, VGParamType, Int32);
 
-  V8_RETURN(Integer::New(vgGetParameterVectorSize((VGHandle) args[0]->Int32Value(),
+  V8_RETURN(Integer::New(vgGetParameterVectorSize(ParameterHandle(args[0]),
                                                   (VGParamType) args[1]->Int32Value())));
 }
 
@@ -598,7 +708,7 @@ V8_METHOD(openvg::GetParameterFV) {
 
   TypedArrayWrapper<VGfloat> values(args[2]);
 
-  vgGetParameterfv((VGHandle) args[0]->Int32Value(),
+  vgGetParameterfv(ParameterHandle(args[0]),
                    (VGParamType) args[1]->Int32Value(),
                    values.length(),
                    values.pointer());
@@ -614,7 +724,7 @@ V8_METHOD(openvg::GetParameterIV) {
 
   TypedArrayWrapper<VGint> values(args[2]);
 
-  vgGetParameteriv((VGHandle) args[0]->Int32Value(),
+  vgGetParameteriv(ParameterHandle(args[0]),
                    (VGParamType) args[1]->Int32Value(),
                    values.length(),
                    values.pointer());
@@ -631,7 +741,7 @@ V8_METHOD(openvg::GetParameterFVOL) {
 
   TypedArrayWrapper<VGfloat> values(args[2]);
 
-  vgGetParameterfv((VGHandle) args[0]->Int32Value(),
+  vgGetParameterfv(ParameterHandle(args[0]),
                    (VGParamType) args[1]->Int32Value(),
                    (VGint) args[4]->Int32Value(),
                    values.pointer(args[3]->Int32Value()));
@@ -648,7 +758,7 @@ V8_METHOD(openvg::GetParameterIVOL) {
 
   TypedArrayWrapper<VGint> values(args[2]);
 
-  vgGetParameteriv((VGHandle) args[0]->Int32Value(),
+  vgGetParameteriv(ParameterHandle(args[0]),
                    (VGParamType) args[1]->Int32Value(),
                    (VGint) args[4]->Int32Value(),
                    values.pointer(args[3]->Int32Value()));
@@ -665,7 +775,7 @@ V8_METHOD(openvg::LoadIdentity) {
 
   CheckArgs0(loadIdentity);
 
-  vgLoadIdentity();
+  matrices::LoadIdentity();
 
   V8_RETURN(Undefined());
 }
@@ -677,7 +787,7 @@ V8_METHOD(openvg::LoadMatrix) {
 
   TypedArrayWrapper<VGfloat> matrix(args[0]);
 
-  vgLoadMatrix(matrix.pointer());
+  matrices::Load(matrix.pointer());
 
   V8_RETURN(Undefined());
 }
@@ -689,7 +799,7 @@ V8_METHOD(openvg::GetMatrix) {
 
   TypedArrayWrapper<VGfloat> matrix(args[0]);
 
-  vgGetMatrix(matrix.pointer());
+  matrices::Get(matrix.pointer());
 
   V8_RETURN(Undefined());
 }
@@ -701,7 +811,7 @@ V8_METHOD(openvg::MultMatrix) {
 
   TypedArrayWrapper<VGfloat> matrix(args[0]);
 
-  vgMultMatrix(matrix.pointer());
+  matrices::Mult(matrix.pointer());
 
   V8_RETURN(Undefined());
 }
@@ -711,8 +821,8 @@ V8_METHOD(openvg::Translate) {
 
   CheckArgs2(translate, x, Number, y, Number);
 
-  vgTranslate((VGfloat) args[0]->NumberValue(),
-              (VGfloat) args[1]->NumberValue());
+  matrices::Translate((VGfloat) args[0]->NumberValue(),
+                      (VGfloat) args[1]->NumberValue());
 
   V8_RETURN(Undefined());
 }
@@ -722,8 +832,8 @@ V8_METHOD(openvg::Scale) {
 
   CheckArgs2(scale, x, Number, y, Number);
 
-  vgScale((VGfloat) args[0]->NumberValue(),
-          (VGfloat) args[1]->NumberValue());
+  matrices::Scale((VGfloat) args[0]->NumberValue(),
+                  (VGfloat) args[1]->NumberValue());
 
   V8_RETURN(Undefined());
 }
@@ -733,8 +843,8 @@ V8_METHOD(openvg::Shear) {
 
   CheckArgs2(shear, x, Number, y, Number);
 
-  vgShear((VGfloat) args[0]->NumberValue(),
-          (VGfloat) args[1]->NumberValue());
+  matrices::Shear((VGfloat) args[0]->NumberValue(),
+                  (VGfloat) args[1]->NumberValue());
 
   V8_RETURN(Undefined());
 }
@@ -744,7 +854,7 @@ V8_METHOD(openvg::Rotate) {
 
   CheckArgs1(shear, angle, Number);
 
-  vgRotate((VGfloat) args[0]->NumberValue());
+  matrices::Rotate((VGfloat) args[0]->NumberValue());
 
   V8_RETURN(Undefined());
 }
@@ -760,7 +870,9 @@ V8_METHOD(openvg::Mask) {
              VGHandle, Uint32, VGMaskOperation, Uint32,
              x, Int32, y, Int32, width, Int32, height, Int32);
 
-  vgMask((VGHandle) args[0]->Uint32Value(),
+  reorder::Barrier();
+
+  vgMask(registry::ReadHandle((VGHandle) args[0]->Uint32Value()),
          static_cast<VGMaskOperation>(args[1]->Uint32Value()),
          (VGint) args[2]->Int32Value(),
          (VGint) args[3]->Int32Value(),
@@ -778,6 +890,7 @@ V8_METHOD(openvg::RenderToMask) {
              VGbitfield, Uint32,
              VGMaskOperation, Uint32);
 
+  matrices::Sync();
   vgRenderToMask((VGPath) args[0]->Uint32Value(),
                  (VGbitfield) args[1]->Uint32Value(),
                  (VGMaskOperation) args[2]->Uint32Value());
@@ -790,8 +903,11 @@ V8_METHOD(openvg::CreateMaskLayer) {
 
   CheckArgs2(createMaskLayer, width, Int32, height, Int32);
 
-  V8_RETURN(Integer::New(vgCreateMaskLayer((VGint) args[0]->Int32Value(),
-                                           (VGint) args[1]->Int32Value())));
+  VGMaskLayer layer = vgCreateMaskLayer((VGint) args[0]->Int32Value(),
+                                        (VGint) args[1]->Int32Value());
+  registry::Created(layer);
+
+  V8_RETURN(Integer::New(layer));
 }
 
 V8_METHOD(openvg::DestroyMaskLayer) {
@@ -800,6 +916,7 @@ V8_METHOD(openvg::DestroyMaskLayer) {
   CheckArgs1(destroyMaskLayer, VGMaskLayer, Uint32);
 
   vgDestroyMaskLayer((VGMaskLayer) args[0]->Uint32Value());
+  registry::Destroyed((VGHandle) args[0]->Uint32Value());
 
   V8_RETURN(Undefined());
 }
@@ -812,6 +929,8 @@ V8_METHOD(openvg::FillMaskLayer) {
              x, Int32, y, Int32, width, Int32, height, Int32,
              value, Number);
 
+  reorder::Barrier();
+
   vgFillMaskLayer((VGMaskLayer) args[0]->Uint32Value(),
                   (VGint) args[1]->Int32Value(),
                   (VGint) args[2]->Int32Value(),
@@ -830,6 +949,8 @@ V8_METHOD(openvg::CopyMask) {
              dx, Int32, dy, Int32, sx, Int32, sy, Int32,
              width, Int32, height, Int32);
 
+  reorder::Barrier();
+
   vgCopyMask((VGMaskLayer) args[0]->Uint32Value(),
              (VGint) args[1]->Int32Value(), (VGint) args[2]->Int32Value(),
              (VGint) args[3]->Int32Value(), (VGint) args[4]->Int32Value(),
@@ -843,6 +964,8 @@ V8_METHOD(openvg::Clear) {
 
   CheckArgs4(clear, x, Int32, y, Int32, width, Int32, height, Int32);
 
+  reorder::Barrier();
+
   vgClear((VGint) args[0]->Int32Value(), (VGint) args[1]->Int32Value(),
           (VGint) args[2]->Int32Value(), (VGint) args[3]->Int32Value());
 
@@ -861,13 +984,16 @@ V8_METHOD(openvg::CreatePath) {
              scale, Number, bias, Number, segmentCapacityHint, Int32,
              coordCapacityHint, Int32, capabilities, Uint32);
 
-  V8_RETURN(Uint32::New(vgCreatePath((VGint) args[0]->Int32Value(),
-                                     static_cast<VGPathDatatype>(args[1]->Uint32Value()),
-                                     (VGfloat) args[2]->NumberValue(),
-                                     (VGfloat) args[3]->NumberValue(),
-                                     (VGint) args[4]->Int32Value(),
-                                     (VGint) args[5]->Int32Value(),
-                                     (VGbitfield) args[6]->Uint32Value())));
+  VGPath path = vgCreatePath((VGint) args[0]->Int32Value(),
+                             static_cast<VGPathDatatype>(args[1]->Uint32Value()),
+                             (VGfloat) args[2]->NumberValue(),
+                             (VGfloat) args[3]->NumberValue(),
+                             (VGint) args[4]->Int32Value(),
+                             (VGint) args[5]->Int32Value(),
+                             (VGbitfield) args[6]->Uint32Value());
+  registry::Created(path);
+
+  V8_RETURN(Uint32::New(path));
 }
 
 V8_METHOD(openvg::ClearPath) {
@@ -875,6 +1001,8 @@ V8_METHOD(openvg::ClearPath) {
 
   CheckArgs2(clearPath, VGPath, Number, capabilities, Uint32);
 
+  reorder::Barrier();
+
   vgClearPath((VGPath) args[0]->Uint32Value(),
               (VGbitfield) args[1]->Uint32Value());
 
@@ -886,7 +1014,10 @@ V8_METHOD(openvg::DestroyPath) {
 
   CheckArgs1(destroyPath, VGPath, Number);
 
+  reorder::Barrier();
+
   vgDestroyPath((VGPath) args[0]->Uint32Value());
+  registry::Destroyed((VGHandle) args[0]->Uint32Value());
 
   V8_RETURN(Undefined());
 }
@@ -915,6 +1046,8 @@ V8_METHOD(openvg::AppendPath) {
 
   CheckArgs2(appendPath, dstPath, Number, srcPath, Number);
 
+  reorder::Barrier();
+
   vgAppendPath((VGPath) args[0]->Uint32Value(),
                (VGPath) args[1]->Uint32Value());
 
@@ -928,6 +1061,8 @@ V8_METHOD(openvg::AppendPathData) {
              dstPath, Number, numSegments, Int32, Uint8Array, Object,
              pathData, Object);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<VGubyte> segments(args[2]);
   TypedArrayWrapper<void> data(args[3]);
 
@@ -946,6 +1081,8 @@ V8_METHOD(openvg::AppendPathDataO) {
              dstPath, Number, numSegments, Int32, Uint8Array, Object,
              pathData, Object);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<VGubyte> segments(args[2]);
   TypedArrayWrapper<void> data(args[4]);
 
@@ -964,6 +1101,8 @@ V8_METHOD(openvg::ModifyPathCoords) {
              VGPath, Number, startIndex, Int32, numSegments, Int32,
              pathData, Object);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<void> data(args[3]);
 
   vgModifyPathCoords((VGPath) args[0]->Uint32Value(),
@@ -979,6 +1118,8 @@ V8_METHOD(openvg::TransformPath) {
 
   CheckArgs2(transformPath, dstPath, Number, srcPath, Number);
 
+  matrices::Sync();
+
   vgTransformPath((VGPath) args[0]->Uint32Value(),
                   (VGPath) args[1]->Uint32Value());
 
@@ -992,6 +1133,8 @@ V8_METHOD(openvg::InterpolatePath) {
              dstPath, Number, startPath, Number, endPath, Number,
              amount, Number);
 
+  reorder::Barrier();
+
   V8_RETURN(Boolean::New(vgInterpolatePath((VGPath) args[0]->Uint32Value(),
                                            (VGPath) args[1]->Uint32Value(),
                                            (VGPath) args[2]->Uint32Value(),
@@ -1059,6 +1202,7 @@ V8_METHOD(openvg::PathTransformedBounds) {
 
   VGfloat minX, minY, width, height;
 
+  matrices::Sync();
   vgPathTransformedBounds((VGPath) args[0]->Uint32Value(),
                           &minX, &minY, &width, &height);
 
@@ -1076,8 +1220,12 @@ V8_METHOD(openvg::DrawPath) {
 
   CheckArgs2(drawPath, VGPath, Number, paintModes, Number);
 
-  vgDrawPath((VGPath) args[0]->Uint32Value(),
-             (VGbitfield) args[1]->Uint32Value());
+  VGPath path = (VGPath) args[0]->Uint32Value();
+  VGbitfield paintModes = (VGbitfield) args[1]->Uint32Value();
+  if (!reorder::DrawPath(path, paintModes)) {
+    matrices::Sync();
+    vgDrawPath(path, paintModes);
+  }
 
   V8_RETURN(Undefined());
 }
@@ -1091,7 +1239,10 @@ V8_METHOD(openvg::CreatePaint) {
 
   CheckArgs0(createPaint);
 
-  V8_RETURN(Uint32::New(vgCreatePaint()));
+  VGPaint paint = vgCreatePaint();
+  registry::Created(paint);
+
+  V8_RETURN(Uint32::New(paint));
 }
 
 V8_METHOD(openvg::DestroyPaint) {
@@ -1099,7 +1250,11 @@ V8_METHOD(openvg::DestroyPaint) {
 
   CheckArgs1(destroyPaint, VGPaint, Number);
 
+  reorder::Barrier();
+
   vgDestroyPaint((VGPaint) args[0]->Uint32Value());
+  state::ForgetPaint((VGPaint) args[0]->Uint32Value());
+  registry::Destroyed((VGHandle) args[0]->Uint32Value());
 
   V8_RETURN(Undefined());
 }
@@ -1109,8 +1264,11 @@ V8_METHOD(openvg::SetPaint) {
 
   CheckArgs2(setPaint, VGPaint, Number, paintModes, Number);
 
-  vgSetPaint((VGPaint) args[0]->Uint32Value(),
-             (VGbitfield) args[1]->Uint32Value());
+  VGPaint paint = (VGPaint) args[0]->Uint32Value();
+  VGbitfield paintModes = (VGbitfield) args[1]->Uint32Value();
+  if (!reorder::SetPaint(paint, paintModes)) {
+    state::SetPaint(paint, paintModes);
+  }
 
   V8_RETURN(Undefined());
 }
@@ -1120,6 +1278,8 @@ V8_METHOD(openvg::GetPaint) {
 
   CheckArgs1(getPaint, VGPaint, Uint32);
 
+  reorder::Barrier();
+
   V8_RETURN(Uint32::New(vgGetPaint(static_cast<VGPaintMode>(args[0]->Uint32Value()))));
 }
 
@@ -1128,6 +1288,8 @@ V8_METHOD(openvg::SetColor) {
 
   CheckArgs2(setColor, VGPaint, Uint32, rgba, Uint32);
 
+  reorder::Barrier();
+
   vgSetColor((VGPaint) args[0]->Uint32Value(),
              (VGuint) args[1]->Uint32Value());
 
@@ -1147,8 +1309,10 @@ V8_METHOD(openvg::PaintPattern) {
 
   CheckArgs2(paintPattern, VGPaint, Uint32, VGImage, Uint32);
 
+  reorder::Barrier();
+
   vgPaintPattern((VGPaint) args[0]->Uint32Value(),
-                 (VGImage) args[1]->Uint32Value());
+                 registry::Read((VGImage) args[1]->Uint32Value()));
 
   V8_RETURN(Undefined());
 }
@@ -1164,10 +1328,10 @@ V8_METHOD(openvg::CreateImage) {
              VGImageFormat, Uint32, width, Int32, height, Int32,
              allowedQuality, Uint32);
 
-  V8_RETURN(Uint32::New(vgCreateImage(static_cast<VGImageFormat>(args[0]->Uint32Value()),
-                                      (VGint) args[1]->Int32Value(),
-                                      (VGint) args[2]->Int32Value(),
-                                      (VGuint) args[3]->Uint32Value())));
+  V8_RETURN(Uint32::New(registry::Create(static_cast<VGImageFormat>(args[0]->Uint32Value()),
+                                         (VGint) args[1]->Int32Value(),
+                                         (VGint) args[2]->Int32Value(),
+                                         (VGuint) args[3]->Uint32Value())));
 }
 
 V8_METHOD(openvg::DestroyImage) {
@@ -1175,7 +1339,9 @@ V8_METHOD(openvg::DestroyImage) {
 
   CheckArgs1(destroyImage, VGImage, Number);
 
-  vgDestroyImage((VGImage) (VGPaint) args[0]->Uint32Value());
+  reorder::Barrier();
+
+  registry::Destroy((VGImage) args[0]->Uint32Value());
 
   V8_RETURN(Undefined());
 }
@@ -1186,7 +1352,9 @@ V8_METHOD(openvg::ClearImage) {
   CheckArgs5(clearImage,
              VGImage, Number, x, Int32, y, Int32, width, Int32, height, Int32);
 
-  vgClearImage((VGImage) args[0]->Uint32Value(),
+  reorder::Barrier();
+
+  vgClearImage(registry::Use((VGImage) args[0]->Uint32Value()),
                (VGint) args[1]->Int32Value(),
                (VGint) args[2]->Int32Value(),
                (VGint) args[3]->Int32Value(),
@@ -1203,21 +1371,10 @@ V8_METHOD(openvg::ImageSubData) {
              dataFormat, Uint32,
              x, Int32, y, Int32, width, Int32, height, Int32);
 
-  Local<Object> data = args[1]->ToObject();
-  void *dataPointer;
+  reorder::Barrier();
 
-  Local<Value> nativeBuffer = data->Get(String::New("buffer"));
-  if (!nativeBuffer->IsUndefined()) {
-    // Native array
-    Handle<Object> dataBuffer = nativeBuffer->ToObject();
-    dataPointer = (void*) dataBuffer->GetIndexedPropertiesExternalArrayData();
-  } else {
-    // Node buffer
-    dataPointer = (void *) Buffer::Data(data);
-  }
-
-  vgImageSubData((VGImage) args[0]->Uint32Value(),
-                 dataPointer,
+  vgImageSubData(registry::Use((VGImage) args[0]->Uint32Value()),
+                 BufferData(args[1]),
                  (VGint) args[2]->Int32Value(),
                  static_cast<VGImageFormat>(args[3]->Uint32Value()),
                  (VGint) args[4]->Int32Value(),
@@ -1228,6 +1385,68 @@ V8_METHOD(openvg::ImageSubData) {
   V8_RETURN(Undefined());
 }
 
+V8_METHOD(openvg::ImageSubDataConvert) {
+  HandleScope scope;
+
+  CheckArgs8(imageSubDataConvert,
+             VGImage, Number, data, Object, dataStride, Int32,
+             dataFormat, Uint32,
+             x, Int32, y, Int32, width, Int32, height, Int32);
+
+  reorder::Barrier();
+
+  VGImage image = registry::Use((VGImage) args[0]->Uint32Value());
+  void *data = BufferData(args[1]);
+  VGint dataStride = (VGint) args[2]->Int32Value();
+  VGint dataFormat = (VGint) args[3]->Uint32Value();
+  VGint width = (VGint) args[6]->Int32Value();
+  VGint height = (VGint) args[7]->Int32Value();
+
+  if (!HoldsPixels(args[1], dataStride, dataFormat, width, height)) {
+    V8_THROW(Exception::RangeError(String::New("imageSubDataConvert: data shorter than dataStride * height")));
+  }
+
+  VGint stagingFormat = vgGetParameteri(image, VG_IMAGE_FORMAT);
+
+  if (!pixels::IsSupported(dataFormat)) {
+    if (dataFormat >= pixels::kRGB_888) {
+      V8_THROW(Exception::TypeError(String::New("imageSubDataConvert: unsupported dataFormat")));
+    }
+    // Leave it to the driver
+    stagingFormat = dataFormat;
+  } else if (!pixels::IsSupported(stagingFormat)) {
+    // Get as close as we can, the driver does the last step
+    stagingFormat = dataFormat < pixels::kRGB_888 ? dataFormat : VG_sRGBA_8888;
+  }
+
+  if (stagingFormat == dataFormat) {
+    vgImageSubData(image, data, dataStride,
+                   static_cast<VGImageFormat>(dataFormat),
+                   (VGint) args[4]->Int32Value(),
+                   (VGint) args[5]->Int32Value(),
+                   width, height);
+    V8_RETURN(Undefined());
+  }
+
+  VGint stagingStride = (width * pixels::BytesPerPixel(stagingFormat) + 15) & ~15;
+  void *staging = pixels::StagingBuffer((size_t) stagingStride * height);
+  if (staging == NULL) {
+    V8_THROW(Exception::Error(String::New("imageSubDataConvert: out of memory")));
+  }
+
+  pixels::Convert(staging, stagingStride, stagingFormat,
+                  data, dataStride, dataFormat,
+                  width, height);
+
+  vgImageSubData(image, staging, stagingStride,
+                 static_cast<VGImageFormat>(stagingFormat),
+                 (VGint) args[4]->Int32Value(),
+                 (VGint) args[5]->Int32Value(),
+                 width, height);
+
+  V8_RETURN(Undefined());
+}
+
 V8_METHOD(openvg::GetImageSubData) {
   HandleScope scope;
 
@@ -1236,9 +1455,11 @@ V8_METHOD(openvg::GetImageSubData) {
              dataFormat, Uint32,
              x, Int32, y, Int32, width, Int32, height, Int32);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<void> data(args[1]);
 
-  vgGetImageSubData((VGImage) args[0]->Uint32Value(),
+  vgGetImageSubData(registry::Read((VGImage) args[0]->Uint32Value()),
                     data.pointer(),
                     (VGint) args[2]->Int32Value(),
                     static_cast<VGImageFormat>(args[3]->Uint32Value()),
@@ -1256,11 +1477,11 @@ V8_METHOD(openvg::ChildImage) {
   CheckArgs5(childImage,
              VGImage, Number, x, Int32, y, Int32, width, Int32, height, Int32);
 
-  V8_RETURN(Uint32::New(vgChildImage((VGImage) args[0]->Uint32Value(),
-                                     (VGint) args[1]->Int32Value(),
-                                     (VGint) args[2]->Int32Value(),
-                                     (VGint) args[3]->Int32Value(),
-                                     (VGint) args[4]->Int32Value())));
+  V8_RETURN(Uint32::New(registry::CreateChild((VGImage) args[0]->Uint32Value(),
+                                              (VGint) args[1]->Int32Value(),
+                                              (VGint) args[2]->Int32Value(),
+                                              (VGint) args[3]->Int32Value(),
+                                              (VGint) args[4]->Int32Value())));
 }
 
 V8_METHOD(openvg::GetParent) {
@@ -1268,7 +1489,7 @@ V8_METHOD(openvg::GetParent) {
 
   CheckArgs1(getParent, VGImage, Number);
 
-  V8_RETURN(Uint32::New(vgGetParent((VGImage) args[0]->Uint32Value())));
+  V8_RETURN(Uint32::New(registry::KeyOf(vgGetParent(registry::Read((VGImage) args[0]->Uint32Value())))));
 }
 
 V8_METHOD(openvg::CopyImage) {
@@ -1279,10 +1500,12 @@ V8_METHOD(openvg::CopyImage) {
              srcImage, Number, sx, Int32, sy, Int32,
              width, Int32, height, Int32, dither, Boolean);
 
-  vgCopyImage((VGImage) args[0]->Uint32Value(),
+  reorder::Barrier();
+
+  vgCopyImage(registry::Use((VGImage) args[0]->Uint32Value()),
               (VGint) args[1]->Int32Value(),
               (VGint) args[2]->Int32Value(),
-              (VGImage) args[3]->Uint32Value(),
+              registry::Read((VGImage) args[3]->Uint32Value()),
               (VGint) args[4]->Int32Value(),
               (VGint) args[5]->Int32Value(),
               (VGint) args[6]->Int32Value(),
@@ -1297,7 +1520,11 @@ V8_METHOD(openvg::DrawImage) {
 
   CheckArgs1(drawImage, VGImage, Number);
 
-  vgDrawImage((VGImage) args[0]->Uint32Value());
+  VGImage image = (VGImage) args[0]->Uint32Value();
+  if (!reorder::DrawImage(image)) {
+    matrices::Sync();
+    registry::Draw(image);
+  }
 
   V8_RETURN(Undefined());
 }
@@ -1310,9 +1537,11 @@ V8_METHOD(openvg::SetPixels) {
              srcImage, Number, dx, Int32, dy, Int32,
              width, Int32, height, Int32);
 
+  reorder::Barrier();
+
   vgSetPixels((VGint) args[0]->Int32Value(),
               (VGint) args[1]->Int32Value(),
-              (VGImage) args[2]->Uint32Value(),
+              registry::Read((VGImage) args[2]->Uint32Value()),
               (VGint) args[3]->Int32Value(),
               (VGint) args[4]->Int32Value(),
               (VGint) args[5]->Int32Value(),
@@ -1328,6 +1557,8 @@ V8_METHOD(openvg::WritePixels) {
              dataFormat, Uint32,
              dx, Int32, dy, Int32, width, Int32, height, Int32);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<void> data(args[0]);
 
   vgWritePixels(data.pointer(),
@@ -1350,7 +1581,9 @@ V8_METHOD(openvg::GetPixels) {
              sx, Int32, sy, Int32,
              width, Int32, height, Int32);
 
-  vgGetPixels((VGImage) args[0]->Uint32Value(),
+  reorder::Barrier();
+
+  vgGetPixels(registry::Use((VGImage) args[0]->Uint32Value()),
               (VGint) args[1]->Int32Value(),
               (VGint) args[2]->Int32Value(),
               (VGint) args[3]->Int32Value(),
@@ -1368,6 +1601,8 @@ V8_METHOD(openvg::ReadPixels) {
              data, Object, dataStride, Int32, dataFormat, Uint32,
              sx, Int32, sy, Int32, width, Int32, height, Int32);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<void> data(args[0]);
 
   vgReadPixels(data.pointer(),
@@ -1388,6 +1623,8 @@ V8_METHOD(openvg::CopyPixels) {
              dx, Int32, dy, Int32, sx, Int32, sy, Int32,
              width, Int32, height, Int32);
 
+  reorder::Barrier();
+
   vgCopyPixels((VGint) args[0]->Int32Value(),
                (VGint) args[1]->Int32Value(),
                (VGint) args[2]->Int32Value(),
@@ -1398,6 +1635,34 @@ V8_METHOD(openvg::CopyPixels) {
   V8_RETURN(Undefined());
 }
 
+V8_METHOD(openvg::ConvertPixels) {
+  HandleScope scope;
+
+  CheckArgs8(convertPixels,
+             dst, Object, dstStride, Int32, dstFormat, Uint32,
+             src, Object, srcStride, Int32, srcFormat, Uint32,
+             width, Int32, height, Int32);
+
+  VGint dstStride = (VGint) args[1]->Int32Value();
+  VGint dstFormat = (VGint) args[2]->Uint32Value();
+  VGint srcStride = (VGint) args[4]->Int32Value();
+  VGint srcFormat = (VGint) args[5]->Uint32Value();
+  VGint width = (VGint) args[6]->Int32Value();
+  VGint height = (VGint) args[7]->Int32Value();
+
+  if (!HoldsPixels(args[0], dstStride, dstFormat, width, height)) {
+    V8_THROW(Exception::RangeError(String::New("convertPixels: dst shorter than dstStride * height")));
+  }
+  if (!HoldsPixels(args[3], srcStride, srcFormat, width, height)) {
+    V8_THROW(Exception::RangeError(String::New("convertPixels: src shorter than srcStride * height")));
+  }
+
+  V8_RETURN(Boolean::New(pixels::Convert(BufferData(args[0]),
+                                         dstStride, dstFormat,
+                                         BufferData(args[3]),
+                                         srcStride, srcFormat,
+                                         width, height)));
+}
 
 /* Text */
 
@@ -1407,7 +1672,10 @@ V8_METHOD(openvg::CreateFont) {
 
   CheckArgs1(createFont, glyphCapacityHint, Int32);
 
-  V8_RETURN(Uint32::New(vgCreateFont((VGint) args[0]->Int32Value())));
+  VGFont font = vgCreateFont((VGint) args[0]->Int32Value());
+  registry::Created(font);
+
+  V8_RETURN(Uint32::New(font));
 }
 
 V8_METHOD(openvg::DestroyFont) {
@@ -1416,6 +1684,7 @@ V8_METHOD(openvg::DestroyFont) {
   CheckArgs1(destroyFont, VGFont, Number);
 
   vgDestroyFont((VGFont) args[0]->Uint32Value());
+  registry::Destroyed((VGHandle) args[0]->Uint32Value());
 
   V8_RETURN(Undefined());
 }
@@ -1452,7 +1721,7 @@ V8_METHOD(openvg::SetGlyphToImage) {
 
   vgSetGlyphToImage((VGFont) args[0]->Uint32Value(),
                     (VGuint) args[1]->Uint32Value(),
-                    (VGImage) args[2]->Uint32Value(),
+                    registry::Read((VGImage) args[2]->Uint32Value()),
                     glyphOrigin.pointer(),
                     escapement.pointer());
 
@@ -1476,6 +1745,7 @@ V8_METHOD(openvg::DrawGlyph) {
   CheckArgs4(drawGlyph, VGFont, Number, glyphIndex, Uint32,
              paintModes, Uint32, allowAutoHinting, Boolean);
 
+  matrices::Sync();
   vgDrawGlyph((VGFont) args[0]->Uint32Value(),
               (VGuint) args[1]->Uint32Value(),
               (VGbitfield) args[2]->Uint32Value(),
@@ -1495,6 +1765,7 @@ V8_METHOD(openvg::DrawGlyphs) {
   TypedArrayWrapper<VGfloat> adjustments_x(args[3]);
   TypedArrayWrapper<VGfloat> adjustments_y(args[4]);
 
+  matrices::Sync();
   vgDrawGlyphs((VGFont) args[0]->Uint32Value(),
                (VGuint) args[1]->Uint32Value(),
                glyphIndices.pointer(),
@@ -1516,10 +1787,12 @@ V8_METHOD(openvg::ColorMatrix) {
   CheckArgs3(colorMatrix,
              dstVGImage, Number, srcVGImage, Number, matrix, Object);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<VGfloat> matrix(args[2]);
 
-  vgColorMatrix((VGImage) args[0]->Uint32Value(),
-                (VGImage) args[1]->Uint32Value(),
+  vgColorMatrix(registry::Use((VGImage) args[0]->Uint32Value()),
+                registry::Read((VGImage) args[1]->Uint32Value()),
                 matrix.pointer());
 
   V8_RETURN(Undefined());
@@ -1534,10 +1807,12 @@ V8_METHOD(openvg::Convolve) {
               kernel, Object, scale, Number, bias, Number,
               tilingMode, Uint32);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<VGshort> kernel(args[6]);
 
-  vgConvolve((VGImage) args[0]->Uint32Value(),
-             (VGImage) args[1]->Uint32Value(),
+  vgConvolve(registry::Use((VGImage) args[0]->Uint32Value()),
+             registry::Read((VGImage) args[1]->Uint32Value()),
              (VGint) args[2]->Int32Value(),
              (VGint) args[3]->Int32Value(),
              (VGint) args[4]->Int32Value(),
@@ -1560,11 +1835,13 @@ V8_METHOD(openvg::SeparableConvolve) {
               scale, Number, bias, Number,
               tilingMode, Uint32);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<VGshort> kernelX(args[6]);
   TypedArrayWrapper<VGshort> kernelY(args[7]);
 
-  vgSeparableConvolve((VGImage) args[0]->Uint32Value(),
-                      (VGImage) args[1]->Uint32Value(),
+  vgSeparableConvolve(registry::Use((VGImage) args[0]->Uint32Value()),
+                      registry::Read((VGImage) args[1]->Uint32Value()),
                       (VGint) args[2]->Int32Value(),
                       (VGint) args[3]->Int32Value(),
                       (VGint) args[4]->Int32Value(),
@@ -1585,8 +1862,10 @@ V8_METHOD(openvg::GaussianBlur) {
              stdDeviationX, Number, stdDeviationY, Number,
              tilingMode, Uint32);
 
-  vgGaussianBlur((VGImage) args[0]->Uint32Value(),
-                 (VGImage) args[1]->Uint32Value(),
+  reorder::Barrier();
+
+  vgGaussianBlur(registry::Use((VGImage) args[0]->Uint32Value()),
+                 registry::Read((VGImage) args[1]->Uint32Value()),
                  (VGfloat) args[2]->NumberValue(),
                  (VGfloat) args[3]->NumberValue(),
                  static_cast<VGTilingMode>(args[4]->Uint32Value()));
@@ -1602,13 +1881,15 @@ V8_METHOD(openvg::Lookup) {
              alphaLUT, Object,
              outputLinear, Boolean, outputPremultiplied, Boolean);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<VGubyte> redLUT(args[2]);
   TypedArrayWrapper<VGubyte> greenLUT(args[3]);
   TypedArrayWrapper<VGubyte> blueLUT(args[4]);
   TypedArrayWrapper<VGubyte> alphaLUT(args[5]);
 
-  vgLookup((VGImage) args[0]->Uint32Value(),
-           (VGImage) args[1]->Uint32Value(),
+  vgLookup(registry::Use((VGImage) args[0]->Uint32Value()),
+           registry::Read((VGImage) args[1]->Uint32Value()),
            redLUT.pointer(),
            greenLUT.pointer(),
            blueLUT.pointer(),
@@ -1626,10 +1907,12 @@ V8_METHOD(openvg::LookupSingle) {
              lookupTable, Object, sourceChannel, Uint32,
              outputLinear, Boolean, outputPremultiplied, Boolean);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<VGuint> lookupTable(args[2]);
 
-  vgLookupSingle((VGImage) args[0]->Uint32Value(),
-                 (VGImage) args[1]->Uint32Value(),
+  vgLookupSingle(registry::Use((VGImage) args[0]->Uint32Value()),
+                 registry::Read((VGImage) args[1]->Uint32Value()),
                  lookupTable.pointer(),
                  static_cast<VGImageChannel>(args[3]->Uint32Value()),
                  (VGboolean) args[4]->BooleanValue(),
@@ -1671,6 +1954,8 @@ V8_METHOD(openvg::vgu::Line) {
   CheckArgs5(line,
              VGPath, Number, x0, Number, y0, Number, x1, Number, y1, Number);
 
+  reorder::Barrier();
+
   V8_RETURN(Uint32::New(vguLine((VGPath) args[0]->Uint32Value(),
                                 (VGfloat) args[1]->NumberValue(),
                                 (VGfloat) args[2]->NumberValue(),
@@ -1685,6 +1970,8 @@ V8_METHOD(openvg::vgu::Polygon) {
              VGPath, Number, Float32Array, Object, count, Int32,
              closed, Boolean);
 
+  reorder::Barrier();
+
   TypedArrayWrapper<VGfloat> points(args[1]);
 
   V8_RETURN(Uint32::New(vguPolygon((VGPath) args[0]->Uint32Value(),
@@ -1699,6 +1986,8 @@ V8_METHOD(openvg::vgu::Rect) {
   CheckArgs5(rect, VGPath, Number, x, Number, y, Number,
              width, Number, height, Number);
 
+  reorder::Barrier();
+
   V8_RETURN(Uint32::New(vguRect((VGPath) args[0]->Uint32Value(),
                                 (VGfloat) args[1]->NumberValue(),
                                 (VGfloat) args[2]->NumberValue(),
@@ -1713,6 +2002,8 @@ V8_METHOD(openvg::vgu::RoundRect) {
              Number, x, Number, y, Number, width, Number, height,
              Number, arcWidth, Number, arcHeight, Number);
 
+  reorder::Barrier();
+
   V8_RETURN(Uint32::New(vguRoundRect((VGPath) args[0]->Uint32Value(),
                                      (VGfloat) args[1]->NumberValue(),
                                      (VGfloat) args[2]->NumberValue(),
@@ -1728,6 +2019,8 @@ V8_METHOD(openvg::vgu::Ellipse) {
   CheckArgs5(ellipse, VGPath, Number, x, Number, y, Number,
              width, Number, height, Number);
 
+  reorder::Barrier();
+
   V8_RETURN(Uint32::New(vguEllipse((VGPath) args[0]->Uint32Value(),
                                    (VGfloat) args[1]->NumberValue(),
                                    (VGfloat) args[2]->NumberValue(),
@@ -1743,6 +2036,8 @@ V8_METHOD(openvg::vgu::Arc) {
              width, Number, height, Number,
              startAngle, Number, angleExtent, Number, VGUArcType, Uint32);
 
+  reorder::Barrier();
+
   V8_RETURN(Uint32::New(vguArc((VGPath) args[0]->Uint32Value(),
                                (VGfloat) args[1]->NumberValue(),
                                (VGfloat) args[2]->NumberValue(),
@@ -1844,16 +2139,17 @@ V8_METHOD(openvg::ext::IterativeAverageBlurKHR) {
   CheckArgs6(iterativeAverageBlurKHR,
              dstVGImage, Number, srcVGImage, Number,
              dimX, Number, dimY, Number, iterative, Number,
-             tilingMode, Object);
+             tilingMode, Uint32);
 
-#ifdef VG_VGEXT_PROTOTYPES
-  vgIterativeAverageBlurKHR((VGImage) args[0]->Uint32Value(),
-                            (VGImage) args[1]->Uint32Value(),
+  reorder::Barrier();
+
+  khr::IterativeAverageBlur(registry::Use((VGImage) args[0]->Uint32Value()),
+                            registry::Read((VGImage) args[1]->Uint32Value()),
                             (VGfloat) args[2]->NumberValue(),
                             (VGfloat) args[3]->NumberValue(),
-                            (VGImage) args[4]->Uint32Value(),
-                            static_cast<VGTilingMode>((VGImage) args[5]->Uint32Value()));
-#endif
+                            (VGuint) args[4]->Uint32Value(),
+                            static_cast<VGTilingMode>(args[5]->Uint32Value()));
+
   V8_RETURN(Undefined());
 }
 
@@ -1865,17 +2161,17 @@ V8_METHOD(openvg::ext::ParametricFilterKHR) {
              strength, Number, offsetX, Number, offsetY, Number,
              filterFlags, Number, highlightPaint, Number, shadowPaint, Number);
 
-#ifdef VG_VGEXT_PROTOTYPES
-  vgParametricFilterKHR((VGImage) args[0]->Uint32Value(),
-                        (VGImage) args[1]->Uint32Value(),
-                        (VGImage) args[2]->Uint32Value(),
+  reorder::Barrier();
+
+  khr::ParametricFilter(registry::Use((VGImage) args[0]->Uint32Value()),
+                        registry::Read((VGImage) args[1]->Uint32Value()),
+                        registry::Read((VGImage) args[2]->Uint32Value()),
                         (VGfloat) args[3]->NumberValue(),
                         (VGfloat) args[4]->NumberValue(),
                         (VGfloat) args[5]->NumberValue(),
                         (VGbitfield) args[6]->Uint32Value(),
                         (VGPaint) args[7]->Uint32Value(),
                         (VGPaint) args[8]->Uint32Value());
-#endif
 
   V8_RETURN(Undefined());
 }
@@ -1890,21 +2186,19 @@ V8_METHOD(openvg::ext::DropShadowKHR) {
               filterFlags, Number, allowedQuality, Number,
               shadowColorRGBA, Number);
 
-#ifdef VG_VGEXT_PROTOTYPES
-  V8_RETURN(Uint32::New(vguDropShadowKHR((VGImage) args[0]->Uint32Value(),
-                                         (VGImage) args[1]->Uint32Value(),
-                                         (VGfloat) args[2]->NumberValue(),
-                                         (VGfloat) args[3]->NumberValue(),
-                                         (VGuint) args[4]->Uint32Value(),
-                                         (VGfloat) args[5]->NumberValue(),
-                                         (VGfloat) args[6]->NumberValue(),
-                                         (VGfloat) args[7]->NumberValue(),
-                                         (VGbitfield) args[8]->Uint32Value(),
-                                         (VGbitfield) args[9]->Uint32Value(),
-                                         (VGuint) args[10]->Uint32Value())));
-#else
-  V8_RETURN(Undefined());
-#endif
+  reorder::Barrier();
+
+  V8_RETURN(Uint32::New(khr::DropShadow(registry::Use((VGImage) args[0]->Uint32Value()),
+                                        registry::Read((VGImage) args[1]->Uint32Value()),
+                                        (VGfloat) args[2]->NumberValue(),
+                                        (VGfloat) args[3]->NumberValue(),
+                                        (VGuint) args[4]->Uint32Value(),
+                                        (VGfloat) args[5]->NumberValue(),
+                                        (VGfloat) args[6]->NumberValue(),
+                                        (VGfloat) args[7]->NumberValue(),
+                                        (VGbitfield) args[8]->Uint32Value(),
+                                        (VGbitfield) args[9]->Uint32Value(),
+                                        (VGuint) args[10]->Uint32Value())));
 }
 
 V8_METHOD(openvg::ext::GlowKHR) {
@@ -1917,19 +2211,17 @@ V8_METHOD(openvg::ext::GlowKHR) {
              filterFlags, Number, allowedQuality, Number,
              glowColorRGBA, Number);
 
-#ifdef VG_VGEXT_PROTOTYPES
-  V8_RETURN(Uint32::New(vguGlowKHR((VGImage) args[0]->Uint32Value(),
-                                   (VGImage) args[1]->Uint32Value(),
-                                   (VGfloat) args[2]->NumberValue(),
-                                   (VGfloat) args[3]->NumberValue(),
-                                   (VGuint) args[4]->Uint32Value(),
-                                   (VGfloat) args[5]->NumberValue(),
-                                   (VGbitfield) args[6]->Uint32Value(),
-                                   (VGbitfield) args[7]->Uint32Value(),
-                                   (VGuint) args[8]->Uint32Value())));
-#else
-  V8_RETURN(Undefined());
-#endif
+  reorder::Barrier();
+
+  V8_RETURN(Uint32::New(khr::Glow(registry::Use((VGImage) args[0]->Uint32Value()),
+                                  registry::Read((VGImage) args[1]->Uint32Value()),
+                                  (VGfloat) args[2]->NumberValue(),
+                                  (VGfloat) args[3]->NumberValue(),
+                                  (VGuint) args[4]->Uint32Value(),
+                                  (VGfloat) args[5]->NumberValue(),
+                                  (VGbitfield) args[6]->Uint32Value(),
+                                  (VGbitfield) args[7]->Uint32Value(),
+                                  (VGuint) args[8]->Uint32Value())));
 }
 
 V8_METHOD(openvg::ext::BevelKHR) {
@@ -1942,39 +2234,76 @@ V8_METHOD(openvg::ext::BevelKHR) {
               filterFlags, Number, allowedQuality, Number,
               highlightColorRGBA, Number, shadowColorRGBA, Number);
 
-#ifdef VG_VGEXT_PROTOTYPES
-  V8_RETURN(Uint32::New(vguBevelKHR((VGImage) args[0]->Uint32Value(),
-                                    (VGImage) args[1]->Uint32Value(),
-                                    (VGfloat) args[2]->NumberValue(),
-                                    (VGfloat) args[3]->NumberValue(),
-                                    (VGuint) args[4]->Uint32Value(),
-                                    (VGfloat) args[5]->NumberValue(),
-                                    (VGfloat) args[6]->NumberValue(),
-                                    (VGfloat) args[7]->NumberValue(),
-                                    (VGbitfield) args[8]->Uint32Value(),
-                                    (VGbitfield) args[9]->Uint32Value(),
-                                    (VGuint) args[10]->Uint32Value(),
-                                    (VGuint) args[11]->Uint32Value())));
-#else
-  V8_RETURN(Undefined());
-#endif
+  reorder::Barrier();
+
+  V8_RETURN(Uint32::New(khr::Bevel(registry::Use((VGImage) args[0]->Uint32Value()),
+                                   registry::Read((VGImage) args[1]->Uint32Value()),
+                                   (VGfloat) args[2]->NumberValue(),
+                                   (VGfloat) args[3]->NumberValue(),
+                                   (VGuint) args[4]->Uint32Value(),
+                                   (VGfloat) args[5]->NumberValue(),
+                                   (VGfloat) args[6]->NumberValue(),
+                                   (VGfloat) args[7]->NumberValue(),
+                                   (VGbitfield) args[8]->Uint32Value(),
+                                   (VGbitfield) args[9]->Uint32Value(),
+                                   (VGuint) args[10]->Uint32Value(),
+                                   (VGuint) args[11]->Uint32Value())));
 }
 
 V8_METHOD(openvg::ext::GradientGlowKHR) {
   HandleScope scope;
 
-  CheckArgs12(gradientGlowKHR,
-              dstVGImage, Number, srcVGImage, Number,
-              dimX, Number, dimY, Number, iterative, Number,
-              strength, Number, distance, Number, angle, Number,
-              filterFlags, Number, allowedQuality, Number,
-              stopsCount, Number, Float32Array, Object);
+  // Always checked: the stops are read below
+  if (!(args.Length() == 12 && args[0]->IsNumber() && args[1]->IsNumber() &&
+        args[2]->IsNumber() && args[3]->IsNumber() && args[4]->IsNumber() &&
+        args[5]->IsNumber() && args[6]->IsNumber() && args[7]->IsNumber() &&
+        args[8]->IsNumber() && args[9]->IsNumber() && args[10]->IsUint32() &&
+        IsFloat32Array(args[11]))) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected gradientGlowKHR(Number, Number, Number, Number, Number, Number, Number, Number, Number, Number, Uint32, Float32Array)")));
+  }
 
-#ifdef VG_VGEXT_PROTOTYPES
   TypedArrayWrapper<VGfloat> glowColorRampStops(args[11]);
+  if ((size_t) glowColorRampStops.length() / 5 < args[10]->Uint32Value()) {
+    V8_THROW(Exception::TypeError(String::New("gradientGlowKHR: expected 5 values per stop")));
+  }
+
+  reorder::Barrier();
+
+  V8_RETURN(Uint32::New(khr::GradientGlow(registry::Use((VGImage) args[0]->Uint32Value()),
+                                          registry::Read((VGImage) args[1]->Uint32Value()),
+                                          (VGfloat) args[2]->NumberValue(),
+                                          (VGfloat) args[3]->NumberValue(),
+                                          (VGuint) args[4]->Uint32Value(),
+                                          (VGfloat) args[5]->NumberValue(),
+                                          (VGfloat) args[6]->NumberValue(),
+                                          (VGfloat) args[7]->NumberValue(),
+                                          (VGbitfield) args[8]->Uint32Value(),
+                                          (VGbitfield) args[9]->Uint32Value(),
+                                          (VGuint) args[10]->Uint32Value(),
+                                          glowColorRampStops.pointer())));
+}
+
+V8_METHOD(openvg::ext::GradientBevelKHR) {
+  HandleScope scope;
 
-  V8_RETURN(Uint32::New(vguGradientGlowKHR((VGImage) args[0]->Uint32Value(),
-                                           (VGImage) args[1]->Uint32Value(),
+  // Always checked: the stops are read below
+  if (!(args.Length() == 12 && args[0]->IsNumber() && args[1]->IsNumber() &&
+        args[2]->IsNumber() && args[3]->IsNumber() && args[4]->IsNumber() &&
+        args[5]->IsNumber() && args[6]->IsNumber() && args[7]->IsNumber() &&
+        args[8]->IsNumber() && args[9]->IsNumber() && args[10]->IsUint32() &&
+        IsFloat32Array(args[11]))) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected gradientBevelKHR(Number, Number, Number, Number, Number, Number, Number, Number, Number, Number, Uint32, Float32Array)")));
+  }
+
+  TypedArrayWrapper<VGfloat> bevelColorRampStops(args[11]);
+  if ((size_t) bevelColorRampStops.length() / 5 < args[10]->Uint32Value()) {
+    V8_THROW(Exception::TypeError(String::New("gradientBevelKHR: expected 5 values per stop")));
+  }
+
+  reorder::Barrier();
+
+  V8_RETURN(Uint32::New(khr::GradientBevel(registry::Use((VGImage) args[0]->Uint32Value()),
+                                           registry::Read((VGImage) args[1]->Uint32Value()),
                                            (VGfloat) args[2]->NumberValue(),
                                            (VGfloat) args[3]->NumberValue(),
                                            (VGuint) args[4]->Uint32Value(),
@@ -1984,40 +2313,7 @@ V8_METHOD(openvg::ext::GradientGlowKHR) {
                                            (VGbitfield) args[8]->Uint32Value(),
                                            (VGbitfield) args[9]->Uint32Value(),
                                            (VGuint) args[10]->Uint32Value(),
-                                           glowColorRampStops.pointer())));
-#else
-  V8_RETURN(Undefined());
-#endif
-}
-
-V8_METHOD(openvg::ext::GradientBevelKHR) {
-  HandleScope scope;
-
-  CheckArgs12(gradientBevelKHR,
-              dstVGImage, Number, srcVGImage, Number,
-              dimX, Number, dimY, Number, iterative, Number,
-              strength, Number, distance, Number, angle, Number,
-              filterFlags, Number, allowedQuality, Number,
-              stopsCount, Number, Float32Array, Object);
-
-#ifdef VG_VGEXT_PROTOTYPES
-  TypedArrayWrapper<VGfloat> bevelColorRampStops(args[11]);
-
-  V8_RETURN(Uint32::New(vguGradientBevelKHR((VGImage) args[0]->Uint32Value(),
-                                            (VGImage) args[1]->Uint32Value(),
-                                            (VGfloat) args[2]->NumberValue(),
-                                            (VGfloat) args[3]->NumberValue(),
-                                            (VGuint) args[4]->Uint32Value(),
-                                            (VGfloat) args[5]->NumberValue(),
-                                            (VGfloat) args[6]->NumberValue(),
-                                            (VGfloat) args[7]->NumberValue(),
-                                            (VGbitfield) args[8]->Uint32Value(),
-                                            (VGbitfield) args[9]->Uint32Value(),
-                                            (VGuint) args[10]->Uint32Value(),
-                                            bevelColorRampStops.pointer())));
-#else
-  V8_RETURN(Undefined());
-#endif
+                                           bevelColorRampStops.pointer())));
 }
 
 V8_METHOD(openvg::ext::ProjectiveMatrixNDS) {
@@ -101,6 +101,7 @@ V8_METHOD_DECL(CreateImage);
 V8_METHOD_DECL(DestroyImage);
 V8_METHOD_DECL(ClearImage);
 V8_METHOD_DECL(ImageSubData);
+V8_METHOD_DECL(ImageSubDataConvert);
 V8_METHOD_DECL(GetImageSubData);
 V8_METHOD_DECL(ChildImage);
 V8_METHOD_DECL(GetParent);
@@ -111,6 +112,7 @@ V8_METHOD_DECL(WritePixels);
 V8_METHOD_DECL(GetPixels);
 V8_METHOD_DECL(ReadPixels);
 V8_METHOD_DECL(CopyPixels);
+V8_METHOD_DECL(ConvertPixels);
 
 /* Text */
 V8_METHOD_DECL(CreateFont);
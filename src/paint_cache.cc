@@ -0,0 +1,266 @@
+#include <string.h>
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include "VG/openvg.h"
+
+#include "paint_cache.h"
+#include "state_cache.h"
+#include "draw_reorder.h"
+#include "image_registry.h"
+#include "typed_array.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+struct gradient_key_t {
+  uint64_t hash;
+  VGPaintType type;
+  VGColorRampSpreadMode spreadMode;
+  bool premultiplied;
+  std::vector<uint32_t> values;  // Geometry then stops, as float bits
+
+  bool operator<(const gradient_key_t &other) const {
+    if (hash != other.hash) return hash < other.hash;
+    if (type != other.type) return type < other.type;
+    if (spreadMode != other.spreadMode) return spreadMode < other.spreadMode;
+    if (premultiplied != other.premultiplied) return premultiplied < other.premultiplied;
+    return values < other.values;
+  }
+};
+
+struct cache_entry_t {
+  gradient_key_t key;
+  VGPaint paint;
+};
+
+typedef std::list<cache_entry_t> lru_t;
+
+lru_t lru;  // Most recently used first
+std::map<gradient_key_t, lru_t::iterator> cache;
+
+size_t capacity = 64;
+size_t hits = 0, misses = 0, evictions = 0, droppedStops = 0;
+
+VGint maxStops = -1;  // VG_MAX_COLOR_RAMP_STOPS, queried on first use
+
+uint64_t Hash(const std::vector<uint32_t> &values) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < values.size(); i++) {
+    hash = (hash ^ values[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+void Push(std::vector<uint32_t> *values, VGfloat value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  values->push_back(bits);
+}
+
+VGfloat Clamp(VGfloat value) {
+  return value < 0 ? 0 : (value > 1 ? 1 : value);
+}
+
+// Appends the stops the driver would use: offsets in [0, 1] and not
+// decreasing, colors clamped, at most VG_MAX_COLOR_RAMP_STOPS of them.
+void AppendStops(std::vector<uint32_t> *values,
+                 const VGfloat *stops, size_t stopCount) {
+  if (maxStops < 0) {
+    maxStops = vgGeti(VG_MAX_COLOR_RAMP_STOPS);
+  }
+
+  size_t kept = 0;
+  VGfloat previous = 0;
+  for (size_t i = 0; i < stopCount; i++) {
+    const VGfloat *stop = stops + i * gradients::kStopValues;
+    if (!(stop[0] >= previous && stop[0] <= 1) || kept >= (size_t) maxStops) {
+      droppedStops++;
+      continue;
+    }
+    previous = stop[0];
+    Push(values, stop[0]);
+    for (size_t j = 1; j < gradients::kStopValues; j++) {
+      Push(values, Clamp(stop[j]));
+    }
+    kept++;
+  }
+}
+
+VGPaint Create(const gradient_key_t &key, size_t geometryLength) {
+  VGPaint paint = vgCreatePaint();
+  if (paint == VG_INVALID_HANDLE) {
+    return paint;
+  }
+  registry::Created(paint);
+
+  const VGfloat *values = reinterpret_cast<const VGfloat*>(&key.values[0]);
+  vgSetParameteri(paint, VG_PAINT_TYPE, key.type);
+  vgSetParameterfv(paint, key.type == VG_PAINT_TYPE_LINEAR_GRADIENT ?
+                   VG_PAINT_LINEAR_GRADIENT : VG_PAINT_RADIAL_GRADIENT,
+                   (VGint) geometryLength, values);
+  vgSetParameterfv(paint, VG_PAINT_COLOR_RAMP_STOPS,
+                   (VGint) (key.values.size() - geometryLength),
+                   values + geometryLength);
+  vgSetParameteri(paint, VG_PAINT_COLOR_RAMP_SPREAD_MODE, key.spreadMode);
+  vgSetParameteri(paint, VG_PAINT_COLOR_RAMP_PREMULTIPLIED,
+                  key.premultiplied ? VG_TRUE : VG_FALSE);
+  return paint;
+}
+
+void Evict() {
+  cache_entry_t &entry = lru.back();
+  reorder::Barrier();
+  vgDestroyPaint(entry.paint);
+  state::ForgetPaint(entry.paint);
+  registry::Destroyed(entry.paint);
+  cache.erase(entry.key);
+  lru.pop_back();
+  evictions++;
+}
+
+void Trim() {
+  while (cache.size() > capacity) {
+    Evict();
+  }
+}
+
+}
+
+VGPaint gradients::Get(VGPaintType type,
+                       const VGfloat *geometry, size_t geometryLength,
+                       const VGfloat *stops, size_t stopCount,
+                       VGColorRampSpreadMode spreadMode, bool premultiplied) {
+  size_t expected = type == VG_PAINT_TYPE_LINEAR_GRADIENT ? 4 :
+                    type == VG_PAINT_TYPE_RADIAL_GRADIENT ? 5 : 0;
+  if (expected == 0 || geometryLength != expected) {
+    return VG_INVALID_HANDLE;
+  }
+
+  gradient_key_t key;
+  key.type = type;
+  key.spreadMode = spreadMode;
+  key.premultiplied = premultiplied;
+  key.values.reserve(geometryLength + stopCount * kStopValues);
+  for (size_t i = 0; i < geometryLength; i++) {
+    Push(&key.values, geometry[i]);
+  }
+  AppendStops(&key.values, stops, stopCount);
+  key.hash = Hash(key.values);
+
+  std::map<gradient_key_t, lru_t::iterator>::iterator it = cache.find(key);
+  if (it != cache.end()) {
+    lru.splice(lru.begin(), lru, it->second);
+    hits++;
+    return it->second->paint;
+  }
+
+  misses++;
+  VGPaint paint = Create(key, geometryLength);
+  if (paint == VG_INVALID_HANDLE) {
+    return paint;
+  }
+
+  cache_entry_t entry = { key, paint };
+  lru.push_front(entry);
+  cache[key] = lru.begin();
+  Trim();
+  return paint;
+}
+
+void gradients::SetCapacity(size_t paints) {
+  // The paint just returned has to stay valid
+  capacity = paints > 0 ? paints : 1;
+  Trim();
+}
+
+void gradients::Clear() {
+  while (!lru.empty()) {
+    Evict();
+  }
+}
+
+void gradients::GetStats(stats_t *stats) {
+  stats->entries = cache.size();
+  stats->capacity = capacity;
+  stats->hits = hits;
+  stats->misses = misses;
+  stats->evictions = evictions;
+  stats->droppedStops = droppedStops;
+}
+
+
+extern void gradients::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "getGradientPaint"     , gradients::GetGradientPaint);
+  NODE_SET_METHOD(target, "setGradientCacheSize" , gradients::SetGradientCacheSize);
+  NODE_SET_METHOD(target, "clearGradientCache"   , gradients::ClearGradientCache);
+  NODE_SET_METHOD(target, "getGradientCacheStats", gradients::GetGradientCacheStats);
+}
+
+V8_METHOD(gradients::GetGradientPaint) {
+  HandleScope scope;
+
+  // Always checked: the arrays are read below
+  if (!(args.Length() == 5 && args[0]->IsUint32() && args[1]->IsObject() &&
+        args[2]->IsObject() && args[3]->IsUint32() && args[4]->IsBoolean())) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected getGradientPaint(VGPaintType,Float32Array,Float32Array,VGColorRampSpreadMode,premultiplied)")));
+  }
+
+  TypedArrayWrapper<VGfloat> geometry(args[1]);
+  TypedArrayWrapper<VGfloat> stops(args[2]);
+
+  VGPaint paint = Get(static_cast<VGPaintType>(args[0]->Uint32Value()),
+                      geometry.pointer(), geometry.length(),
+                      stops.pointer(), stops.length() / kStopValues,
+                      static_cast<VGColorRampSpreadMode>(args[3]->Uint32Value()),
+                      args[4]->BooleanValue());
+  if (paint == VG_INVALID_HANDLE) {
+    V8_THROW(Exception::TypeError(String::New("getGradientPaint: expected a linear gradient with 4 values or a radial gradient with 5")));
+  }
+
+  V8_RETURN(Uint32::New(paint));
+}
+
+V8_METHOD(gradients::SetGradientCacheSize) {
+  HandleScope scope;
+
+  CheckArgs1(setGradientCacheSize, paints, Uint32);
+
+  SetCapacity(args[0]->Uint32Value());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(gradients::ClearGradientCache) {
+  HandleScope scope;
+
+  CheckArgs0(clearGradientCache);
+
+  Clear();
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(gradients::GetGradientCacheStats) {
+  HandleScope scope;
+
+  CheckArgs1(getGradientCacheStats, stats, Object);
+
+  stats_t stats;
+  GetStats(&stats);
+
+  Local<Object> result = args[0].As<Object>();
+  result->Set(String::NewSymbol("entries"), Number::New(stats.entries));
+  result->Set(String::NewSymbol("capacity"), Number::New(stats.capacity));
+  result->Set(String::NewSymbol("hits"), Number::New(stats.hits));
+  result->Set(String::NewSymbol("misses"), Number::New(stats.misses));
+  result->Set(String::NewSymbol("evictions"), Number::New(stats.evictions));
+  result->Set(String::NewSymbol("droppedStops"), Number::New(stats.droppedStops));
+
+  V8_RETURN(Undefined());
+}
@@ -0,0 +1,56 @@
+#ifndef NODE_OPENVG_PAINT_CACHE_H_
+#define NODE_OPENVG_PAINT_CACHE_H_
+
+#include <stddef.h>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// Gradient paints kept across frames, keyed by everything that defines
+// them: paint type, gradient geometry, color ramp stops, spread mode and
+// premultiplication. The stops are validated once, as the driver would,
+// before building the key, so equivalent ramps share a paint. The least
+// recently used paints are destroyed past the capacity; a paint handle is
+// valid until then, so callers ask for it every time they draw with it
+// rather than keeping it.
+namespace gradients {
+
+const size_t kStopValues = 5;  // Offset, R, G, B, A
+
+struct stats_t {
+  size_t entries;
+  size_t capacity;
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+  size_t droppedStops;  // Out of range, out of order or over the limit
+};
+
+// geometry is x0, y0, x1, y1 for linear gradients and cx, cy, fx, fy, r for
+// radial ones. Returns VG_INVALID_HANDLE for other types and geometries of
+// the wrong size.
+VGPaint Get(VGPaintType type, const VGfloat *geometry, size_t geometryLength,
+            const VGfloat *stops, size_t stopCount,
+            VGColorRampSpreadMode spreadMode, bool premultiplied);
+
+// At least one.
+void SetCapacity(size_t paints);
+void Clear();
+void GetStats(stats_t *stats);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(GetGradientPaint);
+V8_FUNCTION_DECL(SetGradientCacheSize);
+V8_FUNCTION_DECL(ClearGradientCache);
+V8_FUNCTION_DECL(GetGradientCacheStats);
+
+}
+
+#endif
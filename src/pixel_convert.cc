@@ -0,0 +1,463 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXELS_SSE2
+#elif (defined(__ARM_NEON__) || defined(__ARM_NEON)) && \
+      __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#include <arm_neon.h>
+#define PIXELS_NEON
+#endif
+
+#include "pixel_convert.h"
+
+// Conversions go through a canonical 32 bit word per pixel holding R in bits
+// 0-7, G in 8-15, B in 16-23 and A in 24-31 (the VG_sABGR_8888 ordering,
+// i.e. RGBA bytes on little endian machines). 8888 to 8888 conversions that
+// don't change premultiplication are done in a single swizzle pass.
+
+namespace {
+
+enum kind_t {
+  kNone,
+  k8888,
+  k565,
+  kL8,
+  kA8,
+  k888
+};
+
+const int kCanonicalShifts[4] = { 0, 8, 16, 24 };
+
+kind_t Kind(VGint format) {
+  if (format == pixels::kRGB_888 || format == pixels::kBGR_888) {
+    return k888;
+  }
+
+  // Only the channel order bits (6 and 7) may be set on top of the base
+  if (format & ~0xdf) {
+    return kNone;
+  }
+
+  bool reordered = (format & 0xc0) != 0;
+
+  switch (format & 0x1f) {
+  case 0: case 1: case 2: case 7: case 8: case 9:
+    return k8888;
+  case 3:
+    return (format & (1 << 6)) ? kNone : k565;
+  case 6: case 10:
+    return reordered ? kNone : kL8;
+  case 11:
+    return reordered ? kNone : kA8;
+  default:
+    return kNone;
+  }
+}
+
+bool HasAlpha(VGint format) {
+  switch (Kind(format)) {
+  case k8888:
+    return (format & 0x1f) != 0 && (format & 0x1f) != 7;
+  case kA8:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Bit position of R, G, B and A inside a 8888 pixel word.
+void Shifts8888(VGint format, int shifts[4]) {
+  bool alphaFirst = (format & (1 << 6)) != 0;
+  bool bgr = (format & (1 << 7)) != 0;
+  int first = alphaFirst ? 16 : 24;
+
+  shifts[bgr ? 2 : 0] = first;
+  shifts[1] = first - 8;
+  shifts[bgr ? 0 : 2] = first - 16;
+  shifts[3] = alphaFirst ? 24 : 0;
+}
+
+inline uint32_t SwizzlePixel(uint32_t p, const int *s, const int *d,
+                             int channels, uint32_t fill) {
+  uint32_t o = fill;
+  for (int c = 0; c < channels; c++) {
+    o |= ((p >> s[c]) & 0xff) << d[c];
+  }
+  return o;
+}
+
+// Moves each of the first `channels` bytes from shift s[c] to shift d[c],
+// and ORs `fill` into the result (used to force opaque alpha).
+void Swizzle(const uint32_t *src, uint32_t *dst, int n,
+             const int *s, const int *d, int channels, uint32_t fill) {
+  int i = 0;
+
+#if defined(PIXELS_SSE2)
+  const __m128i byteMask = _mm_set1_epi32(0xff);
+  const __m128i fillV = _mm_set1_epi32(fill);
+  __m128i sc[4], dc[4];
+  for (int c = 0; c < channels; c++) {
+    sc[c] = _mm_cvtsi32_si128(s[c]);
+    dc[c] = _mm_cvtsi32_si128(d[c]);
+  }
+
+  for (; i + 4 <= n; i += 4) {
+    __m128i p = _mm_loadu_si128((const __m128i*) (src + i));
+    __m128i o = fillV;
+    for (int c = 0; c < channels; c++) {
+      __m128i ch = _mm_and_si128(_mm_srl_epi32(p, sc[c]), byteMask);
+      o = _mm_or_si128(o, _mm_sll_epi32(ch, dc[c]));
+    }
+    _mm_storeu_si128((__m128i*) (dst + i), o);
+  }
+#elif defined(PIXELS_NEON)
+  const uint32x4_t byteMask = vdupq_n_u32(0xff);
+  const uint32x4_t fillV = vdupq_n_u32(fill);
+  int32x4_t sc[4], dc[4];
+  for (int c = 0; c < channels; c++) {
+    sc[c] = vdupq_n_s32(-s[c]);
+    dc[c] = vdupq_n_s32(d[c]);
+  }
+
+  for (; i + 4 <= n; i += 4) {
+    uint32x4_t p = vld1q_u32(src + i);
+    uint32x4_t o = fillV;
+    for (int c = 0; c < channels; c++) {
+      uint32x4_t ch = vandq_u32(vshlq_u32(p, sc[c]), byteMask);
+      o = vorrq_u32(o, vshlq_u32(ch, dc[c]));
+    }
+    vst1q_u32(dst + i, o);
+  }
+#endif
+
+  for (; i < n; i++) {
+    dst[i] = SwizzlePixel(src[i], s, d, channels, fill);
+  }
+}
+
+inline uint32_t MulDiv255(uint32_t c, uint32_t a) {
+  uint32_t t = c * a + 128;
+  return (t + (t >> 8)) >> 8;
+}
+
+void Premultiply(uint32_t *px, int n) {
+  int i = 0;
+
+#if defined(PIXELS_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi16(128);
+  // Multiply the alpha lanes by 255 instead of by themselves
+  const __m128i colorLanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+  const __m128i alphaLanes = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+
+  for (; i + 4 <= n; i += 4) {
+    __m128i p = _mm_loadu_si128((const __m128i*) (px + i));
+    __m128i lo = _mm_unpacklo_epi8(p, zero);
+    __m128i hi = _mm_unpackhi_epi8(p, zero);
+
+    __m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xff), 0xff);
+    __m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xff), 0xff);
+    alo = _mm_or_si128(_mm_and_si128(alo, colorLanes), alphaLanes);
+    ahi = _mm_or_si128(_mm_and_si128(ahi, colorLanes), alphaLanes);
+
+    lo = _mm_add_epi16(_mm_mullo_epi16(lo, alo), round);
+    hi = _mm_add_epi16(_mm_mullo_epi16(hi, ahi), round);
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+    _mm_storeu_si128((__m128i*) (px + i), _mm_packus_epi16(lo, hi));
+  }
+#elif defined(PIXELS_NEON)
+  for (; i + 8 <= n; i += 8) {
+    uint8x8x4_t p = vld4_u8((const uint8_t*) (px + i));
+    for (int c = 0; c < 3; c++) {
+      uint16x8_t t = vmull_u8(p.val[c], p.val[3]);
+      p.val[c] = vraddhn_u16(t, vrshrq_n_u16(t, 8));
+    }
+    vst4_u8((uint8_t*) (px + i), p);
+  }
+#endif
+
+  for (; i < n; i++) {
+    uint32_t p = px[i];
+    uint32_t a = p >> 24;
+    px[i] = MulDiv255(p & 0xff, a) |
+            MulDiv255((p >> 8) & 0xff, a) << 8 |
+            MulDiv255((p >> 16) & 0xff, a) << 16 |
+            (a << 24);
+  }
+}
+
+// There is no integer division in SSE2 or NEON, so this one stays scalar and
+// uses a 16.16 reciprocal table instead.
+void Unpremultiply(uint32_t *px, int n) {
+  static uint32_t reciprocal[256];
+  if (reciprocal[255] == 0) {
+    for (uint32_t a = 1; a < 256; a++) {
+      reciprocal[a] = (255u * 65536u + a / 2) / a;
+    }
+  }
+
+  for (int i = 0; i < n; i++) {
+    uint32_t p = px[i];
+    uint32_t a = p >> 24;
+    if (a == 255) {
+      continue;
+    }
+    uint32_t r = reciprocal[a];
+    uint32_t o = a << 24;
+    for (int shift = 0; shift < 24; shift += 8) {
+      uint32_t c = (((p >> shift) & 0xff) * r + 0x8000) >> 16;
+      o |= (c > 255 ? 255 : c) << shift;
+    }
+    px[i] = o;
+  }
+}
+
+void Unpack565(const uint16_t *src, uint32_t *dst, int n, bool bgr) {
+  for (int i = 0; i < n; i++) {
+    uint32_t p = src[i];
+    uint32_t hi = (p >> 11) & 0x1f, g = (p >> 5) & 0x3f, lo = p & 0x1f;
+    hi = (hi << 3) | (hi >> 2);
+    g = (g << 2) | (g >> 4);
+    lo = (lo << 3) | (lo >> 2);
+    dst[i] = (bgr ? lo | (hi << 16) : hi | (lo << 16)) | (g << 8) | 0xff000000;
+  }
+}
+
+void Pack565(const uint32_t *src, uint16_t *dst, int n, bool bgr) {
+  int i = 0;
+
+#if defined(PIXELS_SSE2)
+  const __m128i mask5 = _mm_set1_epi32(0x1f);
+  const __m128i mask6 = _mm_set1_epi32(0x3f);
+  const __m128i bias32 = _mm_set1_epi32(0x8000);
+  const __m128i bias16 = _mm_set1_epi16((short) 0x8000);
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i o[2];
+    for (int k = 0; k < 2; k++) {
+      __m128i p = _mm_loadu_si128((const __m128i*) (src + i + 4 * k));
+      __m128i r = _mm_and_si128(_mm_srli_epi32(p, 3), mask5);
+      __m128i g = _mm_and_si128(_mm_srli_epi32(p, 10), mask6);
+      __m128i b = _mm_and_si128(_mm_srli_epi32(p, 19), mask5);
+      __m128i hi = bgr ? b : r, lo = bgr ? r : b;
+      o[k] = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(hi, 11),
+                                       _mm_slli_epi32(g, 5)), lo);
+      // Bias into signed range so the saturating pack keeps the value
+      o[k] = _mm_sub_epi32(o[k], bias32);
+    }
+    __m128i packed = _mm_xor_si128(_mm_packs_epi32(o[0], o[1]), bias16);
+    _mm_storeu_si128((__m128i*) (dst + i), packed);
+  }
+#elif defined(PIXELS_NEON)
+  for (; i + 8 <= n; i += 8) {
+    uint8x8x4_t p = vld4_u8((const uint8_t*) (src + i));
+    uint16x8_t o = vshll_n_u8(p.val[bgr ? 2 : 0], 8);
+    o = vsriq_n_u16(o, vshll_n_u8(p.val[1], 8), 5);
+    o = vsriq_n_u16(o, vshll_n_u8(p.val[bgr ? 0 : 2], 8), 11);
+    vst1q_u16(dst + i, o);
+  }
+#endif
+
+  for (; i < n; i++) {
+    uint32_t p = src[i];
+    uint32_t r = (p >> 3) & 0x1f, g = (p >> 10) & 0x3f, b = (p >> 19) & 0x1f;
+    dst[i] = (uint16_t) (((bgr ? b : r) << 11) | (g << 5) | (bgr ? r : b));
+  }
+}
+
+void Unpack888(const uint8_t *src, uint32_t *dst, int n, bool bgr) {
+  int i = 0;
+
+#if defined(PIXELS_NEON)
+  for (; i + 8 <= n; i += 8) {
+    uint8x8x3_t p = vld3_u8(src + 3 * i);
+    uint8x8x4_t o;
+    o.val[0] = p.val[bgr ? 2 : 0];
+    o.val[1] = p.val[1];
+    o.val[2] = p.val[bgr ? 0 : 2];
+    o.val[3] = vdup_n_u8(0xff);
+    vst4_u8((uint8_t*) (dst + i), o);
+  }
+#endif
+
+  for (; i < n; i++) {
+    const uint8_t *p = src + 3 * i;
+    uint32_t r = p[bgr ? 2 : 0], g = p[1], b = p[bgr ? 0 : 2];
+    dst[i] = r | (g << 8) | (b << 16) | 0xff000000;
+  }
+}
+
+void Pack888(const uint32_t *src, uint8_t *dst, int n, bool bgr) {
+  for (int i = 0; i < n; i++) {
+    uint32_t p = src[i];
+    uint8_t *o = dst + 3 * i;
+    o[bgr ? 2 : 0] = p & 0xff;
+    o[1] = (p >> 8) & 0xff;
+    o[bgr ? 0 : 2] = (p >> 16) & 0xff;
+  }
+}
+
+void Unpack(const void *src, VGint format, uint32_t *dst, int n) {
+  switch (Kind(format)) {
+  case k8888: {
+    int shifts[4];
+    Shifts8888(format, shifts);
+    bool alpha = HasAlpha(format);
+    Swizzle((const uint32_t*) src, dst, n, shifts, kCanonicalShifts,
+            alpha ? 4 : 3, alpha ? 0 : 0xff000000);
+    break;
+  }
+  case k565:
+    Unpack565((const uint16_t*) src, dst, n, (format & (1 << 7)) != 0);
+    break;
+  case k888:
+    Unpack888((const uint8_t*) src, dst, n, format == pixels::kBGR_888);
+    break;
+  case kL8:
+    for (int i = 0; i < n; i++) {
+      uint32_t l = ((const uint8_t*) src)[i];
+      dst[i] = l | (l << 8) | (l << 16) | 0xff000000;
+    }
+    break;
+  case kA8:
+    for (int i = 0; i < n; i++) {
+      dst[i] = 0x00ffffff | ((uint32_t) ((const uint8_t*) src)[i] << 24);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+void Pack(const uint32_t *src, void *dst, VGint format, int n) {
+  switch (Kind(format)) {
+  case k8888: {
+    int shifts[4];
+    Shifts8888(format, shifts);
+    Swizzle(src, (uint32_t*) dst, n, kCanonicalShifts, shifts, 4, 0);
+    break;
+  }
+  case k565:
+    Pack565(src, (uint16_t*) dst, n, (format & (1 << 7)) != 0);
+    break;
+  case k888:
+    Pack888(src, (uint8_t*) dst, n, format == pixels::kBGR_888);
+    break;
+  case kL8:
+    // Rec. 709 luma weights, in 8.8 fixed point
+    for (int i = 0; i < n; i++) {
+      uint32_t p = src[i];
+      uint32_t l = (54 * (p & 0xff) + 183 * ((p >> 8) & 0xff) +
+                    19 * ((p >> 16) & 0xff) + 128) >> 8;
+      ((uint8_t*) dst)[i] = (uint8_t) (l > 255 ? 255 : l);
+    }
+    break;
+  case kA8:
+    for (int i = 0; i < n; i++) {
+      ((uint8_t*) dst)[i] = (uint8_t) (src[i] >> 24);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+}
+
+int pixels::BytesPerPixel(VGint format) {
+  switch (Kind(format)) {
+  case k8888: return 4;
+  case k565:  return 2;
+  case k888:  return 3;
+  case kL8:
+  case kA8:   return 1;
+  default:    return 0;
+  }
+}
+
+bool pixels::Convert(void *dst, VGint dstStride, VGint dstFormat,
+                     const void *src, VGint srcStride, VGint srcFormat,
+                     VGint width, VGint height) {
+  kind_t srcKind = Kind(srcFormat), dstKind = Kind(dstFormat);
+  if (srcKind == kNone || dstKind == kNone) {
+    return false;
+  }
+
+  if (width <= 0 || height <= 0) {
+    return true;
+  }
+
+  const uint8_t *s = (const uint8_t*) src;
+  uint8_t *d = (uint8_t*) dst;
+
+  if (srcFormat == dstFormat) {
+    if (s == d && srcStride == dstStride) {
+      return true;
+    }
+    size_t rowBytes = (size_t) width * BytesPerPixel(srcFormat);
+    for (VGint y = 0; y < height; y++, s += srcStride, d += dstStride) {
+      memcpy(d, s, rowBytes);
+    }
+    return true;
+  }
+
+  bool srcAlpha = HasAlpha(srcFormat), dstAlpha = HasAlpha(dstFormat);
+  bool srcPre = IsPremultiplied(srcFormat), dstPre = IsPremultiplied(dstFormat);
+
+  // Opaque sources are already "premultiplied" and alpha only destinations
+  // don't care about colour.
+  bool premultiply = dstPre && !srcPre && srcAlpha;
+  bool unpremultiply = srcPre && !dstPre && dstKind != kA8;
+
+  if (srcKind == k8888 && dstKind == k8888 && !premultiply && !unpremultiply) {
+    int srcShifts[4], dstShifts[4];
+    Shifts8888(srcFormat, srcShifts);
+    Shifts8888(dstFormat, dstShifts);
+    int channels = srcAlpha ? 4 : 3;
+    uint32_t fill = (!srcAlpha && dstAlpha) ? 0xffu << dstShifts[3] : 0;
+
+    for (VGint y = 0; y < height; y++, s += srcStride, d += dstStride) {
+      Swizzle((const uint32_t*) s, (uint32_t*) d, width,
+              srcShifts, dstShifts, channels, fill);
+    }
+    return true;
+  }
+
+  std::vector<uint32_t> row(width);
+
+  for (VGint y = 0; y < height; y++, s += srcStride, d += dstStride) {
+    Unpack(s, srcFormat, &row[0], width);
+    if (premultiply) {
+      Premultiply(&row[0], width);
+    } else if (unpremultiply) {
+      Unpremultiply(&row[0], width);
+    }
+    Pack(&row[0], d, dstFormat, width);
+  }
+
+  return true;
+}
+
+void *pixels::StagingBuffer(size_t size) {
+  static void *buffer = NULL;
+  static size_t capacity = 0;
+
+  if (size > capacity) {
+    free(buffer);
+    if (posix_memalign(&buffer, 16, size) != 0) {
+      buffer = NULL;
+      capacity = 0;
+      return NULL;
+    }
+    capacity = size;
+  }
+
+  return buffer;
+}
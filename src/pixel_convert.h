@@ -0,0 +1,53 @@
+#ifndef NODE_OPENVG_PIXEL_CONVERT_H_
+#define NODE_OPENVG_PIXEL_CONVERT_H_
+
+#include <stddef.h>
+
+#include "VG/openvg.h"
+
+namespace pixels {
+
+// Packed 24 bit layouts (byte order in memory), which have no VGImageFormat
+// counterpart. They can't be uploaded directly, only converted.
+const VGint kRGB_888 = 0x100;
+const VGint kBGR_888 = 0x100 | (1 << 7);
+
+// R, G, B, A bytes in memory, as produced by most decoders.
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+const VGint kRGBA_8888 = VG_sABGR_8888;
+const VGint kRGBA_8888_PRE = VG_sABGR_8888_PRE;
+#else
+const VGint kRGBA_8888 = VG_sRGBA_8888;
+const VGint kRGBA_8888_PRE = VG_sRGBA_8888_PRE;
+#endif
+
+// Returns the size of a pixel in bytes, or 0 if the format can't be handled
+// by Convert.
+int BytesPerPixel(VGint format);
+
+inline bool IsSupported(VGint format) {
+  return BytesPerPixel(format) != 0;
+}
+
+inline bool IsPremultiplied(VGint format) {
+  VGint base = format & 0x1f;
+  return format < 0x100 && (base == 2 || base == 9);
+}
+
+// Converts a width x height rectangle between two pixel formats. Strides are
+// in bytes and may be negative (bottom-up data). Only the channel layout,
+// premultiplication and packing are converted: linear/sRGB tagging is
+// carried over as is. dst may alias src as long as strides are equal and
+// dstFormat isn't wider than srcFormat. Returns false if either format is
+// unsupported.
+bool Convert(void *dst, VGint dstStride, VGint dstFormat,
+             const void *src, VGint srcStride, VGint srcFormat,
+             VGint width, VGint height);
+
+// Grow-only, 16 byte aligned scratch buffer shared by the upload paths.
+// Only valid until the next call.
+void *StagingBuffer(size_t size);
+
+}
+
+#endif
@@ -0,0 +1,384 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXELS_SSE2
+#elif (defined(__ARM_NEON__) || defined(__ARM_NEON)) && \
+      __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#include <arm_neon.h>
+#define PIXELS_NEON
+#endif
+
+#include "pixel_filter.h"
+
+void pixels::Downsample2x(void *dst, VGint dstStride,
+                          const void *src, VGint srcStride,
+                          VGint width, VGint height) {
+  for (VGint y = 0; y < height; y++) {
+    const uint8_t *row0 = (const uint8_t*) src + (2 * y) * srcStride;
+    const uint8_t *row1 = row0 + srcStride;
+    uint8_t *out = (uint8_t*) dst + y * dstStride;
+    VGint x = 0;
+
+#if defined(PIXELS_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+
+    // 4 destination pixels from 8 source pixels per row
+    for (; x + 4 <= width; x += 4) {
+      __m128i sums[2];
+      for (int k = 0; k < 2; k++) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (row0 + 8 * (x + 2 * k)));
+        __m128i b = _mm_loadu_si128((const __m128i*) (row1 + 8 * (x + 2 * k)));
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                   _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                   _mm_unpackhi_epi8(b, zero));
+        // Add horizontal neighbours: pixel 0 + 1 and pixel 2 + 3
+        lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+        hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+        sums[k] = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), two), 2);
+      }
+      _mm_storeu_si128((__m128i*) (out + 4 * x), _mm_packus_epi16(sums[0], sums[1]));
+    }
+#elif defined(PIXELS_NEON)
+    // 8 destination pixels from 16 source pixels per row
+    for (; x + 8 <= width; x += 8) {
+      uint8x16x4_t a = vld4q_u8(row0 + 8 * x);
+      uint8x16x4_t b = vld4q_u8(row1 + 8 * x);
+      uint8x8x4_t o;
+      for (int c = 0; c < 4; c++) {
+        uint16x8_t sum = vaddq_u16(vpaddlq_u8(a.val[c]), vpaddlq_u8(b.val[c]));
+        o.val[c] = vrshrn_n_u16(sum, 2);
+      }
+      vst4_u8(out + 4 * x, o);
+    }
+#endif
+
+    for (; x < width; x++) {
+      const uint8_t *a = row0 + 8 * x, *b = row1 + 8 * x;
+      for (int c = 0; c < 4; c++) {
+        out[4 * x + c] = (uint8_t) ((a[c] + a[c + 4] + b[c] + b[c + 4] + 2) >> 2);
+      }
+    }
+  }
+}
+
+namespace {
+
+// Maps a sample index outside [0, size) according to the tiling mode, -1
+// meaning the fill value.
+inline int Tile(int i, int size, VGTilingMode tiling) {
+  if (i >= 0 && i < size) {
+    return i;
+  }
+  switch (tiling) {
+  case VG_TILE_PAD:
+    return i < 0 ? 0 : size - 1;
+  case VG_TILE_REPEAT:
+    i %= size;
+    return i < 0 ? i + size : i;
+  case VG_TILE_REFLECT:
+    i %= 2 * size;
+    if (i < 0) {
+      i += 2 * size;
+    }
+    return i < size ? i : 2 * size - 1 - i;
+  default:
+    return -1;
+  }
+}
+
+#if defined(PIXELS_SSE2)
+typedef __m128i sum4_t;
+
+inline sum4_t Load4(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  __m128i zero = _mm_setzero_si128();
+  return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero), zero);
+}
+
+inline sum4_t Zero4() { return _mm_setzero_si128(); }
+inline sum4_t Add4(sum4_t a, sum4_t b) { return _mm_add_epi32(a, b); }
+inline sum4_t Sub4(sum4_t a, sum4_t b) { return _mm_sub_epi32(a, b); }
+
+inline void Store4(uint8_t *p, sum4_t sum, float scale) {
+  __m128i v = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum), _mm_set1_ps(scale)));
+  v = _mm_packs_epi32(v, v);
+  uint32_t out = (uint32_t) _mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+  memcpy(p, &out, 4);
+}
+#elif defined(PIXELS_NEON)
+typedef uint32x4_t sum4_t;
+
+inline sum4_t Load4(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  uint8x8_t bytes = vreinterpret_u8_u32(vdup_n_u32(v));
+  return vmovl_u16(vget_low_u16(vmovl_u8(bytes)));
+}
+
+inline sum4_t Zero4() { return vdupq_n_u32(0); }
+inline sum4_t Add4(sum4_t a, sum4_t b) { return vaddq_u32(a, b); }
+inline sum4_t Sub4(sum4_t a, sum4_t b) { return vsubq_u32(a, b); }
+
+inline void Store4(uint8_t *p, sum4_t sum, float scale) {
+  float32x4_t f = vmlaq_n_f32(vdupq_n_f32(0.5f), vcvtq_f32_u32(sum), scale);
+  uint16x4_t v = vmovn_u32(vcvtq_u32_f32(f));
+  uint32_t out = vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(v, v))), 0);
+  memcpy(p, &out, 4);
+}
+#endif
+
+void BlurRow(uint8_t *dst, const uint8_t *src, int channels, VGint width,
+             int radius, VGTilingMode tiling, const uint8_t *fill) {
+  const float scale = 1.0f / (2 * radius + 1);
+
+#if defined(PIXELS_SSE2) || defined(PIXELS_NEON)
+  if (channels == 4) {
+    sum4_t sum = Zero4();
+    for (int i = -radius; i <= radius; i++) {
+      int t = Tile(i, width, tiling);
+      sum = Add4(sum, Load4(t < 0 ? fill : src + 4 * t));
+    }
+    for (VGint x = 0; x < width; x++) {
+      Store4(dst + 4 * x, sum, scale);
+      int in = Tile(x + radius + 1, width, tiling);
+      int out = Tile(x - radius, width, tiling);
+      sum = Sub4(Add4(sum, Load4(in < 0 ? fill : src + 4 * in)),
+                 Load4(out < 0 ? fill : src + 4 * out));
+    }
+    return;
+  }
+#endif
+
+  for (int c = 0; c < channels; c++) {
+    int sum = 0;
+    for (int i = -radius; i <= radius; i++) {
+      int t = Tile(i, width, tiling);
+      sum += t < 0 ? fill[c] : src[channels * t + c];
+    }
+    for (VGint x = 0; x < width; x++) {
+      dst[channels * x + c] = (uint8_t) (sum * scale + 0.5f);
+      int in = Tile(x + radius + 1, width, tiling);
+      int out = Tile(x - radius, width, tiling);
+      sum += (in < 0 ? fill[c] : src[channels * in + c]) -
+             (out < 0 ? fill[c] : src[channels * out + c]);
+    }
+  }
+}
+
+// Vertical pass: running column sums over whole rows.
+void BlurColumns(uint8_t *dst, VGint dstStride,
+                 const uint8_t *src, VGint srcStride, const uint8_t *fillRow,
+                 int32_t *sums, VGint count, VGint height,
+                 int radius, VGTilingMode tiling) {
+  const float scale = 1.0f / (2 * radius + 1);
+
+  memset(sums, 0, sizeof(int32_t) * count);
+  for (int i = -radius; i <= radius; i++) {
+    int t = Tile(i, height, tiling);
+    const uint8_t *row = t < 0 ? fillRow : src + (size_t) t * srcStride;
+    for (VGint k = 0; k < count; k++) {
+      sums[k] += row[k];
+    }
+  }
+
+  for (VGint y = 0; y < height; y++) {
+    int in = Tile(y + radius + 1, height, tiling);
+    int out = Tile(y - radius, height, tiling);
+    const uint8_t *add = in < 0 ? fillRow : src + (size_t) in * srcStride;
+    const uint8_t *sub = out < 0 ? fillRow : src + (size_t) out * srcStride;
+    uint8_t *row = dst + (size_t) y * dstStride;
+    VGint k = 0;
+
+#if defined(PIXELS_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 factor = _mm_set1_ps(scale);
+    for (; k + 16 <= count; k += 16) {
+      __m128i *s = (__m128i*) (sums + k);
+      __m128i lo = _mm_packs_epi32(
+        _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(s[0]), factor)),
+        _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(s[1]), factor)));
+      __m128i hi = _mm_packs_epi32(
+        _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(s[2]), factor)),
+        _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(s[3]), factor)));
+      _mm_storeu_si128((__m128i*) (row + k), _mm_packus_epi16(lo, hi));
+
+      __m128i a = _mm_loadu_si128((const __m128i*) (add + k));
+      __m128i b = _mm_loadu_si128((const __m128i*) (sub + k));
+      __m128i dLo = _mm_sub_epi16(_mm_unpacklo_epi8(a, zero),
+                                  _mm_unpacklo_epi8(b, zero));
+      __m128i dHi = _mm_sub_epi16(_mm_unpackhi_epi8(a, zero),
+                                  _mm_unpackhi_epi8(b, zero));
+      // Sign extend the 16 bit differences
+      s[0] = _mm_add_epi32(s[0], _mm_srai_epi32(_mm_unpacklo_epi16(dLo, dLo), 16));
+      s[1] = _mm_add_epi32(s[1], _mm_srai_epi32(_mm_unpackhi_epi16(dLo, dLo), 16));
+      s[2] = _mm_add_epi32(s[2], _mm_srai_epi32(_mm_unpacklo_epi16(dHi, dHi), 16));
+      s[3] = _mm_add_epi32(s[3], _mm_srai_epi32(_mm_unpackhi_epi16(dHi, dHi), 16));
+    }
+#elif defined(PIXELS_NEON)
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    for (; k + 16 <= count; k += 16) {
+      int32x4_t s[4];
+      uint16x4_t v[4];
+      for (int j = 0; j < 4; j++) {
+        s[j] = vld1q_s32(sums + k + 4 * j);
+        v[j] = vmovn_u32(vcvtq_u32_f32(vmlaq_n_f32(half, vcvtq_f32_s32(s[j]), scale)));
+      }
+      vst1q_u8(row + k, vcombine_u8(vmovn_u16(vcombine_u16(v[0], v[1])),
+                                    vmovn_u16(vcombine_u16(v[2], v[3]))));
+
+      uint8x16_t a = vld1q_u8(add + k);
+      uint8x16_t b = vld1q_u8(sub + k);
+      int16x8_t dLo = vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(a), vget_low_u8(b)));
+      int16x8_t dHi = vreinterpretq_s16_u16(vsubl_u8(vget_high_u8(a), vget_high_u8(b)));
+      vst1q_s32(sums + k +  0, vaddw_s16(s[0], vget_low_s16(dLo)));
+      vst1q_s32(sums + k +  4, vaddw_s16(s[1], vget_high_s16(dLo)));
+      vst1q_s32(sums + k +  8, vaddw_s16(s[2], vget_low_s16(dHi)));
+      vst1q_s32(sums + k + 12, vaddw_s16(s[3], vget_high_s16(dHi)));
+    }
+#endif
+
+    for (; k < count; k++) {
+      row[k] = (uint8_t) (sums[k] * scale + 0.5f);
+      sums[k] += add[k] - sub[k];
+    }
+  }
+}
+
+}
+
+bool pixels::BoxBlur(void *dst, VGint dstStride,
+                     const void *src, VGint srcStride,
+                     int channels, VGint width, VGint height,
+                     int radiusX, int radiusY, int passes,
+                     VGTilingMode tiling, const VGubyte *fill) {
+  VGint count = width * channels;
+  uint8_t *rows = (uint8_t*) malloc((size_t) count * (height + 1));
+  int32_t *sums = NULL;
+  if (rows == NULL ||
+      posix_memalign((void**) &sums, 16, sizeof(int32_t) * count) != 0) {
+    free(rows);
+    return false;
+  }
+
+  uint8_t *fillRow = rows + (size_t) count * height;
+  for (VGint k = 0; k < count; k++) {
+    fillRow[k] = fill != NULL ? fill[k % channels] : 0;
+  }
+
+  const uint8_t *in = (const uint8_t*) src;
+  VGint inStride = srcStride;
+  for (int pass = 0; pass < passes; pass++) {
+    for (VGint y = 0; y < height; y++) {
+      BlurRow(rows + (size_t) y * count, in + (size_t) y * inStride,
+              channels, width, radiusX, tiling, fillRow);
+    }
+    BlurColumns((uint8_t*) dst, dstStride, rows, count, fillRow,
+                sums, count, height, radiusY, tiling);
+    in = (const uint8_t*) dst;
+    inStride = dstStride;
+  }
+
+  free(rows);
+  free(sums);
+  return true;
+}
+
+namespace {
+
+// Source index and 7 bit weight of the next sample, for each destination
+// column or row. index is kept below size - 1 so index + 1 is always valid.
+void BilinearTaps(VGint dstSize, VGint srcSize, int32_t *index, int16_t *weight) {
+  float scale = (float) srcSize / dstSize;
+  for (VGint i = 0; i < dstSize; i++) {
+    float position = (i + 0.5f) * scale - 0.5f;
+    if (position < 0.0f) {
+      position = 0.0f;
+    }
+    int32_t base = (int32_t) position;
+    int16_t fraction = (int16_t) ((position - base) * 128 + 0.5f);
+    if (base >= srcSize - 1) {
+      base = srcSize > 1 ? srcSize - 2 : 0;
+      fraction = srcSize > 1 ? 128 : 0;
+    }
+    index[i] = base;
+    weight[i] = fraction;
+  }
+}
+
+}
+
+bool pixels::ResizeBilinear(void *dst, VGint dstStride,
+                            VGint dstWidth, VGint dstHeight,
+                            const void *src, VGint srcStride,
+                            VGint srcWidth, VGint srcHeight) {
+  int32_t *xIndex = (int32_t*) malloc(sizeof(int32_t) * (dstWidth + dstHeight));
+  int16_t *xWeight = (int16_t*) malloc(sizeof(int16_t) * (dstWidth + dstHeight));
+  if (xIndex == NULL || xWeight == NULL) {
+    free(xIndex);
+    free(xWeight);
+    return false;
+  }
+  int32_t *yIndex = xIndex + dstWidth;
+  int16_t *yWeight = xWeight + dstWidth;
+  BilinearTaps(dstWidth, srcWidth, xIndex, xWeight);
+  BilinearTaps(dstHeight, srcHeight, yIndex, yWeight);
+
+  // Single column sources would read past the row
+  bool vector = srcWidth > 1;
+
+  for (VGint y = 0; y < dstHeight; y++) {
+    const uint8_t *row0 = (const uint8_t*) src + (size_t) yIndex[y] * srcStride;
+    const uint8_t *row1 = srcHeight > 1 ? row0 + srcStride : row0;
+    int wy = yWeight[y];
+    uint8_t *out = (uint8_t*) dst + (size_t) y * dstStride;
+    VGint x = 0;
+
+#if defined(PIXELS_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vy = _mm_set1_epi16((short) wy);
+    for (; vector && x < dstWidth; x++) {
+      // Both horizontal neighbours at once, as 2 x 4 words
+      __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (row0 + 4 * xIndex[x])), zero);
+      __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) (row1 + 4 * xIndex[x])), zero);
+      __m128i v = _mm_add_epi16(a, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(b, a), vy), 7));
+      __m128i left = v, right = _mm_srli_si128(v, 8);
+      __m128i h = _mm_add_epi16(left, _mm_srai_epi16(
+        _mm_mullo_epi16(_mm_sub_epi16(right, left), _mm_set1_epi16(xWeight[x])), 7));
+      uint32_t pixel = (uint32_t) _mm_cvtsi128_si32(_mm_packus_epi16(h, h));
+      memcpy(out + 4 * x, &pixel, 4);
+    }
+#elif defined(PIXELS_NEON)
+    for (; vector && x < dstWidth; x++) {
+      int16x8_t a = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(row0 + 4 * xIndex[x])));
+      int16x8_t b = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(row1 + 4 * xIndex[x])));
+      int16x8_t v = vaddq_s16(a, vshrq_n_s16(vmulq_n_s16(vsubq_s16(b, a), wy), 7));
+      int16x4_t left = vget_low_s16(v), right = vget_high_s16(v);
+      int16x4_t h = vadd_s16(left, vshr_n_s16(vmul_n_s16(vsub_s16(right, left), xWeight[x]), 7));
+      uint8x8_t bytes = vqmovun_s16(vcombine_s16(h, h));
+      uint32_t pixel = vget_lane_u32(vreinterpret_u32_u8(bytes), 0);
+      memcpy(out + 4 * x, &pixel, 4);
+    }
+#endif
+
+    for (; x < dstWidth; x++) {
+      const uint8_t *a = row0 + 4 * xIndex[x], *b = row1 + 4 * xIndex[x];
+      int next = srcWidth > 1 ? 4 : 0;
+      int wx = xWeight[x];
+      for (int c = 0; c < 4; c++) {
+        int left = a[c] + (((b[c] - a[c]) * wy) >> 7);
+        int right = a[c + next] + (((b[c + next] - a[c + next]) * wy) >> 7);
+        out[4 * x + c] = (uint8_t) (left + (((right - left) * wx) >> 7));
+      }
+    }
+  }
+
+  free(xIndex);
+  free(xWeight);
+  return true;
+}
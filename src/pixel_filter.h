@@ -0,0 +1,33 @@
+#ifndef NODE_OPENVG_PIXEL_FILTER_H_
+#define NODE_OPENVG_PIXEL_FILTER_H_
+
+#include "VG/openvg.h"
+
+// CPU image filters working on 32 bit premultiplied pixels
+// (pixels::kRGBA_8888_PRE).
+namespace pixels {
+
+// Halves an image with a 2x2 box filter. width and height are the size of
+// the destination; odd source rows/columns past 2 * width are ignored.
+void Downsample2x(void *dst, VGint dstStride,
+                  const void *src, VGint srcStride,
+                  VGint width, VGint height);
+
+
+// Separable box blur with a (2 * radiusX + 1) x (2 * radiusY + 1) window on
+// 8 bit data with 1 or 4 interleaved channels, repeated `passes` times.
+// Samples outside the image follow `tiling`, VG_TILE_FILL taking one value
+// per channel from `fill`. dst may be src. Returns false if out of memory.
+bool BoxBlur(void *dst, VGint dstStride, const void *src, VGint srcStride,
+             int channels, VGint width, VGint height,
+             int radiusX, int radiusY, int passes,
+             VGTilingMode tiling, const VGubyte *fill);
+
+// Bilinear resize of 32 bit pixels, sampling pixel centers.
+bool ResizeBilinear(void *dst, VGint dstStride, VGint dstWidth, VGint dstHeight,
+                    const void *src, VGint srcStride,
+                    VGint srcWidth, VGint srcHeight);
+
+}
+
+#endif
@@ -0,0 +1,1137 @@
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+
+#include "VG/openvg.h"
+
+#include "scene_graph.h"
+#include "animation_timeline.h"
+#include "clip_stack.h"
+#include "egl.h"
+#include "image_registry.h"
+#include "matrix_stack.h"
+#include "state_cache.h"
+#include "text_layer.h"
+#include "typed_array.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+// Damage rectangles kept per scene before the closest ones are merged
+const size_t kMaxDamage = 8;
+
+// Pixels added around content bounds for antialiasing
+const VGint kPadding = 1;
+
+struct scene_t {
+  std::vector<scene::rect_t> damage;
+  VGfloat background[4];
+  bool rendered;
+};
+
+std::map<uint32_t, scene::node_t> nodes;
+uint32_t nextNode = 1;
+
+std::map<uint32_t, scene_t> scenes;
+
+size_t renders = 0, skippedRenders = 0, layerImages = 0, layerRenders = 0;
+size_t dirtyRects = 0, updatedNodes = 0, drawnNodes = 0, compositedLayers = 0;
+
+// Of the layers being drawn directly, applied to everything drawn
+VGfloat opacity = 1;
+
+const VGfloat kIdentity[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+
+const scene::rect_t kEmpty = { 0, 0, 0, 0 };
+
+bool IsEmpty(const scene::rect_t &r) {
+  return r.x0 >= r.x1 || r.y0 >= r.y1;
+}
+
+scene::rect_t Union(const scene::rect_t &a, const scene::rect_t &b) {
+  if (IsEmpty(a)) return b;
+  if (IsEmpty(b)) return a;
+  scene::rect_t r = { std::min(a.x0, b.x0), std::min(a.y0, b.y0),
+                      std::max(a.x1, b.x1), std::max(a.y1, b.y1) };
+  return r;
+}
+
+scene::rect_t Intersection(const scene::rect_t &a, const scene::rect_t &b) {
+  scene::rect_t r = { std::max(a.x0, b.x0), std::max(a.y0, b.y0),
+                      std::min(a.x1, b.x1), std::min(a.y1, b.y1) };
+  return IsEmpty(r) ? kEmpty : r;
+}
+
+bool Touches(const scene::rect_t &a, const scene::rect_t &b) {
+  return a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1;
+}
+
+double Area(const scene::rect_t &r) {
+  return IsEmpty(r) ? 0 : (double) (r.x1 - r.x0) * (r.y1 - r.y0);
+}
+
+scene::rect_t Surface() {
+  scene::rect_t r = { 0, 0, (VGint) egl::State.screen_width,
+                      (VGint) egl::State.screen_height };
+  return r;
+}
+
+// Adds a rectangle, merging it with those it touches, then merging the
+// pairs that grow the least while there are too many.
+void AddDamage(std::vector<scene::rect_t> *damage, scene::rect_t r) {
+  if (IsEmpty(r)) {
+    return;
+  }
+
+  for (size_t i = 0; i < damage->size();) {
+    if (Touches((*damage)[i], r)) {
+      r = Union((*damage)[i], r);
+      damage->erase(damage->begin() + i);
+      i = 0;
+    } else {
+      i++;
+    }
+  }
+  damage->push_back(r);
+
+  while (damage->size() > kMaxDamage) {
+    size_t bestA = 0, bestB = 1;
+    double bestGrowth = -1;
+    for (size_t a = 0; a < damage->size(); a++) {
+      for (size_t b = a + 1; b < damage->size(); b++) {
+        scene::rect_t u = Union((*damage)[a], (*damage)[b]);
+        double growth = Area(u) - Area((*damage)[a]) - Area((*damage)[b]);
+        if (bestGrowth < 0 || growth < bestGrowth) {
+          bestGrowth = growth;
+          bestA = a;
+          bestB = b;
+        }
+      }
+    }
+    (*damage)[bestA] = Union((*damage)[bestA], (*damage)[bestB]);
+    damage->erase(damage->begin() + bestB);
+  }
+}
+
+scene_t &SceneOf(uint32_t root) {
+  std::map<uint32_t, scene_t>::iterator it = scenes.find(root);
+  if (it != scenes.end()) {
+    return it->second;
+  }
+  scene_t &scene = scenes[root];
+  std::fill(scene.background, scene.background + 4, 0.0f);
+  scene.rendered = false;
+  return scene;
+}
+
+uint32_t RootOf(uint32_t id) {
+  while (nodes[id].parent != 0) {
+    id = nodes[id].parent;
+  }
+  return id;
+}
+
+void Multiply(const VGfloat *a, const VGfloat *b, VGfloat *result) {
+  for (int column = 0; column < 3; column++) {
+    const VGfloat *bc = b + column * 3;
+    result[column * 3 + 0] = a[0] * bc[0] + a[3] * bc[1] + a[6] * bc[2];
+    result[column * 3 + 1] = a[1] * bc[0] + a[4] * bc[1] + a[7] * bc[2];
+    result[column * 3 + 2] = a[2] * bc[0] + a[5] * bc[1] + a[8] * bc[2];
+  }
+}
+
+// Surface pixels covered by a user space rectangle under an affine matrix.
+scene::rect_t ToPixels(const VGfloat *m,
+                       VGfloat x0, VGfloat y0, VGfloat x1, VGfloat y1) {
+  const VGfloat xs[4] = { x0, x1, x0, x1 };
+  const VGfloat ys[4] = { y0, y0, y1, y1 };
+  VGfloat minX = 0, minY = 0, maxX = 0, maxY = 0;
+  for (int i = 0; i < 4; i++) {
+    VGfloat x = m[0] * xs[i] + m[3] * ys[i] + m[6];
+    VGfloat y = m[1] * xs[i] + m[4] * ys[i] + m[7];
+    if (i == 0) {
+      minX = maxX = x;
+      minY = maxY = y;
+    } else {
+      minX = fminf(minX, x); maxX = fmaxf(maxX, x);
+      minY = fminf(minY, y); maxY = fmaxf(maxY, y);
+    }
+  }
+
+  scene::rect_t r = { (VGint) floorf(minX) - kPadding,
+                      (VGint) floorf(minY) - kPadding,
+                      (VGint) ceilf(maxX) + kPadding,
+                      (VGint) ceilf(maxY) + kPadding };
+  return r;
+}
+
+// Content bounds in user coordinates, from the driver or the text layer.
+void UpdateLocal(scene::node_t *node) {
+  node->localKnown = true;
+  node->unbounded = false;
+  std::fill(node->local, node->local + 4, 0.0f);
+
+  switch (node->kind) {
+  case scene::kPath: {
+    VGfloat x = 0, y = 0, width = -1, height = -1;
+    vgPathBounds(node->path, &x, &y, &width, &height);
+    if (width < 0 || height < 0) {
+      // Without VG_PATH_CAPABILITY_PATH_BOUNDS
+      node->unbounded = true;
+      break;
+    }
+    VGfloat pad = node->strokePaint != VG_INVALID_HANDLE ?
+                  node->strokeWidth * 2 : 0;
+    node->local[0] = x - pad;
+    node->local[1] = y - pad;
+    node->local[2] = x + width + pad;
+    node->local[3] = y + height + pad;
+    break;
+  }
+  case scene::kImage: {
+    VGImage image = registry::Read(node->image);
+    node->local[2] = (VGfloat) vgGetParameteri(image, VG_IMAGE_WIDTH);
+    node->local[3] = (VGfloat) vgGetParameteri(image, VG_IMAGE_HEIGHT);
+    break;
+  }
+  case scene::kText: {
+    textlayers::text_layer_t *layer = textlayers::Find(node->textLayer);
+    VGint left, bottom, right, top;
+    if (layer != NULL &&
+        textlayers::GetBounds(layer, &left, &bottom, &right, &top)) {
+      node->local[0] = (VGfloat) left;
+      node->local[1] = (VGfloat) bottom;
+      node->local[2] = (VGfloat) right;
+      node->local[3] = (VGfloat) top;
+    }
+    break;
+  }
+  case scene::kGroup:
+    break;
+  }
+}
+
+scene::rect_t ContentBounds(scene::node_t *node) {
+  if (node->kind == scene::kGroup) {
+    return kEmpty;
+  }
+  if (!node->localKnown) {
+    UpdateLocal(node);
+  }
+  if (node->unbounded) {
+    return Surface();
+  }
+  if (node->local[0] >= node->local[2] || node->local[1] >= node->local[3]) {
+    return kEmpty;
+  }
+  return ToPixels(node->world, node->local[0], node->local[1],
+                  node->local[2], node->local[3]);
+}
+
+scene::rect_t ClipBounds(const scene::node_t *node, const VGfloat *matrix) {
+  if (node->clipKind == scene::kClipRect) {
+    return ToPixels(matrix, node->clipRect[0], node->clipRect[1],
+                    node->clipRect[0] + node->clipRect[2],
+                    node->clipRect[1] + node->clipRect[3]);
+  }
+
+  VGfloat x = 0, y = 0, width = -1, height = -1;
+  vgPathBounds(node->clipPath, &x, &y, &width, &height);
+  if (width < 0 || height < 0) {
+    return Surface();
+  }
+  return ToPixels(matrix, x, y, x + width, y + height);
+}
+
+// Recomputes the world matrices and bounds of the nodes that changed and
+// those below them, adding what they covered and cover now to the damage.
+void Update(uint32_t id, const VGfloat *parentWorld,
+            bool parentChanged, bool parentShown,
+            std::vector<scene::rect_t> *damage) {
+  scene::node_t &node = nodes[id];
+  bool changed = parentChanged || node.dirty;
+  if (!changed && !node.subtreeDirty) {
+    return;
+  }
+
+  if (changed) {
+    Multiply(parentWorld, node.transform, node.world);
+    node.shown = parentShown && node.visible;
+
+    scene::rect_t old = node.contentBounds;
+    node.contentBounds = node.shown ? ContentBounds(&node) : kEmpty;
+    AddDamage(damage, old);
+    if (memcmp(&old, &node.contentBounds, sizeof(old)) != 0) {
+      AddDamage(damage, node.contentBounds);
+    }
+    updatedNodes++;
+  }
+
+  scene::rect_t bounds = node.contentBounds;
+  for (size_t i = 0; i < node.children.size(); i++) {
+    Update(node.children[i], node.world, changed, node.shown, damage);
+    bounds = Union(bounds, nodes[node.children[i]].bounds);
+  }
+  if (node.clipKind != scene::kNoClip && !IsEmpty(bounds)) {
+    bounds = Intersection(bounds, ClipBounds(&node, node.world));
+  }
+
+  node.bounds = bounds;
+  node.dirty = false;
+  node.subtreeDirty = false;
+}
+
+void LoadWorld(VGint matrixMode, const VGfloat *world) {
+  state::SetI(VG_MATRIX_MODE, matrixMode);
+  matrices::Load(world);
+}
+
+void SetOpacity(VGfloat alpha) {
+  if (alpha < 1) {
+    const VGfloat values[8] = { 1, 1, 1, alpha, 0, 0, 0, 0 };
+    state::SetFV(VG_COLOR_TRANSFORM_VALUES, 8, values);
+    state::SetI(VG_COLOR_TRANSFORM, VG_TRUE);
+  } else {
+    state::SetI(VG_COLOR_TRANSFORM, VG_FALSE);
+  }
+}
+
+void DrawContent(scene::node_t *node, const VGfloat *matrix) {
+  switch (node->kind) {
+  case scene::kPath: {
+    VGbitfield paintModes = 0;
+    if (node->fillPaint != VG_INVALID_HANDLE) {
+      state::SetPaint(node->fillPaint, VG_FILL_PATH);
+      paintModes |= VG_FILL_PATH;
+    }
+    if (node->strokePaint != VG_INVALID_HANDLE) {
+      state::SetPaint(node->strokePaint, VG_STROKE_PATH);
+      state::SetF(VG_STROKE_LINE_WIDTH, node->strokeWidth);
+      paintModes |= VG_STROKE_PATH;
+    }
+    if (paintModes == 0) {
+      return;
+    }
+    LoadWorld(VG_MATRIX_PATH_USER_TO_SURFACE, matrix);
+    matrices::Sync();
+    vgDrawPath(node->path, paintModes);
+    break;
+  }
+  case scene::kImage:
+    LoadWorld(VG_MATRIX_IMAGE_USER_TO_SURFACE, matrix);
+    matrices::Sync();
+    registry::Draw(node->image);
+    break;
+  case scene::kText: {
+    textlayers::text_layer_t *layer = textlayers::Find(node->textLayer);
+    if (layer == NULL) {
+      return;
+    }
+    if (node->fillPaint != VG_INVALID_HANDLE) {
+      state::SetPaint(node->fillPaint, VG_FILL_PATH);
+    }
+    LoadWorld(VG_MATRIX_PATH_USER_TO_SURFACE, matrix);
+    textlayers::Draw(layer, 0, 0);
+    break;
+  }
+  case scene::kGroup:
+    return;
+  }
+  drawnNodes++;
+}
+
+void ReleaseLayerImage(scene::node_t *node) {
+  if (node->layerImage != VG_INVALID_HANDLE) {
+    registry::Destroy(node->layerImage);
+    node->layerImage = VG_INVALID_HANDLE;
+    layerImages--;
+  }
+}
+
+// Pixels covered by a subtree with the node drawn through matrix. Returns
+// false if some content has no bounds.
+bool Extent(uint32_t id, const VGfloat *matrix, scene::rect_t *extent) {
+  scene::node_t &node = nodes[id];
+  *extent = kEmpty;
+  if (!node.visible) {
+    return true;
+  }
+
+  if (node.kind != scene::kGroup) {
+    if (!node.localKnown) {
+      UpdateLocal(&node);
+    }
+    if (node.unbounded) {
+      return false;
+    }
+    if (node.local[0] < node.local[2] && node.local[1] < node.local[3]) {
+      *extent = ToPixels(matrix, node.local[0], node.local[1],
+                         node.local[2], node.local[3]);
+    }
+  }
+
+  for (size_t i = 0; i < node.children.size(); i++) {
+    VGfloat childMatrix[9];
+    Multiply(matrix, nodes[node.children[i]].transform, childMatrix);
+    scene::rect_t child;
+    if (!Extent(node.children[i], childMatrix, &child)) {
+      return false;
+    }
+    *extent = Union(*extent, child);
+  }
+
+  if (node.clipKind != scene::kNoClip && !IsEmpty(*extent)) {
+    *extent = Intersection(*extent, ClipBounds(&node, matrix));
+  }
+  return true;
+}
+
+void Draw(uint32_t id, const scene::rect_t *area, const VGfloat *matrix,
+          bool composite);
+
+// Draws the subtree of a layer node into its image, sized to what it covers
+// in the node's coordinates. Leaves the node to be drawn directly when it
+// can't have an image.
+void RenderLayer(uint32_t id) {
+  scene::node_t &node = nodes[id];
+  node.layerDirty = false;
+  node.layerDirect = false;
+
+  scene::rect_t extent;
+  if (!Extent(id, kIdentity, &extent)) {
+    node.layerDirect = true;
+    ReleaseLayerImage(&node);
+    return;
+  }
+  if (IsEmpty(extent)) {
+    ReleaseLayerImage(&node);
+    return;
+  }
+
+  VGint width = extent.x1 - extent.x0, height = extent.y1 - extent.y0;
+  if (width > vgGeti(VG_MAX_IMAGE_WIDTH) ||
+      height > vgGeti(VG_MAX_IMAGE_HEIGHT)) {
+    node.layerDirect = true;
+    ReleaseLayerImage(&node);
+    return;
+  }
+
+  if (node.layerImage == VG_INVALID_HANDLE ||
+      node.layerWidth != width || node.layerHeight != height) {
+    ReleaseLayerImage(&node);
+    node.layerImage = registry::Create(VG_sRGBA_8888_PRE, width, height,
+                                       VG_IMAGE_QUALITY_NONANTIALIASED |
+                                       VG_IMAGE_QUALITY_FASTER |
+                                       VG_IMAGE_QUALITY_BETTER);
+    if (node.layerImage == VG_INVALID_HANDLE) {
+      node.layerDirect = true;
+      return;
+    }
+    layerImages++;
+  }
+  node.layerX = extent.x0;
+  node.layerY = extent.y0;
+  node.layerWidth = width;
+  node.layerHeight = height;
+
+  egl::image_target_t target;
+  if (!egl::BeginImageTarget(registry::Use(node.layerImage), &target)) {
+    node.layerDirect = true;
+    ReleaseLayerImage(&node);
+    return;
+  }
+  clips::Suspend();
+  VGfloat outerOpacity = opacity;
+  opacity = 1;
+  SetOpacity(opacity);
+
+  const VGfloat transparent[4] = { 0, 0, 0, 0 };
+  state::SetFV(VG_CLEAR_COLOR, 4, transparent);
+  vgClear(0, 0, width, height);
+
+  VGfloat matrix[9];
+  memcpy(matrix, kIdentity, sizeof(matrix));
+  matrix[6] = (VGfloat) -extent.x0;
+  matrix[7] = (VGfloat) -extent.y0;
+  Draw(id, NULL, matrix, false);
+
+  opacity = outerOpacity;
+  SetOpacity(opacity);
+  clips::Resume();
+  egl::EndImageTarget(&target);
+  layerRenders++;
+}
+
+// Draws a layer's image, rendering it first if needed. Returns false when
+// the layer has to be drawn directly.
+bool Composite(uint32_t id, const VGfloat *matrix) {
+  scene::node_t &node = nodes[id];
+  if (node.layerDirty) {
+    RenderLayer(id);
+  }
+  if (node.layerDirect) {
+    return false;
+  }
+  if (node.layerImage == VG_INVALID_HANDLE) {
+    return true;
+  }
+
+  VGfloat imageMatrix[9];
+  memcpy(imageMatrix, matrix, sizeof(imageMatrix));
+  imageMatrix[6] += matrix[0] * node.layerX + matrix[3] * node.layerY;
+  imageMatrix[7] += matrix[1] * node.layerX + matrix[4] * node.layerY;
+  LoadWorld(VG_MATRIX_IMAGE_USER_TO_SURFACE, imageMatrix);
+  SetOpacity(opacity * node.opacity);
+  matrices::Sync();
+  registry::Draw(node.layerImage);
+  SetOpacity(opacity);
+
+  compositedLayers++;
+  return true;
+}
+
+// Draws a subtree, the node through matrix, leaving out what's outside
+// area unless it's NULL. Layer nodes are composited unless composite is
+// false, which draws the layer's own content.
+void Draw(uint32_t id, const scene::rect_t *area, const VGfloat *matrix,
+          bool composite) {
+  scene::node_t &node = nodes[id];
+  if (!node.visible ||
+      (area != NULL && IsEmpty(Intersection(node.bounds, *area)))) {
+    return;
+  }
+  if (node.layer && composite && Composite(id, matrix)) {
+    return;
+  }
+
+  VGfloat outerOpacity = opacity;
+  if (node.layer && composite && node.opacity < 1) {
+    // Drawn directly
+    opacity *= node.opacity;
+    SetOpacity(opacity);
+  }
+
+  bool clipped = false;
+  if (node.clipKind != scene::kNoClip) {
+    LoadWorld(VG_MATRIX_PATH_USER_TO_SURFACE, matrix);
+    clipped = node.clipKind == scene::kClipRect ?
+      clips::PushRect(node.clipRect[0], node.clipRect[1],
+                      node.clipRect[2], node.clipRect[3]) :
+      clips::PushPath(node.clipPath);
+  }
+
+  // Out of mask layers, a clipped node is better left out than overflowing
+  if (clipped || node.clipKind == scene::kNoClip) {
+    if (area == NULL || !IsEmpty(Intersection(node.contentBounds, *area))) {
+      DrawContent(&node, matrix);
+    }
+    for (size_t i = 0; i < node.children.size(); i++) {
+      VGfloat childMatrix[9];
+      Multiply(matrix, nodes[node.children[i]].transform, childMatrix);
+      Draw(node.children[i], area, childMatrix, true);
+    }
+  }
+
+  if (clipped) {
+    clips::Pop();
+  }
+  if (opacity != outerOpacity) {
+    opacity = outerOpacity;
+    SetOpacity(opacity);
+  }
+}
+}
+
+uint32_t scene::Create() {
+  uint32_t id = nextNode++;
+  node_t &node = nodes[id];
+  node.parent = 0;
+  memcpy(node.transform, kIdentity, sizeof(node.transform));
+  node.visible = true;
+  node.kind = kGroup;
+  node.path = VG_INVALID_HANDLE;
+  node.image = VG_INVALID_HANDLE;
+  node.textLayer = 0;
+  node.fillPaint = VG_INVALID_HANDLE;
+  node.strokePaint = VG_INVALID_HANDLE;
+  node.strokeWidth = 1;
+  node.clipKind = kNoClip;
+  std::fill(node.clipRect, node.clipRect + 4, 0.0f);
+  node.clipPath = VG_INVALID_HANDLE;
+  node.layer = false;
+  node.opacity = 1;
+  node.dirty = true;
+  node.subtreeDirty = false;
+  node.shown = false;
+  memcpy(node.world, kIdentity, sizeof(node.world));
+  node.localKnown = false;
+  node.unbounded = false;
+  std::fill(node.local, node.local + 4, 0.0f);
+  node.contentBounds = kEmpty;
+  node.bounds = kEmpty;
+  node.layerImage = VG_INVALID_HANDLE;
+  node.layerDirty = true;
+  node.layerDirect = false;
+  node.layerX = node.layerY = node.layerWidth = node.layerHeight = 0;
+  return id;
+}
+
+void scene::Destroy(uint32_t id) {
+  if (Get(id) == NULL) {
+    return;
+  }
+  Detach(id);
+
+  // The children become roots of their own
+  std::vector<uint32_t> children = nodes[id].children;
+  for (size_t i = 0; i < children.size(); i++) {
+    node_t &child = nodes[children[i]];
+    child.parent = 0;
+    child.dirty = true;
+  }
+
+  ReleaseLayerImage(&nodes[id]);
+  nodes.erase(id);
+  scenes.erase(id);
+}
+
+scene::node_t *scene::Get(uint32_t id) {
+  std::map<uint32_t, node_t>::iterator it = nodes.find(id);
+  return it != nodes.end() ? &it->second : NULL;
+}
+
+bool scene::Append(uint32_t parent, uint32_t child) {
+  for (uint32_t id = parent; id != 0; id = nodes[id].parent) {
+    if (id == child) {
+      return false;
+    }
+  }
+
+  Detach(child);
+  nodes[parent].children.push_back(child);
+  nodes[child].parent = parent;
+  MarkMoved(child);
+  return true;
+}
+
+void scene::Detach(uint32_t id) {
+  node_t &node = nodes[id];
+  if (node.parent == 0) {
+    return;
+  }
+
+  // What the subtree drew has to go
+  AddDamage(&SceneOf(RootOf(id)).damage, node.bounds);
+
+  std::vector<uint32_t> &siblings = nodes[node.parent].children;
+  siblings.erase(std::find(siblings.begin(), siblings.end(), id));
+  MarkDirty(node.parent);
+  node.parent = 0;
+  node.dirty = true;
+}
+
+void scene::MarkDirty(uint32_t id) {
+  nodes[id].layerDirty = true;
+  MarkMoved(id);
+}
+
+void scene::MarkMoved(uint32_t id) {
+  nodes[id].dirty = true;
+  // All the way up, for the layers
+  for (uint32_t parent = nodes[id].parent; parent != 0;
+       parent = nodes[parent].parent) {
+    nodes[parent].subtreeDirty = true;
+    nodes[parent].layerDirty = true;
+  }
+}
+
+void scene::SetLayer(uint32_t id, bool enabled) {
+  node_t &node = nodes[id];
+  if (node.layer == enabled) {
+    return;
+  }
+  node.layer = enabled;
+  ReleaseLayerImage(&node);
+  MarkDirty(id);
+}
+
+void scene::Invalidate(uint32_t id) {
+  nodes[id].localKnown = false;
+  MarkDirty(id);
+}
+
+void scene::Damage(uint32_t root, VGint x, VGint y, VGint width, VGint height) {
+  rect_t r = { x, y, x + width, y + height };
+  AddDamage(&SceneOf(root).damage, r);
+}
+
+void scene::SetBackground(uint32_t root, const VGfloat *color) {
+  scene_t &scene = SceneOf(root);
+  if (memcmp(scene.background, color, sizeof(scene.background)) != 0) {
+    memcpy(scene.background, color, sizeof(scene.background));
+    AddDamage(&scene.damage, Surface());
+  }
+}
+
+size_t scene::Render(uint32_t root) {
+  // Animated nodes are marked like any other changed node
+  animations::Evaluate();
+
+  scene_t &scene = SceneOf(root);
+  if (!scene.rendered) {
+    AddDamage(&scene.damage, Surface());
+    scene.rendered = true;
+  }
+
+  renders++;
+  updatedNodes = drawnNodes = compositedLayers = 0;
+  Update(root, kIdentity, false, true, &scene.damage);
+
+  std::vector<rect_t> damage;
+  for (size_t i = 0; i < scene.damage.size(); i++) {
+    rect_t r = Intersection(scene.damage[i], Surface());
+    if (!IsEmpty(r)) {
+      damage.push_back(r);
+    }
+  }
+  scene.damage.clear();
+  dirtyRects = damage.size();
+  if (damage.empty()) {
+    skippedRenders++;
+    return 0;
+  }
+
+  // Everything set below is put back afterwards
+  VGint matrixMode = state::MatrixMode();
+  VGPaint fillPaint = vgGetPaint(VG_FILL_PATH);
+  VGPaint strokePaint = vgGetPaint(VG_STROKE_PATH);
+  VGfloat lineWidth = vgGetf(VG_STROKE_LINE_WIDTH);
+  VGfloat clearColor[4];
+  vgGetfv(VG_CLEAR_COLOR, 4, clearColor);
+  VGint imageMode = vgGeti(VG_IMAGE_MODE);
+  VGint colorTransform = vgGeti(VG_COLOR_TRANSFORM);
+  VGfloat colorTransformValues[8];
+  vgGetfv(VG_COLOR_TRANSFORM_VALUES, 8, colorTransformValues);
+
+  state::SetI(VG_MATRIX_MODE, VG_MATRIX_IMAGE_USER_TO_SURFACE);
+  matrices::Push();
+  state::SetI(VG_MATRIX_MODE, VG_MATRIX_PATH_USER_TO_SURFACE);
+  matrices::Push();
+  state::SetI(VG_IMAGE_MODE, VG_DRAW_IMAGE_NORMAL);
+  opacity = 1;
+  SetOpacity(opacity);
+
+  for (size_t i = 0; i < damage.size(); i++) {
+    const rect_t &r = damage[i];
+    LoadWorld(VG_MATRIX_PATH_USER_TO_SURFACE, kIdentity);
+    clips::PushRect((VGfloat) r.x0, (VGfloat) r.y0,
+                    (VGfloat) (r.x1 - r.x0), (VGfloat) (r.y1 - r.y0));
+    // Set every time, rendering layers clears to transparent
+    state::SetFV(VG_CLEAR_COLOR, 4, scene.background);
+    vgClear(r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0);
+    Draw(root, &r, nodes[root].world, true);
+    clips::Pop();
+  }
+
+  state::SetI(VG_MATRIX_MODE, VG_MATRIX_IMAGE_USER_TO_SURFACE);
+  matrices::Pop();
+  state::SetI(VG_MATRIX_MODE, VG_MATRIX_PATH_USER_TO_SURFACE);
+  matrices::Pop();
+  state::SetI(VG_MATRIX_MODE, matrixMode);
+  state::SetPaint(fillPaint, VG_FILL_PATH);
+  state::SetPaint(strokePaint, VG_STROKE_PATH);
+  state::SetF(VG_STROKE_LINE_WIDTH, lineWidth);
+  state::SetFV(VG_CLEAR_COLOR, 4, clearColor);
+  state::SetI(VG_IMAGE_MODE, imageMode);
+  state::SetFV(VG_COLOR_TRANSFORM_VALUES, 8, colorTransformValues);
+  state::SetI(VG_COLOR_TRANSFORM, colorTransform);
+
+  return damage.size();
+}
+
+void scene::GetStats(stats_t *stats) {
+  stats->nodes = nodes.size();
+  stats->renders = renders;
+  stats->skippedRenders = skippedRenders;
+  stats->layers = layerImages;
+  stats->layerRenders = layerRenders;
+  stats->dirtyRects = dirtyRects;
+  stats->updatedNodes = updatedNodes;
+  stats->drawnNodes = drawnNodes;
+  stats->compositedLayers = compositedLayers;
+}
+
+
+extern void scene::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "createSceneNode"    , scene::CreateSceneNode);
+  NODE_SET_METHOD(target, "destroySceneNode"   , scene::DestroySceneNode);
+  NODE_SET_METHOD(target, "appendSceneNode"    , scene::AppendSceneNode);
+  NODE_SET_METHOD(target, "removeSceneNode"    , scene::RemoveSceneNode);
+  NODE_SET_METHOD(target, "setNodeTransform"   , scene::SetNodeTransform);
+  NODE_SET_METHOD(target, "setNodeVisible"     , scene::SetNodeVisible);
+  NODE_SET_METHOD(target, "setNodePath"        , scene::SetNodePath);
+  NODE_SET_METHOD(target, "setNodeImage"       , scene::SetNodeImage);
+  NODE_SET_METHOD(target, "setNodeText"        , scene::SetNodeText);
+  NODE_SET_METHOD(target, "clearNodeContent"   , scene::ClearNodeContent);
+  NODE_SET_METHOD(target, "setNodeClipRect"    , scene::SetNodeClipRect);
+  NODE_SET_METHOD(target, "setNodeClipPath"    , scene::SetNodeClipPath);
+  NODE_SET_METHOD(target, "clearNodeClip"      , scene::ClearNodeClip);
+  NODE_SET_METHOD(target, "setNodeLayer"       , scene::SetNodeLayer);
+  NODE_SET_METHOD(target, "setNodeOpacity"     , scene::SetNodeOpacity);
+  NODE_SET_METHOD(target, "invalidateSceneNode", scene::InvalidateSceneNode);
+  NODE_SET_METHOD(target, "setSceneBackground" , scene::SetSceneBackground);
+  NODE_SET_METHOD(target, "damageScene"        , scene::DamageScene);
+  NODE_SET_METHOD(target, "renderScene"        , scene::RenderScene);
+  NODE_SET_METHOD(target, "getSceneStats"      , scene::GetSceneStats);
+}
+
+V8_METHOD(scene::CreateSceneNode) {
+  HandleScope scope;
+
+  CheckArgs0(createSceneNode);
+
+  V8_RETURN(Uint32::New(Create()));
+}
+
+V8_METHOD(scene::DestroySceneNode) {
+  HandleScope scope;
+
+  CheckArgs1(destroySceneNode, node, Uint32);
+
+  Destroy(args[0]->Uint32Value());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::AppendSceneNode) {
+  HandleScope scope;
+
+  CheckArgs2(appendSceneNode, parent, Uint32, child, Uint32);
+
+  uint32_t parent = args[0]->Uint32Value(), child = args[1]->Uint32Value();
+  if (Get(parent) == NULL || Get(child) == NULL) {
+    V8_THROW(Exception::TypeError(String::New("appendSceneNode: unknown scene node")));
+  }
+  if (!Append(parent, child)) {
+    V8_THROW(Exception::TypeError(String::New("appendSceneNode: a node can't be appended below itself")));
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::RemoveSceneNode) {
+  HandleScope scope;
+
+  CheckArgs1(removeSceneNode, node, Uint32);
+
+  uint32_t id = args[0]->Uint32Value();
+  if (Get(id) == NULL) {
+    V8_THROW(Exception::TypeError(String::New("removeSceneNode: unknown scene node")));
+  }
+  Detach(id);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::SetNodeTransform) {
+  HandleScope scope;
+
+  // Always checked: the array is read below
+  if (!(args.Length() == 2 && args[0]->IsUint32() && args[1]->IsObject())) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected setNodeTransform(Number, Float32Array)")));
+  }
+
+  uint32_t id = args[0]->Uint32Value();
+  node_t *node = Get(id);
+  if (node == NULL) {
+    V8_THROW(Exception::TypeError(String::New("setNodeTransform: unknown scene node")));
+  }
+  TypedArrayWrapper<VGfloat> matrix(args[1]);
+  if (matrix.length() < 9) {
+    V8_THROW(Exception::TypeError(String::New("setNodeTransform: expected 9 values")));
+  }
+
+  // Affine like the path matrix
+  VGfloat transform[9];
+  memcpy(transform, matrix.pointer(), sizeof(transform));
+  transform[2] = transform[5] = 0;
+  transform[8] = 1;
+  if (memcmp(node->transform, transform, sizeof(transform)) != 0) {
+    memcpy(node->transform, transform, sizeof(transform));
+    MarkMoved(id);
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::SetNodeVisible) {
+  HandleScope scope;
+
+  CheckArgs2(setNodeVisible, node, Uint32, visible, Boolean);
+
+  uint32_t id = args[0]->Uint32Value();
+  node_t *node = Get(id);
+  if (node == NULL) {
+    V8_THROW(Exception::TypeError(String::New("setNodeVisible: unknown scene node")));
+  }
+  bool visible = args[1]->BooleanValue();
+  if (node->visible != visible) {
+    node->visible = visible;
+    MarkMoved(id);
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::SetNodePath) {
+  HandleScope scope;
+
+  CheckArgs5(setNodePath, node, Uint32, VGPath, Uint32,
+             fillPaint, Uint32, strokePaint, Uint32, strokeWidth, Number);
+
+  uint32_t id = args[0]->Uint32Value();
+  node_t *node = Get(id);
+  if (node == NULL) {
+    V8_THROW(Exception::TypeError(String::New("setNodePath: unknown scene node")));
+  }
+  node->kind = kPath;
+  node->path = (VGPath) args[1]->Uint32Value();
+  node->fillPaint = (VGPaint) args[2]->Uint32Value();
+  node->strokePaint = (VGPaint) args[3]->Uint32Value();
+  node->strokeWidth = (VGfloat) args[4]->NumberValue();
+  Invalidate(id);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::SetNodeImage) {
+  HandleScope scope;
+
+  CheckArgs2(setNodeImage, node, Uint32, VGImage, Uint32);
+
+  uint32_t id = args[0]->Uint32Value();
+  node_t *node = Get(id);
+  if (node == NULL) {
+    V8_THROW(Exception::TypeError(String::New("setNodeImage: unknown scene node")));
+  }
+  node->kind = kImage;
+  node->image = (VGImage) args[1]->Uint32Value();
+  Invalidate(id);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::SetNodeText) {
+  HandleScope scope;
+
+  CheckArgs3(setNodeText, node, Uint32, layer, Uint32, fillPaint, Uint32);
+
+  uint32_t id = args[0]->Uint32Value();
+  node_t *node = Get(id);
+  if (node == NULL) {
+    V8_THROW(Exception::TypeError(String::New("setNodeText: unknown scene node")));
+  }
+  node->kind = kText;
+  node->textLayer = args[1]->Uint32Value();
+  node->fillPaint = (VGPaint) args[2]->Uint32Value();
+  Invalidate(id);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::ClearNodeContent) {
+  HandleScope scope;
+
+  CheckArgs1(clearNodeContent, node, Uint32);
+
+  uint32_t id = args[0]->Uint32Value();
+  node_t *node = Get(id);
+  if (node == NULL) {
+    V8_THROW(Exception::TypeError(String::New("clearNodeContent: unknown scene node")));
+  }
+  if (node->kind != kGroup) {
+    node->kind = kGroup;
+    Invalidate(id);
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::SetNodeClipRect) {
+  HandleScope scope;
+
+  CheckArgs5(setNodeClipRect, node, Uint32,
+             x, Number, y, Number, width, Number, height, Number);
+
+  uint32_t id = args[0]->Uint32Value();
+  node_t *node = Get(id);
+  if (node == NULL) {
+    V8_THROW(Exception::TypeError(String::New("setNodeClipRect: unknown scene node")));
+  }
+  node->clipKind = kClipRect;
+  for (int i = 0; i < 4; i++) {
+    node->clipRect[i] = (VGfloat) args[i + 1]->NumberValue();
+  }
+  MarkDirty(id);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::SetNodeClipPath) {
+  HandleScope scope;
+
+  CheckArgs2(setNodeClipPath, node, Uint32, VGPath, Uint32);
+
+  uint32_t id = args[0]->Uint32Value();
+  node_t *node = Get(id);
+  if (node == NULL) {
+    V8_THROW(Exception::TypeError(String::New("setNodeClipPath: unknown scene node")));
+  }
+  node->clipKind = kClipPath;
+  node->clipPath = (VGPath) args[1]->Uint32Value();
+  MarkDirty(id);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::ClearNodeClip) {
+  HandleScope scope;
+
+  CheckArgs1(clearNodeClip, node, Uint32);
+
+  uint32_t id = args[0]->Uint32Value();
+  node_t *node = Get(id);
+  if (node == NULL) {
+    V8_THROW(Exception::TypeError(String::New("clearNodeClip: unknown scene node")));
+  }
+  if (node->clipKind != kNoClip) {
+    node->clipKind = kNoClip;
+    MarkDirty(id);
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::SetNodeLayer) {
+  HandleScope scope;
+
+  CheckArgs2(setNodeLayer, node, Uint32, enabled, Boolean);
+
+  uint32_t id = args[0]->Uint32Value();
+  if (Get(id) == NULL) {
+    V8_THROW(Exception::TypeError(String::New("setNodeLayer: unknown scene node")));
+  }
+  SetLayer(id, args[1]->BooleanValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::SetNodeOpacity) {
+  HandleScope scope;
+
+  CheckArgs2(setNodeOpacity, node, Uint32, opacity, Number);
+
+  uint32_t id = args[0]->Uint32Value();
+  node_t *node = Get(id);
+  if (node == NULL) {
+    V8_THROW(Exception::TypeError(String::New("setNodeOpacity: unknown scene node")));
+  }
+  VGfloat opacity = (VGfloat) args[1]->NumberValue();
+  opacity = opacity < 0 ? 0 : (opacity > 1 ? 1 : opacity);
+  if (node->opacity != opacity) {
+    node->opacity = opacity;
+    MarkMoved(id);
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::InvalidateSceneNode) {
+  HandleScope scope;
+
+  CheckArgs1(invalidateSceneNode, node, Uint32);
+
+  uint32_t id = args[0]->Uint32Value();
+  if (Get(id) == NULL) {
+    V8_THROW(Exception::TypeError(String::New("invalidateSceneNode: unknown scene node")));
+  }
+  Invalidate(id);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::SetSceneBackground) {
+  HandleScope scope;
+
+  CheckArgs5(setSceneBackground, root, Uint32,
+             red, Number, green, Number, blue, Number, alpha, Number);
+
+  uint32_t root = args[0]->Uint32Value();
+  if (Get(root) == NULL) {
+    V8_THROW(Exception::TypeError(String::New("setSceneBackground: unknown scene node")));
+  }
+  VGfloat color[4];
+  for (int i = 0; i < 4; i++) {
+    color[i] = (VGfloat) args[i + 1]->NumberValue();
+  }
+  SetBackground(root, color);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::DamageScene) {
+  HandleScope scope;
+
+  CheckArgs5(damageScene, root, Uint32,
+             x, Int32, y, Int32, width, Int32, height, Int32);
+
+  uint32_t root = args[0]->Uint32Value();
+  if (Get(root) == NULL) {
+    V8_THROW(Exception::TypeError(String::New("damageScene: unknown scene node")));
+  }
+  Damage(root, (VGint) args[1]->Int32Value(), (VGint) args[2]->Int32Value(),
+         (VGint) args[3]->Int32Value(), (VGint) args[4]->Int32Value());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(scene::RenderScene) {
+  HandleScope scope;
+
+  CheckArgs1(renderScene, root, Uint32);
+
+  uint32_t root = args[0]->Uint32Value();
+  node_t *node = Get(root);
+  if (node == NULL || node->parent != 0) {
+    V8_THROW(Exception::TypeError(String::New("renderScene: expected a root scene node")));
+  }
+
+  V8_RETURN(Uint32::New(Render(root)));
+}
+
+V8_METHOD(scene::GetSceneStats) {
+  HandleScope scope;
+
+  CheckArgs1(getSceneStats, stats, Object);
+
+  stats_t stats;
+  GetStats(&stats);
+
+  Local<Object> result = args[0].As<Object>();
+  result->Set(String::NewSymbol("nodes"), Number::New(stats.nodes));
+  result->Set(String::NewSymbol("renders"), Number::New(stats.renders));
+  result->Set(String::NewSymbol("skippedRenders"), Number::New(stats.skippedRenders));
+  result->Set(String::NewSymbol("layers"), Number::New(stats.layers));
+  result->Set(String::NewSymbol("layerRenders"), Number::New(stats.layerRenders));
+  result->Set(String::NewSymbol("dirtyRects"), Number::New(stats.dirtyRects));
+  result->Set(String::NewSymbol("updatedNodes"), Number::New(stats.updatedNodes));
+  result->Set(String::NewSymbol("drawnNodes"), Number::New(stats.drawnNodes));
+  result->Set(String::NewSymbol("compositedLayers"), Number::New(stats.compositedLayers));
+
+  V8_RETURN(Undefined());
+}
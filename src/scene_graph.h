@@ -0,0 +1,168 @@
+#ifndef NODE_OPENVG_SCENE_GRAPH_H_
+#define NODE_OPENVG_SCENE_GRAPH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// A retained scene: a tree of nodes, each with a transform relative to its
+// parent, an optional clip applying to its content and children, and as
+// content a path, an image, a text layer (text_layer.h) or nothing.
+//
+// Changing a node marks it dirty. Rendering a root finds the dirty nodes
+// through their ancestors, adds the surface pixels they covered before and
+// cover now to the scene's damage, and redraws only the damaged rectangles:
+// each one is scissored through the clip stack, cleared to the scene's
+// background and drawn into by the nodes overlapping it, in tree order.
+// That relies on the window surface keeping its content across swaps,
+// which egl::Init asks for. A root's first render redraws the whole
+// surface; anything drawn over the scene by other means has to be reported
+// with Damage().
+//
+// A node made a layer is drawn, with its subtree, into an image of its own
+// through a pbuffer, at one pixel per unit of its coordinates, and the
+// image is what gets composited with the node's transform and opacity
+// (VG_COLOR_TRANSFORM). Moving a layer or changing its opacity or
+// visibility only composites it again; it's rendered again when something
+// in it changes. Layers that can't have an image, being unbounded or too
+// large, are drawn directly with their opacity applied to each node.
+//
+// Stroked paths are assumed to stay within twice their line width of the
+// path, which holds for the default miter limit of 4. Changes to a path's
+// segments, an image's pixels or a text layer aren't seen by the scene and
+// need Invalidate() on the nodes using them.
+namespace scene {
+
+enum kind_t {
+  kGroup = 0,
+  kPath,
+  kImage,
+  kText
+};
+
+enum clip_kind_t {
+  kNoClip = 0,
+  kClipRect,
+  kClipPath
+};
+
+struct rect_t {
+  VGint x0, y0, x1, y1;  // Surface pixels, empty unless x0 < x1 and y0 < y1
+};
+
+struct node_t {
+  uint32_t parent;  // 0 for roots
+  std::vector<uint32_t> children;
+  VGfloat transform[9];  // Column major like vgLoadMatrix, affine
+  bool visible;
+
+  kind_t kind;
+  VGPath path;
+  VGImage image;
+  uint32_t textLayer;
+  VGPaint fillPaint;    // For paths and text layers
+  VGPaint strokePaint;  // For paths
+  VGfloat strokeWidth;
+
+  clip_kind_t clipKind;
+  VGfloat clipRect[4];  // x, y, width, height
+  VGPath clipPath;
+
+  bool layer;
+  VGfloat opacity;  // Of layers
+
+  // Kept by Render()
+  bool dirty;         // Its own properties changed
+  bool subtreeDirty;  // Some descendant's did
+  bool shown;         // Visible along with all its ancestors
+  VGfloat world[9];
+  bool localKnown;
+  bool unbounded;     // Content bounds unknown, taken as the surface
+  VGfloat local[4];   // Content bounds in user coordinates, x0, y0, x1, y1
+  rect_t contentBounds;
+  rect_t bounds;      // Content and children, within the clip
+  VGImage layerImage; // VG_INVALID_HANDLE when empty or drawn directly
+  bool layerDirty;
+  bool layerDirect;   // Couldn't have an image
+  VGint layerX, layerY, layerWidth, layerHeight;  // Of the image
+};
+
+struct stats_t {
+  size_t nodes;
+  size_t renders;
+  size_t skippedRenders;  // Nothing damaged
+  size_t layers;          // With an image
+  size_t layerRenders;
+  // Last render
+  size_t dirtyRects;
+  size_t updatedNodes;
+  size_t drawnNodes;
+  size_t compositedLayers;
+};
+
+// Returns 0 if there's no such node.
+uint32_t Create();
+void Destroy(uint32_t id);
+node_t *Get(uint32_t id);
+
+// Returns false if child is parent or one of its ancestors.
+bool Append(uint32_t parent, uint32_t child);
+void Detach(uint32_t id);
+
+// Marks the node for updating after its properties changed.
+void MarkDirty(uint32_t id);
+
+// Same for changes that leave its own layer's image valid: transform,
+// visibility and opacity.
+void MarkMoved(uint32_t id);
+
+void SetLayer(uint32_t id, bool enabled);
+
+// Forgets the content bounds, for content that changed behind its back.
+void Invalidate(uint32_t id);
+
+void Damage(uint32_t root, VGint x, VGint y, VGint width, VGint height);
+void SetBackground(uint32_t root, const VGfloat *color);
+
+// Evaluates the playing animations (animation_timeline.h), then redraws
+// what changed under a root. Returns the rectangles redrawn.
+size_t Render(uint32_t root);
+
+void GetStats(stats_t *stats);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(CreateSceneNode);
+V8_FUNCTION_DECL(DestroySceneNode);
+V8_FUNCTION_DECL(AppendSceneNode);
+V8_FUNCTION_DECL(RemoveSceneNode);
+V8_FUNCTION_DECL(SetNodeTransform);
+V8_FUNCTION_DECL(SetNodeVisible);
+V8_FUNCTION_DECL(SetNodePath);
+V8_FUNCTION_DECL(SetNodeImage);
+V8_FUNCTION_DECL(SetNodeText);
+V8_FUNCTION_DECL(ClearNodeContent);
+V8_FUNCTION_DECL(SetNodeClipRect);
+V8_FUNCTION_DECL(SetNodeClipPath);
+V8_FUNCTION_DECL(ClearNodeClip);
+V8_FUNCTION_DECL(SetNodeLayer);
+V8_FUNCTION_DECL(SetNodeOpacity);
+V8_FUNCTION_DECL(InvalidateSceneNode);
+V8_FUNCTION_DECL(SetSceneBackground);
+V8_FUNCTION_DECL(DamageScene);
+V8_FUNCTION_DECL(RenderScene);
+V8_FUNCTION_DECL(GetSceneStats);
+
+}
+
+#endif
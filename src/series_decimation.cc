@@ -0,0 +1,308 @@
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "VG/openvg.h"
+
+#include "series_decimation.h"
+#include "typed_array.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+size_t seriesCount = 0, pointCount = 0, decimatedCount = 0;
+
+// Kept between series
+std::vector<VGfloat> keptX, keptY;
+
+// The points [*first, *last) within lo..hi
+void Range(const charts::series_t &series, VGfloat lo, VGfloat hi,
+           size_t *first, size_t *last) {
+  if (series.x) {
+    *first = std::lower_bound(series.x, series.x + series.count, lo) - series.x;
+    *last = std::upper_bound(series.x, series.x + series.count, hi) - series.x;
+  } else {
+    *first = lo > 0 ? (size_t) ceil(lo) : 0;
+    *last = hi >= 0 ? (size_t) floor(hi) + 1 : 0;
+    *last = std::min(*last, series.count);
+  }
+  *first = std::min(*first, *last);
+}
+
+struct output_t {
+  const charts::series_t &series;
+  std::vector<VGfloat> *xs, *ys;
+
+  void Point(size_t i) {
+    xs->push_back(charts::DataX(series, i));
+    ys->push_back(series.y[i]);
+  }
+
+  // Once, however many columns or buckets in a row are empty
+  void Gap() {
+    if (!ys->empty() && !isnan(ys->back())) {
+      xs->push_back(NAN);
+      ys->push_back(NAN);
+    }
+  }
+};
+
+void MinMax(output_t &out, size_t first, size_t last, VGfloat lo, VGfloat hi,
+            size_t columns) {
+  const charts::series_t &series = out.series;
+  double scale = hi > lo ? columns / ((double) hi - lo) : 0;
+
+  size_t column = 0, low = 0, high = 0;
+  bool open = false, found = false;
+  for (size_t i = first; i <= last; i++) {
+    size_t c = 0;
+    if (i < last) {
+      double offset = (charts::DataX(series, i) - lo) * scale;
+      c = offset > 0 ? std::min((size_t) offset, columns - 1) : 0;
+    }
+    if (open && (i == last || c != column)) {
+      if (!found) {
+        out.Gap();
+      } else {
+        out.Point(std::min(low, high));
+        if (low != high) {
+          out.Point(std::max(low, high));
+        }
+      }
+      found = false;
+    }
+    if (i == last) {
+      break;
+    }
+    column = c;
+    open = true;
+
+    if (charts::Missing(series, i)) {
+      continue;
+    }
+    VGfloat y = series.y[i];
+    if (!found) {
+      low = high = i;
+      found = true;
+    } else if (y < series.y[low]) {
+      low = i;
+    } else if (y > series.y[high]) {
+      high = i;
+    }
+  }
+}
+
+void LTTB(output_t &out, size_t first, size_t last, size_t columns) {
+  const charts::series_t &series = out.series;
+  size_t count = last - first;
+  if (count <= columns) {
+    for (size_t i = first; i < last; i++) {
+      out.Point(i);
+    }
+    return;
+  }
+  if (columns < 3) {
+    out.Point(first);
+    if (columns == 2) {
+      out.Point(last - 1);
+    }
+    return;
+  }
+
+  // The first and last points are kept, the rest split into columns - 2
+  // buckets
+  double every = (double) (count - 2) / (columns - 2);
+  size_t a = first;
+  out.Point(a);
+  for (size_t b = 0; b < columns - 2; b++) {
+    size_t start = first + (size_t) (b * every) + 1;
+    size_t end = first + (size_t) ((b + 1) * every) + 1;
+    size_t nextEnd = std::min(first + (size_t) ((b + 2) * every) + 1, last);
+
+    double ax = charts::DataX(series, a), ay = series.y[a];
+    double avgX = 0, avgY = 0;
+    size_t averaged = 0;
+    for (size_t i = end; i < nextEnd; i++) {
+      if (!charts::Missing(series, i)) {
+        avgX += charts::DataX(series, i);
+        avgY += series.y[i];
+        averaged++;
+      }
+    }
+    if (averaged > 0) {
+      avgX /= averaged;
+      avgY /= averaged;
+    } else {
+      avgX = ax;
+      avgY = ay;
+    }
+
+    // Twice the triangle's area
+    double largest = -1;
+    size_t kept = last;
+    for (size_t i = start; i < end; i++) {
+      if (charts::Missing(series, i)) {
+        continue;
+      }
+      VGfloat x = charts::DataX(series, i), y = series.y[i];
+      double area = fabs((ax - avgX) * (y - ay) - (ax - x) * (avgY - ay));
+      if (isnan(area)) {
+        area = 0;
+      }
+      if (area > largest) {
+        largest = area;
+        kept = i;
+      }
+    }
+
+    if (kept == last) {
+      out.Gap();
+    } else {
+      out.Point(kept);
+      a = kept;
+    }
+  }
+  out.Point(last - 1);
+}
+
+}
+
+size_t decimation::Decimate(const charts::series_t &series,
+                            const charts::axis_t &axis, method_t method,
+                            size_t columns, std::vector<VGfloat> *xs,
+                            std::vector<VGfloat> *ys) {
+  VGfloat lo = std::min(axis.xMin, axis.xMax);
+  VGfloat hi = std::max(axis.xMin, axis.xMax);
+  size_t first, last;
+  Range(series, lo, hi, &first, &last);
+
+  xs->clear();
+  ys->clear();
+  if (columns > 0) {
+    output_t out = { series, xs, ys };
+    if (method == kMinMax) {
+      MinMax(out, first, last, lo, hi, columns);
+    } else {
+      LTTB(out, first, last, columns);
+    }
+  }
+
+  seriesCount++;
+  pointCount += last - first;
+  decimatedCount += ys->size();
+  return ys->size();
+}
+
+size_t decimation::Polyline(VGPath path, const charts::series_t &series,
+                            const charts::axis_t &axis, method_t method,
+                            size_t columns) {
+  size_t count = Decimate(series, axis, method, columns, &keptX, &keptY);
+  if (count == 0) {
+    return 0;
+  }
+
+  charts::series_t decimated = { &keptX[0], &keptY[0], count };
+  return charts::Polyline(path, decimated, axis);
+}
+
+void decimation::GetStats(stats_t *stats) {
+  stats->series = seriesCount;
+  stats->points = pointCount;
+  stats->decimated = decimatedCount;
+}
+
+
+extern void decimation::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "decimateSeries"    , decimation::DecimateSeries);
+  NODE_SET_METHOD(target, "chartDecimated"    , decimation::ChartDecimated);
+  NODE_SET_METHOD(target, "getDecimationStats", decimation::GetDecimationStats);
+}
+
+V8_METHOD(decimation::DecimateSeries) {
+  HandleScope scope;
+
+  // Always checked: the arrays are read below
+  if (!(args.Length() == 7 && (args[0]->IsObject() || args[0]->IsNull()) &&
+        args[1]->IsObject() && args[2]->IsObject() && args[3]->IsUint32() &&
+        args[4]->IsUint32() && IsFloat32Array(args[5]) &&
+        IsFloat32Array(args[6]))) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected decimateSeries(Float32Array|null, Float32Array, Float32Array, Number, Number, Float32Array, Float32Array)")));
+  }
+
+  charts::series_t series;
+  charts::axis_t axis;
+  if (const char *error = charts::ReadSeries(args[0], args[1], args[2],
+                                             &series, &axis)) {
+    V8_THROW(charts::ArgumentError("decimateSeries", error));
+  }
+  uint32_t method = args[3]->Uint32Value();
+  if (method > kLTTB) {
+    V8_THROW(Exception::TypeError(String::New("decimateSeries: unknown method")));
+  }
+
+  size_t count = Decimate(series, axis, (method_t) method,
+                          args[4]->Uint32Value(), &keptX, &keptY);
+
+  TypedArrayWrapper<VGfloat> outX(args[5]);
+  TypedArrayWrapper<VGfloat> outY(args[6]);
+  if ((size_t) outX.length() < count || (size_t) outY.length() < count) {
+    V8_THROW(Exception::RangeError(String::New("decimateSeries: output arrays shorter than the points kept")));
+  }
+  if (count > 0) {
+    memcpy(outX.pointer(), &keptX[0], count * sizeof(VGfloat));
+    memcpy(outY.pointer(), &keptY[0], count * sizeof(VGfloat));
+  }
+
+  V8_RETURN(Integer::New(count));
+}
+
+V8_METHOD(decimation::ChartDecimated) {
+  HandleScope scope;
+
+  // Always checked: the arrays are read below
+  if (!(args.Length() == 7 && args[0]->IsUint32() &&
+        (args[1]->IsObject() || args[1]->IsNull()) && args[2]->IsObject() &&
+        args[3]->IsObject() && args[4]->IsUint32() && args[5]->IsUint32() &&
+        args[6]->IsBoolean())) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected chartDecimated(Number, Float32Array|null, Float32Array, Float32Array, Number, Number, Boolean)")));
+  }
+
+  VGPath path = (VGPath) args[0]->Uint32Value();
+  charts::series_t series;
+  charts::axis_t axis;
+  const char *error = charts::ReadSeries(args[1], args[2], args[3],
+                                         &series, &axis);
+  if (!error && args[4]->Uint32Value() > kLTTB) {
+    error = "unknown method";
+  }
+  if (!error) {
+    error = charts::PreparePath(path, args[6]->BooleanValue());
+  }
+  if (error) {
+    V8_THROW(charts::ArgumentError("chartDecimated", error));
+  }
+
+  V8_RETURN(Integer::New(Polyline(path, series, axis,
+                                  (method_t) args[4]->Uint32Value(),
+                                  args[5]->Uint32Value())));
+}
+
+V8_METHOD(decimation::GetDecimationStats) {
+  HandleScope scope;
+
+  CheckArgs1(getDecimationStats, stats, Object);
+
+  stats_t stats;
+  GetStats(&stats);
+
+  Local<Object> result = args[0].As<Object>();
+  result->Set(String::NewSymbol("series"), Number::New(stats.series));
+  result->Set(String::NewSymbol("points"), Number::New(stats.points));
+  result->Set(String::NewSymbol("decimated"), Number::New(stats.decimated));
+
+  V8_RETURN(Undefined());
+}
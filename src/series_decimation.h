@@ -0,0 +1,62 @@
+#ifndef NODE_OPENVG_SERIES_DECIMATION_H_
+#define NODE_OPENVG_SERIES_DECIMATION_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+#include "chart_geometry.h"
+
+using namespace v8;
+
+// Downsampling of series far longer than the surface is wide, before they
+// become chart polylines. Min/max keeps, for each pixel column, the lowest
+// and highest point in the order they came, so spikes survive; Largest-
+// Triangle-Three-Buckets keeps one point per bucket, the one making the
+// largest triangle with the point kept before and the average of the next
+// bucket, following the shape of the series rather than its extremes.
+//
+// Only the points within the axis' x range are decimated, and x values
+// must be ascending. NaN values are skipped, a column or bucket of nothing
+// else leaving a gap.
+namespace decimation {
+
+enum method_t {
+  kMinMax = 0,
+  kLTTB
+};
+
+struct stats_t {
+  size_t series;
+  size_t points;     // Read
+  size_t decimated;  // Kept
+};
+
+// Replaces xs and ys with about columns points of series (two per column
+// for min/max); returns their count.
+size_t Decimate(const charts::series_t &series, const charts::axis_t &axis,
+                method_t method, size_t columns,
+                std::vector<VGfloat> *xs, std::vector<VGfloat> *ys);
+
+// Appends the decimated series to path as charts::Polyline does; returns
+// the segments appended.
+size_t Polyline(VGPath path, const charts::series_t &series,
+                const charts::axis_t &axis, method_t method, size_t columns);
+
+void GetStats(stats_t *stats);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(DecimateSeries);
+V8_FUNCTION_DECL(ChartDecimated);
+V8_FUNCTION_DECL(GetDecimationStats);
+
+}
+
+#endif
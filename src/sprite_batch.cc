@@ -0,0 +1,175 @@
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "VG/openvg.h"
+
+#include "sprite_batch.h"
+#include "image_registry.h"
+#include "matrix_stack.h"
+#include "state_cache.h"
+#include "typed_array.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+const size_t kColorTransformValues = 8;
+
+size_t batches = 0, spriteCount = 0;
+
+// Sprite indices, kept between batches
+std::vector<uint32_t> order;
+
+struct by_image_t {
+  const VGImage *images;
+
+  bool operator()(uint32_t a, uint32_t b) const {
+    return images[a] < images[b];
+  }
+};
+
+}
+
+void sprites::Draw(const batch_t &batch) {
+  if (batch.count == 0) {
+    return;
+  }
+  batches++;
+  spriteCount += batch.count;
+
+  order.resize(batch.count);
+  for (size_t i = 0; i < batch.count; i++) {
+    order[i] = (uint32_t) i;
+  }
+  if (batch.sort) {
+    by_image_t byImage = { batch.images };
+    std::stable_sort(order.begin(), order.end(), byImage);
+  }
+
+  VGint matrixMode = state::MatrixMode();
+  state::SetI(VG_MATRIX_MODE, VG_MATRIX_IMAGE_USER_TO_SURFACE);
+  matrices::Push();
+  VGfloat base[9], m[9];
+  matrices::Get(base);
+  memcpy(m, base, sizeof(m));
+
+  VGint colorTransform = VG_FALSE;
+  VGfloat colorTransformValues[kColorTransformValues];
+  if (batch.colorTransforms != NULL) {
+    colorTransform = vgGeti(VG_COLOR_TRANSFORM);
+    vgGetfv(VG_COLOR_TRANSFORM_VALUES, kColorTransformValues,
+            colorTransformValues);
+    state::SetI(VG_COLOR_TRANSFORM, VG_TRUE);
+  }
+
+  for (size_t i = 0; i < batch.count; i++) {
+    uint32_t sprite = order[i];
+    const VGfloat *t = batch.transforms + sprite * batch.stride;
+
+    if (batch.stride == 2 ||
+        (t[0] == 1 && t[1] == 0 && t[2] == 0 && t[3] == 1)) {
+      const VGfloat tx = t[batch.stride - 2], ty = t[batch.stride - 1];
+      memcpy(m, base, sizeof(VGfloat) * 6);
+      m[6] = base[6] + base[0] * tx + base[3] * ty;
+      m[7] = base[7] + base[1] * tx + base[4] * ty;
+      m[8] = base[8] + base[2] * tx + base[5] * ty;
+    } else {
+      // base * (t[0] t[2] t[4]; t[1] t[3] t[5]; 0 0 1)
+      for (int row = 0; row < 3; row++) {
+        m[row] = base[row] * t[0] + base[3 + row] * t[1];
+        m[3 + row] = base[row] * t[2] + base[3 + row] * t[3];
+        m[6 + row] = base[row] * t[4] + base[3 + row] * t[5] + base[6 + row];
+      }
+    }
+    matrices::Load(m);
+
+    if (batch.colorTransforms != NULL) {
+      state::SetFV(VG_COLOR_TRANSFORM_VALUES, kColorTransformValues,
+                   batch.colorTransforms + sprite * kColorTransformValues);
+    }
+
+    matrices::Sync();
+    registry::Draw(batch.images[sprite]);
+  }
+
+  if (batch.colorTransforms != NULL) {
+    state::SetFV(VG_COLOR_TRANSFORM_VALUES, kColorTransformValues,
+                 colorTransformValues);
+    state::SetI(VG_COLOR_TRANSFORM, colorTransform);
+  }
+  matrices::Pop();
+  state::SetI(VG_MATRIX_MODE, matrixMode);
+}
+
+void sprites::GetStats(stats_t *stats) {
+  stats->batches = batches;
+  stats->sprites = spriteCount;
+}
+
+
+extern void sprites::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "drawImages"    , sprites::DrawImages);
+  NODE_SET_METHOD(target, "getSpriteStats", sprites::GetSpriteStats);
+}
+
+V8_METHOD(sprites::DrawImages) {
+  HandleScope scope;
+
+  // Always checked: the arrays are read below
+  if (!(args.Length() == 6 && IsUint32Array(args[0]) &&
+        IsFloat32Array(args[1]) && args[2]->IsUint32() &&
+        (IsFloat32Array(args[3]) || args[3]->IsNull()) &&
+        args[4]->IsUint32() && args[5]->IsBoolean())) {
+    V8_THROW(Exception::TypeError(String::New("Invalid arguments: Expected drawImages(Uint32Array, Float32Array, Number, Float32Array|null, Number, Boolean)")));
+  }
+
+  TypedArrayWrapper<VGImage> images(args[0]);
+  TypedArrayWrapper<VGfloat> transforms(args[1]);
+
+  batch_t batch;
+  batch.images = images.pointer();
+  batch.transforms = transforms.pointer();
+  batch.stride = args[2]->Uint32Value();
+  batch.colorTransforms = NULL;
+  batch.count = args[4]->Uint32Value();
+  batch.sort = args[5]->BooleanValue();
+
+  if (batch.stride != 2 && batch.stride != 6) {
+    V8_THROW(Exception::TypeError(String::New("drawImages: transforms take 2 or 6 values per sprite")));
+  }
+  if ((size_t) images.length() < batch.count ||
+      (size_t) transforms.length() < batch.count * batch.stride) {
+    V8_THROW(Exception::RangeError(String::New("drawImages: arrays shorter than count sprites")));
+  }
+
+  if (!args[3]->IsNull()) {
+    TypedArrayWrapper<VGfloat> colorTransforms(args[3]);
+    if ((size_t) colorTransforms.length() < batch.count * kColorTransformValues) {
+      V8_THROW(Exception::RangeError(String::New("drawImages: color transforms shorter than count sprites")));
+    }
+    batch.colorTransforms = colorTransforms.pointer();
+  }
+
+  Draw(batch);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(sprites::GetSpriteStats) {
+  HandleScope scope;
+
+  CheckArgs1(getSpriteStats, stats, Object);
+
+  stats_t stats;
+  GetStats(&stats);
+
+  Local<Object> result = args[0].As<Object>();
+  result->Set(String::NewSymbol("batches"), Number::New(stats.batches));
+  result->Set(String::NewSymbol("sprites"), Number::New(stats.sprites));
+
+  V8_RETURN(Undefined());
+}
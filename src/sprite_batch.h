@@ -0,0 +1,51 @@
+#ifndef NODE_OPENVG_SPRITE_BATCH_H_
+#define NODE_OPENVG_SPRITE_BATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// Many images drawn with one call, each under the current image matrix
+// times a transform of its own: a translation (tx, ty) or an affine matrix
+// (sx, shy, shx, sy, tx, ty, the first two rows of vgLoadMatrix's columns).
+// Translations only add to the last column, and a matrix the driver already
+// has isn't loaded again. Sprites may carry VG_COLOR_TRANSFORM_VALUES,
+// eight values each, set only when they differ from the previous sprite's.
+// Sorting groups the sprites by image, for drivers that switch textures
+// between images, when the order they overlap in doesn't matter.
+namespace sprites {
+
+struct batch_t {
+  const VGImage *images;
+  const VGfloat *transforms;
+  size_t stride;                   // 2 or 6 values per sprite
+  const VGfloat *colorTransforms;  // 8 values per sprite, or NULL
+  size_t count;
+  bool sort;
+};
+
+struct stats_t {
+  size_t batches;
+  size_t sprites;
+};
+
+void Draw(const batch_t &batch);
+
+void GetStats(stats_t *stats);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(DrawImages);
+V8_FUNCTION_DECL(GetSpriteStats);
+
+}
+
+#endif
@@ -0,0 +1,514 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <vector>
+
+#include "VG/openvg.h"
+
+#include "state_cache.h"
+#include "draw_reorder.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+// The parameters of the OpenVG 1.1 context are 0x1100 to 0x11ff, extension
+// parameters elsewhere go straight to the driver.
+const VGint kFirstParam = 0x1100;
+const VGint kParamCount = 0x100;
+
+enum kind_t {
+  kUnknown = 0,
+  kFloat,
+  kInt,
+  kFloatVector,
+  kIntVector
+};
+
+struct entry_t {
+  kind_t kind;
+  std::vector<uint32_t> bits;
+};
+
+entry_t params[kParamCount];
+
+struct paint_entry_t {
+  bool known;
+  VGPaint paint;
+};
+
+paint_entry_t fillPaint = { false, VG_INVALID_HANDLE };
+paint_entry_t strokePaint = { false, VG_INVALID_HANDLE };
+
+// What state blocks may hold. Vectors have count values or, with a count
+// of 0, any multiple of multiple up to the limit query times multiple.
+struct param_spec_t {
+  VGParamType type;
+  bool vector;
+  bool isFloat;
+  VGint minValue, maxValue;  // Integer parameters
+  VGint count;
+  VGint multiple;
+  VGint limit;  // VGParamType
+};
+
+const param_spec_t kBlockParams[] = {
+  { VG_STROKE_LINE_WIDTH, false, true, 0, 0, 1, 1, 0 },
+  { VG_STROKE_CAP_STYLE, false, false, VG_CAP_BUTT, VG_CAP_SQUARE, 1, 1, 0 },
+  { VG_STROKE_JOIN_STYLE, false, false, VG_JOIN_MITER, VG_JOIN_BEVEL, 1, 1, 0 },
+  { VG_STROKE_MITER_LIMIT, false, true, 0, 0, 1, 1, 0 },
+  { VG_STROKE_DASH_PATTERN, true, true, 0, 0, 0, 1, VG_MAX_DASH_COUNT },
+  { VG_STROKE_DASH_PHASE, false, true, 0, 0, 1, 1, 0 },
+  { VG_STROKE_DASH_PHASE_RESET, false, false, VG_FALSE, VG_TRUE, 1, 1, 0 },
+  { VG_FILL_RULE, false, false, VG_EVEN_ODD, VG_NON_ZERO, 1, 1, 0 },
+  { VG_BLEND_MODE, false, false, VG_BLEND_SRC, VG_BLEND_ADDITIVE, 1, 1, 0 },
+  { VG_RENDERING_QUALITY, false, false, VG_RENDERING_QUALITY_NONANTIALIASED,
+    VG_RENDERING_QUALITY_BETTER, 1, 1, 0 },
+  { VG_IMAGE_MODE, false, false, VG_DRAW_IMAGE_NORMAL, VG_DRAW_IMAGE_STENCIL, 1, 1, 0 },
+  { VG_MASKING, false, false, VG_FALSE, VG_TRUE, 1, 1, 0 },
+  { VG_SCISSORING, false, false, VG_FALSE, VG_TRUE, 1, 1, 0 },
+  { VG_SCISSOR_RECTS, true, false, -0x7fffffff, 0x7fffffff, 0, 4, VG_MAX_SCISSOR_RECTS },
+  { VG_COLOR_TRANSFORM, false, false, VG_FALSE, VG_TRUE, 1, 1, 0 },
+  { VG_COLOR_TRANSFORM_VALUES, true, true, 0, 0, 8, 1, 0 },
+  { VG_CLEAR_COLOR, true, true, 0, 0, 4, 1, 0 },
+  { VG_TILE_FILL_COLOR, true, true, 0, 0, 4, 1, 0 }
+};
+
+// Shadowed as well, but not for blocks. VG_GLYPH_ORIGIN isn't shadowed as
+// drawing glyphs moves it.
+const param_spec_t kOtherParams[] = {
+  { VG_MATRIX_MODE, false, false, VG_MATRIX_PATH_USER_TO_SURFACE,
+    VG_MATRIX_GLYPH_USER_TO_SURFACE, 1, 1, 0 },
+  { VG_IMAGE_QUALITY, false, false, VG_IMAGE_QUALITY_NONANTIALIASED,
+    VG_IMAGE_QUALITY_NONANTIALIASED | VG_IMAGE_QUALITY_FASTER |
+    VG_IMAGE_QUALITY_BETTER, 1, 1, 0 },
+  { VG_PIXEL_LAYOUT, false, false, VG_PIXEL_LAYOUT_UNKNOWN,
+    VG_PIXEL_LAYOUT_BGR_HORIZONTAL, 1, 1, 0 },
+  { VG_FILTER_FORMAT_LINEAR, false, false, VG_FALSE, VG_TRUE, 1, 1, 0 },
+  { VG_FILTER_FORMAT_PREMULTIPLIED, false, false, VG_FALSE, VG_TRUE, 1, 1, 0 },
+  { VG_FILTER_CHANNEL_MASK, false, false, 0,
+    VG_RED | VG_GREEN | VG_BLUE | VG_ALPHA, 1, 1, 0 }
+};
+
+std::map<uint32_t, state::state_block_t> blocks;
+uint32_t nextBlock = 1;
+
+// Bumped whenever the shadow changes, so that applying the block applied
+// last with nothing changed since takes no work at all
+size_t generation = 0;
+uint32_t lastBlock = 0;
+size_t lastGeneration = 0;
+
+bool enabled = true;
+size_t hits = 0, misses = 0, invalidations = 0, blockHits = 0;
+
+const param_spec_t *SpecOf(VGParamType type, bool blocksOnly) {
+  for (size_t i = 0; i < sizeof(kBlockParams) / sizeof(kBlockParams[0]); i++) {
+    if (kBlockParams[i].type == type) {
+      return &kBlockParams[i];
+    }
+  }
+  for (size_t i = 0; !blocksOnly &&
+       i < sizeof(kOtherParams) / sizeof(kOtherParams[0]); i++) {
+    if (kOtherParams[i].type == type) {
+      return &kOtherParams[i];
+    }
+  }
+  return NULL;
+}
+
+// The limit queries are constant for an implementation
+VGint LimitOf(VGint limit) {
+  static std::map<VGint, VGint> limits;
+  std::map<VGint, VGint>::iterator it = limits.find(limit);
+  if (it == limits.end()) {
+    it = limits.insert(std::make_pair(limit, vgGeti((VGParamType) limit))).first;
+  }
+  return it->second;
+}
+
+bool CountFits(const param_spec_t *spec, VGint count) {
+  return spec->count > 0 ? count == spec->count :
+    count % spec->multiple == 0 && count / spec->multiple <= LimitOf(spec->limit);
+}
+
+// Whether the driver is sure to take a value. Integer parameters set from
+// floats are left to its conversion rules.
+bool Accepted(VGParamType type, kind_t kind, VGint count, const void *values) {
+  const param_spec_t *spec = SpecOf(type, false);
+  if (spec == NULL) {
+    return false;
+  }
+
+  bool vector = kind == kFloatVector || kind == kIntVector;
+  if (spec->vector ? !vector || !CountFits(spec, count) : count != 1) {
+    return false;
+  }
+  if (spec->isFloat) {
+    return true;
+  }
+  if (kind == kFloat || kind == kFloatVector) {
+    return false;
+  }
+
+  const VGint *ints = static_cast<const VGint*>(values);
+  for (VGint i = 0; i < count; i++) {
+    if (ints[i] < spec->minValue || ints[i] > spec->maxValue) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint32_t LengthOf(const Local<Object> &array) {
+  return array->Get(String::NewSymbol("length"))->Uint32Value();
+}
+
+entry_t *EntryOf(VGParamType type) {
+  VGint index = (VGint) type - kFirstParam;
+  if (!enabled || index < 0 || index >= kParamCount) {
+    return NULL;
+  }
+  return &params[index];
+}
+
+// Records the value, returning true if the context already has it.
+bool Matches(VGParamType type, entry_t *entry, kind_t kind, VGint count,
+             const void *values) {
+  if (count < 0 || (count > 0 && values == NULL) ||
+      !Accepted(type, kind, count, values)) {
+    // Possibly an error for the driver to report, leaving the value as it was
+    entry->kind = kUnknown;
+    return false;
+  }
+
+  size_t bytes = (size_t) count * sizeof(uint32_t);
+  if (entry->kind == kind && entry->bits.size() == (size_t) count &&
+      (count == 0 || memcmp(&entry->bits[0], values, bytes) == 0)) {
+    hits++;
+    return true;
+  }
+
+  entry->kind = kind;
+  entry->bits.resize(count);
+  if (count > 0) {
+    memcpy(&entry->bits[0], values, bytes);
+  }
+  misses++;
+  generation++;
+  return false;
+}
+
+bool PaintMatches(paint_entry_t *entry, VGPaint paint) {
+  if (entry->known && entry->paint == paint) {
+    return true;
+  }
+  entry->known = true;
+  entry->paint = paint;
+  return false;
+}
+
+}
+
+void state::SetF(VGParamType type, VGfloat value) {
+  reorder::Barrier();
+
+  entry_t *entry = EntryOf(type);
+  if (entry == NULL || !Matches(type, entry, kFloat, 1, &value)) {
+    vgSetf(type, value);
+  }
+}
+
+void state::SetI(VGParamType type, VGint value) {
+  // Recorded draws keep their matrices whatever the mode
+  if (type != VG_MATRIX_MODE) {
+    reorder::Barrier();
+  }
+
+  entry_t *entry = EntryOf(type);
+  if (entry == NULL || !Matches(type, entry, kInt, 1, &value)) {
+    vgSeti(type, value);
+  }
+}
+
+void state::SetFV(VGParamType type, VGint count, const VGfloat *values) {
+  reorder::Barrier();
+
+  entry_t *entry = EntryOf(type);
+  if (entry == NULL || !Matches(type, entry, kFloatVector, count, values)) {
+    vgSetfv(type, count, values);
+  }
+}
+
+void state::SetIV(VGParamType type, VGint count, const VGint *values) {
+  reorder::Barrier();
+
+  entry_t *entry = EntryOf(type);
+  if (entry == NULL || !Matches(type, entry, kIntVector, count, values)) {
+    vgSetiv(type, count, values);
+  }
+}
+
+void state::SetPaint(VGPaint paint, VGbitfield paintModes) {
+  reorder::Barrier();
+
+  if (!enabled ||
+      (paintModes & ~(VGbitfield) (VG_FILL_PATH | VG_STROKE_PATH)) != 0) {
+    // Invalid modes are the driver's to report
+    vgSetPaint(paint, paintModes);
+    return;
+  }
+
+  VGbitfield changed = 0;
+  if ((paintModes & VG_FILL_PATH) && !PaintMatches(&fillPaint, paint)) {
+    changed |= VG_FILL_PATH;
+  }
+  if ((paintModes & VG_STROKE_PATH) && !PaintMatches(&strokePaint, paint)) {
+    changed |= VG_STROKE_PATH;
+  }
+
+  if (changed != 0 || paintModes == 0) {
+    vgSetPaint(paint, changed != 0 ? changed : paintModes);
+    misses++;
+  } else {
+    hits++;
+  }
+}
+
+VGint state::MatrixMode() {
+  entry_t *entry = EntryOf(VG_MATRIX_MODE);
+  if (entry != NULL && entry->kind == kInt) {
+    return (VGint) entry->bits[0];
+  }
+
+  VGint mode = vgGeti(VG_MATRIX_MODE);
+  if (entry != NULL) {
+    entry->kind = kInt;
+    entry->bits.assign(1, (uint32_t) mode);
+  }
+  return mode;
+}
+
+void state::ForgetPaint(VGPaint paint) {
+  if (fillPaint.paint == paint) {
+    fillPaint.known = false;
+  }
+  if (strokePaint.paint == paint) {
+    strokePaint.known = false;
+  }
+}
+
+bool state::AddToBlock(state_block_t *block, VGParamType type,
+                       const std::vector<double> &values, bool vector) {
+  const param_spec_t *spec = SpecOf(type, true);
+  if (spec == NULL || spec->vector != vector) {
+    return false;
+  }
+
+  VGint count = (VGint) values.size();
+  if (!CountFits(spec, count)) {
+    return false;
+  }
+
+  block_param_t param;
+  param.type = type;
+  param.vector = vector;
+  param.isFloat = spec->isFloat;
+  for (VGint i = 0; i < count; i++) {
+    if (spec->isFloat) {
+      param.floats.push_back((VGfloat) values[i]);
+    } else if (values[i] != floor(values[i]) ||
+               values[i] < spec->minValue || values[i] > spec->maxValue) {
+      return false;
+    } else {
+      param.ints.push_back((VGint) values[i]);
+    }
+  }
+
+  for (size_t i = 0; i < block->params.size(); i++) {
+    if (block->params[i].type == type) {
+      block->params[i] = param;
+      return true;
+    }
+  }
+  block->params.push_back(param);
+  return true;
+}
+
+void state::Apply(uint32_t id, const state_block_t &block) {
+  if (enabled && id == lastBlock && generation == lastGeneration) {
+    blockHits++;
+    return;
+  }
+
+  for (size_t i = 0; i < block.params.size(); i++) {
+    const block_param_t &param = block.params[i];
+    if (param.vector && param.isFloat) {
+      SetFV(param.type, (VGint) param.floats.size(),
+            param.floats.empty() ? NULL : &param.floats[0]);
+    } else if (param.vector) {
+      SetIV(param.type, (VGint) param.ints.size(),
+            param.ints.empty() ? NULL : &param.ints[0]);
+    } else if (param.isFloat) {
+      SetF(param.type, param.floats[0]);
+    } else {
+      SetI(param.type, param.ints[0]);
+    }
+  }
+
+  lastBlock = id;
+  lastGeneration = generation;
+}
+
+void state::Invalidate() {
+  for (VGint i = 0; i < kParamCount; i++) {
+    params[i].kind = kUnknown;
+  }
+  fillPaint.known = false;
+  strokePaint.known = false;
+  invalidations++;
+  generation++;
+}
+
+void state::SetEnabled(bool value) {
+  if (value && !enabled) {
+    // Calls made meanwhile weren't recorded
+    Invalidate();
+  }
+  enabled = value;
+}
+
+void state::GetStats(stats_t *stats) {
+  stats->enabled = enabled;
+  stats->hits = hits;
+  stats->misses = misses;
+  stats->invalidations = invalidations;
+  stats->blocks = blocks.size();
+  stats->blockHits = blockHits;
+}
+
+
+extern void state::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "setStateCacheEnabled", state::SetStateCacheEnabled);
+  NODE_SET_METHOD(target, "invalidateStateCache", state::InvalidateStateCache);
+  NODE_SET_METHOD(target, "getStateCacheStats"  , state::GetStateCacheStats);
+  NODE_SET_METHOD(target, "createStateBlock"    , state::CreateStateBlock);
+  NODE_SET_METHOD(target, "applyStateBlock"     , state::ApplyStateBlock);
+  NODE_SET_METHOD(target, "destroyStateBlock"   , state::DestroyStateBlock);
+}
+
+V8_METHOD(state::SetStateCacheEnabled) {
+  HandleScope scope;
+
+  CheckArgs1(setStateCacheEnabled, enabled, Boolean);
+
+  SetEnabled(args[0]->BooleanValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(state::InvalidateStateCache) {
+  HandleScope scope;
+
+  CheckArgs0(invalidateStateCache);
+
+  Invalidate();
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(state::GetStateCacheStats) {
+  HandleScope scope;
+
+  CheckArgs1(getStateCacheStats, stats, Object);
+
+  stats_t stats;
+  GetStats(&stats);
+
+  Local<Object> result = args[0].As<Object>();
+  result->Set(String::NewSymbol("enabled"), Boolean::New(stats.enabled));
+  result->Set(String::NewSymbol("hits"), Number::New(stats.hits));
+  result->Set(String::NewSymbol("misses"), Number::New(stats.misses));
+  result->Set(String::NewSymbol("invalidations"), Number::New(stats.invalidations));
+  result->Set(String::NewSymbol("blocks"), Number::New(stats.blocks));
+  result->Set(String::NewSymbol("blockHits"), Number::New(stats.blockHits));
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(state::CreateStateBlock) {
+  HandleScope scope;
+
+  CheckArgs1(createStateBlock, params, Object);
+
+  // Keys are VGParamType values, values numbers or arrays of numbers
+  Local<Object> source = args[0].As<Object>();
+  Local<Array> types = source->GetPropertyNames();
+
+  state_block_t block;
+  std::vector<double> values;
+  for (uint32_t i = 0; i < types->Length(); i++) {
+    Local<Value> key = types->Get(i);
+    Local<Value> value = source->Get(key);
+    bool vector = value->IsArray();
+
+    values.clear();
+    if (vector) {
+      Local<Object> array = value.As<Object>();
+      uint32_t length = LengthOf(array);
+      for (uint32_t j = 0; j < length; j++) {
+        values.push_back(array->Get(j)->NumberValue());
+      }
+    } else if (value->IsNumber() || value->IsBoolean()) {
+      values.push_back(value->NumberValue());
+    }
+
+    if ((values.empty() && !vector) ||
+        !AddToBlock(&block, (VGParamType) key->Uint32Value(), values, vector)) {
+      char message[80];
+      snprintf(message, sizeof(message),
+               "createStateBlock: invalid value for parameter 0x%x",
+               key->Uint32Value());
+      V8_THROW(Exception::TypeError(String::New(message)));
+    }
+  }
+
+  uint32_t id = nextBlock++;
+  blocks[id] = block;
+
+  V8_RETURN(Uint32::New(id));
+}
+
+V8_METHOD(state::ApplyStateBlock) {
+  HandleScope scope;
+
+  CheckArgs1(applyStateBlock, block, Uint32);
+
+  uint32_t id = args[0]->Uint32Value();
+  std::map<uint32_t, state_block_t>::iterator it = blocks.find(id);
+  if (it == blocks.end()) {
+    V8_THROW(Exception::TypeError(String::New("applyStateBlock: unknown state block")));
+  }
+
+  Apply(id, it->second);
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(state::DestroyStateBlock) {
+  HandleScope scope;
+
+  CheckArgs1(destroyStateBlock, block, Uint32);
+
+  uint32_t id = args[0]->Uint32Value();
+  blocks.erase(id);
+  if (lastBlock == id) {
+    lastBlock = 0;
+  }
+
+  V8_RETURN(Undefined());
+}
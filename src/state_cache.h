@@ -0,0 +1,96 @@
+#ifndef NODE_OPENVG_STATE_CACHE_H_
+#define NODE_OPENVG_STATE_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// Shadow copy of the context state set through the bindings (vgSetf, vgSeti,
+// vgSetfv, vgSetiv, which covers VG_MATRIX_MODE, and vgSetPaint), so that
+// calls setting a value the context already has never reach the driver.
+// Values are compared as they were passed, bit for bit, and a parameter
+// set as a float doesn't match the same value set as an integer. Only
+// values the driver is sure to take are recorded, other calls leaving the
+// parameter unknown, and VG_GLYPH_ORIGIN, which drawing glyphs moves, is
+// never shadowed.
+//
+// The shadow is forgotten when another surface or context is made current.
+// Native code should set these parameters through the setters below; code
+// that sets them directly must put the previous values back before
+// returning, or call Invalidate().
+//
+// Setters other than VG_MATRIX_MODE's first draw what draw_reorder.h is
+// holding back, as those draws were recorded under the current values.
+//
+// State blocks are validated sets of stroke, fill and blending parameters
+// applied together, with only the parameters the shadow doesn't already
+// have reaching the driver.
+namespace state {
+
+struct stats_t {
+  bool enabled;
+  size_t hits;       // Calls skipped
+  size_t misses;     // Calls made
+  size_t invalidations;
+  size_t blocks;
+  size_t blockHits;  // Blocks applied with nothing to set
+};
+
+struct block_param_t {
+  VGParamType type;
+  bool vector;
+  bool isFloat;
+  std::vector<VGfloat> floats;  // One of the two, as isFloat says
+  std::vector<VGint> ints;
+};
+
+struct state_block_t {
+  std::vector<block_param_t> params;
+};
+
+void SetF(VGParamType type, VGfloat value);
+void SetI(VGParamType type, VGint value);
+void SetFV(VGParamType type, VGint count, const VGfloat *values);
+void SetIV(VGParamType type, VGint count, const VGint *values);
+void SetPaint(VGPaint paint, VGbitfield paintModes);
+
+// VG_MATRIX_MODE from the shadow, read from the driver when unknown.
+VGint MatrixMode();
+
+// A destroyed paint's handle may be reused by the driver for a new one.
+void ForgetPaint(VGPaint paint);
+
+// Checks a value given for a state block parameter and adds it, replacing
+// an earlier one. Returns false for parameters blocks can't hold and for
+// values out of their range.
+bool AddToBlock(state_block_t *block, VGParamType type,
+                const std::vector<double> &values, bool vector);
+
+void Apply(uint32_t id, const state_block_t &block);
+
+void Invalidate();
+void SetEnabled(bool enabled);
+void GetStats(stats_t *stats);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(SetStateCacheEnabled);
+V8_FUNCTION_DECL(InvalidateStateCache);
+V8_FUNCTION_DECL(GetStateCacheStats);
+V8_FUNCTION_DECL(CreateStateBlock);
+V8_FUNCTION_DECL(ApplyStateBlock);
+V8_FUNCTION_DECL(DestroyStateBlock);
+
+}
+
+#endif
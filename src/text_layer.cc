@@ -0,0 +1,354 @@
+#include <math.h>
+
+#include <algorithm>
+#include <map>
+
+#include "VG/openvg.h"
+
+#include "text_layer.h"
+#include "font_face.h"
+#include "glyph_cache.h"
+#include "image_registry.h"
+#include "egl.h"
+#include "matrix_stack.h"
+#include "state_cache.h"
+#include "argchecks.h"
+
+using namespace v8;
+using namespace node;
+
+namespace {
+
+const VGint kPadding = 1;
+const VGbitfield kQuality = VG_IMAGE_QUALITY_NONANTIALIASED;
+
+struct line_t {
+  size_t start, length;  // UTF-16 code units
+};
+
+std::map<uint32_t, textlayers::text_layer_t> layers;
+uint32_t nextLayer = 1;
+
+void SplitLines(const std::vector<uint16_t> &text, std::vector<line_t> *lines) {
+  line_t line = { 0, 0 };
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '\n') {
+      line.length = i - line.start;
+      lines->push_back(line);
+      line.start = i + 1;
+    }
+  }
+  line.length = text.size() - line.start;
+  lines->push_back(line);
+}
+
+void ReleaseImage(textlayers::text_layer_t *layer) {
+  if (layer->image != VG_INVALID_HANDLE) {
+    registry::Destroy(layer->image);
+    layer->image = VG_INVALID_HANDLE;
+  }
+}
+
+// Pixel bounds of the laid out glyphs relative to the first pen. Returns
+// false if nothing would be drawn.
+bool Bounds(const textlayers::text_layer_t *layer,
+            const faces::face_t *face, const std::vector<line_t> &lines,
+            VGint *left, VGint *bottom, VGint *right, VGint *top) {
+  bool found = false;
+  VGfloat minX = 0, minY = 0, maxX = 0, maxY = 0;
+  std::vector<VGuint> glyphs;
+
+  for (size_t i = 0; i < lines.size(); i++) {
+    glyphs.clear();
+    faces::GlyphsOf(face, &layer->text[0] + lines[i].start, lines[i].length,
+                    &glyphs);
+    VGfloat pen = 0, baseline = -layer->lineHeight * i;
+
+    for (size_t j = 0; j < glyphs.size(); j++) {
+      VGfloat x = 0, y = 0, width = -1, height = -1;
+      vgPathBounds(faces::Path(layer->face, glyphs[j]), &x, &y, &width, &height);
+      if (width > 0 && height > 0) {
+        VGfloat x0 = pen + x * layer->size, y0 = baseline + y * layer->size;
+        VGfloat x1 = x0 + width * layer->size, y1 = y0 + height * layer->size;
+        if (!found) {
+          minX = x0; minY = y0; maxX = x1; maxY = y1;
+          found = true;
+        } else {
+          minX = fminf(minX, x0); minY = fminf(minY, y0);
+          maxX = fmaxf(maxX, x1); maxY = fmaxf(maxY, y1);
+        }
+      }
+      pen += layer->size * face->advances[glyphs[j]];
+    }
+  }
+
+  *left = (VGint) floorf(minX) - kPadding;
+  *bottom = (VGint) floorf(minY) - kPadding;
+  *right = (VGint) ceilf(maxX) + kPadding;
+  *top = (VGint) ceilf(maxY) + kPadding;
+  return found;
+}
+
+// Draws the outlines into the layer's image.
+bool DrawOutlines(const textlayers::text_layer_t *layer,
+                  const faces::face_t *face, const std::vector<line_t> &lines) {
+  std::vector<glyphs::outline_t> outlines;
+  std::vector<VGuint> indices;
+  for (size_t i = 0; i < lines.size(); i++) {
+    indices.clear();
+    faces::GlyphsOf(face, &layer->text[0] + lines[i].start, lines[i].length,
+                    &indices);
+    glyphs::outline_t outline;
+    outline.face = layer->face;
+    outline.x = (VGfloat) -layer->left;
+    outline.y = -layer->lineHeight * i - layer->bottom;
+    outline.size = layer->size;
+
+    for (size_t j = 0; j < indices.size(); j++) {
+      outline.glyph = indices[j];
+      outlines.push_back(outline);
+      outline.x += layer->size * face->advances[indices[j]];
+    }
+  }
+  return glyphs::RenderOutlines(layer->image, layer->width, layer->height,
+                                outlines);
+}
+
+// Lays the text out and renders it, reusing the image when the size is the
+// same. Returns false when the outlines have to be drawn instead.
+bool Render(textlayers::text_layer_t *layer) {
+  const faces::face_t *face = faces::Get(layer->face);
+  std::vector<line_t> lines;
+  SplitLines(layer->text, &lines);
+
+  VGint left, bottom, right, top;
+  if (face == NULL || layer->text.empty() ||
+      !Bounds(layer, face, lines, &left, &bottom, &right, &top)) {
+    ReleaseImage(layer);
+    return true;
+  }
+  if (!glyphs::CanRenderOutlines() ||
+      right - left > vgGeti(VG_MAX_IMAGE_WIDTH) ||
+      top - bottom > vgGeti(VG_MAX_IMAGE_HEIGHT)) {
+    ReleaseImage(layer);
+    return false;
+  }
+
+  if (layer->image == VG_INVALID_HANDLE ||
+      layer->width != right - left || layer->height != top - bottom) {
+    ReleaseImage(layer);
+    layer->image = registry::Create(VG_sRGBA_8888_PRE, right - left,
+                                    top - bottom, kQuality);
+    if (layer->image == VG_INVALID_HANDLE) {
+      return false;
+    }
+  }
+  layer->left = left;
+  layer->bottom = bottom;
+  layer->width = right - left;
+  layer->height = top - bottom;
+
+  if (!DrawOutlines(layer, face, lines)) {
+    ReleaseImage(layer);
+    return false;
+  }
+  layer->renders++;
+  return true;
+}
+
+void DrawLines(const textlayers::text_layer_t *layer, VGfloat x, VGfloat y) {
+  std::vector<line_t> lines;
+  SplitLines(layer->text, &lines);
+  for (size_t i = 0; i < lines.size(); i++) {
+    if (lines[i].length > 0) {
+      faces::Draw(layer->face, &layer->text[0] + lines[i].start,
+                  lines[i].length, x, y - layer->lineHeight * i,
+                  layer->size, VG_FILL_PATH);
+    }
+  }
+}
+
+}
+
+void textlayers::Init(text_layer_t *layer) {
+  layer->face = 0;
+  layer->size = 0;
+  layer->lineHeight = 0;
+  layer->image = VG_INVALID_HANDLE;
+  layer->dirty = true;
+  layer->outlines = false;
+  layer->left = layer->bottom = 0;
+  layer->width = layer->height = 0;
+  layer->renders = 0;
+  layer->draws = 0;
+}
+
+void textlayers::Destroy(text_layer_t *layer) {
+  ReleaseImage(layer);
+}
+
+bool textlayers::Set(text_layer_t *layer, uint32_t face,
+                     const uint16_t *text, size_t length,
+                     VGfloat size, VGfloat lineHeight) {
+  if (layer->face == face && layer->size == size &&
+      layer->lineHeight == lineHeight && layer->text.size() == length &&
+      std::equal(text, text + length, layer->text.begin())) {
+    return false;
+  }
+
+  layer->face = face;
+  layer->text.assign(text, text + length);
+  layer->size = size;
+  layer->lineHeight = lineHeight;
+  layer->dirty = true;
+  return true;
+}
+
+void textlayers::Draw(text_layer_t *layer, VGfloat x, VGfloat y) {
+  if (layer->dirty) {
+    layer->outlines = !Render(layer);
+    layer->dirty = false;
+  }
+  layer->draws++;
+
+  if (layer->outlines) {
+    DrawLines(layer, x, y);
+    return;
+  }
+  if (layer->image == VG_INVALID_HANDLE) {
+    return;
+  }
+
+  matrices::Sync();
+  VGint matrixMode = state::MatrixMode();
+  VGint imageMode = vgGeti(VG_IMAGE_MODE);
+  state::SetI(VG_MATRIX_MODE, VG_MATRIX_PATH_USER_TO_SURFACE);
+  VGfloat pathMatrix[9];
+  vgGetMatrix(pathMatrix);
+  state::SetI(VG_MATRIX_MODE, VG_MATRIX_IMAGE_USER_TO_SURFACE);
+  VGfloat imageMatrix[9];
+  vgGetMatrix(imageMatrix);
+
+  vgLoadMatrix(pathMatrix);
+  vgTranslate(x + layer->left, y + layer->bottom);
+  state::SetI(VG_IMAGE_MODE, VG_DRAW_IMAGE_STENCIL);
+  registry::Draw(layer->image);
+
+  state::SetI(VG_IMAGE_MODE, imageMode);
+  vgLoadMatrix(imageMatrix);
+  state::SetI(VG_MATRIX_MODE, matrixMode);
+}
+
+textlayers::text_layer_t *textlayers::Find(uint32_t id) {
+  std::map<uint32_t, text_layer_t>::iterator it = layers.find(id);
+  return it != layers.end() ? &it->second : NULL;
+}
+
+bool textlayers::GetBounds(const text_layer_t *layer,
+                           VGint *left, VGint *bottom, VGint *right, VGint *top) {
+  const faces::face_t *face = faces::Get(layer->face);
+  if (face == NULL || layer->text.empty()) {
+    return false;
+  }
+  std::vector<line_t> lines;
+  SplitLines(layer->text, &lines);
+  return Bounds(layer, face, lines, left, bottom, right, top);
+}
+
+
+extern void textlayers::InitBindings(Handle<Object> target) {
+  NODE_SET_METHOD(target, "createTextLayer" , textlayers::CreateTextLayer);
+  NODE_SET_METHOD(target, "setTextLayer"    , textlayers::SetTextLayer);
+  NODE_SET_METHOD(target, "drawTextLayer"   , textlayers::DrawTextLayer);
+  NODE_SET_METHOD(target, "destroyTextLayer", textlayers::DestroyTextLayer);
+  NODE_SET_METHOD(target, "getTextLayerInfo", textlayers::GetTextLayerInfo);
+}
+
+V8_METHOD(textlayers::CreateTextLayer) {
+  HandleScope scope;
+
+  CheckArgs4(createTextLayer, face, Uint32, text, String,
+             size, Number, lineHeight, Number);
+
+  uint32_t id = nextLayer++;
+  text_layer_t &layer = layers[id];
+  Init(&layer);
+
+  String::Value text(args[1]);
+  Set(&layer, args[0]->Uint32Value(), *text, text.length(),
+      (VGfloat) args[2]->NumberValue(), (VGfloat) args[3]->NumberValue());
+
+  V8_RETURN(Uint32::New(id));
+}
+
+V8_METHOD(textlayers::SetTextLayer) {
+  HandleScope scope;
+
+  CheckArgs5(setTextLayer, layer, Uint32, face, Uint32, text, String,
+             size, Number, lineHeight, Number);
+
+  std::map<uint32_t, text_layer_t>::iterator it = layers.find(args[0]->Uint32Value());
+  if (it == layers.end()) {
+    V8_THROW(Exception::TypeError(String::New("setTextLayer: unknown text layer")));
+  }
+
+  String::Value text(args[2]);
+  bool changed = Set(&it->second, args[1]->Uint32Value(), *text, text.length(),
+                     (VGfloat) args[3]->NumberValue(),
+                     (VGfloat) args[4]->NumberValue());
+
+  V8_RETURN(Boolean::New(changed));
+}
+
+V8_METHOD(textlayers::DrawTextLayer) {
+  HandleScope scope;
+
+  CheckArgs3(drawTextLayer, layer, Uint32, x, Number, y, Number);
+
+  std::map<uint32_t, text_layer_t>::iterator it = layers.find(args[0]->Uint32Value());
+  if (it == layers.end()) {
+    V8_THROW(Exception::TypeError(String::New("drawTextLayer: unknown text layer")));
+  }
+
+  Draw(&it->second, (VGfloat) args[1]->NumberValue(),
+       (VGfloat) args[2]->NumberValue());
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(textlayers::DestroyTextLayer) {
+  HandleScope scope;
+
+  CheckArgs1(destroyTextLayer, layer, Uint32);
+
+  std::map<uint32_t, text_layer_t>::iterator it = layers.find(args[0]->Uint32Value());
+  if (it != layers.end()) {
+    Destroy(&it->second);
+    layers.erase(it);
+  }
+
+  V8_RETURN(Undefined());
+}
+
+V8_METHOD(textlayers::GetTextLayerInfo) {
+  HandleScope scope;
+
+  CheckArgs2(getTextLayerInfo, layer, Uint32, info, Object);
+
+  std::map<uint32_t, text_layer_t>::iterator it = layers.find(args[0]->Uint32Value());
+  if (it == layers.end()) {
+    V8_THROW(Exception::TypeError(String::New("getTextLayerInfo: unknown text layer")));
+  }
+  const text_layer_t &layer = it->second;
+
+  Local<Object> result = args[1].As<Object>();
+  result->Set(String::NewSymbol("left"), Number::New(layer.left));
+  result->Set(String::NewSymbol("bottom"), Number::New(layer.bottom));
+  result->Set(String::NewSymbol("width"), Number::New(layer.width));
+  result->Set(String::NewSymbol("height"), Number::New(layer.height));
+  result->Set(String::NewSymbol("cached"), Boolean::New(!layer.dirty && !layer.outlines));
+  result->Set(String::NewSymbol("renders"), Number::New(layer.renders));
+  result->Set(String::NewSymbol("draws"), Number::New(layer.draws));
+
+  V8_RETURN(Undefined());
+}
@@ -0,0 +1,77 @@
+#ifndef NODE_OPENVG_TEXT_LAYER_H_
+#define NODE_OPENVG_TEXT_LAYER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <v8.h>
+#include <node.h>
+
+#include "VG/openvg.h"
+
+#include "v8_helpers.h"
+
+using namespace v8;
+
+// Blocks of text that rarely change (labels, headings) rendered once into a
+// VGImage through a pbuffer and then drawn with a single vgDrawImage, until
+// their text, face or size changes. The image holds white coverage and is
+// drawn as a stencil with the current fill paint, so changing the colour
+// doesn't render it again. Text is laid out at one pixel per user unit with
+// the first line's pen at the origin and each '\n' starting a line
+// lineHeight lower; the faces are those of font_face.h, whose outlines need
+// VG_PATH_CAPABILITY_PATH_BOUNDS.
+namespace textlayers {
+
+struct text_layer_t {
+  uint32_t face;
+  std::vector<uint16_t> text;  // UTF-16
+  VGfloat size;
+  VGfloat lineHeight;
+
+  VGImage image;  // VG_INVALID_HANDLE until rendered, or when empty
+  bool dirty;
+  bool outlines;  // Drawn from the outlines instead of an image
+  VGint left, bottom;  // Image origin relative to the pen
+  VGint width, height;
+
+  size_t renders;
+  size_t draws;
+};
+
+void Init(text_layer_t *layer);
+void Destroy(text_layer_t *layer);
+
+// Marks the layer for rendering again if anything differs. Returns whether
+// it did.
+bool Set(text_layer_t *layer, uint32_t face,
+         const uint16_t *text, size_t length,
+         VGfloat size, VGfloat lineHeight);
+
+// Draws the layer with the first line's pen at (x, y) in path user
+// coordinates, rendering it first if needed. Falls back to drawing the
+// outlines when the driver can't draw into images or the text is larger
+// than an image can be.
+void Draw(text_layer_t *layer, VGfloat x, VGfloat y);
+
+// The layer created through the bindings with that id, or NULL.
+text_layer_t *Find(uint32_t id);
+
+// Pixel bounds of the laid out text relative to the first pen, without
+// rendering it. Returns false if nothing would be drawn.
+bool GetBounds(const text_layer_t *layer,
+               VGint *left, VGint *bottom, VGint *right, VGint *top);
+
+extern void InitBindings(Handle<Object> target);
+
+V8_FUNCTION_DECL(CreateTextLayer);
+V8_FUNCTION_DECL(SetTextLayer);
+V8_FUNCTION_DECL(DrawTextLayer);
+V8_FUNCTION_DECL(DestroyTextLayer);
+V8_FUNCTION_DECL(GetTextLayerInfo);
+
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef NODE_OPENVG_TYPED_ARRAY_H_
+#define NODE_OPENVG_TYPED_ARRAY_H_
+
+#include <v8.h>
+
+using namespace v8;
+
+// TYPED_ARRAY_TYPE_* defined in bindings.gyp
+#ifdef TYPED_ARRAY_TYPE_PRE_0_11
+template<class C> class TypedArrayWrapper {
+ private:
+  Local<Object> array;
+  Handle<Object> buffer;
+  int byteOffset;
+ public:
+  inline __attribute__((always_inline)) TypedArrayWrapper(const Local<Value>& arg) :
+    array(arg->ToObject()),
+    buffer(array->Get(String::New("buffer"))->ToObject()),
+    byteOffset(array->Get(String::New("byteOffset"))->Int32Value()) {
+  }
+
+  inline __attribute__((always_inline)) C* pointer(int offset = 0) {
+    return (C*) &((char*) buffer->GetIndexedPropertiesExternalArrayData())[byteOffset + offset];
+  }
+
+  inline __attribute__((always_inline)) int length() {
+    return array->Get(String::New("length"))->Uint32Value();
+  }
+};
+#else
+template<class C> class TypedArrayWrapper {
+ private:
+  Local<TypedArray> array;
+ public:
+  inline __attribute__((always_inline)) TypedArrayWrapper(const Local<Value>& arg) :
+    array(Handle<TypedArray>::Cast(arg->ToObject())) {
+  }
+
+  inline __attribute__((always_inline)) C* pointer(int offset = 0) {
+    return (C*) &((char*) array->BaseAddress())[offset];
+  }
+
+  inline __attribute__((always_inline)) int length() {
+    return array->Length();
+  }
+};
+#endif
+
+// For arguments read or written through TypedArrayWrapper<VGfloat>, whose
+// length counts floats only if they are one
+inline bool IsFloat32Array(const Local<Value>& arg) {
+#ifdef TYPED_ARRAY_TYPE_PRE_0_11
+  return arg->IsObject() &&
+         arg->ToObject()->GetIndexedPropertiesExternalArrayDataType() ==
+           kExternalFloatArray;
+#else
+  return arg->IsFloat32Array();
+#endif
+}
+
+// Likewise for TypedArrayWrapper<VGuint> and 32 bit handles
+inline bool IsUint32Array(const Local<Value>& arg) {
+#ifdef TYPED_ARRAY_TYPE_PRE_0_11
+  return arg->IsObject() &&
+         arg->ToObject()->GetIndexedPropertiesExternalArrayDataType() ==
+           kExternalUnsignedIntArray;
+#else
+  return arg->IsUint32Array();
+#endif
+}
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef V8_HELPERS_H_
 #define V8_HELPERS_H_
 
+#include <v8.h>
+
 // V8_CALLBACK_STYLE_* defined in bindings.gyp
 #ifdef V8_CALLBACK_STYLE_PRE_3_20
 #define V8_METHOD(method) v8::Handle<v8::Value> method(const v8::Arguments& args)
@@ -17,4 +19,34 @@
 
 #define V8_THROW(exception) V8_RETURN(ThrowException(exception))
 
+// Persistent handle management differs on both sides of V8 3.20 as well
+template<class T>
+inline void V8PersistentReset(v8::Persistent<T>& handle,
+                              v8::Handle<T> value) {
+#ifdef V8_CALLBACK_STYLE_PRE_3_20
+  handle = v8::Persistent<T>::New(value);
+#else
+  handle.Reset(v8::Isolate::GetCurrent(), value);
+#endif
+}
+
+template<class T>
+inline v8::Local<T> V8PersistentLocal(const v8::Persistent<T>& handle) {
+#ifdef V8_CALLBACK_STYLE_PRE_3_20
+  return v8::Local<T>::New(handle);
+#else
+  return v8::Local<T>::New(v8::Isolate::GetCurrent(), handle);
+#endif
+}
+
+template<class T>
+inline void V8PersistentDispose(v8::Persistent<T>& handle) {
+#ifdef V8_CALLBACK_STYLE_PRE_3_20
+  handle.Dispose();
+  handle.Clear();
+#else
+  handle.Reset();
+#endif
+}
+
 #endif